@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "ref_ptr.h"
+
+#if defined(_WIN32)
+#include <dxgi1_6.h>
+#include <wrl/client.h> // ComPtr
+#endif
+
+// an adapter and the outputs attached into it at the time of the enumeration.
+struct AdapterInfo {
+	DXGI_ADAPTER_DESC				desc;
+	std::vector<DXGI_OUTPUT_DESC>	outputs;
+};
+
+// a utility to compare LUIDs so adapters can be ordered and searched by them.
+inline bool luidLess(const LUID& a, const LUID& b) {
+	return a.HighPart != b.HighPart ? a.HighPart < b.HighPart : a.LowPart < b.LowPart;
+}
+
+// a utility to check whether two LUIDs are the same.
+inline bool luidEqual(const LUID& a, const LUID& b) {
+	return a.HighPart == b.HighPart && a.LowPart == b.LowPart;
+}
+
+// ============================================================================
+// AdapterTopology
+//
+// An immutable snapshot of the display adapters and their outputs. Adapters
+// are sorted by their LUIDs, which stay the same until the system restarts.
+// Each published snapshot has a version that grows by one on each change.
+// ============================================================================
+struct AdapterTopology {
+	uint64_t					version;
+	std::vector<AdapterInfo>	adapters;
+
+	const AdapterInfo* find(const LUID& luid) const {
+		auto it = std::lower_bound(adapters.begin(), adapters.end(), luid, [](const AdapterInfo& info, const LUID& luid) {
+			return luidLess(info.desc.AdapterLuid, luid);
+		});
+		return (it != adapters.end() && luidEqual(it->desc.AdapterLuid, luid)) ? &*it : nullptr;
+	}
+};
+
+// the changes between two versions of the adapter topology.
+struct AdapterTopologyDiff {
+	uint64_t			fromVersion;
+	uint64_t			toVersion;
+	std::vector<LUID>	added;
+	std::vector<LUID>	removed;
+	std::vector<LUID>	changed;
+
+	bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+};
+
+// a utility to check whether the descriptions of two adapters are the same.
+inline bool adapterInfoEqual(const AdapterInfo& a, const AdapterInfo& b) {
+	if (std::memcmp(a.desc.Description, b.desc.Description, sizeof(a.desc.Description)) != 0
+		|| a.desc.VendorId != b.desc.VendorId
+		|| a.desc.DeviceId != b.desc.DeviceId
+		|| a.desc.SubSysId != b.desc.SubSysId
+		|| a.desc.Revision != b.desc.Revision
+		|| a.desc.DedicatedVideoMemory != b.desc.DedicatedVideoMemory
+		|| a.desc.DedicatedSystemMemory != b.desc.DedicatedSystemMemory
+		|| a.desc.SharedSystemMemory != b.desc.SharedSystemMemory
+		|| a.outputs.size() != b.outputs.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.outputs.size(); i++) {
+		auto& x = a.outputs[i];
+		auto& y = b.outputs[i];
+		if (std::memcmp(x.DeviceName, y.DeviceName, sizeof(x.DeviceName)) != 0
+			|| x.DesktopCoordinates.left != y.DesktopCoordinates.left
+			|| x.DesktopCoordinates.top != y.DesktopCoordinates.top
+			|| x.DesktopCoordinates.right != y.DesktopCoordinates.right
+			|| x.DesktopCoordinates.bottom != y.DesktopCoordinates.bottom
+			|| x.AttachedToDesktop != y.AttachedToDesktop
+			|| x.Rotation != y.Rotation
+			|| x.Monitor != y.Monitor) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// a utility to build the difference between two adapter topologies.
+inline AdapterTopologyDiff diffTopology(const AdapterTopology& from, const AdapterTopology& to) {
+	// both adapter lists are sorted by LUIDs, so a single merge pass is enough.
+	AdapterTopologyDiff diff;
+	diff.fromVersion = from.version;
+	diff.toVersion = to.version;
+	auto a = from.adapters.begin();
+	auto b = to.adapters.begin();
+	while (a != from.adapters.end() || b != to.adapters.end()) {
+		if (b == to.adapters.end() || (a != from.adapters.end() && luidLess(a->desc.AdapterLuid, b->desc.AdapterLuid))) {
+			diff.removed.push_back((a++)->desc.AdapterLuid);
+		} else if (a == from.adapters.end() || luidLess(b->desc.AdapterLuid, a->desc.AdapterLuid)) {
+			diff.added.push_back((b++)->desc.AdapterLuid);
+		} else {
+			if (!adapterInfoEqual(*a, *b)) {
+				diff.changed.push_back(b->desc.AdapterLuid);
+			}
+			a++;
+			b++;
+		}
+	}
+	return diff;
+}
+
+// ============================================================================
+// AdapterChangeSource
+//
+// An abstraction over the notifications about changes in the adapter set. The
+// source calls the given callback from any thread whenever the adapters may
+// have changed. Spurious calls are allowed, as the service diffs the result.
+//
+//   - start	-- Start delivering notifications into the callback
+//   - stop		-- Stop delivering notifications (blocks until stopped)
+//
+// The manual source only notifies when told to, which is used in the tests
+// and simulations. On Windows the DXGI 1.6 event source uses the function
+// IDXGIFactory7::RegisterAdaptersChangedEvent with a waiting thread.
+// ============================================================================
+class AdapterChangeSource {
+public:
+	virtual ~AdapterChangeSource() = default;
+	virtual void start(std::function<void()> callback) = 0;
+	virtual void stop() = 0;
+};
+
+class ManualAdapterChangeSource final : public AdapterChangeSource {
+public:
+	void start(std::function<void()> callback) override {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCallback = std::move(callback);
+	}
+
+	void stop() override {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCallback = nullptr;
+	}
+
+	void notify() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mCallback) {
+			mCallback();
+		}
+	}
+private:
+	std::mutex				mMutex;
+	std::function<void()>	mCallback;
+};
+
+#if defined(_WIN32)
+class DxgiAdapterChangeSource final : public AdapterChangeSource {
+public:
+	DxgiAdapterChangeSource() : mCookie(0) {
+		mChangeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		mStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	}
+
+	~DxgiAdapterChangeSource() {
+		stop();
+		CloseHandle(mChangeEvent);
+		CloseHandle(mStopEvent);
+	}
+
+	void start(std::function<void()> callback) override {
+		stop();
+		if (FAILED(CreateDXGIFactory2(0, IID_PPV_ARGS(&mFactory)))
+			|| FAILED(mFactory->RegisterAdaptersChangedEvent(mChangeEvent, &mCookie))) {
+			mFactory = nullptr;
+			return;
+		}
+		ResetEvent(mStopEvent);
+		mThread = std::thread([this, callback]() {
+			HANDLE events[] = { mChangeEvent, mStopEvent };
+			while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+				callback();
+			}
+		});
+	}
+
+	void stop() override {
+		if (mThread.joinable()) {
+			SetEvent(mStopEvent);
+			mThread.join();
+		}
+		if (mFactory) {
+			mFactory->UnregisterAdaptersChangedEvent(mCookie);
+			mFactory = nullptr;
+		}
+	}
+private:
+	Microsoft::WRL::ComPtr<IDXGIFactory7>	mFactory;
+	DWORD									mCookie;
+	HANDLE									mChangeEvent;
+	HANDLE									mStopEvent;
+	std::thread								mThread;
+};
+
+// a utility to enumerate the adapters and outputs with a fresh DXGI factory.
+inline std::vector<AdapterInfo> enumerateAdapters() {
+	// factories snapshot adapters on creation, so a new factory is required.
+	std::vector<AdapterInfo> adapters;
+	Microsoft::WRL::ComPtr<IDXGIFactory1> factory;
+	if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory)))) {
+		return adapters;
+	}
+	Microsoft::WRL::ComPtr<IDXGIAdapter1> adapter;
+	for (auto i = 0u; factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; i++) {
+		AdapterInfo info = {};
+		adapter->GetDesc(&info.desc);
+		Microsoft::WRL::ComPtr<IDXGIOutput> output;
+		for (auto j = 0u; adapter->EnumOutputs(j, &output) != DXGI_ERROR_NOT_FOUND; j++) {
+			DXGI_OUTPUT_DESC desc;
+			if (SUCCEEDED(output->GetDesc(&desc))) {
+				info.outputs.push_back(desc);
+			}
+		}
+		adapters.push_back(std::move(info));
+	}
+	return adapters;
+}
+#endif
+
+// a published adapter topology, which counts the references of its readers.
+struct AdapterTopologySnapshot final : AdapterTopology {
+	mutable std::atomic<int64_t> refs;
+
+	ULONG AddRef() const {
+		return static_cast<ULONG>(refs.fetch_add(1, std::memory_order_relaxed) + 1);
+	}
+
+	ULONG Release() const {
+		auto count = refs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		if (count == 0) {
+			delete this;
+		}
+		return static_cast<ULONG>(count);
+	}
+};
+
+// ============================================================================
+// AdapterTopologyService
+//
+// Keeps the latest adapter topology available for the readers without any
+// locking or re-enumeration. A change notification wakes a worker thread, which
+// enumerates the adapters with the given function, diffs the result against
+// the current topology and publishes it with an atomic pointer swap.
+//
+//   - current		-- Get a reference to the latest topology (lock-free)
+//   - version		-- Get the version of the latest topology (wait-free)
+//   - refresh		-- Request a re-enumeration without a notification
+//   - waitVersion	-- Block until the target version has been published
+//
+// Notifications that arrive during an enumeration are coalesced into a single
+// follow-up enumeration. Unchanged results are not published at all, so the
+// version only grows when adapters were added, removed or their desc changed.
+//
+// Snapshots are reference counted, so a reader can keep the one obtained with
+// current() as long as it needs, and a replaced snapshot is deleted when its
+// last reader releases it. The published word packs the snapshot pointer with
+// a count of the readers, which a reader increments with the same atomic add
+// that loads the pointer, so the snapshot cannot be deleted between the load
+// and the count (a split reference count). The publisher moves that count into
+// the snapshot when it is replaced, and the readers move it earlier whenever it
+// grows large. A current snapshot holds a large bias in its own count, so the
+// releases of the readers never delete it before the replacement.
+// ============================================================================
+class AdapterTopologyService final {
+public:
+	typedef std::function<std::vector<AdapterInfo>()> Enumerator;
+	typedef std::function<void(const AdapterTopologyDiff&)> Listener;
+
+	AdapterTopologyService(Enumerator enumerator, AdapterChangeSource& source, Listener listener = nullptr)
+		: mEnumerator(std::move(enumerator)), mSource(source), mListener(std::move(listener)),
+		mCurrent(0), mPending(false), mBusy(false), mRunning(true) {
+		publish(enumerate(0).release());
+		mThread = std::thread([this]() { run(); });
+		mSource.start([this]() { refresh(); });
+	}
+
+	~AdapterTopologyService() {
+		mSource.stop();
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mRunning = false;
+		}
+		mWakeup.notify_all();
+		mThread.join();
+		retire(mCurrent.exchange(0, std::memory_order_acq_rel));
+	}
+
+	RefPtr<const AdapterTopologySnapshot> current() const {
+		auto packed = mCurrent.fetch_add(READER, std::memory_order_acq_rel) + READER;
+		auto snapshot = unpack(packed);
+		auto readers = static_cast<int64_t>(packed >> READER_SHIFT);
+		if (readers >= FLUSH_READERS) {
+			// move the readers into the snapshot before the count overflows (undone if another reader came).
+			snapshot->refs.fetch_add(readers, std::memory_order_relaxed);
+			if (!mCurrent.compare_exchange_strong(packed, packed & POINTER_MASK, std::memory_order_acq_rel)) {
+				snapshot->refs.fetch_sub(readers, std::memory_order_relaxed);
+			}
+		}
+		return RefPtr<const AdapterTopologySnapshot>::adopt(snapshot);
+	}
+
+	uint64_t version() const {
+		return mVersion.load(std::memory_order_acquire);
+	}
+
+	void refresh() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mPending = true;
+		}
+		mWakeup.notify_all();
+	}
+
+	// wait until the target version is published or the timeout expires.
+	bool waitVersion(uint64_t version, std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(mMutex);
+		return mPublished.wait_for(lock, timeout, [this, version]() { return this->version() >= version; });
+	}
+
+	// wait until all requested enumerations have been processed.
+	bool waitIdle(std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(mMutex);
+		return mPublished.wait_for(lock, timeout, [this]() { return !mPending && !mBusy; });
+	}
+private:
+	static constexpr int READER_SHIFT = 48;
+	static constexpr uint64_t READER = uint64_t(1) << READER_SHIFT;
+	static constexpr uint64_t POINTER_MASK = READER - 1;
+	static constexpr int64_t FLUSH_READERS = 1 << 12;
+	static constexpr int64_t CURRENT_BIAS = int64_t(1) << 40;
+
+	static AdapterTopologySnapshot* unpack(uint64_t packed) {
+		return reinterpret_cast<AdapterTopologySnapshot*>(static_cast<uintptr_t>(packed & POINTER_MASK));
+	}
+
+	std::unique_ptr<AdapterTopologySnapshot> enumerate(uint64_t version) {
+		auto topology = std::make_unique<AdapterTopologySnapshot>();
+		topology->version = version;
+		topology->adapters = mEnumerator();
+		std::sort(topology->adapters.begin(), topology->adapters.end(), [](const AdapterInfo& a, const AdapterInfo& b) {
+			return luidLess(a.desc.AdapterLuid, b.desc.AdapterLuid);
+		});
+		return topology;
+	}
+
+	void publish(AdapterTopologySnapshot* snapshot) {
+		auto packed = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(snapshot));
+		assert((packed & ~POINTER_MASK) == 0);
+		snapshot->refs.store(CURRENT_BIAS, std::memory_order_relaxed);
+		auto previous = mCurrent.exchange(packed, std::memory_order_acq_rel);
+		mVersion.store(snapshot->version, std::memory_order_release);
+		retire(previous);
+	}
+
+	// replace the bias with the readers still in the word, which deletes the snapshot unless a reader holds it.
+	static void retire(uint64_t packed) {
+		auto snapshot = unpack(packed);
+		if (snapshot != nullptr) {
+			auto delta = static_cast<int64_t>(packed >> READER_SHIFT) - CURRENT_BIAS;
+			if (snapshot->refs.fetch_add(delta, std::memory_order_acq_rel) + delta == 0) {
+				delete snapshot;
+			}
+		}
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (true) {
+			mWakeup.wait(lock, [this]() { return mPending || !mRunning; });
+			if (!mRunning) {
+				return;
+			}
+			mPending = false;
+			mBusy = true;
+			lock.unlock();
+
+			// enumerate outside of the lock so notifications are not blocked.
+			auto previous = current();
+			auto next = enumerate(previous->version + 1);
+			auto diff = diffTopology(*previous, *next);
+			previous.reset();
+			if (!diff.empty()) {
+				publish(next.release());
+				if (mListener) {
+					mListener(diff);
+				}
+			}
+
+			lock.lock();
+			mBusy = false;
+			mPublished.notify_all();
+		}
+	}
+
+	Enumerator										mEnumerator;
+	AdapterChangeSource&							mSource;
+	Listener										mListener;
+	mutable std::atomic<uint64_t>					mCurrent;
+	std::atomic<uint64_t>							mVersion;
+	std::mutex										mMutex;
+	std::condition_variable							mWakeup;
+	std::condition_variable							mPublished;
+	bool											mPending;
+	bool											mBusy;
+	bool											mRunning;
+	std::thread										mThread;
+};
\ No newline at end of file
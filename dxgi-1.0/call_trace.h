@@ -0,0 +1,353 @@
+#pragma once
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// CallTracer
+//
+// A low-overhead tracer for the HRESULT returning calls. Each call which is
+// wrapped with the TRACE_CALL macro is recorded with its call site, result,
+// thread and the start and end timestamps. The macro evaluates to the result
+// of the call, so it can be used directly inside the check_hresult.
+//
+//		check_hresult(TRACE_CALL(factory->EnumAdapters(0, &adapter)));
+//
+// Records are written into per-thread single-producer rings, so the recording
+// thread never takes a lock or allocates after its first traced call. Rings
+// are drained by the collect function, which can be called from any thread.
+// When a ring is full, new records are dropped and counted until it's drained.
+//
+//		setEnabled	-- Enable or disable the recording (disabled by default)
+//		collect		-- Drain all the rings into a TraceDump
+//
+// Dumps are stored in a compact binary format (see writeTraceDump) and can be
+// converted into a Chrome trace / Perfetto JSON with the writeChromeTrace or
+// with the dxgi-trace tool. The binary format uses the native byte order.
+//
+// Timestamps are read from the TSC on x86 (see TscTimeSource), as the steady
+// clock and the QPC may cost tens of nanoseconds per read on virtual machines.
+// Note that the rings of the exited threads are kept alive (and drainable)
+// for the whole lifetime of the process.
+// ============================================================================
+
+#if defined(TIME_SOURCE_TSC)
+typedef TscTimeSource TraceClock;
+#else
+typedef SteadyTimeSource TraceClock;
+#endif
+
+// the amount of records in each of the per-thread rings (must be a power of two).
+constexpr uint32_t TRACE_RING_CAPACITY = 1 << 14;
+
+// the magic number and version of the binary trace dump.
+constexpr uint32_t TRACE_DUMP_MAGIC = 0x52545844; // "DXTR"
+constexpr uint32_t TRACE_DUMP_VERSION = 1;
+
+// a single traced call (24 bytes).
+struct TraceRecord {
+	int64_t		start;		// the start time in TraceClock ticks
+	uint32_t	duration;	// the duration in ticks (saturates at UINT32_MAX)
+	uint32_t	site;		// the index of the call site
+	HRESULT		result;		// the result of the call
+	uint32_t	thread;		// the index of the recording thread (from 1)
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must be packed into 24 bytes");
+
+// a location of a traced call.
+struct TraceSite {
+	std::string	file;
+	uint32_t	line;
+	std::string	call;
+};
+
+// a collection of traced calls.
+struct TraceDump {
+	int64_t						frequency = 0;	// the ticks per second
+	uint64_t					dropped = 0;	// the amount of dropped records
+	std::vector<TraceSite>		sites;
+	std::vector<TraceRecord>	records;		// sorted by the start time
+};
+
+// a single-producer single-consumer ring of trace records.
+class TraceRing final {
+public:
+	explicit TraceRing(uint32_t thread) : mThread(thread), mHead(0), mTail(0), mDropped(0) {
+		mRecords.reset(new TraceRecord[TRACE_RING_CAPACITY]);
+	}
+
+	// push a new record (called only by the owning thread).
+	void push(int64_t start, int64_t end, uint32_t site, HRESULT result) {
+		auto head = mHead.load(std::memory_order_relaxed);
+		if (head - mTail.load(std::memory_order_acquire) == TRACE_RING_CAPACITY) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		auto duration = static_cast<uint64_t>(end - start);
+		auto& record = mRecords[head & (TRACE_RING_CAPACITY - 1)];
+		record.start = start;
+		record.duration = duration > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(duration);
+		record.site = site;
+		record.result = result;
+		record.thread = mThread;
+		mHead.store(head + 1, std::memory_order_release);
+	}
+
+	// drain all the available records (called by a single consumer at a time).
+	void drain(std::vector<TraceRecord>& records, uint64_t& dropped) {
+		auto tail = mTail.load(std::memory_order_relaxed);
+		auto head = mHead.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			records.push_back(mRecords[tail & (TRACE_RING_CAPACITY - 1)]);
+		}
+		mTail.store(tail, std::memory_order_release);
+		dropped += mDropped.exchange(0, std::memory_order_relaxed);
+	}
+private:
+	uint32_t						mThread;
+	std::unique_ptr<TraceRecord[]>	mRecords;
+	std::atomic<uint32_t>			mHead;
+	std::atomic<uint32_t>			mTail;
+	std::atomic<uint64_t>			mDropped;
+};
+
+class CallTracer final {
+public:
+	CallTracer() : mEnabled(false) {}
+
+	void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+	bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+	int64_t now() { return mClock.now(); }
+
+	// register a new call site and get its index (called once per site).
+	uint32_t registerSite(const char* file, uint32_t line, const char* call) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mSites.push_back({ file, line, call });
+		return static_cast<uint32_t>(mSites.size() - 1);
+	}
+
+	// record a call which started at the given time and ends now.
+	void record(uint32_t site, int64_t start, HRESULT result) {
+		auto end = now();
+		thread_local TraceRing* ring = nullptr;
+		if (ring == nullptr) {
+			ring = registerThread();
+		}
+		ring->push(start, end, site, result);
+	}
+
+	// drain the records from all the threads.
+	TraceDump collect() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		TraceDump dump;
+		dump.frequency = mClock.frequency();
+		dump.sites = mSites;
+		for (auto& ring : mRings) {
+			ring->drain(dump.records, dump.dropped);
+		}
+		std::stable_sort(dump.records.begin(), dump.records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+			return a.start < b.start;
+		});
+		return dump;
+	}
+private:
+	TraceRing* registerThread() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRings.emplace_back(new TraceRing(static_cast<uint32_t>(mRings.size() + 1)));
+		return mRings.back().get();
+	}
+
+	TraceClock								mClock;
+	std::atomic<bool>						mEnabled;
+	std::mutex								mMutex;
+	std::vector<TraceSite>					mSites;
+	std::vector<std::unique_ptr<TraceRing>>	mRings;
+};
+
+// a utility to get the process-wide call tracer.
+inline CallTracer& callTracer() {
+	static CallTracer tracer;
+	return tracer;
+}
+
+// a scope of a single traced call.
+class TraceScope final {
+public:
+	explicit TraceScope(uint32_t site) : mSite(site), mStart(0), mEnabled(callTracer().enabled()) {
+		if (mEnabled) {
+			mStart = callTracer().now();
+		}
+	}
+
+	HRESULT finish(HRESULT result) {
+		if (mEnabled) {
+			callTracer().record(mSite, mStart, result);
+		}
+		return result;
+	}
+private:
+	uint32_t	mSite;
+	int64_t		mStart;
+	bool		mEnabled;
+};
+
+// a macro to trace a HRESULT returning call (evaluates to the result).
+#define TRACE_CALL(...) ([&]() -> HRESULT { \
+	static const uint32_t traceSite = callTracer().registerSite(__FILE__, __LINE__, #__VA_ARGS__); \
+	TraceScope traceScope(traceSite); \
+	return traceScope.finish(__VA_ARGS__); \
+}())
+
+// a utility to write a trace dump in the binary format.
+//
+//		uint32_t	magic, version
+//		int64_t		frequency
+//		uint64_t	dropped
+//		uint32_t	site count, record count
+//		sites		uint32_t line, uint32_t file length, file, uint32_t call length, call
+//		records		TraceRecord[record count]
+inline HRESULT writeTraceDump(FILE* file, const TraceDump& dump) {
+	auto write = [file](const void* data, size_t size) {
+		return size == 0 || fwrite(data, size, 1, file) == 1;
+	};
+	auto writeString = [&write](const std::string& value) {
+		auto length = static_cast<uint32_t>(value.size());
+		return write(&length, sizeof(length)) && write(value.data(), value.size());
+	};
+	auto siteCount = static_cast<uint32_t>(dump.sites.size());
+	auto recordCount = static_cast<uint32_t>(dump.records.size());
+	auto ok = write(&TRACE_DUMP_MAGIC, sizeof(TRACE_DUMP_MAGIC))
+		&& write(&TRACE_DUMP_VERSION, sizeof(TRACE_DUMP_VERSION))
+		&& write(&dump.frequency, sizeof(dump.frequency))
+		&& write(&dump.dropped, sizeof(dump.dropped))
+		&& write(&siteCount, sizeof(siteCount))
+		&& write(&recordCount, sizeof(recordCount));
+	for (auto& site : dump.sites) {
+		ok = ok && write(&site.line, sizeof(site.line)) && writeString(site.file) && writeString(site.call);
+	}
+	ok = ok && write(dump.records.data(), dump.records.size() * sizeof(TraceRecord));
+	return ok ? S_OK : E_FAIL;
+}
+
+// a utility to read a trace dump in the binary format.
+inline HRESULT readTraceDump(FILE* file, TraceDump* dump) {
+	auto read = [file](void* data, size_t size) {
+		return size == 0 || fread(data, size, 1, file) == 1;
+	};
+	auto readString = [&read](std::string& value) {
+		uint32_t length = 0;
+		if (!read(&length, sizeof(length)) || length > (1u << 20)) {
+			return false;
+		}
+		value.resize(length);
+		return read(&value[0], length);
+	};
+	uint32_t magic = 0, version = 0, siteCount = 0, recordCount = 0;
+	if (!read(&magic, sizeof(magic)) || !read(&version, sizeof(version))) {
+		return E_FAIL;
+	}
+	if (magic != TRACE_DUMP_MAGIC || version != TRACE_DUMP_VERSION) {
+		return E_INVALIDARG;
+	}
+	TraceDump result;
+	if (!read(&result.frequency, sizeof(result.frequency)) || !read(&result.dropped, sizeof(result.dropped))
+		|| !read(&siteCount, sizeof(siteCount)) || !read(&recordCount, sizeof(recordCount))) {
+		return E_FAIL;
+	}
+	result.sites.resize(siteCount);
+	for (auto& site : result.sites) {
+		if (!read(&site.line, sizeof(site.line)) || !readString(site.file) || !readString(site.call)) {
+			return E_FAIL;
+		}
+	}
+	result.records.resize(recordCount);
+	if (!read(result.records.data(), result.records.size() * sizeof(TraceRecord))) {
+		return E_FAIL;
+	}
+	for (auto& record : result.records) {
+		if (record.site >= siteCount) {
+			return E_INVALIDARG;
+		}
+	}
+	*dump = std::move(result);
+	return S_OK;
+}
+
+// a utility to open a file (fopen is deprecated by the MSVC).
+inline FILE* openTraceFile(const char* path, const char* mode) {
+#if defined(_MSC_VER)
+	FILE* file = nullptr;
+	return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+// a utility to collect the traced calls and save them into a binary dump file.
+inline HRESULT saveCallTrace(const char* path) {
+	auto file = openTraceFile(path, "wb");
+	if (file == nullptr) {
+		return E_FAIL;
+	}
+	auto result = writeTraceDump(file, callTracer().collect());
+	if (fclose(file) != 0 && SUCCEEDED(result)) {
+		result = E_FAIL;
+	}
+	return result;
+}
+
+// a utility to write a string as a JSON string literal.
+inline void writeJsonString(FILE* file, const std::string& value) {
+	fputc('"', file);
+	for (auto c : value) {
+		auto u = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		} else if (u < 0x20) {
+			fprintf(file, "\\u%04x", u);
+		} else {
+			fputc(c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+// a utility to write a trace dump as a Chrome trace / Perfetto JSON.
+inline HRESULT writeChromeTrace(FILE* file, const TraceDump& dump) {
+	if (dump.frequency <= 0) {
+		return E_INVALIDARG;
+	}
+	auto origin = dump.records.empty() ? 0 : dump.records.front().start;
+	auto micros = 1000000.0 / static_cast<double>(dump.frequency);
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%llu},\"traceEvents\":[",
+		static_cast<unsigned long long>(dump.dropped));
+	for (size_t i = 0; i < dump.records.size(); i++) {
+		auto& record = dump.records[i];
+		auto& site = dump.sites[record.site];
+		fprintf(file, "%s\n{\"name\":", i == 0 ? "" : ",");
+		writeJsonString(file, site.call);
+		fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"hr\":\"0x%08x\",\"file\":",
+			FAILED(record.result) ? "failed" : "dxgi",
+			record.thread,
+			static_cast<double>(record.start - origin) * micros,
+			static_cast<double>(record.duration) * micros,
+			static_cast<uint32_t>(record.result));
+		writeJsonString(file, site.file);
+		fprintf(file, ",\"line\":%u}}", site.line);
+	}
+	fprintf(file, "\n]}\n");
+	return ferror(file) ? E_FAIL : S_OK;
+}
\ No newline at end of file
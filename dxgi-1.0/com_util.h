@@ -1,46 +1,52 @@
-#pragma once
-
-#include <wrl/client.h> // ComPtr
-#include <comdef.h>		// _com_error
-#include <string>
-
-// a utility to easily catch failed HRESULTS.
-inline void check_hresult(HRESULT result) {
-	if (FAILED(result)) {
-		throw _com_error(result);
-	}
-}
-
-// a utility to count COM object references.
-inline UINT countRefs(Microsoft::WRL::ComPtr<IUnknown> object) {
-	object->AddRef();
-	return object->Release();
-}
-
-// a utility to create a new GUID.
-inline GUID createGUID() {
-	GUID guid;
-	check_hresult(CoCreateGuid(&guid));
-	return guid;
-}
-
-// a utility to convert RECT into a descriptive string.
-inline std::string rectString(RECT& rect) {
-	std::string str = "{";
-	str += "top: " + std::to_string(rect.top);
-	str += ", right: " + std::to_string(rect.right);
-	str += ", bottom: " + std::to_string(rect.bottom);
-	str += ", left: " + std::to_string(rect.left);
-	str += "}";
-	return str;
-}
-
-// a utility to convert DWORD into a boolean string.
-inline const char* boolString(DWORD value) {
-	return value == 0 ? "false" : "true";
-}
-
-// a utility to convert BOOL into a boolean string.
-inline const char* boolString(BOOL value) {
-	return value == 0 ? "false" : "true";
+#pragma once
+
+#include <wrl/client.h> // ComPtr
+#include <comdef.h>		// _com_error
+
+#include "hresult.h"
+#include "ref_ptr.h"
+
+// a utility to throw failed results as _com_error exceptions. The result with
+// its source location is written into the debugger output and attached as the
+// description of the error, so the catch site can read it from Description().
+template <typename T>
+inline void check_hresult(const Result<T>& result) {
+	if (!result.ok()) {
+		auto string = resultString(result);
+		Microsoft::WRL::ComPtr<ICreateErrorInfo> create;
+		Microsoft::WRL::ComPtr<IErrorInfo> info;
+		if (result.location().file != nullptr && SUCCEEDED(CreateErrorInfo(&create)) && SUCCEEDED(create.As(&info))) {
+			wchar_t description[256];
+			if (MultiByteToWideChar(CP_UTF8, 0, string.c_str(), -1, description, 256) > 0) {
+				create->SetDescription(description);
+			}
+		}
+		string.append("\n", 1);
+		OutputDebugStringA(string.c_str());
+		// the _com_error takes over the reference of the error info.
+		throw _com_error(result.code(), info.Detach());
+	}
+}
+
+// a utility to easily catch failed HRESULTS of the TRACE_CALL. Other calls
+// should go through the RESULT_OF so the failure has a source location.
+inline void check_hresult(HRESULT result) {
+	check_hresult(Result<void>(result));
+}
+
+// a utility to create a new GUID.
+inline GUID createGUID() {
+	GUID guid;
+	check_hresult(RESULT_OF(CoCreateGuid(&guid)));
+	return guid;
+}
+
+// a utility to convert DWORD into a boolean string.
+inline const char* boolString(DWORD value) {
+	return value == 0 ? "false" : "true";
+}
+
+// a utility to convert BOOL into a boolean string.
+inline const char* boolString(BOOL value) {
+	return value == 0 ? "false" : "true";
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+#include "format_convert.h"
+#include "simd_util.h"
+
+// a utility to hash a row of bytes from at most 256 evenly spaced 8-byte words.
+inline uint64_t rowHash(const BYTE* data, size_t size) {
+	const uint64_t K = 0x9e3779b97f4a7c15ull;
+	const size_t MAX_WORDS = 256;
+	auto words = size / 8;
+	auto stride = words > MAX_WORDS ? words / MAX_WORDS : 1;
+	uint64_t hash = K ^ size;
+	for (size_t i = 0; i < words; i += stride) {
+		uint64_t word;
+		std::memcpy(&word, data + i * 8, sizeof(word));
+		hash = (hash ^ word) * K;
+		hash ^= hash >> 29;
+	}
+	for (auto i = words * 8; i < size; i++) {
+		hash = (hash ^ data[i]) * K;
+	}
+	return hash ^ (hash >> 32);
+}
+
+// ============================================================================
+// DuplicationEngine
+//
+// Produces the dirty and move rectangles of consecutive frames in the same way
+// as the IDXGIOutputDuplication reports them, so that a downstream encoder may
+// touch only the changed parts of the desktop image. The first frame is fully
+// dirty. Move rectangles tell which parts of the previous frame were copied
+// into a new location and must be applied before the dirty rectangles.
+//
+//   - update				-- Compare the next frame against the previous one
+//   - GetFrameDirtyRects	-- Get dirty rectangles (IDXGIOutputDuplication)
+//   - GetFrameMoveRects	-- Get move rectangles (IDXGIOutputDuplication)
+//
+// Changes are searched from a grid of TILE_SIZE tiles, whose rows are compared
+// with SIMD until the first difference is found. Dirty tiles are then merged
+// into rectangles from runs of horizontally adjacent tiles with equal extents.
+//
+// Each large enough dirty rectangle is checked for a vertical scroll. Rows of
+// the previous and the current frame are hashed from sampled words and every
+// row with a unique hash votes for an offset to the row with the same hash. As
+// the winning offset is verified with exact row compares, the sampling cannot
+// produce wrong moves. The longest run of matching rows (at least MIN_MOVE_ROWS)
+// becomes a move rectangle and the rest of the rectangle stays dirty.
+//
+// Note that horizontal moves (e.g. dragged windows) are reported as dirty.
+// ============================================================================
+class DuplicationEngine final {
+public:
+	static constexpr UINT TILE_SIZE = 32;
+	static constexpr UINT MIN_MOVE_ROWS = 16;
+	static constexpr UINT MIN_MOVE_WIDTH = 2 * TILE_SIZE;
+
+	DuplicationEngine(UINT width, UINT height, DXGI_FORMAT format, SimdLevel level = bestSimdLevel())
+		: mWidth(width), mHeight(height), mFormat(format), mLevel(level), mFrames(0), mDirtyTiles(0) {
+		mBytesPerPixel = formatBytesPerPixel(format);
+		mPitch = static_cast<size_t>(width) * mBytesPerPixel;
+		mTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		mTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		mPrevious.resize(mPitch * height);
+		mDirty.resize(static_cast<size_t>(mTilesX) * mTilesY);
+	}
+
+	HRESULT update(const SurfaceView& frame) {
+		if (frame.bits == nullptr || frame.width != mWidth || frame.height != mHeight
+			|| frame.format != mFormat || mBytesPerPixel == 0) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mDirtyRects.clear();
+		mMoveRects.clear();
+		mFrames++;
+		if (mFrames == 1) {
+			std::fill(mDirty.begin(), mDirty.end(), static_cast<uint8_t>(1));
+			mDirtyTiles = static_cast<UINT>(mDirty.size());
+			mDirtyRects.push_back({ 0, 0, static_cast<LONG>(mWidth), static_cast<LONG>(mHeight) });
+			copyRows(frame, mDirtyRects.front());
+			return S_OK;
+		}
+
+		markDirtyTiles(frame);
+		std::vector<RECT> changes;
+		mergeDirtyTiles(&changes);
+		for (const auto& rect : changes) {
+			detectScroll(frame, rect);
+		}
+		for (const auto& rect : changes) {
+			copyRows(frame, rect);
+		}
+		return S_OK;
+	}
+
+	HRESULT GetFrameDirtyRects(UINT bufferSize, RECT* buffer, UINT* required) const {
+		return copyRects(mDirtyRects, bufferSize, buffer, required);
+	}
+
+	HRESULT GetFrameMoveRects(UINT bufferSize, DXGI_OUTDUPL_MOVE_RECT* buffer, UINT* required) const {
+		return copyRects(mMoveRects, bufferSize, buffer, required);
+	}
+
+	const std::vector<RECT>& dirtyRects() const { return mDirtyRects; }
+	const std::vector<DXGI_OUTDUPL_MOVE_RECT>& moveRects() const { return mMoveRects; }
+	UINT dirtyTiles() const { return mDirtyTiles; }
+	UINT tileCount() const { return static_cast<UINT>(mDirty.size()); }
+private:
+	template <typename T>
+	static HRESULT copyRects(const std::vector<T>& rects, UINT bufferSize, T* buffer, UINT* required) {
+		if (required == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*required = static_cast<UINT>(rects.size() * sizeof(T));
+		if (bufferSize < *required || (buffer == nullptr && *required > 0)) {
+			return DXGI_ERROR_MORE_DATA;
+		}
+		std::copy(rects.begin(), rects.end(), buffer);
+		return S_OK;
+	}
+
+	const BYTE* currentRow(const SurfaceView& frame, LONG y, LONG x = 0) const {
+		return frame.bits + static_cast<ptrdiff_t>(y) * frame.pitch + static_cast<size_t>(x) * mBytesPerPixel;
+	}
+
+	const BYTE* previousRow(LONG y, LONG x = 0) const {
+		return mPrevious.data() + static_cast<size_t>(y) * mPitch + static_cast<size_t>(x) * mBytesPerPixel;
+	}
+
+	void markDirtyTiles(const SurfaceView& frame) {
+		// rows are walked in the memory order and clean tiles are compared until dirty.
+		mDirtyTiles = 0;
+		std::fill(mDirty.begin(), mDirty.end(), static_cast<uint8_t>(0));
+		for (UINT ty = 0; ty < mTilesY; ty++) {
+			auto dirty = &mDirty[ty * mTilesX];
+			auto bottom = std::min((ty + 1) * TILE_SIZE, mHeight);
+			UINT found = 0;
+			for (auto y = ty * TILE_SIZE; y < bottom && found < mTilesX; y++) {
+				auto row = static_cast<LONG>(y);
+				for (UINT tx = 0; tx < mTilesX; tx++) {
+					if (dirty[tx] != 0) {
+						continue;
+					}
+					auto left = static_cast<LONG>(tx * TILE_SIZE);
+					auto size = static_cast<size_t>(std::min(TILE_SIZE, mWidth - tx * TILE_SIZE)) * mBytesPerPixel;
+					if (!bytesEqual(currentRow(frame, row, left), previousRow(row, left), size, mLevel)) {
+						dirty[tx] = 1;
+						found++;
+					}
+				}
+			}
+			mDirtyTiles += found;
+		}
+	}
+
+	void mergeDirtyTiles(std::vector<RECT>* rects) const {
+		// rectangles which may still grow downwards with a matching run.
+		std::vector<size_t> open;
+		for (UINT ty = 0; ty < mTilesY; ty++) {
+			std::vector<size_t> next;
+			for (UINT tx = 0; tx < mTilesX; tx++) {
+				if (mDirty[ty * mTilesX + tx] == 0) {
+					continue;
+				}
+				auto end = tx;
+				while (end < mTilesX && mDirty[ty * mTilesX + end] != 0) {
+					end++;
+				}
+				RECT run = {
+					static_cast<LONG>(tx * TILE_SIZE),
+					static_cast<LONG>(ty * TILE_SIZE),
+					static_cast<LONG>(std::min(end * TILE_SIZE, mWidth)),
+					static_cast<LONG>(std::min((ty + 1) * TILE_SIZE, mHeight))
+				};
+				auto match = std::find_if(open.begin(), open.end(), [&](size_t index) {
+					auto& rect = (*rects)[index];
+					return rect.left == run.left && rect.right == run.right;
+				});
+				if (match != open.end()) {
+					(*rects)[*match].bottom = run.bottom;
+					next.push_back(*match);
+				} else {
+					next.push_back(rects->size());
+					rects->push_back(run);
+				}
+				tx = end;
+			}
+			open.swap(next);
+		}
+	}
+
+	void detectScroll(const SurfaceView& frame, const RECT& rect) {
+		auto height = rect.bottom - rect.top;
+		auto size = static_cast<size_t>(rect.right - rect.left) * mBytesPerPixel;
+		if (height < static_cast<LONG>(2 * MIN_MOVE_ROWS) || rect.right - rect.left < static_cast<LONG>(MIN_MOVE_WIDTH)) {
+			mDirtyRects.push_back(rect);
+			return;
+		}
+
+		// map the unique row hashes of the previous frame into their rows.
+		std::unordered_map<uint64_t, LONG> previous;
+		previous.reserve(static_cast<size_t>(height));
+		for (auto y = rect.top; y < rect.bottom; y++) {
+			auto result = previous.emplace(rowHash(previousRow(y, rect.left), size), y);
+			if (!result.second) {
+				result.first->second = -1;
+			}
+		}
+
+		// let each current row vote for the offset of the matching previous row.
+		std::vector<UINT> votes(static_cast<size_t>(height) * 2, 0);
+		for (auto y = rect.top; y < rect.bottom; y++) {
+			auto it = previous.find(rowHash(currentRow(frame, y, rect.left), size));
+			if (it != previous.end() && it->second >= 0 && it->second != y) {
+				votes[static_cast<size_t>(y - it->second + height)]++;
+			}
+		}
+		auto best = std::max_element(votes.begin(), votes.end());
+		if (*best < MIN_MOVE_ROWS) {
+			mDirtyRects.push_back(rect);
+			return;
+		}
+
+		// find the longest verified run of rows which moved with the offset.
+		auto offset = static_cast<LONG>(best - votes.begin()) - height;
+		auto first = std::max(rect.top, rect.top + offset);
+		auto last = std::min(rect.bottom, rect.bottom + offset);
+		LONG runTop = 0;
+		LONG runBottom = 0;
+		for (auto y = first; y < last; y++) {
+			auto start = y;
+			while (y < last && bytesEqual(currentRow(frame, y, rect.left), previousRow(y - offset, rect.left), size, mLevel)) {
+				y++;
+			}
+			if (y - start > runBottom - runTop) {
+				runTop = start;
+				runBottom = y;
+			}
+		}
+		if (runBottom - runTop < static_cast<LONG>(MIN_MOVE_ROWS)) {
+			mDirtyRects.push_back(rect);
+			return;
+		}
+
+		DXGI_OUTDUPL_MOVE_RECT move = {};
+		move.SourcePoint = { rect.left, runTop - offset };
+		move.DestinationRect = { rect.left, runTop, rect.right, runBottom };
+		mMoveRects.push_back(move);
+		if (runTop > rect.top) {
+			mDirtyRects.push_back({ rect.left, rect.top, rect.right, runTop });
+		}
+		if (runBottom < rect.bottom) {
+			mDirtyRects.push_back({ rect.left, runBottom, rect.right, rect.bottom });
+		}
+	}
+
+	void copyRows(const SurfaceView& frame, const RECT& rect) {
+		auto size = static_cast<size_t>(rect.right - rect.left) * mBytesPerPixel;
+		for (auto y = rect.top; y < rect.bottom; y++) {
+			auto row = mPrevious.data() + static_cast<size_t>(y) * mPitch + static_cast<size_t>(rect.left) * mBytesPerPixel;
+			std::memcpy(row, currentRow(frame, y, rect.left), size);
+		}
+	}
+
+	UINT								mWidth;
+	UINT								mHeight;
+	DXGI_FORMAT							mFormat;
+	SimdLevel							mLevel;
+	UINT								mBytesPerPixel;
+	size_t								mPitch;
+	UINT								mTilesX;
+	UINT								mTilesY;
+	UINT								mFrames;
+	UINT								mDirtyTiles;
+	std::vector<BYTE>					mPrevious;
+	std::vector<uint8_t>				mDirty;
+	std::vector<RECT>					mDirtyRects;
+	std::vector<DXGI_OUTDUPL_MOVE_RECT>	mMoveRects;
+};
\ No newline at end of file
@@ -0,0 +1,350 @@
+#pragma once
+
+// ============================================================================
+// A portable subset of the DXGI type definitions.
+//
+// On Windows this simply includes the real DXGI headers. Elsewhere it defines
+// the handful of types, flags and HRESULT codes which are used by the software
+// implementations in this sandbox so they can be compiled and exercised also
+// on headless machines without the Windows SDK (e.g. a Linux build farm).
+//
+// Note that the values below match the ones in the Windows SDK headers so any
+// data recorded on either platform can be compared against each other.
+// ============================================================================
+#if defined(_WIN32)
+
+#include <dxgi1_6.h>
+
+#else
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef uint8_t  BYTE;
+typedef uint16_t UINT16;
+typedef int32_t  BOOL;
+typedef int32_t  INT;
+typedef uint32_t UINT;
+typedef int32_t  LONG;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef int64_t  INT64;
+typedef uint64_t UINT64;
+typedef int32_t  HRESULT;
+typedef size_t   SIZE_T;
+typedef wchar_t  WCHAR;
+typedef void*    HANDLE;
+typedef void*    HWND;
+typedef void*    HMONITOR;
+
+typedef union _LARGE_INTEGER {
+	struct {
+		DWORD LowPart;
+		LONG  HighPart;
+	};
+	int64_t QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _LUID {
+	DWORD LowPart;
+	LONG  HighPart;
+} LUID;
+
+typedef struct tagRECT {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT;
+
+typedef struct tagPOINT {
+	LONG x;
+	LONG y;
+} POINT;
+
+typedef struct _GUID {
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t  Data4[8];
+} GUID;
+
+typedef GUID IID;
+typedef const GUID& REFGUID;
+typedef const IID& REFIID;
+
+inline bool IsEqualGUID(REFGUID a, REFGUID b) {
+	return std::memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+inline bool operator==(REFGUID a, REFGUID b) { return IsEqualGUID(a, b); }
+inline bool operator!=(REFGUID a, REFGUID b) { return !IsEqualGUID(a, b); }
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)    (((HRESULT)(hr)) < 0)
+
+#define S_OK          ((HRESULT)0L)
+#define S_FALSE       ((HRESULT)1L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER     ((HRESULT)0x80004003L)
+#define E_FAIL        ((HRESULT)0x80004005L)
+#define E_INVALIDARG  ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+
+#define DXGI_STATUS_OCCLUDED                    ((HRESULT)0x087A0001L)
+#define DXGI_STATUS_MODE_CHANGE_IN_PROGRESS     ((HRESULT)0x087A0008L)
+#define DXGI_ERROR_INVALID_CALL                 ((HRESULT)0x887A0001L)
+#define DXGI_ERROR_NOT_FOUND                    ((HRESULT)0x887A0002L)
+#define DXGI_ERROR_MORE_DATA                    ((HRESULT)0x887A0003L)
+#define DXGI_ERROR_UNSUPPORTED                  ((HRESULT)0x887A0004L)
+#define DXGI_ERROR_DEVICE_REMOVED               ((HRESULT)0x887A0005L)
+#define DXGI_ERROR_DEVICE_HUNG                  ((HRESULT)0x887A0006L)
+#define DXGI_ERROR_DEVICE_RESET                 ((HRESULT)0x887A0007L)
+#define DXGI_ERROR_WAS_STILL_DRAWING            ((HRESULT)0x887A000AL)
+#define DXGI_ERROR_FRAME_STATISTICS_DISJOINT    ((HRESULT)0x887A000BL)
+#define DXGI_ERROR_NOT_CURRENTLY_AVAILABLE      ((HRESULT)0x887A0022L)
+#define DXGI_ERROR_ACCESS_LOST                  ((HRESULT)0x887A0026L)
+#define DXGI_ERROR_WAIT_TIMEOUT                 ((HRESULT)0x887A0027L)
+#define DXGI_ERROR_SESSION_DISCONNECTED         ((HRESULT)0x887A0028L)
+#define DXGI_ERROR_NAME_ALREADY_EXISTS          ((HRESULT)0x887A002CL)
+
+#define WAIT_ABANDONED 0x00000080L
+#define WAIT_TIMEOUT   258L
+#define INFINITE       0xFFFFFFFF
+
+#define STDMETHODCALLTYPE
+
+// the root interface of all the COM objects (as declared in the Unknwn.h).
+struct IUnknown {
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+
+static const IID IID_IUnknown = { 0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+
+typedef enum DXGI_FORMAT {
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+	DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DXGI_FORMAT_B5G6R5_UNORM = 85,
+	DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+	DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DXGI_FORMAT_AYUV = 100,
+	DXGI_FORMAT_Y410 = 101,
+	DXGI_FORMAT_NV12 = 103,
+	DXGI_FORMAT_P010 = 104,
+	DXGI_FORMAT_YUY2 = 107,
+	DXGI_FORMAT_B4G4R4A4_UNORM = 115,
+	DXGI_FORMAT_FORCE_UINT = 0xffffffff
+} DXGI_FORMAT;
+
+typedef struct DXGI_RATIONAL {
+	UINT Numerator;
+	UINT Denominator;
+} DXGI_RATIONAL;
+
+typedef enum DXGI_MODE_SCANLINE_ORDER {
+	DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED = 0,
+	DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE = 1,
+	DXGI_MODE_SCANLINE_ORDER_UPPER_FIELD_FIRST = 2,
+	DXGI_MODE_SCANLINE_ORDER_LOWER_FIELD_FIRST = 3
+} DXGI_MODE_SCANLINE_ORDER;
+
+typedef enum DXGI_MODE_SCALING {
+	DXGI_MODE_SCALING_UNSPECIFIED = 0,
+	DXGI_MODE_SCALING_CENTERED = 1,
+	DXGI_MODE_SCALING_STRETCHED = 2
+} DXGI_MODE_SCALING;
+
+typedef enum DXGI_MODE_ROTATION {
+	DXGI_MODE_ROTATION_UNSPECIFIED = 0,
+	DXGI_MODE_ROTATION_IDENTITY = 1,
+	DXGI_MODE_ROTATION_ROTATE90 = 2,
+	DXGI_MODE_ROTATION_ROTATE180 = 3,
+	DXGI_MODE_ROTATION_ROTATE270 = 4
+} DXGI_MODE_ROTATION;
+
+typedef struct DXGI_ADAPTER_DESC {
+	WCHAR Description[128];
+	UINT VendorId;
+	UINT DeviceId;
+	UINT SubSysId;
+	UINT Revision;
+	SIZE_T DedicatedVideoMemory;
+	SIZE_T DedicatedSystemMemory;
+	SIZE_T SharedSystemMemory;
+	LUID AdapterLuid;
+} DXGI_ADAPTER_DESC;
+
+typedef struct DXGI_OUTPUT_DESC {
+	WCHAR DeviceName[32];
+	RECT DesktopCoordinates;
+	BOOL AttachedToDesktop;
+	DXGI_MODE_ROTATION Rotation;
+	HMONITOR Monitor;
+} DXGI_OUTPUT_DESC;
+
+typedef struct DXGI_MODE_DESC {
+	UINT Width;
+	UINT Height;
+	DXGI_RATIONAL RefreshRate;
+	DXGI_FORMAT Format;
+	DXGI_MODE_SCANLINE_ORDER ScanlineOrdering;
+	DXGI_MODE_SCALING Scaling;
+} DXGI_MODE_DESC;
+
+typedef struct DXGI_SAMPLE_DESC {
+	UINT Count;
+	UINT Quality;
+} DXGI_SAMPLE_DESC;
+
+typedef struct DXGI_SURFACE_DESC {
+	UINT Width;
+	UINT Height;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+} DXGI_SURFACE_DESC;
+
+typedef UINT DXGI_USAGE;
+
+#define DXGI_USAGE_SHADER_INPUT         0x00000010UL
+#define DXGI_USAGE_RENDER_TARGET_OUTPUT 0x00000020UL
+#define DXGI_USAGE_BACK_BUFFER          0x00000040UL
+#define DXGI_USAGE_SHARED               0x00000080UL
+#define DXGI_USAGE_READ_ONLY            0x00000100UL
+#define DXGI_USAGE_DISCARD_ON_PRESENT   0x00000200UL
+#define DXGI_USAGE_UNORDERED_ACCESS     0x00000400UL
+
+typedef enum DXGI_SWAP_EFFECT {
+	DXGI_SWAP_EFFECT_DISCARD = 0,
+	DXGI_SWAP_EFFECT_SEQUENTIAL = 1,
+	DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL = 3,
+	DXGI_SWAP_EFFECT_FLIP_DISCARD = 4
+} DXGI_SWAP_EFFECT;
+
+typedef enum DXGI_SWAP_CHAIN_FLAG {
+	DXGI_SWAP_CHAIN_FLAG_NONPREROTATED = 1,
+	DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH = 2,
+	DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE = 4,
+	DXGI_SWAP_CHAIN_FLAG_RESTRICTED_CONTENT = 8,
+	DXGI_SWAP_CHAIN_FLAG_RESTRICT_SHARED_RESOURCE_DRIVER = 16,
+	DXGI_SWAP_CHAIN_FLAG_DISPLAY_ONLY = 32,
+	DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT = 64,
+	DXGI_SWAP_CHAIN_FLAG_FOREGROUND_LAYER = 128,
+	DXGI_SWAP_CHAIN_FLAG_FULLSCREEN_VIDEO = 256,
+	DXGI_SWAP_CHAIN_FLAG_YUV_VIDEO = 512,
+	DXGI_SWAP_CHAIN_FLAG_HW_PROTECTED = 1024,
+	DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING = 2048
+} DXGI_SWAP_CHAIN_FLAG;
+
+typedef struct DXGI_SWAP_CHAIN_DESC {
+	DXGI_MODE_DESC BufferDesc;
+	DXGI_SAMPLE_DESC SampleDesc;
+	DXGI_USAGE BufferUsage;
+	UINT BufferCount;
+	HWND OutputWindow;
+	BOOL Windowed;
+	DXGI_SWAP_EFFECT SwapEffect;
+	UINT Flags;
+} DXGI_SWAP_CHAIN_DESC;
+
+typedef struct DXGI_FRAME_STATISTICS {
+	UINT PresentCount;
+	UINT PresentRefreshCount;
+	UINT SyncRefreshCount;
+	LARGE_INTEGER SyncQPCTime;
+	LARGE_INTEGER SyncGPUTime;
+} DXGI_FRAME_STATISTICS;
+
+typedef struct DXGI_MAPPED_RECT {
+	INT Pitch;
+	BYTE* pBits;
+} DXGI_MAPPED_RECT;
+
+typedef enum DXGI_RESIDENCY {
+	DXGI_RESIDENCY_FULLY_RESIDENT = 1,
+	DXGI_RESIDENCY_RESIDENT_IN_SHARED_MEMORY = 2,
+	DXGI_RESIDENCY_EVICTED_TO_DISK = 3
+} DXGI_RESIDENCY;
+
+typedef enum DXGI_MEMORY_SEGMENT_GROUP {
+	DXGI_MEMORY_SEGMENT_GROUP_LOCAL = 0,
+	DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL = 1
+} DXGI_MEMORY_SEGMENT_GROUP;
+
+typedef struct DXGI_QUERY_VIDEO_MEMORY_INFO {
+	UINT64 Budget;
+	UINT64 CurrentUsage;
+	UINT64 AvailableForReservation;
+	UINT64 CurrentReservation;
+} DXGI_QUERY_VIDEO_MEMORY_INFO;
+
+#define DXGI_RESOURCE_PRIORITY_MINIMUM 0x28000000UL
+#define DXGI_RESOURCE_PRIORITY_LOW     0x50000000UL
+#define DXGI_RESOURCE_PRIORITY_NORMAL  0x78000000UL
+#define DXGI_RESOURCE_PRIORITY_HIGH    0xa0000000UL
+#define DXGI_RESOURCE_PRIORITY_MAXIMUM 0xc8000000UL
+
+typedef enum DXGI_OFFER_RESOURCE_PRIORITY {
+	DXGI_OFFER_RESOURCE_PRIORITY_LOW = 1,
+	DXGI_OFFER_RESOURCE_PRIORITY_NORMAL = 2,
+	DXGI_OFFER_RESOURCE_PRIORITY_HIGH = 3
+} DXGI_OFFER_RESOURCE_PRIORITY;
+
+typedef enum DXGI_RECLAIM_RESOURCE_RESULTS {
+	DXGI_RECLAIM_RESOURCE_RESULT_OK = 0,
+	DXGI_RECLAIM_RESOURCE_RESULT_DISCARDED = 1,
+	DXGI_RECLAIM_RESOURCE_RESULT_NOT_COMMITTED = 2
+} DXGI_RECLAIM_RESOURCE_RESULTS;
+
+typedef struct DXGI_OUTDUPL_MOVE_RECT {
+	POINT SourcePoint;
+	RECT DestinationRect;
+} DXGI_OUTDUPL_MOVE_RECT;
+
+typedef struct DXGI_RGB {
+	float Red;
+	float Green;
+	float Blue;
+} DXGI_RGB;
+
+typedef struct DXGI_GAMMA_CONTROL {
+	DXGI_RGB Scale;
+	DXGI_RGB Offset;
+	DXGI_RGB GammaCurve[1025];
+} DXGI_GAMMA_CONTROL;
+
+typedef struct DXGI_GAMMA_CONTROL_CAPABILITIES {
+	BOOL ScaleAndOffsetSupported;
+	float MaxConvertedValue;
+	float MinConvertedValue;
+	UINT NumGammaControlPoints;
+	float ControlPointPositions[1025];
+} DXGI_GAMMA_CONTROL_CAPABILITIES;
+
+typedef struct DXGI_HDR_METADATA_HDR10 {
+	UINT16 RedPrimary[2];
+	UINT16 GreenPrimary[2];
+	UINT16 BluePrimary[2];
+	UINT16 WhitePoint[2];
+	UINT MaxMasteringLuminance;
+	UINT MinMasteringLuminance;
+	UINT16 MaxContentLightLevel;
+	UINT16 MaxFrameAverageLightLevel;
+} DXGI_HDR_METADATA_HDR10;
+
+#define DXGI_PRESENT_TEST            0x00000001UL
+#define DXGI_PRESENT_DO_NOT_SEQUENCE 0x00000002UL
+#define DXGI_PRESENT_RESTART         0x00000004UL
+#define DXGI_PRESENT_ALLOW_TEARING   0x00000200UL
+
+#define DXGI_MAP_READ    1UL
+#define DXGI_MAP_WRITE   2UL
+#define DXGI_MAP_DISCARD 4UL
+
+#endif
\ No newline at end of file
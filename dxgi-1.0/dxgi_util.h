@@ -1,111 +1,384 @@
-#pragma once
-
-#include <dxgi.h>
-#include <string>
-
-#define CHECK_BIT(x, bit) (x & bit) != 0
-
-// a utility to convert DXGI_MODE_ROTATION into a descriptive string.
-inline const char* rotationString(DXGI_MODE_ROTATION rotation) {
-	switch (rotation) {
-	case DXGI_MODE_ROTATION_IDENTITY:
-		return "identity";
-	case DXGI_MODE_ROTATION_ROTATE180:
-		return "rotate-180";
-	case DXGI_MODE_ROTATION_ROTATE270:
-		return "rotate-270";
-	case DXGI_MODE_ROTATION_ROTATE90:
-		return "rotate-90";
-	case DXGI_MODE_ROTATION_UNSPECIFIED:
-		return "unspecified";
-	default:
-		return "unknown";
-	}
-}
-
-// a utility to get string presentation of DXGI_MODE_SCALING.
-inline const char* scalingString(DXGI_MODE_SCALING mode) {
-	switch (mode) {
-	case DXGI_MODE_SCALING_CENTERED:
-		return "centered";
-	case DXGI_MODE_SCALING_STRETCHED:
-		return "stretched";
-	case DXGI_MODE_SCALING_UNSPECIFIED:
-		return "unspecified";
-	default:
-		return "unknown";
-	}
-}
-
-// a utility to get string presentation of DXGI_MODE_SCANLINE_ORDER.
-inline const char* scanlineOrderingString(DXGI_MODE_SCANLINE_ORDER mode) {
-	switch (mode) {
-	case DXGI_MODE_SCANLINE_ORDER_LOWER_FIELD_FIRST:
-		return "lower-field-first";
-	case DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE:
-		return "progressive";
-	case DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED:
-		return "unspecified";
-	case DXGI_MODE_SCANLINE_ORDER_UPPER_FIELD_FIRST:
-		return "upper-field-first";
-	default:
-		return "unknown";
-	}
-}
-
-// a utility to get string presentation of DXGI_RESIDENCY.
-inline const char* residencyString(DXGI_RESIDENCY residency) {
-	switch (residency) {
-	case DXGI_RESIDENCY_EVICTED_TO_DISK:
-		return "evicted-to-disk";
-	case DXGI_RESIDENCY_FULLY_RESIDENT:
-		return "fully-resident";
-	case DXGI_RESIDENCY_RESIDENT_IN_SHARED_MEMORY:
-		return "in-shared-memory";
-	default:
-		return "unknown";
-	}
-}
-
-// a utility to get string presentation of DXGI_SWAP_EFFECT.
-inline const char* swapEffectString(DXGI_SWAP_EFFECT effect) {
-	switch (effect) {
-	case DXGI_SWAP_EFFECT_DISCARD:
-		return "discard";
-	case DXGI_SWAP_EFFECT_FLIP_DISCARD:
-		return "flip-discard";
-	case DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL:
-		return "flip-sequential";
-	case DXGI_SWAP_EFFECT_SEQUENTIAL:
-		return "sequential";
-	default:
-		return "unknown";
-	}
-}
-
-// a utility to get string presentation of DXGI_USAGE.
-inline std::string usageString(DXGI_USAGE usage) {
-	std::string result;
-	if (CHECK_BIT(usage, DXGI_USAGE_BACK_BUFFER)) {
-		result += "[back-buffer]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_DISCARD_ON_PRESENT)) {
-		result += "[discard-on-present]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_READ_ONLY)) {
-		result += "[read-only]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_RENDER_TARGET_OUTPUT)) {
-		result += "[render-target-output]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_SHADER_INPUT)) {
-		result += "[shared-input]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_SHARED)) {
-		result += "[shared]";
-	}
-	if (CHECK_BIT(usage, DXGI_USAGE_UNORDERED_ACCESS)) {
-		result += "[unordered-access]";
-	}
-	return result;
+#pragma once
+
+#include "dxgi_shim.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ============================================================================
+// Enum and flag formatting
+//
+// Names of the DXGI enums and flags are kept in constant tables next to their
+// values, so that each name lookup is a plain table lookup without any kind
+// of string building. The tables are sorted by value and the dense ones are
+// indexed directly, like the FORMAT_NAMES. Flag sets and rectangles are
+// written into sinks, which are objects with an append(const char*, size_t)
+// function.
+//
+//		BufferSink		-- Writes into a caller-provided character buffer
+//		FixedString		-- A fixed capacity string returned by the helpers
+//
+// Neither of them allocates from the heap. Text which does not fit into the
+// buffer is truncated and the result is always null-terminated. Unknown enum
+// values are named "unknown" and unknown flag bits are written in hex.
+// ============================================================================
+
+// a name of an enum value.
+template <typename T>
+struct EnumName {
+	T			value;
+	const char*	name;
+};
+
+// a name of a bit in a flag set.
+struct FlagName {
+	UINT		flag;
+	const char*	name;
+};
+
+// a utility to find the name of the enum value from the table. The tables are
+// sorted by value, so a value of a dense table is found at its offset from the
+// first value without any search (only the gaps fall back to a linear search).
+template <typename T, size_t N>
+constexpr const char* enumName(const EnumName<T>(&names)[N], T value) {
+	auto index = static_cast<size_t>(value) - static_cast<size_t>(names[0].value);
+	if (index < N && names[index].value == value) {
+		return names[index].name;
+	}
+	for (const auto& name : names) {
+		if (name.value == value) {
+			return name.name;
+		}
+	}
+	return "unknown";
+}
+
+// a utility to append text into a fixed buffer (truncates and null-terminates).
+inline void appendText(char* data, size_t capacity, size_t* size, bool* truncated, const char* text, size_t length) {
+	auto available = capacity - 1 - *size;
+	if (length > available) {
+		length = available;
+		*truncated = true;
+	}
+	std::memcpy(data + *size, text, length);
+	*size += length;
+	data[*size] = '\0';
+}
+
+// a sink which writes into a caller-provided buffer.
+class BufferSink final {
+public:
+	BufferSink(char* buffer, size_t capacity) : mData(buffer), mCapacity(capacity), mSize(0), mTruncated(false) {
+		mData[0] = '\0';
+	}
+
+	template <size_t N>
+	explicit BufferSink(char(&buffer)[N]) : BufferSink(buffer, N) {
+	}
+
+	void append(const char* text, size_t length) {
+		appendText(mData, mCapacity, &mSize, &mTruncated, text, length);
+	}
+
+	const char* c_str() const { return mData; }
+	size_t size() const { return mSize; }
+	bool truncated() const { return mTruncated; }
+private:
+	char*	mData;
+	size_t	mCapacity;
+	size_t	mSize;
+	bool	mTruncated;
+};
+
+// a fixed capacity string which is returned by value from the formatters.
+template <size_t Capacity>
+class FixedString final {
+public:
+	FixedString() : mSize(0), mTruncated(false) {
+		mData[0] = '\0';
+	}
+
+	void append(const char* text, size_t length) {
+		appendText(mData, Capacity, &mSize, &mTruncated, text, length);
+	}
+
+	const char* c_str() const { return mData; }
+	size_t size() const { return mSize; }
+	bool truncated() const { return mTruncated; }
+private:
+	char	mData[Capacity];
+	size_t	mSize;
+	bool	mTruncated;
+};
+
+// a utility to append a null-terminated string into the sink.
+template <typename Sink>
+inline void appendString(Sink& sink, const char* text) {
+	sink.append(text, std::strlen(text));
+}
+
+// a utility to append a signed decimal integer into the sink.
+template <typename Sink>
+inline void appendInt(Sink& sink, int64_t value) {
+	char digits[24];
+	auto end = digits + sizeof(digits);
+	auto begin = end;
+	auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+	do {
+		*--begin = static_cast<char>('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+	if (value < 0) {
+		*--begin = '-';
+	}
+	sink.append(begin, static_cast<size_t>(end - begin));
+}
+
+// a utility to append a hexadecimal integer (with the 0x prefix) into the sink.
+template <typename Sink>
+inline void appendHex(Sink& sink, uint64_t value) {
+	char digits[18];
+	auto end = digits + sizeof(digits);
+	auto begin = end;
+	do {
+		*--begin = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	} while (value != 0);
+	*--begin = 'x';
+	*--begin = '0';
+	sink.append(begin, static_cast<size_t>(end - begin));
+}
+
+// a utility to append the names of the flags as [name] items into the sink.
+template <typename Sink, size_t N>
+inline void appendFlags(Sink& sink, const FlagName(&names)[N], UINT flags) {
+	for (const auto& name : names) {
+		if ((flags & name.flag) != 0) {
+			sink.append("[", 1);
+			appendString(sink, name.name);
+			sink.append("]", 1);
+			flags &= ~name.flag;
+		}
+	}
+	if (flags != 0) {
+		sink.append("[", 1);
+		appendHex(sink, flags);
+		sink.append("]", 1);
+	}
+}
+
+// a utility to append RECT into the sink.
+template <typename Sink>
+inline void appendRect(Sink& sink, const RECT& rect) {
+	appendString(sink, "{top: ");
+	appendInt(sink, rect.top);
+	appendString(sink, ", right: ");
+	appendInt(sink, rect.right);
+	appendString(sink, ", bottom: ");
+	appendInt(sink, rect.bottom);
+	appendString(sink, ", left: ");
+	appendInt(sink, rect.left);
+	appendString(sink, "}");
+}
+
+constexpr EnumName<DXGI_MODE_ROTATION> ROTATION_NAMES[] = {
+	{ DXGI_MODE_ROTATION_UNSPECIFIED, "unspecified" },
+	{ DXGI_MODE_ROTATION_IDENTITY, "identity" },
+	{ DXGI_MODE_ROTATION_ROTATE90, "rotate-90" },
+	{ DXGI_MODE_ROTATION_ROTATE180, "rotate-180" },
+	{ DXGI_MODE_ROTATION_ROTATE270, "rotate-270" }
+};
+
+constexpr EnumName<DXGI_MODE_SCALING> SCALING_NAMES[] = {
+	{ DXGI_MODE_SCALING_UNSPECIFIED, "unspecified" },
+	{ DXGI_MODE_SCALING_CENTERED, "centered" },
+	{ DXGI_MODE_SCALING_STRETCHED, "stretched" }
+};
+
+constexpr EnumName<DXGI_MODE_SCANLINE_ORDER> SCANLINE_ORDER_NAMES[] = {
+	{ DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED, "unspecified" },
+	{ DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE, "progressive" },
+	{ DXGI_MODE_SCANLINE_ORDER_UPPER_FIELD_FIRST, "upper-field-first" },
+	{ DXGI_MODE_SCANLINE_ORDER_LOWER_FIELD_FIRST, "lower-field-first" }
+};
+
+constexpr EnumName<DXGI_RESIDENCY> RESIDENCY_NAMES[] = {
+	{ DXGI_RESIDENCY_FULLY_RESIDENT, "fully-resident" },
+	{ DXGI_RESIDENCY_RESIDENT_IN_SHARED_MEMORY, "in-shared-memory" },
+	{ DXGI_RESIDENCY_EVICTED_TO_DISK, "evicted-to-disk" }
+};
+
+constexpr EnumName<DXGI_SWAP_EFFECT> SWAP_EFFECT_NAMES[] = {
+	{ DXGI_SWAP_EFFECT_DISCARD, "discard" },
+	{ DXGI_SWAP_EFFECT_SEQUENTIAL, "sequential" },
+	{ DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL, "flip-sequential" },
+	{ DXGI_SWAP_EFFECT_FLIP_DISCARD, "flip-discard" }
+};
+
+constexpr FlagName USAGE_NAMES[] = {
+	{ DXGI_USAGE_BACK_BUFFER, "back-buffer" },
+	{ DXGI_USAGE_DISCARD_ON_PRESENT, "discard-on-present" },
+	{ DXGI_USAGE_READ_ONLY, "read-only" },
+	{ DXGI_USAGE_RENDER_TARGET_OUTPUT, "render-target-output" },
+	{ DXGI_USAGE_SHADER_INPUT, "shader-input" },
+	{ DXGI_USAGE_SHARED, "shared" },
+	{ DXGI_USAGE_UNORDERED_ACCESS, "unordered-access" }
+};
+
+constexpr FlagName PRESENT_NAMES[] = {
+	{ DXGI_PRESENT_TEST, "test" },
+	{ DXGI_PRESENT_DO_NOT_SEQUENCE, "do-not-sequence" },
+	{ DXGI_PRESENT_RESTART, "restart" },
+	{ DXGI_PRESENT_ALLOW_TEARING, "allow-tearing" }
+};
+
+constexpr FlagName MAP_NAMES[] = {
+	{ DXGI_MAP_READ, "read" },
+	{ DXGI_MAP_WRITE, "write" },
+	{ DXGI_MAP_DISCARD, "discard" }
+};
+
+constexpr FlagName SWAP_CHAIN_FLAG_NAMES[] = {
+	{ DXGI_SWAP_CHAIN_FLAG_NONPREROTATED, "nonprerotated" },
+	{ DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH, "allow-mode-switch" },
+	{ DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE, "gdi-compatible" },
+	{ DXGI_SWAP_CHAIN_FLAG_RESTRICTED_CONTENT, "restricted-content" },
+	{ DXGI_SWAP_CHAIN_FLAG_RESTRICT_SHARED_RESOURCE_DRIVER, "restrict-shared-resource-driver" },
+	{ DXGI_SWAP_CHAIN_FLAG_DISPLAY_ONLY, "display-only" },
+	{ DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT, "frame-latency-waitable-object" },
+	{ DXGI_SWAP_CHAIN_FLAG_FOREGROUND_LAYER, "foreground-layer" },
+	{ DXGI_SWAP_CHAIN_FLAG_FULLSCREEN_VIDEO, "fullscreen-video" },
+	{ DXGI_SWAP_CHAIN_FLAG_YUV_VIDEO, "yuv-video" },
+	{ DXGI_SWAP_CHAIN_FLAG_HW_PROTECTED, "hw-protected" },
+	{ DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING, "allow-tearing" }
+};
+
+// the names of DXGI_FORMAT values 0 - 115 (indexed with the value).
+constexpr const char* FORMAT_NAMES[] = {
+	"UNKNOWN",
+	"R32G32B32A32_TYPELESS", "R32G32B32A32_FLOAT", "R32G32B32A32_UINT", "R32G32B32A32_SINT",
+	"R32G32B32_TYPELESS", "R32G32B32_FLOAT", "R32G32B32_UINT", "R32G32B32_SINT",
+	"R16G16B16A16_TYPELESS", "R16G16B16A16_FLOAT", "R16G16B16A16_UNORM", "R16G16B16A16_UINT",
+	"R16G16B16A16_SNORM", "R16G16B16A16_SINT",
+	"R32G32_TYPELESS", "R32G32_FLOAT", "R32G32_UINT", "R32G32_SINT",
+	"R32G8X24_TYPELESS", "D32_FLOAT_S8X24_UINT", "R32_FLOAT_X8X24_TYPELESS", "X32_TYPELESS_G8X24_UINT",
+	"R10G10B10A2_TYPELESS", "R10G10B10A2_UNORM", "R10G10B10A2_UINT", "R11G11B10_FLOAT",
+	"R8G8B8A8_TYPELESS", "R8G8B8A8_UNORM", "R8G8B8A8_UNORM_SRGB", "R8G8B8A8_UINT",
+	"R8G8B8A8_SNORM", "R8G8B8A8_SINT",
+	"R16G16_TYPELESS", "R16G16_FLOAT", "R16G16_UNORM", "R16G16_UINT", "R16G16_SNORM", "R16G16_SINT",
+	"R32_TYPELESS", "D32_FLOAT", "R32_FLOAT", "R32_UINT", "R32_SINT",
+	"R24G8_TYPELESS", "D24_UNORM_S8_UINT", "R24_UNORM_X8_TYPELESS", "X24_TYPELESS_G8_UINT",
+	"R8G8_TYPELESS", "R8G8_UNORM", "R8G8_UINT", "R8G8_SNORM", "R8G8_SINT",
+	"R16_TYPELESS", "R16_FLOAT", "D16_UNORM", "R16_UNORM", "R16_UINT", "R16_SNORM", "R16_SINT",
+	"R8_TYPELESS", "R8_UNORM", "R8_UINT", "R8_SNORM", "R8_SINT", "A8_UNORM",
+	"R1_UNORM", "R9G9B9E5_SHAREDEXP", "R8G8_B8G8_UNORM", "G8R8_G8B8_UNORM",
+	"BC1_TYPELESS", "BC1_UNORM", "BC1_UNORM_SRGB", "BC2_TYPELESS", "BC2_UNORM", "BC2_UNORM_SRGB",
+	"BC3_TYPELESS", "BC3_UNORM", "BC3_UNORM_SRGB", "BC4_TYPELESS", "BC4_UNORM", "BC4_SNORM",
+	"BC5_TYPELESS", "BC5_UNORM", "BC5_SNORM",
+	"B5G6R5_UNORM", "B5G5R5A1_UNORM", "B8G8R8A8_UNORM", "B8G8R8X8_UNORM", "R10G10B10_XR_BIAS_A2_UNORM",
+	"B8G8R8A8_TYPELESS", "B8G8R8A8_UNORM_SRGB", "B8G8R8X8_TYPELESS", "B8G8R8X8_UNORM_SRGB",
+	"BC6H_TYPELESS", "BC6H_UF16", "BC6H_SF16", "BC7_TYPELESS", "BC7_UNORM", "BC7_UNORM_SRGB",
+	"AYUV", "Y410", "Y416", "NV12", "P010", "P016", "420_OPAQUE", "YUY2", "Y210", "Y216",
+	"NV11", "AI44", "IA44", "P8", "A8P8", "B4G4R4A4_UNORM"
+};
+
+static_assert(sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0]) == 116, "DXGI_FORMAT names must match the values");
+
+// the names of the sparse DXGI_FORMAT values after B4G4R4A4_UNORM.
+constexpr EnumName<UINT> SPARSE_FORMAT_NAMES[] = {
+	{ 130, "P208" },
+	{ 131, "V208" },
+	{ 132, "V408" },
+	{ 189, "SAMPLER_FEEDBACK_MIN_MIP_OPAQUE" },
+	{ 190, "SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE" }
+};
+
+// a utility to get string presentation of DXGI_FORMAT (without the prefix).
+inline const char* formatString(DXGI_FORMAT format) {
+	auto value = static_cast<UINT>(format);
+	if (value < sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0])) {
+		return FORMAT_NAMES[value];
+	}
+	return enumName(SPARSE_FORMAT_NAMES, value);
+}
+
+// a utility to convert DXGI_MODE_ROTATION into a descriptive string.
+inline const char* rotationString(DXGI_MODE_ROTATION rotation) {
+	return enumName(ROTATION_NAMES, rotation);
+}
+
+// a utility to get string presentation of DXGI_MODE_SCALING.
+inline const char* scalingString(DXGI_MODE_SCALING mode) {
+	return enumName(SCALING_NAMES, mode);
+}
+
+// a utility to get string presentation of DXGI_MODE_SCANLINE_ORDER.
+inline const char* scanlineOrderingString(DXGI_MODE_SCANLINE_ORDER mode) {
+	return enumName(SCANLINE_ORDER_NAMES, mode);
+}
+
+// a utility to get string presentation of DXGI_RESIDENCY.
+inline const char* residencyString(DXGI_RESIDENCY residency) {
+	return enumName(RESIDENCY_NAMES, residency);
+}
+
+// a utility to get string presentation of DXGI_SWAP_EFFECT.
+inline const char* swapEffectString(DXGI_SWAP_EFFECT effect) {
+	return enumName(SWAP_EFFECT_NAMES, effect);
+}
+
+// a utility to get string presentation of DXGI_USAGE.
+inline FixedString<160> usageString(DXGI_USAGE usage) {
+	FixedString<160> result;
+	appendFlags(result, USAGE_NAMES, usage);
+	return result;
+}
+
+// a utility to get string presentation of DXGI_PRESENT flags.
+inline FixedString<64> presentFlagsString(UINT flags) {
+	FixedString<64> result;
+	appendFlags(result, PRESENT_NAMES, flags);
+	return result;
+}
+
+// a utility to get string presentation of DXGI_MAP flags.
+inline FixedString<32> mapFlagsString(UINT flags) {
+	FixedString<32> result;
+	appendFlags(result, MAP_NAMES, flags);
+	return result;
+}
+
+// a utility to get string presentation of DXGI_SWAP_CHAIN_FLAG flags.
+inline FixedString<320> swapChainFlagsString(UINT flags) {
+	FixedString<320> result;
+	appendFlags(result, SWAP_CHAIN_FLAG_NAMES, flags);
+	return result;
+}
+
+// a utility to convert RECT into a descriptive string.
+inline FixedString<80> rectString(const RECT& rect) {
+	FixedString<80> result;
+	appendRect(result, rect);
+	return result;
+}
+
+// a utility to get the amount of bytes used to store a single DXGI_FORMAT pixel.
+inline UINT formatBytesPerPixel(DXGI_FORMAT format) {
+	switch (format) {
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		return 4;
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 2;
+	default:
+		return 0;
+	}
 }
\ No newline at end of file
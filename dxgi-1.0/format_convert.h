@@ -0,0 +1,644 @@
+#pragma once
+
+#include <cstring>
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+#include "simd_util.h"
+
+// ============================================================================
+// Pixel Format Conversion
+//
+// Converts pixels between the surface formats commonly used with the mapped
+// surfaces. Both the source and the destination are described with a pitch
+// aware SurfaceView, which can be built directly from a DXGI_MAPPED_RECT.
+//
+//		R8G8B8A8_UNORM (_SRGB)	-- 8-bit channels in RGBA order
+//		B8G8R8A8_UNORM (_SRGB)	-- 8-bit channels in BGRA order
+//		R10G10B10A2_UNORM		-- 10-bit colour and 2-bit alpha channels
+//		R16G16B16A16_FLOAT		-- 16-bit floating point channels
+//		B5G6R5_UNORM			-- 16-bit pixels without an alpha channel
+//		B5G5R5A1_UNORM			-- 16-bit pixels with a 1-bit alpha channel
+//		B4G4R4A4_UNORM			-- 16-bit pixels with 4-bit channels
+//
+// Conversions work as defined by the Direct3D data conversion rules. UNORM
+// values are turned into floats by dividing with the maximum value, floats
+// are clamped to [0, 1] and rounded to nearest when turned into UNORM values
+// and floats are rounded to nearest even when turned into 16-bit floats. The
+// missing alpha channel is treated as fully opaque. _SRGB formats are copied
+// as stored values, as the conversion only changes the memory layout.
+//
+// The most common format pairs have SIMD kernels, while the other pairs use a
+// scalar kernel which decodes pixels into floats and then encodes them again.
+// Rounding results of the kernels are bit-exact with the scalar kernel. UNORM
+// to UNORM conversions are never closer than 1/2046 to a rounding tie, and the
+// products of the 16-bit float conversions are exact, so neither the order of
+// the float operations nor a contraction into fused multiply-add matters.
+// ============================================================================
+
+// a pitch aware view into pixels of a mapped surface.
+struct SurfaceView {
+	BYTE*		bits;
+	INT			pitch;
+	UINT		width;
+	UINT		height;
+	DXGI_FORMAT	format;
+};
+
+// a utility to build a surface view from a DXGI_MAPPED_RECT.
+inline SurfaceView surfaceView(const DXGI_MAPPED_RECT& rect, UINT width, UINT height, DXGI_FORMAT format) {
+	return { rect.pBits, rect.Pitch, width, height, format };
+}
+
+// a function to convert a single row of the given amount of pixels.
+typedef void(*ConvertRowFunc)(const BYTE* src, BYTE* dst, UINT count);
+
+// the memory layouts of the supported formats.
+enum class PixelLayout {
+	Unknown,
+	Rgba8,
+	Bgra8,
+	Rgb10a2,
+	Rgba16f,
+	B5g6r5,
+	B5g5r5a1,
+	B4g4r4a4
+};
+
+// a utility to get the memory layout of the format.
+inline PixelLayout pixelLayout(DXGI_FORMAT format) {
+	switch (format) {
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		return PixelLayout::Rgba8;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		return PixelLayout::Bgra8;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+		return PixelLayout::Rgb10a2;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		return PixelLayout::Rgba16f;
+	case DXGI_FORMAT_B5G6R5_UNORM:
+		return PixelLayout::B5g6r5;
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+		return PixelLayout::B5g5r5a1;
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return PixelLayout::B4g4r4a4;
+	default:
+		return PixelLayout::Unknown;
+	}
+}
+
+// ============================================================================
+// Scalar kernels
+// ============================================================================
+
+// a utility to convert a UNORM value with the given maximum into a float.
+inline float unormToFloat(uint32_t value, float maximum) {
+	return static_cast<float>(value) * (1.0f / maximum);
+}
+
+// a utility to convert a float into a UNORM value with the given maximum.
+inline uint32_t floatToUnorm(float value, float maximum) {
+	value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+	return static_cast<uint32_t>(value * maximum + 0.5f);
+}
+
+// a utility to decode pixels of the layout into RGBA floats.
+template <PixelLayout Layout>
+inline void decodePixels(const BYTE* src, float* rgba, UINT count) {
+	for (UINT i = 0; i < count; i++, rgba += 4) {
+		if constexpr (Layout == PixelLayout::Rgba8 || Layout == PixelLayout::Bgra8) {
+			const auto red = Layout == PixelLayout::Rgba8 ? 0 : 2;
+			rgba[0] = unormToFloat(src[i * 4 + red], 255.0f);
+			rgba[1] = unormToFloat(src[i * 4 + 1], 255.0f);
+			rgba[2] = unormToFloat(src[i * 4 + 2 - red], 255.0f);
+			rgba[3] = unormToFloat(src[i * 4 + 3], 255.0f);
+		} else if constexpr (Layout == PixelLayout::Rgb10a2) {
+			uint32_t pixel;
+			std::memcpy(&pixel, src + i * 4, sizeof(pixel));
+			rgba[0] = unormToFloat(pixel & 0x3ff, 1023.0f);
+			rgba[1] = unormToFloat((pixel >> 10) & 0x3ff, 1023.0f);
+			rgba[2] = unormToFloat((pixel >> 20) & 0x3ff, 1023.0f);
+			rgba[3] = unormToFloat(pixel >> 30, 3.0f);
+		} else if constexpr (Layout == PixelLayout::Rgba16f) {
+			uint16_t pixel[4];
+			std::memcpy(pixel, src + i * 8, sizeof(pixel));
+			for (auto c = 0; c < 4; c++) {
+				rgba[c] = halfToFloat(pixel[c]);
+			}
+		} else {
+			uint16_t pixel;
+			std::memcpy(&pixel, src + i * 2, sizeof(pixel));
+			if constexpr (Layout == PixelLayout::B5g6r5) {
+				rgba[0] = unormToFloat(pixel >> 11, 31.0f);
+				rgba[1] = unormToFloat((pixel >> 5) & 0x3f, 63.0f);
+				rgba[2] = unormToFloat(pixel & 0x1f, 31.0f);
+				rgba[3] = 1.0f;
+			} else if constexpr (Layout == PixelLayout::B5g5r5a1) {
+				rgba[0] = unormToFloat((pixel >> 10) & 0x1f, 31.0f);
+				rgba[1] = unormToFloat((pixel >> 5) & 0x1f, 31.0f);
+				rgba[2] = unormToFloat(pixel & 0x1f, 31.0f);
+				rgba[3] = unormToFloat(pixel >> 15, 1.0f);
+			} else {
+				rgba[0] = unormToFloat((pixel >> 8) & 0xf, 15.0f);
+				rgba[1] = unormToFloat((pixel >> 4) & 0xf, 15.0f);
+				rgba[2] = unormToFloat(pixel & 0xf, 15.0f);
+				rgba[3] = unormToFloat(pixel >> 12, 15.0f);
+			}
+		}
+	}
+}
+
+// a utility to encode RGBA floats into pixels of the layout.
+template <PixelLayout Layout>
+inline void encodePixels(const float* rgba, BYTE* dst, UINT count) {
+	for (UINT i = 0; i < count; i++, rgba += 4) {
+		if constexpr (Layout == PixelLayout::Rgba8 || Layout == PixelLayout::Bgra8) {
+			const auto red = Layout == PixelLayout::Rgba8 ? 0 : 2;
+			dst[i * 4 + red] = static_cast<BYTE>(floatToUnorm(rgba[0], 255.0f));
+			dst[i * 4 + 1] = static_cast<BYTE>(floatToUnorm(rgba[1], 255.0f));
+			dst[i * 4 + 2 - red] = static_cast<BYTE>(floatToUnorm(rgba[2], 255.0f));
+			dst[i * 4 + 3] = static_cast<BYTE>(floatToUnorm(rgba[3], 255.0f));
+		} else if constexpr (Layout == PixelLayout::Rgb10a2) {
+			auto pixel = floatToUnorm(rgba[0], 1023.0f)
+				| (floatToUnorm(rgba[1], 1023.0f) << 10)
+				| (floatToUnorm(rgba[2], 1023.0f) << 20)
+				| (floatToUnorm(rgba[3], 3.0f) << 30);
+			std::memcpy(dst + i * 4, &pixel, sizeof(pixel));
+		} else if constexpr (Layout == PixelLayout::Rgba16f) {
+			uint16_t pixel[4];
+			for (auto c = 0; c < 4; c++) {
+				pixel[c] = floatToHalf(rgba[c]);
+			}
+			std::memcpy(dst + i * 8, pixel, sizeof(pixel));
+		} else {
+			uint32_t pixel;
+			if constexpr (Layout == PixelLayout::B5g6r5) {
+				pixel = (floatToUnorm(rgba[0], 31.0f) << 11)
+					| (floatToUnorm(rgba[1], 63.0f) << 5)
+					| floatToUnorm(rgba[2], 31.0f);
+			} else if constexpr (Layout == PixelLayout::B5g5r5a1) {
+				pixel = (floatToUnorm(rgba[0], 31.0f) << 10)
+					| (floatToUnorm(rgba[1], 31.0f) << 5)
+					| floatToUnorm(rgba[2], 31.0f)
+					| (floatToUnorm(rgba[3], 1.0f) << 15);
+			} else {
+				pixel = (floatToUnorm(rgba[0], 15.0f) << 8)
+					| (floatToUnorm(rgba[1], 15.0f) << 4)
+					| floatToUnorm(rgba[2], 15.0f)
+					| (floatToUnorm(rgba[3], 15.0f) << 12);
+			}
+			auto packed = static_cast<uint16_t>(pixel);
+			std::memcpy(dst + i * 2, &packed, sizeof(packed));
+		}
+	}
+}
+
+// a generic kernel which converts pixels through RGBA floats in small chunks.
+template <PixelLayout Src, PixelLayout Dst>
+inline void convertRowGeneric(const BYTE* src, BYTE* dst, UINT count) {
+	const UINT CHUNK = 64;
+	float rgba[CHUNK * 4];
+	const auto srcSize = Src == PixelLayout::Rgba16f ? 8u : (Src >= PixelLayout::B5g6r5 ? 2u : 4u);
+	const auto dstSize = Dst == PixelLayout::Rgba16f ? 8u : (Dst >= PixelLayout::B5g6r5 ? 2u : 4u);
+	for (UINT i = 0; i < count; i += CHUNK) {
+		auto n = count - i < CHUNK ? count - i : CHUNK;
+		decodePixels<Src>(src + i * srcSize, rgba, n);
+		encodePixels<Dst>(rgba, dst + i * dstSize, n);
+	}
+}
+
+// a scalar kernel which swaps the red and blue channels of 8-bit pixels.
+inline void swizzleRowScalar(const BYTE* src, BYTE* dst, UINT count) {
+	for (UINT i = 0; i < count; i++) {
+		auto red = src[i * 4];
+		dst[i * 4] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = red;
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+// ============================================================================
+// SSE 4.1 and AVX2 kernels
+// ============================================================================
+#if defined(SIMD_X86)
+
+SIMD_TARGET_SSE41 inline __m128i quantizeSse41(__m128i value, __m128 scale) {
+	auto scaled = _mm_mul_ps(_mm_cvtepi32_ps(value), scale);
+	return _mm_cvttps_epi32(_mm_add_ps(scaled, _mm_set1_ps(0.5f)));
+}
+
+SIMD_TARGET_SSE41 inline void swizzleRowSse41(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(pixels, mask));
+	}
+	swizzleRowScalar(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Src>
+SIMD_TARGET_SSE41 inline void convert8ToRgb10a2Sse41(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm_set1_epi32(0xff);
+	const auto scale = _mm_set1_ps(1023.0f / 255.0f);
+	const auto alphaScale = _mm_set1_ps(3.0f / 255.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		auto c0 = quantizeSse41(_mm_and_si128(pixels, mask), scale);
+		auto c1 = quantizeSse41(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask), scale);
+		auto c2 = quantizeSse41(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask), scale);
+		auto c3 = quantizeSse41(_mm_srli_epi32(pixels, 24), alphaScale);
+		auto red = Src == PixelLayout::Rgba8 ? c0 : c2;
+		auto blue = Src == PixelLayout::Rgba8 ? c2 : c0;
+		auto result = _mm_or_si128(_mm_or_si128(red, _mm_slli_epi32(c1, 10)),
+			_mm_or_si128(_mm_slli_epi32(blue, 20), _mm_slli_epi32(c3, 30)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), result);
+	}
+	convertRowGeneric<Src, PixelLayout::Rgb10a2>(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Dst>
+SIMD_TARGET_SSE41 inline void convertRgb10a2To8Sse41(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm_set1_epi32(0x3ff);
+	const auto scale = _mm_set1_ps(255.0f / 1023.0f);
+	const auto alphaScale = _mm_set1_ps(255.0f / 3.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		auto red = quantizeSse41(_mm_and_si128(pixels, mask), scale);
+		auto green = quantizeSse41(_mm_and_si128(_mm_srli_epi32(pixels, 10), mask), scale);
+		auto blue = quantizeSse41(_mm_and_si128(_mm_srli_epi32(pixels, 20), mask), scale);
+		auto alpha = quantizeSse41(_mm_srli_epi32(pixels, 30), alphaScale);
+		auto c0 = Dst == PixelLayout::Rgba8 ? red : blue;
+		auto c2 = Dst == PixelLayout::Rgba8 ? blue : red;
+		auto result = _mm_or_si128(_mm_or_si128(c0, _mm_slli_epi32(green, 8)),
+			_mm_or_si128(_mm_slli_epi32(c2, 16), _mm_slli_epi32(alpha, 24)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), result);
+	}
+	convertRowGeneric<PixelLayout::Rgb10a2, Dst>(src + i * 4, dst + i * 4, count - i);
+}
+
+SIMD_TARGET_AVX2 inline __m256i quantizeAvx2(__m256 value, __m256 scale) {
+	auto scaled = _mm256_mul_ps(value, scale);
+	return _mm256_cvttps_epi32(_mm256_add_ps(scaled, _mm256_set1_ps(0.5f)));
+}
+
+SIMD_TARGET_AVX2 inline __m256i quantizeAvx2(__m256i value, __m256 scale) {
+	return quantizeAvx2(_mm256_cvtepi32_ps(value), scale);
+}
+
+SIMD_TARGET_AVX2 inline void swizzleRowAvx2(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(pixels, mask));
+	}
+	swizzleRowScalar(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Src>
+SIMD_TARGET_AVX2 inline void convert8ToRgb10a2Avx2(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm256_set1_epi32(0xff);
+	const auto scale = _mm256_set1_ps(1023.0f / 255.0f);
+	const auto alphaScale = _mm256_set1_ps(3.0f / 255.0f);
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+		auto c0 = quantizeAvx2(_mm256_and_si256(pixels, mask), scale);
+		auto c1 = quantizeAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask), scale);
+		auto c2 = quantizeAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask), scale);
+		auto c3 = quantizeAvx2(_mm256_srli_epi32(pixels, 24), alphaScale);
+		auto red = Src == PixelLayout::Rgba8 ? c0 : c2;
+		auto blue = Src == PixelLayout::Rgba8 ? c2 : c0;
+		auto result = _mm256_or_si256(_mm256_or_si256(red, _mm256_slli_epi32(c1, 10)),
+			_mm256_or_si256(_mm256_slli_epi32(blue, 20), _mm256_slli_epi32(c3, 30)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), result);
+	}
+	convert8ToRgb10a2Sse41<Src>(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Dst>
+SIMD_TARGET_AVX2 inline void convertRgb10a2To8Avx2(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = _mm256_set1_epi32(0x3ff);
+	const auto scale = _mm256_set1_ps(255.0f / 1023.0f);
+	const auto alphaScale = _mm256_set1_ps(255.0f / 3.0f);
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+		auto red = quantizeAvx2(_mm256_and_si256(pixels, mask), scale);
+		auto green = quantizeAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask), scale);
+		auto blue = quantizeAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 20), mask), scale);
+		auto alpha = quantizeAvx2(_mm256_srli_epi32(pixels, 30), alphaScale);
+		auto c0 = Dst == PixelLayout::Rgba8 ? red : blue;
+		auto c2 = Dst == PixelLayout::Rgba8 ? blue : red;
+		auto result = _mm256_or_si256(_mm256_or_si256(c0, _mm256_slli_epi32(green, 8)),
+			_mm256_or_si256(_mm256_slli_epi32(c2, 16), _mm256_slli_epi32(alpha, 24)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), result);
+	}
+	convertRgb10a2To8Sse41<Dst>(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Src>
+SIMD_TARGET_AVX2 inline void convert8ToRgba16fAvx2(const BYTE* src, BYTE* dst, UINT count) {
+	const auto swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	const auto scale = _mm256_set1_ps(1.0f / 255.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		if (Src == PixelLayout::Bgra8) {
+			pixels = _mm_shuffle_epi8(pixels, swizzle);
+		}
+		auto low = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pixels)), scale);
+		auto high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8))), scale);
+		auto out = reinterpret_cast<__m128i*>(dst + i * 8);
+		_mm_storeu_si128(out, _mm256_cvtps_ph(low, _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128(out + 1, _mm256_cvtps_ph(high, _MM_FROUND_TO_NEAREST_INT));
+	}
+	convertRowGeneric<Src, PixelLayout::Rgba16f>(src + i * 4, dst + i * 8, count - i);
+}
+
+template <PixelLayout Dst>
+SIMD_TARGET_AVX2 inline void convertRgba16fTo8Avx2(const BYTE* src, BYTE* dst, UINT count) {
+	const auto swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	const auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto scale = _mm256_set1_ps(255.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto in = reinterpret_cast<const __m128i*>(src + i * 8);
+		// the max returns the second operand for NaNs, so NaNs become zero.
+		auto low = _mm256_min_ps(_mm256_max_ps(_mm256_cvtph_ps(_mm_loadu_si128(in)), zero), one);
+		auto high = _mm256_min_ps(_mm256_max_ps(_mm256_cvtph_ps(_mm_loadu_si128(in + 1)), zero), one);
+		auto words = _mm256_packus_epi32(quantizeAvx2(low, scale),
+			quantizeAvx2(high, scale));
+		auto bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), order);
+		auto pixels = _mm256_castsi256_si128(bytes);
+		if (Dst == PixelLayout::Bgra8) {
+			pixels = _mm_shuffle_epi8(pixels, swizzle);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), pixels);
+	}
+	convertRowGeneric<PixelLayout::Rgba16f, Dst>(src + i * 8, dst + i * 4, count - i);
+}
+
+#endif
+
+// ============================================================================
+// NEON kernels
+// ============================================================================
+#if defined(SIMD_NEON)
+
+inline uint32x4_t quantizeNeon(float32x4_t value, float32x4_t scale) {
+	auto scaled = vmulq_f32(value, scale);
+	return vcvtq_u32_f32(vaddq_f32(scaled, vdupq_n_f32(0.5f)));
+}
+
+inline uint32x4_t quantizeNeon(uint32x4_t value, float32x4_t scale) {
+	return quantizeNeon(vcvtq_f32_u32(value), scale);
+}
+
+inline void swizzleRowNeon(const BYTE* src, BYTE* dst, UINT count) {
+	UINT i = 0;
+	for (; i + 16 <= count; i += 16) {
+		auto pixels = vld4q_u8(src + i * 4);
+		auto red = pixels.val[0];
+		pixels.val[0] = pixels.val[2];
+		pixels.val[2] = red;
+		vst4q_u8(dst + i * 4, pixels);
+	}
+	swizzleRowScalar(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Src>
+inline void convert8ToRgb10a2Neon(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = vdupq_n_u32(0xff);
+	const auto scale = vdupq_n_f32(1023.0f / 255.0f);
+	const auto alphaScale = vdupq_n_f32(3.0f / 255.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = vld1q_u32(reinterpret_cast<const uint32_t*>(src + i * 4));
+		auto c0 = quantizeNeon(vandq_u32(pixels, mask), scale);
+		auto c1 = quantizeNeon(vandq_u32(vshrq_n_u32(pixels, 8), mask), scale);
+		auto c2 = quantizeNeon(vandq_u32(vshrq_n_u32(pixels, 16), mask), scale);
+		auto c3 = quantizeNeon(vshrq_n_u32(pixels, 24), alphaScale);
+		auto red = Src == PixelLayout::Rgba8 ? c0 : c2;
+		auto blue = Src == PixelLayout::Rgba8 ? c2 : c0;
+		auto result = vorrq_u32(vorrq_u32(red, vshlq_n_u32(c1, 10)),
+			vorrq_u32(vshlq_n_u32(blue, 20), vshlq_n_u32(c3, 30)));
+		vst1q_u32(reinterpret_cast<uint32_t*>(dst + i * 4), result);
+	}
+	convertRowGeneric<Src, PixelLayout::Rgb10a2>(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Dst>
+inline void convertRgb10a2To8Neon(const BYTE* src, BYTE* dst, UINT count) {
+	const auto mask = vdupq_n_u32(0x3ff);
+	const auto scale = vdupq_n_f32(255.0f / 1023.0f);
+	const auto alphaScale = vdupq_n_f32(255.0f / 3.0f);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		auto pixels = vld1q_u32(reinterpret_cast<const uint32_t*>(src + i * 4));
+		auto red = quantizeNeon(vandq_u32(pixels, mask), scale);
+		auto green = quantizeNeon(vandq_u32(vshrq_n_u32(pixels, 10), mask), scale);
+		auto blue = quantizeNeon(vandq_u32(vshrq_n_u32(pixels, 20), mask), scale);
+		auto alpha = quantizeNeon(vshrq_n_u32(pixels, 30), alphaScale);
+		auto c0 = Dst == PixelLayout::Rgba8 ? red : blue;
+		auto c2 = Dst == PixelLayout::Rgba8 ? blue : red;
+		auto result = vorrq_u32(vorrq_u32(c0, vshlq_n_u32(green, 8)),
+			vorrq_u32(vshlq_n_u32(c2, 16), vshlq_n_u32(alpha, 24)));
+		vst1q_u32(reinterpret_cast<uint32_t*>(dst + i * 4), result);
+	}
+	convertRowGeneric<PixelLayout::Rgb10a2, Dst>(src + i * 4, dst + i * 4, count - i);
+}
+
+template <PixelLayout Src>
+inline void convert8ToRgba16fNeon(const BYTE* src, BYTE* dst, UINT count) {
+	const uint8_t order[8] = { 2, 1, 0, 3, 6, 5, 4, 7 };
+	const auto swizzle = vld1_u8(order);
+	const auto scale = vdupq_n_f32(1.0f / 255.0f);
+	UINT i = 0;
+	for (; i + 2 <= count; i += 2) {
+		auto bytes = vld1_u8(src + i * 4);
+		if (Src == PixelLayout::Bgra8) {
+			bytes = vtbl1_u8(bytes, swizzle);
+		}
+		auto pixels = vmovl_u8(bytes);
+		auto low = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(pixels))), scale);
+		auto high = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(pixels))), scale);
+		auto out = reinterpret_cast<float16_t*>(dst + i * 8);
+		vst1_f16(out, vcvt_f16_f32(low));
+		vst1_f16(out + 4, vcvt_f16_f32(high));
+	}
+	convertRowGeneric<Src, PixelLayout::Rgba16f>(src + i * 4, dst + i * 8, count - i);
+}
+
+template <PixelLayout Dst>
+inline void convertRgba16fTo8Neon(const BYTE* src, BYTE* dst, UINT count) {
+	const uint8_t order[8] = { 2, 1, 0, 3, 6, 5, 4, 7 };
+	const auto swizzle = vld1_u8(order);
+	const auto zero = vdupq_n_f32(0.0f);
+	const auto one = vdupq_n_f32(1.0f);
+	const auto scale = vdupq_n_f32(255.0f);
+	UINT i = 0;
+	for (; i + 2 <= count; i += 2) {
+		auto in = reinterpret_cast<const float16_t*>(src + i * 8);
+		// the maxnm returns the number for NaNs, so NaNs become zero.
+		auto low = vminq_f32(vmaxnmq_f32(vcvt_f32_f16(vld1_f16(in)), zero), one);
+		auto high = vminq_f32(vmaxnmq_f32(vcvt_f32_f16(vld1_f16(in + 4)), zero), one);
+		auto lowWords = vmovn_u32(quantizeNeon(low, scale));
+		auto highWords = vmovn_u32(quantizeNeon(high, scale));
+		auto pixels = vmovn_u16(vcombine_u16(lowWords, highWords));
+		if (Dst == PixelLayout::Bgra8) {
+			pixels = vtbl1_u8(pixels, swizzle);
+		}
+		vst1_u8(dst + i * 4, pixels);
+	}
+	convertRowGeneric<PixelLayout::Rgba16f, Dst>(src + i * 8, dst + i * 4, count - i);
+}
+
+#endif
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+// a utility to find the generic kernel for the given destination layout.
+template <PixelLayout Src>
+inline ConvertRowFunc findGenericRow(PixelLayout dst) {
+	switch (dst) {
+	case PixelLayout::Rgba8:
+		return &convertRowGeneric<Src, PixelLayout::Rgba8>;
+	case PixelLayout::Bgra8:
+		return &convertRowGeneric<Src, PixelLayout::Bgra8>;
+	case PixelLayout::Rgb10a2:
+		return &convertRowGeneric<Src, PixelLayout::Rgb10a2>;
+	case PixelLayout::Rgba16f:
+		return &convertRowGeneric<Src, PixelLayout::Rgba16f>;
+	case PixelLayout::B5g6r5:
+		return &convertRowGeneric<Src, PixelLayout::B5g6r5>;
+	case PixelLayout::B5g5r5a1:
+		return &convertRowGeneric<Src, PixelLayout::B5g5r5a1>;
+	case PixelLayout::B4g4r4a4:
+		return &convertRowGeneric<Src, PixelLayout::B4g4r4a4>;
+	default:
+		return nullptr;
+	}
+}
+
+// a utility to find the scalar kernel which converts pixels between layouts.
+inline ConvertRowFunc findGenericRow(PixelLayout src, PixelLayout dst) {
+	switch (src) {
+	case PixelLayout::Rgba8:
+		return findGenericRow<PixelLayout::Rgba8>(dst);
+	case PixelLayout::Bgra8:
+		return findGenericRow<PixelLayout::Bgra8>(dst);
+	case PixelLayout::Rgb10a2:
+		return findGenericRow<PixelLayout::Rgb10a2>(dst);
+	case PixelLayout::Rgba16f:
+		return findGenericRow<PixelLayout::Rgba16f>(dst);
+	case PixelLayout::B5g6r5:
+		return findGenericRow<PixelLayout::B5g6r5>(dst);
+	case PixelLayout::B5g5r5a1:
+		return findGenericRow<PixelLayout::B5g5r5a1>(dst);
+	case PixelLayout::B4g4r4a4:
+		return findGenericRow<PixelLayout::B4g4r4a4>(dst);
+	default:
+		return nullptr;
+	}
+}
+
+// a utility to find the fastest kernel for the given layouts and SIMD level.
+inline ConvertRowFunc findConvertRow(PixelLayout src, PixelLayout dst, SimdLevel level) {
+	auto swizzle = (src == PixelLayout::Rgba8 && dst == PixelLayout::Bgra8)
+		|| (src == PixelLayout::Bgra8 && dst == PixelLayout::Rgba8);
+	auto rgba = src == PixelLayout::Rgba8 || dst == PixelLayout::Rgba8;
+	auto bgra = src == PixelLayout::Bgra8 || dst == PixelLayout::Bgra8;
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		if (swizzle) {
+			return &swizzleRowAvx2;
+		} else if (src == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convertRgb10a2To8Avx2<PixelLayout::Rgba8> : &convertRgb10a2To8Avx2<PixelLayout::Bgra8>;
+		} else if (dst == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convert8ToRgb10a2Avx2<PixelLayout::Rgba8> : &convert8ToRgb10a2Avx2<PixelLayout::Bgra8>;
+		} else if (src == PixelLayout::Rgba16f && (rgba || bgra)) {
+			return rgba ? &convertRgba16fTo8Avx2<PixelLayout::Rgba8> : &convertRgba16fTo8Avx2<PixelLayout::Bgra8>;
+		} else if (dst == PixelLayout::Rgba16f && (rgba || bgra)) {
+			return rgba ? &convert8ToRgba16fAvx2<PixelLayout::Rgba8> : &convert8ToRgba16fAvx2<PixelLayout::Bgra8>;
+		}
+	}
+	if (level == SimdLevel::Avx2 || level == SimdLevel::Sse41) {
+		if (swizzle) {
+			return &swizzleRowSse41;
+		} else if (src == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convertRgb10a2To8Sse41<PixelLayout::Rgba8> : &convertRgb10a2To8Sse41<PixelLayout::Bgra8>;
+		} else if (dst == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convert8ToRgb10a2Sse41<PixelLayout::Rgba8> : &convert8ToRgb10a2Sse41<PixelLayout::Bgra8>;
+		}
+	}
+#elif defined(SIMD_NEON)
+	if (level == SimdLevel::Neon) {
+		if (swizzle) {
+			return &swizzleRowNeon;
+		} else if (src == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convertRgb10a2To8Neon<PixelLayout::Rgba8> : &convertRgb10a2To8Neon<PixelLayout::Bgra8>;
+		} else if (dst == PixelLayout::Rgb10a2 && (rgba || bgra)) {
+			return rgba ? &convert8ToRgb10a2Neon<PixelLayout::Rgba8> : &convert8ToRgb10a2Neon<PixelLayout::Bgra8>;
+		} else if (src == PixelLayout::Rgba16f && (rgba || bgra)) {
+			return rgba ? &convertRgba16fTo8Neon<PixelLayout::Rgba8> : &convertRgba16fTo8Neon<PixelLayout::Bgra8>;
+		} else if (dst == PixelLayout::Rgba16f && (rgba || bgra)) {
+			return rgba ? &convert8ToRgba16fNeon<PixelLayout::Rgba8> : &convert8ToRgba16fNeon<PixelLayout::Bgra8>;
+		}
+	}
+#endif
+	if (swizzle) {
+		return &swizzleRowScalar;
+	}
+	return findGenericRow(src, dst);
+}
+
+// ============================================================================
+// convertSurface
+//
+// Converts pixels from the source view into the destination view. The views
+// must have the same size and must not overlap unless the formats match and
+// the views point to the same memory, in which case nothing is done.
+//
+// Returns E_INVALIDARG if views are null or have different sizes.
+// Returns DXGI_ERROR_UNSUPPORTED if either of the formats is not supported.
+// ============================================================================
+inline HRESULT convertSurface(const SurfaceView& src, const SurfaceView& dst, SimdLevel level = bestSimdLevel()) {
+	if (src.bits == nullptr || dst.bits == nullptr || src.width != dst.width || src.height != dst.height) {
+		return E_INVALIDARG;
+	}
+	auto srcLayout = pixelLayout(src.format);
+	auto dstLayout = pixelLayout(dst.format);
+	if (srcLayout == PixelLayout::Unknown || dstLayout == PixelLayout::Unknown) {
+		return DXGI_ERROR_UNSUPPORTED;
+	}
+
+	// matching layouts only require a row copy.
+	if (srcLayout == dstLayout) {
+		auto rowSize = static_cast<size_t>(src.width) * formatBytesPerPixel(src.format);
+		for (UINT y = 0; y < src.height && src.bits != dst.bits; y++) {
+			std::memcpy(dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch,
+				src.bits + static_cast<ptrdiff_t>(y) * src.pitch, rowSize);
+		}
+		return S_OK;
+	}
+
+	auto convertRow = findConvertRow(srcLayout, dstLayout, level);
+	for (UINT y = 0; y < src.height; y++) {
+		convertRow(src.bits + static_cast<ptrdiff_t>(y) * src.pitch,
+			dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch, src.width);
+	}
+	return S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+#include "vblank_clock.h"
+
+// ============================================================================
+// FrameLimiter
+//
+// A just-in-time frame limiter which minimizes the input latency. A loop that
+// starts rendering right after the previous Present samples the input early
+// and then lets the finished frame wait for the next vblank, so the input is
+// always about a frame old when it is shown. The limiter instead predicts the
+// CPU cost of the next frame and delays the frame start so that the frame is
+// finished just before the deadline of its present.
+//
+//		start = deadline - predicted cost - safety margin
+//
+// The deadline depends on the present mode of the swap chain.
+//
+//		VSync	-- The next vblank (of the VBlankClock), minus the present lead
+//		Tearing	-- The previous deadline plus the target interval (a frame
+//				   cap), or right after the frame if there is no target
+//
+// The tearing mode is meant for the swap chains created with the flag
+// DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING, when the factory reports support for
+// DXGI_FEATURE_PRESENT_ALLOW_TEARING (i.e. a variable refresh rate display).
+//
+// The cost of the next frame is predicted with the given percentile of the
+// latest HISTORY_SIZE frame costs, so rare spikes do not move the frame start
+// and a change in the scene costs is followed within a second. A frame which
+// finishes after its deadline is counted as missed. Note that the spikes above
+// the percentile are then missed by design, and with vsync each of them waits
+// for one more vblank, so the tail latency can be worse than the one of a loop
+// without the limiter. A safety margin which covers the spikes avoids that at
+// the cost of the median latency (see the limiter.* benchmarks of dxgi-bench).
+//
+//		auto deadline = limiter.beginFrame();	// waits for the frame start
+//		sampleInput();
+//		render();
+//		limiter.endFrame();
+//		swapchain->Present(1, 0);
+// ============================================================================
+enum class PresentMode {
+	VSync,
+	Tearing
+};
+
+// a utility to get string presentation of PresentMode.
+inline const char* presentModeString(PresentMode mode) {
+	switch (mode) {
+	case PresentMode::VSync:	return "vsync";
+	case PresentMode::Tearing:	return "tearing";
+	default:					return "unknown";
+	}
+}
+
+struct FrameLimiterDesc {
+	PresentMode	mode;
+	int64_t		presentLead;	// ticks the present must be called before the vblank (vsync).
+	int64_t		targetInterval;	// ticks between the frames, or 0 for no cap (tearing).
+	int64_t		safetyMargin;	// ticks kept between the predicted end and the deadline.
+	double		percentile;		// the percentile of the history used as the prediction.
+};
+
+class FrameLimiter final {
+public:
+	static constexpr UINT HISTORY_SIZE = 64;
+
+	// the clock is required only for the vsync and the waiter only for accurate wakes.
+	FrameLimiter(const FrameLimiterDesc& desc, TimeSource& time, const VBlankClock* clock = nullptr, PreciseWaiter* waiter = nullptr)
+		: mDesc(desc), mTime(time), mClock(clock), mWaiter(waiter) {
+		mDesc.percentile = std::min(std::max(mDesc.percentile, 0.0), 1.0);
+		mCosts = {};
+		mCount = 0;
+		mNext = 0;
+		mPrediction = 0;
+		mStart = 0;
+		mDeadline = 0;
+		mFrames = 0;
+		mMissed = 0;
+	}
+
+	// wait until the just-in-time start of the next frame, and get the deadline of its present.
+	int64_t beginFrame() {
+		auto now = mTime.now();
+		auto earliest = now + mPrediction + mDesc.safetyMargin;
+		if (mDesc.mode == PresentMode::VSync && mClock != nullptr) {
+			// never target the same vblank twice, even if the previous frame was late.
+			auto vblank = mClock->nextVBlank(std::max(earliest, mDeadline) + mDesc.presentLead);
+			mDeadline = vblank - mDesc.presentLead;
+		} else if (mDesc.targetInterval > 0 && mDeadline != 0) {
+			mDeadline = std::max(mDeadline + mDesc.targetInterval, earliest);
+		} else {
+			mDeadline = earliest;
+		}
+
+		auto start = mDeadline - mPrediction - mDesc.safetyMargin;
+		if (start > now) {
+			if (mWaiter != nullptr) {
+				mWaiter->waitUntil(start);
+			} else {
+				mTime.waitUntil(start);
+			}
+		}
+		mStart = mTime.now();
+		return mDeadline;
+	}
+
+	// tell that the frame has been rendered and is about to be presented.
+	void endFrame() {
+		auto end = mTime.now();
+		mFrames++;
+		if (end > mDeadline) {
+			mMissed++;
+		}
+		mCosts[mNext] = end - mStart;
+		mNext = (mNext + 1) % HISTORY_SIZE;
+		mCount = std::min(mCount + 1, HISTORY_SIZE);
+		predict();
+	}
+
+	int64_t predictedCost() const { return mPrediction; }
+	int64_t deadline() const { return mDeadline; }
+	uint64_t frames() const { return mFrames; }
+	uint64_t missed() const { return mMissed; }
+private:
+	void predict() {
+		std::array<int64_t, HISTORY_SIZE> costs;
+		std::copy(mCosts.begin(), mCosts.begin() + mCount, costs.begin());
+		auto index = static_cast<UINT>(mDesc.percentile * (mCount - 1) + 0.5);
+		std::nth_element(costs.begin(), costs.begin() + index, costs.begin() + mCount);
+		mPrediction = costs[index];
+	}
+
+	FrameLimiterDesc					mDesc;
+	TimeSource&							mTime;
+	const VBlankClock*					mClock;
+	PreciseWaiter*						mWaiter;
+	std::array<int64_t, HISTORY_SIZE>	mCosts;
+	UINT								mCount;
+	UINT								mNext;
+	int64_t								mPrediction;
+	int64_t								mStart;
+	int64_t								mDeadline;
+	uint64_t							mFrames;
+	uint64_t							mMissed;
+};
\ No newline at end of file
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "frame_stats.h"
+#include "hresult.h"
+#include "ref_ptr.h"
+#include "soft_swap_chain.h"
+#include "time_source.h"
+
+// ============================================================================
+// FramePipeline
+//
+// Decouples the rendering of the frames from the presentation of the frames,
+// so that the thread which pumps the window messages never blocks on either.
+// The pipeline runs the following stages on their own threads.
+//
+//		message thread	-- The caller, which only starts, tunes and stops it
+//		render workers	-- Take a frame slot, render into a surface and queue it
+//		present thread	-- Present the rendered frames in their frame order
+//
+// The frames in flight are limited with the maximum frame latency, just like
+// IDXGIDevice1::SetMaximumFrameLatency limits the frames which the CPU may be
+// ahead of the GPU. A render worker must get a latency slot before it starts a
+// new frame, and the slot is given back only after the frame was presented. A
+// lower latency gives a faster response to the input, while a higher latency
+// tolerates more variance in the frame times without missing the vblanks.
+//
+// Workers hand the rendered frames into the present thread through a bounded
+// lock-free queue. As several workers may render at the same time, the frames
+// may arrive out of order, so the present thread keeps a small reorder window
+// indexed with the frame index. Surfaces are recycled with another queue and
+// created only when all the existing ones are in flight, so the amount of the
+// surfaces never exceeds the highest frame latency that has been used.
+//
+// The time of each stage is recorded into the histograms (see the report).
+//
+//		wait	-- Ticks a worker waited for a latency slot
+//		render	-- Ticks the render function took
+//		queue	-- Ticks a rendered frame waited for the present thread
+//		present	-- Ticks the present sink took
+//		latency	-- Ticks from the start of a frame to the end of its present
+//		interval-- Ticks between the consecutive presents
+//
+// Retryable present results (e.g. an occluded window) skip the frame and are
+// counted, while a fatal render or present result stops the whole pipeline
+// and is reported by the result function. The time source is shared by all
+// the threads, so it must be thread-safe (all but the ManualTimeSource are).
+// ============================================================================
+
+// a bounded multi-producer multi-consumer lock-free queue (Dmitry Vyukov).
+template <typename T>
+class BoundedQueue final {
+public:
+	explicit BoundedQueue(size_t capacity) {
+		size_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		mMask = size - 1;
+		mCells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++) {
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mEnqueue.store(0, std::memory_order_relaxed);
+		mDequeue.store(0, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	// try to push the value into the queue, or return false if the queue is full.
+	bool tryPush(T value) {
+		auto position = mEnqueue.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = mCells[position & mMask];
+			auto sequence = cell.sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				if (mEnqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					cell.value = std::move(value);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = mEnqueue.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// try to pop a value from the queue, or return false if the queue is empty.
+	bool tryPop(T* value) {
+		auto position = mDequeue.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = mCells[position & mMask];
+			auto sequence = cell.sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0) {
+				if (mDequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					*value = std::move(cell.value);
+					cell.sequence.store(position + mMask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = mDequeue.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	size_t capacity() const { return mMask + 1; }
+private:
+	struct Cell {
+		std::atomic<size_t>	sequence;
+		T					value;
+	};
+
+	std::unique_ptr<Cell[]>				mCells;
+	size_t								mMask;
+	alignas(64) std::atomic<size_t>		mEnqueue;
+	alignas(64) std::atomic<size_t>		mDequeue;
+};
+
+// a utility to wait with an increasing backoff (spin, yield and finally sleep).
+class Backoff final {
+public:
+	void wait() {
+		if (mCount < 16) {
+			mCount++;
+		} else if (mCount < 64) {
+			mCount++;
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+
+	void reset() { mCount = 0; }
+private:
+	uint32_t mCount = 0;
+};
+
+// a frame which moves through the pipeline.
+struct PipelineFrame {
+	uint64_t			index;		// the index of the frame (0, 1, 2 ...).
+	SoftwareSurface*	surface;	// the surface where the frame is rendered.
+	HRESULT				result;		// the result of the render function.
+	int64_t				started;	// ticks when the frame got a latency slot.
+	int64_t				rendered;	// ticks when the frame was rendered.
+};
+
+// the final stage of the pipeline which presents the rendered frames.
+class PresentSink {
+public:
+	virtual ~PresentSink() = default;
+	virtual HRESULT present(const PipelineFrame& frame) = 0;
+};
+
+// a present sink which copies the frames into a software swap chain (e.g. for headless tests).
+class SoftwarePresentSink final : public PresentSink {
+public:
+	SoftwarePresentSink(SoftwareSwapChain& swapchain, UINT syncInterval = 1)
+		: mSwapChain(swapchain), mSyncInterval(syncInterval) {}
+
+	HRESULT present(const PipelineFrame& frame) override {
+		RefPtr<SoftwareSurface> buffer;
+		auto result = mSwapChain.GetBuffer(0, &buffer);
+		if (FAILED(result)) {
+			return result;
+		}
+		auto& surface = *frame.surface;
+		if (buffer->format() != surface.format()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto height = buffer->height() < surface.height() ? buffer->height() : surface.height();
+		auto width = buffer->width() < surface.width() ? buffer->width() : surface.width();
+		auto rowSize = static_cast<size_t>(width) * formatBytesPerPixel(surface.format());
+		for (UINT y = 0; y < height; y++) {
+			memcpy(buffer->data() + static_cast<size_t>(y) * buffer->pitch(), surface.data() + static_cast<size_t>(y) * surface.pitch(), rowSize);
+		}
+		buffer.reset();
+		return mSwapChain.Present(mSyncInterval, 0);
+	}
+private:
+	SoftwareSwapChain&	mSwapChain;
+	UINT				mSyncInterval;
+};
+
+// a function which renders the frame into its surface.
+typedef std::function<HRESULT(const PipelineFrame& frame)> RenderFunction;
+
+struct FramePipelineDesc {
+	UINT		width;
+	UINT		height;
+	DXGI_FORMAT	format;
+	UINT		renderWorkers;		// amount of the render threads (at least 1).
+	UINT		maxFrameLatency;	// amount of the frames in flight (1..MAX_FRAME_LATENCY).
+};
+
+// a summary of the frames which went through the pipeline.
+struct FramePipelineReport {
+	uint64_t		presented;	// amount of the presented frames.
+	uint64_t		retried;	// amount of the frames skipped with a retryable result.
+	uint64_t		dropped;	// amount of the rendered frames not presented as the pipeline was stopping.
+	uint64_t		surfaces;	// amount of the surfaces created for the frames in flight.
+	HistogramReport	wait;
+	HistogramReport	render;
+	HistogramReport	queue;
+	HistogramReport	present;
+	HistogramReport	latency;
+	HistogramReport	interval;
+};
+
+class FramePipeline final {
+public:
+	static constexpr UINT MAX_FRAME_LATENCY = 16;
+	static constexpr UINT DEFAULT_FRAME_LATENCY = 3;
+
+	FramePipeline(const FramePipelineDesc& desc, TimeSource& time, RenderFunction render, PresentSink& sink)
+		: mDesc(desc), mTime(time), mRender(std::move(render)), mSink(sink),
+		mFrames(MAX_FRAME_LATENCY), mSurfaces(MAX_FRAME_LATENCY), mWindow(MAX_FRAME_LATENCY) {
+		mDesc.renderWorkers = mDesc.renderWorkers == 0 ? 1 : mDesc.renderWorkers;
+		mMaxFrameLatency.store(clampLatency(mDesc.maxFrameLatency), std::memory_order_relaxed);
+		mInFlight.store(0, std::memory_order_relaxed);
+		mWorkers.store(0, std::memory_order_relaxed);
+		mNextFrame.store(0, std::memory_order_relaxed);
+		mSurfaceCount.store(0, std::memory_order_relaxed);
+		mStopping.store(false, std::memory_order_relaxed);
+		mResult.store(S_OK, std::memory_order_relaxed);
+		mPresented.store(0, std::memory_order_relaxed);
+		mRetried.store(0, std::memory_order_relaxed);
+		mDropped.store(0, std::memory_order_relaxed);
+	}
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	~FramePipeline() { stop(); }
+
+	// start the render workers and the present thread.
+	HRESULT start() {
+		if (!mThreads.empty()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mStopping.store(false, std::memory_order_relaxed);
+		mResult.store(S_OK, std::memory_order_relaxed);
+		mNextFrame.store(0, std::memory_order_relaxed);
+		mWorkers.store(mDesc.renderWorkers, std::memory_order_relaxed);
+		mThreads.emplace_back([this]() { presentLoop(); });
+		for (UINT i = 0; i < mDesc.renderWorkers; i++) {
+			mThreads.emplace_back([this]() { renderLoop(); });
+		}
+		return S_OK;
+	}
+
+	// stop the pipeline after the frames in flight have been flushed (the rendered ones are dropped).
+	void stop() {
+		mStopping.store(true, std::memory_order_release);
+		for (auto& thread : mThreads) {
+			thread.join();
+		}
+		mThreads.clear();
+	}
+
+	// set the amount of the frames in flight (may be changed while running).
+	HRESULT SetMaximumFrameLatency(UINT maxLatency) {
+		if (maxLatency > MAX_FRAME_LATENCY) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMaxFrameLatency.store(clampLatency(maxLatency), std::memory_order_relaxed);
+		return S_OK;
+	}
+
+	HRESULT GetMaximumFrameLatency(UINT* maxLatency) const {
+		if (maxLatency == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*maxLatency = mMaxFrameLatency.load(std::memory_order_relaxed);
+		return S_OK;
+	}
+
+	// check whether the pipeline is still running (false after a fatal result).
+	bool running() const { return !mThreads.empty() && !mStopping.load(std::memory_order_acquire); }
+
+	// get the first fatal result which stopped the pipeline (S_OK if none).
+	HRESULT result() const { return mResult.load(std::memory_order_acquire); }
+
+	FramePipelineReport report() const {
+		FramePipelineReport report = {};
+		report.presented = mPresented.load(std::memory_order_relaxed);
+		report.retried = mRetried.load(std::memory_order_relaxed);
+		report.dropped = mDropped.load(std::memory_order_relaxed);
+		report.surfaces = mSurfaceCount.load(std::memory_order_relaxed);
+		report.wait = mWaitTime.report();
+		report.render = mRenderTime.report();
+		report.queue = mQueueTime.report();
+		report.present = mPresentTime.report();
+		report.latency = mLatency.report();
+		report.interval = mInterval.report();
+		return report;
+	}
+private:
+	static UINT clampLatency(UINT latency) {
+		return latency == 0 ? DEFAULT_FRAME_LATENCY : (latency > MAX_FRAME_LATENCY ? MAX_FRAME_LATENCY : latency);
+	}
+
+	void fail(HRESULT result) {
+		auto expected = S_OK;
+		mResult.compare_exchange_strong(expected, result, std::memory_order_acq_rel);
+		mStopping.store(true, std::memory_order_release);
+	}
+
+	// wait for a latency slot, or return false when the pipeline is stopping.
+	bool acquireSlot() {
+		Backoff backoff;
+		auto inFlight = mInFlight.load(std::memory_order_relaxed);
+		while (!mStopping.load(std::memory_order_acquire)) {
+			if (inFlight < mMaxFrameLatency.load(std::memory_order_relaxed)) {
+				if (mInFlight.compare_exchange_weak(inFlight, inFlight + 1, std::memory_order_acquire)) {
+					return true;
+				}
+				continue;
+			}
+			backoff.wait();
+			inFlight = mInFlight.load(std::memory_order_relaxed);
+		}
+		return false;
+	}
+
+	SoftwareSurface* acquireSurface() {
+		SoftwareSurface* surface = nullptr;
+		if (mSurfaces.tryPop(&surface)) {
+			return surface;
+		}
+		// all the surfaces are in flight, so the latency must have been raised.
+		mSurfaceCount.fetch_add(1, std::memory_order_relaxed);
+		return makeRef<SoftwareSurface>(mDesc.width, mDesc.height, mDesc.format).detach();
+	}
+
+	void renderLoop() {
+		for (;;) {
+			auto waitBegin = mTime.now();
+			if (!acquireSlot()) {
+				break;
+			}
+			PipelineFrame frame = {};
+			frame.started = mTime.now();
+			mWaitTime.record(static_cast<uint64_t>(frame.started - waitBegin));
+			frame.index = mNextFrame.fetch_add(1, std::memory_order_relaxed);
+			frame.surface = acquireSurface();
+			frame.result = mRender(frame);
+			frame.rendered = mTime.now();
+			mRenderTime.record(static_cast<uint64_t>(frame.rendered - frame.started));
+
+			// the queue has a cell for each possible frame in flight, so this spins only briefly.
+			Backoff backoff;
+			while (!mFrames.tryPush(frame)) {
+				backoff.wait();
+			}
+		}
+		mWorkers.fetch_sub(1, std::memory_order_release);
+	}
+
+	void presentLoop() {
+		uint64_t nextFrame = 0;
+		int64_t lastPresent = 0;
+		Backoff backoff;
+		for (;;) {
+			PipelineFrame frame;
+			if (!mFrames.tryPop(&frame)) {
+				// all the started frames are flushed before stopping.
+				if (mStopping.load(std::memory_order_acquire) && mWorkers.load(std::memory_order_acquire) == 0
+					&& mInFlight.load(std::memory_order_acquire) == 0) {
+					break;
+				}
+				backoff.wait();
+				continue;
+			}
+			backoff.reset();
+			mWindow[frame.index % MAX_FRAME_LATENCY] = frame;
+			mPending[frame.index % MAX_FRAME_LATENCY] = true;
+
+			// present the frames in order as long as the next frame is available.
+			while (mPending[nextFrame % MAX_FRAME_LATENCY]) {
+				auto& next = mWindow[nextFrame % MAX_FRAME_LATENCY];
+				mPending[nextFrame % MAX_FRAME_LATENCY] = false;
+				// the frames rendered after a stop are dropped, and kept out of the presented frames and the histograms.
+				auto result = next.result;
+				if (SUCCEEDED(result) && mStopping.load(std::memory_order_relaxed)) {
+					mDropped.fetch_add(1, std::memory_order_relaxed);
+				} else {
+					auto begin = mTime.now();
+					mQueueTime.record(static_cast<uint64_t>(begin - next.rendered));
+					if (SUCCEEDED(result)) {
+						result = mSink.present(next);
+					}
+					auto end = mTime.now();
+
+					switch (classifyHresult(result)) {
+					case HresultClass::Success:
+						mPresentTime.record(static_cast<uint64_t>(end - begin));
+						mLatency.record(static_cast<uint64_t>(end - next.started));
+						if (lastPresent != 0) {
+							mInterval.record(static_cast<uint64_t>(end - lastPresent));
+						}
+						lastPresent = end;
+						mPresented.fetch_add(1, std::memory_order_relaxed);
+						break;
+					case HresultClass::Retryable:
+						mRetried.fetch_add(1, std::memory_order_relaxed);
+						break;
+					default:
+						fail(result);
+						break;
+					}
+				}
+
+				// give the surface and the latency slot back for the next frame.
+				if (!mSurfaces.tryPush(next.surface)) {
+					next.surface->Release();
+				}
+				mInFlight.fetch_sub(1, std::memory_order_release);
+				nextFrame++;
+			}
+		}
+
+		SoftwareSurface* surface = nullptr;
+		while (mSurfaces.tryPop(&surface)) {
+			surface->Release();
+		}
+	}
+
+	FramePipelineDesc						mDesc;
+	TimeSource&								mTime;
+	RenderFunction							mRender;
+	PresentSink&							mSink;
+	BoundedQueue<PipelineFrame>				mFrames;
+	BoundedQueue<SoftwareSurface*>			mSurfaces;
+	std::vector<PipelineFrame>				mWindow;
+	bool									mPending[MAX_FRAME_LATENCY] = {};
+	std::vector<std::thread>				mThreads;
+	std::atomic<UINT>						mMaxFrameLatency;
+	std::atomic<UINT>						mInFlight;
+	std::atomic<UINT>						mWorkers;
+	std::atomic<uint64_t>					mNextFrame;
+	std::atomic<uint64_t>					mSurfaceCount;
+	std::atomic<bool>						mStopping;
+	std::atomic<HRESULT>					mResult;
+	std::atomic<uint64_t>					mPresented;
+	std::atomic<uint64_t>					mRetried;
+	std::atomic<uint64_t>					mDropped;
+	LatencyHistogram						mWaitTime;
+	LatencyHistogram						mRenderTime;
+	LatencyHistogram						mQueueTime;
+	LatencyHistogram						mPresentTime;
+	LatencyHistogram						mLatency;
+	LatencyHistogram						mInterval;
+};
\ No newline at end of file
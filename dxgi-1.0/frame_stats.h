@@ -0,0 +1,307 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// a utility to get the index of the highest set bit in a non-zero value.
+inline uint32_t highestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#elif defined(__GNUC__)
+	return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+	auto index = 0u;
+	while (value >>= 1) {
+		index++;
+	}
+	return index;
+#endif
+}
+
+// a summary of the values recorded into a histogram.
+struct HistogramReport {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t p999;
+	double mean;
+};
+
+// ============================================================================
+// LatencyHistogram
+//
+// A histogram with a high dynamic range for 64-bit tick values. Each power of
+// two range is split into SUB_BUCKETS linear buckets, so the recorded values
+// are stored with a relative error of 1/SUB_BUCKETS (~1.6%) at most, whereas
+// the memory usage stays fixed. Values above 2^MAX_BITS are clamped.
+//
+//   - record		-- Record a value (wait-free)
+//   - percentile	-- Get the value at the target percentile [0, 100]
+//   - report		-- Get the count, min, max, mean and p50/p99/p99.9 values
+//   - reset		-- Forget all recorded values
+//
+// All counters are relaxed atomics, so a single thread may record values into
+// the histogram while other threads read percentiles without any locking. The
+// readers may see a value being recorded only partially, which is acceptable
+// for the statistics but means that the reports are not exact snapshots.
+// ============================================================================
+class LatencyHistogram final {
+public:
+	static constexpr uint32_t SUB_BITS = 6;
+	static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BITS;
+	static constexpr uint32_t MAX_BITS = 40;
+	static constexpr uint32_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+	LatencyHistogram() {
+		reset();
+	}
+
+	void record(uint64_t value) {
+		mBuckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		mCount.fetch_add(1, std::memory_order_relaxed);
+		mSum.fetch_add(value, std::memory_order_relaxed);
+		auto min = mMin.load(std::memory_order_relaxed);
+		while (value < min && !mMin.compare_exchange_weak(min, value, std::memory_order_relaxed)) {}
+		auto max = mMax.load(std::memory_order_relaxed);
+		while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+	}
+
+	uint64_t percentile(double percentile) const {
+		auto count = mCount.load(std::memory_order_relaxed);
+		if (count == 0) {
+			return 0;
+		}
+		auto target = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+		target = target == 0 ? 1 : target;
+		auto seen = uint64_t(0);
+		for (auto i = 0u; i < BUCKETS; i++) {
+			seen += mBuckets[i].load(std::memory_order_relaxed);
+			if (seen >= target) {
+				auto value = bucketValue(i);
+				auto max = mMax.load(std::memory_order_relaxed);
+				return value > max ? max : value;
+			}
+		}
+		return mMax.load(std::memory_order_relaxed);
+	}
+
+	HistogramReport report() const {
+		HistogramReport report = {};
+		report.count = mCount.load(std::memory_order_relaxed);
+		if (report.count != 0) {
+			report.min = mMin.load(std::memory_order_relaxed);
+			report.max = mMax.load(std::memory_order_relaxed);
+			report.mean = static_cast<double>(mSum.load(std::memory_order_relaxed)) / report.count;
+			report.p50 = percentile(50.0);
+			report.p99 = percentile(99.0);
+			report.p999 = percentile(99.9);
+		}
+		return report;
+	}
+
+	void reset() {
+		for (auto& bucket : mBuckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		mCount.store(0, std::memory_order_relaxed);
+		mSum.store(0, std::memory_order_relaxed);
+		mMin.store(UINT64_MAX, std::memory_order_relaxed);
+		mMax.store(0, std::memory_order_relaxed);
+	}
+
+	static uint32_t bucketIndex(uint64_t value) {
+		if (value < SUB_BUCKETS) {
+			return static_cast<uint32_t>(value);
+		}
+		auto shift = highestBit(value) - SUB_BITS;
+		if (shift >= MAX_BITS - SUB_BITS) {
+			return BUCKETS - 1;
+		}
+		return shift * SUB_BUCKETS + static_cast<uint32_t>(value >> shift);
+	}
+
+	// get the highest value which would be stored into the target bucket.
+	static uint64_t bucketValue(uint32_t index) {
+		if (index < SUB_BUCKETS) {
+			return index;
+		}
+		auto shift = index / SUB_BUCKETS - 1;
+		auto sub = uint64_t(index % SUB_BUCKETS + SUB_BUCKETS);
+		return ((sub + 1) << shift) - 1;
+	}
+private:
+	std::array<std::atomic<uint64_t>, BUCKETS>	mBuckets;
+	std::atomic<uint64_t>						mCount;
+	std::atomic<uint64_t>						mSum;
+	std::atomic<uint64_t>						mMin;
+	std::atomic<uint64_t>						mMax;
+};
+
+// a summary of the frame statistics collected by the recorder.
+struct FrameStatisticsReport {
+	uint64_t		samples;		// amount of sampled presents.
+	uint64_t		disjoints;		// amount of disjoint intervals.
+	uint64_t		missedVBlanks;	// vblanks without the expected new frame.
+	uint64_t		glitches;		// samples which had any missed vblanks.
+	int64_t			refreshTicks;	// the estimated refresh period.
+	HistogramReport	frameTime;		// ticks between the Present calls.
+	HistogramReport	latency;		// ticks from Present call to the scan-out.
+};
+
+// ============================================================================
+// FrameStatisticsRecorder
+//
+// Samples DXGI_FRAME_STATISTICS after each Present and accumulates them into
+// histograms of frame times and present-to-scanout latencies. The time of
+// each Present is taken from the given time source, which must tick in the
+// same units as the SyncQPCTime (QpcTimeSource on Windows, or the time source
+// of a SoftwareSwapChain, or a ManualTimeSource in tests).
+//
+// The recorder follows the DXGI documentation about the frame statistics:
+//
+//   1. PresentCount tells the latest Present that has been shown on screen.
+//   2. PresentRefreshCount tells the vblank where that frame got shown.
+//   3. SyncRefreshCount and SyncQPCTime tell the vblank that was sampled.
+//
+// A frame that has been shown at PresentRefreshCount has been scanned out at
+// SyncQPCTime - (SyncRefreshCount - PresentRefreshCount) * refresh period. If
+// the refresh count between two samples advanced more than sync interval for
+// each new frame, the missing vblanks were glitches i.e. repeated frames.
+//
+// A sample is treated as a disjoint if GetFrameStatistics returns the error
+// DXGI_ERROR_FRAME_STATISTICS_DISJOINT (e.g. on a mode change or when the
+// output is not in a state to give the statistics) or the counters go back.
+// Disjoints are counted and the next valid sample starts a new interval, so
+// the glitches are never computed over a discontinuity.
+// ============================================================================
+class FrameStatisticsRecorder final {
+public:
+	static constexpr UINT PENDING_SIZE = 256;
+
+	FrameStatisticsRecorder(TimeSource& time, DXGI_RATIONAL refreshRate, UINT syncInterval = 1)
+		: mTime(time), mSyncInterval(syncInterval == 0 ? 1 : syncInterval) {
+		reset();
+		mRefreshTicks = refreshRate.Numerator == 0 ? 0
+			: static_cast<int64_t>(static_cast<double>(time.frequency()) * refreshRate.Denominator / refreshRate.Numerator);
+	}
+
+	// sample the statistics right after the Present with the given count returned.
+	void sample(UINT presentCount, HRESULT result, const DXGI_FRAME_STATISTICS& stats) {
+		auto now = mTime.now();
+		if (mLastPresentTime != 0) {
+			mFrameTime.record(static_cast<uint64_t>(now - mLastPresentTime));
+		}
+		mLastPresentTime = now;
+		mPresentTimes[presentCount % PENDING_SIZE] = { presentCount, now };
+		mSamples.fetch_add(1, std::memory_order_relaxed);
+
+		if (result == DXGI_ERROR_FRAME_STATISTICS_DISJOINT || FAILED(result)) {
+			disjoint();
+			return;
+		}
+		if (mHasPrevious && (stats.PresentCount < mPrevious.PresentCount
+			|| stats.SyncRefreshCount < mPrevious.SyncRefreshCount
+			|| stats.PresentRefreshCount < mPrevious.PresentRefreshCount)) {
+			disjoint();
+		}
+
+		if (mHasPrevious) {
+			// refine the refresh period from the sampled vblank timestamps.
+			auto refreshes = static_cast<int64_t>(stats.SyncRefreshCount - mPrevious.SyncRefreshCount);
+			if (refreshes > 0) {
+				auto period = (stats.SyncQPCTime.QuadPart - mPrevious.SyncQPCTime.QuadPart) / refreshes;
+				auto refreshTicks = mRefreshTicks.load(std::memory_order_relaxed);
+				mRefreshTicks.store(refreshTicks == 0 ? period : (refreshTicks * 7 + period) / 8, std::memory_order_relaxed);
+			}
+
+			// compare the amount of new frames against the amount of vblanks.
+			auto frames = stats.PresentCount - mPrevious.PresentCount;
+			auto vblanks = stats.PresentRefreshCount - mPrevious.PresentRefreshCount;
+			if (frames > 0 && vblanks > frames * mSyncInterval) {
+				mMissedVBlanks.fetch_add(vblanks - frames * mSyncInterval, std::memory_order_relaxed);
+				mGlitches.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		// resolve the scan-out latency of the latest shown frame.
+		auto& pending = mPresentTimes[stats.PresentCount % PENDING_SIZE];
+		if (pending.presentCount == stats.PresentCount && pending.time != 0 && stats.PresentCount != mLastResolved) {
+			auto behind = static_cast<int64_t>(stats.SyncRefreshCount - stats.PresentRefreshCount);
+			auto scanout = stats.SyncQPCTime.QuadPart - behind * mRefreshTicks.load(std::memory_order_relaxed);
+			if (scanout >= pending.time) {
+				mLatency.record(static_cast<uint64_t>(scanout - pending.time));
+			}
+			mLastResolved = stats.PresentCount;
+		}
+		mPrevious = stats;
+		mHasPrevious = true;
+	}
+
+	FrameStatisticsReport report() const {
+		FrameStatisticsReport report = {};
+		report.samples = mSamples.load(std::memory_order_relaxed);
+		report.disjoints = mDisjoints.load(std::memory_order_relaxed);
+		report.missedVBlanks = mMissedVBlanks.load(std::memory_order_relaxed);
+		report.glitches = mGlitches.load(std::memory_order_relaxed);
+		report.refreshTicks = mRefreshTicks.load(std::memory_order_relaxed);
+		report.frameTime = mFrameTime.report();
+		report.latency = mLatency.report();
+		return report;
+	}
+
+	void reset() {
+		mSamples.store(0, std::memory_order_relaxed);
+		mDisjoints.store(0, std::memory_order_relaxed);
+		mMissedVBlanks.store(0, std::memory_order_relaxed);
+		mGlitches.store(0, std::memory_order_relaxed);
+		mFrameTime.reset();
+		mLatency.reset();
+		mPresentTimes = {};
+		mPrevious = {};
+		mHasPrevious = false;
+		mLastPresentTime = 0;
+		mLastResolved = 0;
+	}
+
+	const LatencyHistogram& frameTimes() const { return mFrameTime; }
+	const LatencyHistogram& latencies() const { return mLatency; }
+private:
+	struct PendingPresent {
+		UINT	presentCount;
+		int64_t	time;
+	};
+
+	void disjoint() {
+		if (mHasPrevious) {
+			mDisjoints.fetch_add(1, std::memory_order_relaxed);
+		}
+		mHasPrevious = false;
+	}
+
+	TimeSource&								mTime;
+	UINT									mSyncInterval;
+	std::atomic<int64_t>					mRefreshTicks;
+	std::atomic<uint64_t>					mSamples;
+	std::atomic<uint64_t>					mDisjoints;
+	std::atomic<uint64_t>					mMissedVBlanks;
+	std::atomic<uint64_t>					mGlitches;
+	LatencyHistogram						mFrameTime;
+	LatencyHistogram						mLatency;
+	std::array<PendingPresent, PENDING_SIZE>	mPresentTimes;
+	DXGI_FRAME_STATISTICS					mPrevious;
+	bool									mHasPrevious;
+	int64_t									mLastPresentTime;
+	UINT									mLastResolved;
+};
\ No newline at end of file
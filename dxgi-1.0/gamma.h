@@ -0,0 +1,530 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "simd_util.h"
+
+// ============================================================================
+// Gamma Ramps
+//
+// Builds DXGI_GAMMA_CONTROL ramps from the following kinds of curves and also
+// applies them in software to surfaces shown on outputs which are not in the
+// fullscreen mode (where IDXGIOutput::SetGammaControl cannot be used).
+//
+//		GammaCurveType::Identity	-- Output equals the input
+//		GammaCurveType::Srgb		-- The sRGB (IEC 61966-2-1) EOTF
+//		GammaCurveType::Bt1886		-- The BT.1886 EOTF with white and black levels
+//		GammaCurveType::Power		-- A pure power curve with a custom exponent
+//		GammaCurveType::Calibration	-- Curves loaded from a calibration file
+//
+// The display itself is modelled as a pure power curve with the displayGamma
+// exponent, so the ramp value of an input x is EOTF(x)^(1/displayGamma). This
+// makes a typical 2.2 display to follow the target EOTF. Calibration curves
+// already describe the ramp itself, so they are used as they are.
+//
+// The sRGB and BT.1886 (100 nits white, 0.1 nits black) curves for the 2.2
+// display are compiled into constexpr tables with GAMMA_CURVE_POINTS points.
+//
+// Note that the software applier adds the scale and offset to the values
+// which are looked up from the curve.
+// ============================================================================
+constexpr UINT GAMMA_CURVE_POINTS = 1025;
+
+// a utility to calculate the base two logarithm of a positive value at compile time.
+constexpr double constLog2(double value) {
+	auto exponent = 0;
+	while (value >= 2.0) {
+		value *= 0.5;
+		exponent++;
+	}
+	while (value < 1.0) {
+		value *= 2.0;
+		exponent--;
+	}
+	// ln(m) = 2 * atanh((m - 1) / (m + 1)) converges fast with m in [1, 2).
+	auto z = (value - 1.0) / (value + 1.0);
+	auto z2 = z * z;
+	auto term = z;
+	auto sum = 0.0;
+	for (auto k = 1; k < 26; k += 2) {
+		sum += term / k;
+		term *= z2;
+	}
+	return exponent + 2.0 * sum / 0.69314718055994530942;
+}
+
+// a utility to calculate two raised to the given power at compile time.
+constexpr double constExp2(double value) {
+	auto whole = static_cast<int>(value);
+	whole -= whole > value ? 1 : 0;
+	auto x = (value - whole) * 0.69314718055994530942;
+	auto term = 1.0;
+	auto sum = 1.0;
+	for (auto k = 1; k < 16; k++) {
+		term *= x / k;
+		sum += term;
+	}
+	for (; whole > 0; whole--) {
+		sum *= 2.0;
+	}
+	for (; whole < 0; whole++) {
+		sum *= 0.5;
+	}
+	return sum;
+}
+
+// a utility to raise a non-negative value to the given power at compile time.
+constexpr double constPow(double value, double exponent) {
+	return value <= 0.0 ? 0.0 : constExp2(exponent * constLog2(value));
+}
+
+// the sRGB ramp value of the input for a display with the given gamma.
+constexpr double srgbRamp(double x, double displayGamma) {
+	return x <= 0.04045
+		? constPow(x / 12.92, 1.0 / displayGamma)
+		: constPow((x + 0.055) / 1.055, 2.4 / displayGamma);
+}
+
+// the BT.1886 ramp value of the input for a display with the given gamma.
+constexpr double bt1886Ramp(double x, double whiteNits, double blackNits, double displayGamma) {
+	auto white = constPow(whiteNits, 1.0 / 2.4);
+	auto black = constPow(blackNits, 1.0 / 2.4);
+	auto a = constPow(white - black, 2.4);
+	auto b = black / (white - black);
+	auto luminance = a * constPow(x + b, 2.4);
+	return constPow((luminance - blackNits) / (whiteNits - blackNits), 1.0 / displayGamma);
+}
+
+// a utility to build a table of curve values at evenly spaced inputs.
+template <typename Curve>
+constexpr std::array<float, GAMMA_CURVE_POINTS> makeGammaTable(Curve curve) {
+	std::array<float, GAMMA_CURVE_POINTS> table = {};
+	for (UINT i = 0; i < GAMMA_CURVE_POINTS; i++) {
+		table[i] = static_cast<float>(curve(static_cast<double>(i) / (GAMMA_CURVE_POINTS - 1)));
+	}
+	return table;
+}
+
+constexpr auto SRGB_GAMMA_TABLE = makeGammaTable([](double x) {
+	return srgbRamp(x, 2.2);
+});
+
+constexpr auto BT1886_GAMMA_TABLE = makeGammaTable([](double x) {
+	return bt1886Ramp(x, 100.0, 0.1, 2.2);
+});
+
+// ============================================================================
+// CalibrationCurve
+//
+// Per channel curves loaded from a calibration file. Each data line contains
+// the input value followed by the red, green and blue outputs, all in [0, 1].
+// This is the format of the ArgyllCMS .cal files where the lines are placed
+// between the BEGIN_DATA and END_DATA keywords. Other lines are ignored. Files
+// without the keywords are read as plain four column files.
+//
+// Inputs must be ascending. Values between the points are interpolated.
+// ============================================================================
+class CalibrationCurve final {
+public:
+	static HRESULT parse(const std::string& text, std::shared_ptr<CalibrationCurve>* curve) {
+		if (curve == nullptr) {
+			return E_INVALIDARG;
+		}
+		auto result = std::make_shared<CalibrationCurve>();
+		auto sections = text.find("BEGIN_DATA") != std::string::npos;
+		auto inside = !sections;
+		std::istringstream lines(text);
+		std::string line;
+		while (std::getline(lines, line)) {
+			if (line.find("END_DATA") != std::string::npos && line.find("END_DATA_FORMAT") == std::string::npos) {
+				inside = false;
+			} else if (line.find("BEGIN_DATA") != std::string::npos && line.find("BEGIN_DATA_FORMAT") == std::string::npos) {
+				inside = true;
+			} else if (inside) {
+				std::istringstream values(line);
+				Point point = {};
+				if (values >> point.input >> point.rgb[0] >> point.rgb[1] >> point.rgb[2]) {
+					if (!result->mPoints.empty() && point.input <= result->mPoints.back().input) {
+						return DXGI_ERROR_INVALID_CALL;
+					}
+					result->mPoints.push_back(point);
+				}
+			}
+		}
+		if (result->mPoints.size() < 2) {
+			return DXGI_ERROR_NOT_FOUND;
+		}
+		*curve = result;
+		return S_OK;
+	}
+
+	static HRESULT load(const std::string& path, std::shared_ptr<CalibrationCurve>* curve) {
+		std::ifstream file(path);
+		if (!file) {
+			return DXGI_ERROR_NOT_FOUND;
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+		return parse(text.str(), curve);
+	}
+
+	double evaluate(int channel, double x) const {
+		auto it = std::lower_bound(mPoints.begin(), mPoints.end(), x, [](const Point& point, double value) {
+			return point.input < value;
+		});
+		if (it == mPoints.begin()) {
+			return it->rgb[channel];
+		} else if (it == mPoints.end()) {
+			return mPoints.back().rgb[channel];
+		}
+		auto& prev = *(it - 1);
+		auto t = (x - prev.input) / (it->input - prev.input);
+		return prev.rgb[channel] + (it->rgb[channel] - prev.rgb[channel]) * t;
+	}
+
+	size_t size() const { return mPoints.size(); }
+private:
+	struct Point {
+		double input;
+		double rgb[3];
+	};
+
+	std::vector<Point> mPoints;
+};
+
+enum class GammaCurveType {
+	Identity,
+	Srgb,
+	Bt1886,
+	Power,
+	Calibration
+};
+
+// a description of a gamma curve with the scale and offset of the ramp.
+struct GammaCurve {
+	GammaCurveType								type;
+	double										power;			// the exponent of the power curve.
+	double										whiteNits;		// the BT.1886 white level.
+	double										blackNits;		// the BT.1886 black level.
+	double										displayGamma;	// the native gamma of the display.
+	std::shared_ptr<const CalibrationCurve>		calibration;	// the calibration file curves.
+	DXGI_RGB									scale;
+	DXGI_RGB									offset;
+
+	static GammaCurve identity() {
+		return { GammaCurveType::Identity, 1.0, 100.0, 0.1, 2.2, nullptr, { 1.0f, 1.0f, 1.0f }, {} };
+	}
+
+	static GammaCurve srgb(double displayGamma = 2.2) {
+		auto curve = identity();
+		curve.type = GammaCurveType::Srgb;
+		curve.displayGamma = displayGamma;
+		return curve;
+	}
+
+	static GammaCurve bt1886(double whiteNits = 100.0, double blackNits = 0.1, double displayGamma = 2.2) {
+		auto curve = srgb(displayGamma);
+		curve.type = GammaCurveType::Bt1886;
+		curve.whiteNits = whiteNits;
+		curve.blackNits = blackNits;
+		return curve;
+	}
+
+	static GammaCurve powerLaw(double power, double displayGamma = 2.2) {
+		auto curve = srgb(displayGamma);
+		curve.type = GammaCurveType::Power;
+		curve.power = power;
+		return curve;
+	}
+
+	static GammaCurve calibrated(std::shared_ptr<const CalibrationCurve> calibration) {
+		auto curve = identity();
+		curve.type = GammaCurveType::Calibration;
+		curve.calibration = calibration;
+		return curve;
+	}
+
+	// get the ramp value of the channel (0 = red, 1 = green, 2 = blue) for the input.
+	double evaluate(int channel, double x) const {
+		x = std::min(std::max(x, 0.0), 1.0);
+		switch (type) {
+		case GammaCurveType::Srgb:
+			return x <= 0.04045
+				? std::pow(x / 12.92, 1.0 / displayGamma)
+				: std::pow((x + 0.055) / 1.055, 2.4 / displayGamma);
+		case GammaCurveType::Bt1886: {
+			auto white = std::pow(whiteNits, 1.0 / 2.4);
+			auto black = std::pow(blackNits, 1.0 / 2.4);
+			auto luminance = std::pow(white - black, 2.4) * std::pow(x + black / (white - black), 2.4);
+			return std::pow(std::max((luminance - blackNits) / (whiteNits - blackNits), 0.0), 1.0 / displayGamma);
+		}
+		case GammaCurveType::Power:
+			return std::pow(x, power / displayGamma);
+		case GammaCurveType::Calibration:
+			return calibration ? calibration->evaluate(channel, x) : x;
+		default:
+			return x;
+		}
+	}
+
+	// get the constexpr table for the curve or null if there is no such table.
+	const std::array<float, GAMMA_CURVE_POINTS>* table() const {
+		if (displayGamma != 2.2) {
+			return nullptr;
+		} else if (type == GammaCurveType::Srgb) {
+			return &SRGB_GAMMA_TABLE;
+		} else if (type == GammaCurveType::Bt1886 && whiteNits == 100.0 && blackNits == 0.1) {
+			return &BT1886_GAMMA_TABLE;
+		}
+		return nullptr;
+	}
+};
+
+// ============================================================================
+// buildGammaControl
+//
+// Builds a DXGI_GAMMA_CONTROL from the curve. When capabilities are given, the
+// curve is evaluated at the ControlPointPositions of the output and the values
+// are mapped into [MinConvertedValue, MaxConvertedValue]. Without capabilities
+// GAMMA_CURVE_POINTS evenly spaced points with the range [0, 1] are used.
+//
+// Returns DXGI_ERROR_INVALID_CALL if the control is null or the output has
+// more control points than the DXGI_GAMMA_CONTROL can hold. Returns
+// DXGI_ERROR_UNSUPPORTED if the curve has a scale or an offset while the
+// output does not support them.
+// ============================================================================
+inline HRESULT buildGammaControl(const GammaCurve& curve, const DXGI_GAMMA_CONTROL_CAPABILITIES* caps, DXGI_GAMMA_CONTROL* control) {
+	auto points = caps != nullptr ? caps->NumGammaControlPoints : GAMMA_CURVE_POINTS;
+	if (control == nullptr || points < 2 || points > GAMMA_CURVE_POINTS) {
+		return DXGI_ERROR_INVALID_CALL;
+	}
+	auto identityScale = curve.scale.Red == 1.0f && curve.scale.Green == 1.0f && curve.scale.Blue == 1.0f
+		&& curve.offset.Red == 0.0f && curve.offset.Green == 0.0f && curve.offset.Blue == 0.0f;
+	if (caps != nullptr && !caps->ScaleAndOffsetSupported && !identityScale) {
+		return DXGI_ERROR_UNSUPPORTED;
+	}
+
+	*control = {};
+	control->Scale = curve.scale;
+	control->Offset = curve.offset;
+	auto minimum = caps != nullptr ? caps->MinConvertedValue : 0.0f;
+	auto range = caps != nullptr ? caps->MaxConvertedValue - caps->MinConvertedValue : 1.0f;
+	auto table = caps == nullptr ? curve.table() : nullptr;
+	for (UINT i = 0; i < points; i++) {
+		auto& value = control->GammaCurve[i];
+		if (table != nullptr) {
+			value.Red = value.Green = value.Blue = (*table)[i];
+			continue;
+		}
+		auto x = caps != nullptr ? caps->ControlPointPositions[i] : static_cast<double>(i) / (points - 1);
+		value.Red = static_cast<float>(minimum + range * curve.evaluate(0, x));
+		value.Green = static_cast<float>(minimum + range * curve.evaluate(1, x));
+		value.Blue = static_cast<float>(minimum + range * curve.evaluate(2, x));
+	}
+	return S_OK;
+}
+
+// ============================================================================
+// GammaLut
+//
+// Applies a DXGI_GAMMA_CONTROL to R8G8B8A8, B8G8R8A8 and R10G10B10A2 surfaces
+// in software. The control is turned into per channel lookup tables, which
+// are stored as 32-bit values that are already shifted into their channel.
+// Alpha channels are left untouched.
+//
+// The AVX2 kernels use gathers and the NEON kernel uses table lookups for the
+// 8-bit formats. Other levels use the scalar kernel. All of them use the same
+// tables, so the results are bit-exact with each other.
+// ============================================================================
+class GammaLut final {
+public:
+	GammaLut(const DXGI_GAMMA_CONTROL& control, const DXGI_GAMMA_CONTROL_CAPABILITIES* caps = nullptr) {
+		auto points = caps != nullptr ? std::min(caps->NumGammaControlPoints, GAMMA_CURVE_POINTS) : GAMMA_CURVE_POINTS;
+		auto minimum = caps != nullptr ? caps->MinConvertedValue : 0.0f;
+		auto range = caps != nullptr ? caps->MaxConvertedValue - caps->MinConvertedValue : 1.0f;
+		const float scale[] = { control.Scale.Red, control.Scale.Green, control.Scale.Blue };
+		const float offset[] = { control.Offset.Red, control.Offset.Green, control.Offset.Blue };
+		for (auto c = 0; c < 3; c++) {
+			for (UINT i = 0; i < 256; i++) {
+				auto value = lookup(control, caps, points, c, i / 255.0f) * scale[c] + offset[c];
+				m8[c][i] = floatToUnorm((value - minimum) / range, 255.0f) << (c * 8);
+			}
+			for (UINT i = 0; i < 1024; i++) {
+				auto value = lookup(control, caps, points, c, i / 1023.0f) * scale[c] + offset[c];
+				m10[c][i] = floatToUnorm((value - minimum) / range, 1023.0f) << (c * 10);
+			}
+		}
+		for (UINT i = 0; i < 256; i++) {
+			m8Swapped[0][i] = m8[2][i] >> 16;
+			m8Swapped[1][i] = m8[1][i];
+			m8Swapped[2][i] = m8[0][i] << 16;
+		}
+	}
+
+	HRESULT apply(const SurfaceView& surface, SimdLevel level = bestSimdLevel()) const {
+		auto layout = pixelLayout(surface.format);
+		if (surface.bits == nullptr) {
+			return E_INVALIDARG;
+		} else if (layout != PixelLayout::Rgba8 && layout != PixelLayout::Bgra8 && layout != PixelLayout::Rgb10a2) {
+			return DXGI_ERROR_UNSUPPORTED;
+		}
+		for (UINT y = 0; y < surface.height; y++) {
+			auto row = reinterpret_cast<uint32_t*>(surface.bits + static_cast<ptrdiff_t>(y) * surface.pitch);
+			if (layout == PixelLayout::Rgb10a2) {
+				applyRow10(row, surface.width, level);
+			} else {
+				applyRow8(row, surface.width, layout == PixelLayout::Bgra8, level);
+			}
+		}
+		return S_OK;
+	}
+private:
+	// interpolate the curve value of the channel at the given input.
+	static float lookup(const DXGI_GAMMA_CONTROL& control, const DXGI_GAMMA_CONTROL_CAPABILITIES* caps, UINT points, int c, float x) {
+		auto value = [&](UINT i) {
+			auto& rgb = control.GammaCurve[i];
+			return c == 0 ? rgb.Red : (c == 1 ? rgb.Green : rgb.Blue);
+		};
+		UINT i = 0;
+		float t = 0.0f;
+		if (caps == nullptr) {
+			auto position = x * (points - 1);
+			i = std::min(static_cast<UINT>(position), points - 2);
+			t = position - i;
+		} else {
+			auto end = caps->ControlPointPositions + points;
+			auto upper = std::upper_bound(caps->ControlPointPositions, end, x);
+			if (upper == caps->ControlPointPositions) {
+				return value(0);
+			} else if (upper == end) {
+				return value(points - 1);
+			}
+			i = static_cast<UINT>(upper - caps->ControlPointPositions) - 1;
+			t = (x - caps->ControlPointPositions[i]) / (caps->ControlPointPositions[i + 1] - caps->ControlPointPositions[i]);
+		}
+		return value(i) + (value(i + 1) - value(i)) * t;
+	}
+
+	void applyRow8(uint32_t* row, UINT count, bool bgra, SimdLevel level) const {
+		// BGRA pixels use the red table with the third byte and vice versa.
+		auto& low = bgra ? m8Swapped[0] : m8[0];
+		auto& high = bgra ? m8Swapped[2] : m8[2];
+		UINT i = 0;
+#if defined(SIMD_X86)
+		if (level == SimdLevel::Avx2) {
+			i = applyRow8Avx2(row, count, low.data(), m8[1].data(), high.data());
+		}
+#elif defined(SIMD_NEON)
+		if (level == SimdLevel::Neon) {
+			i = applyRow8Neon(row, count, bgra);
+		}
+#endif
+		for (; i < count; i++) {
+			auto pixel = row[i];
+			row[i] = (pixel & 0xff000000u)
+				| low[pixel & 0xff]
+				| m8[1][(pixel >> 8) & 0xff]
+				| high[(pixel >> 16) & 0xff];
+		}
+		(void)level;
+	}
+
+	void applyRow10(uint32_t* row, UINT count, SimdLevel level) const {
+		UINT i = 0;
+#if defined(SIMD_X86)
+		if (level == SimdLevel::Avx2) {
+			i = applyRow10Avx2(row, count, m10[0].data(), m10[1].data(), m10[2].data());
+		}
+#endif
+		for (; i < count; i++) {
+			auto pixel = row[i];
+			row[i] = (pixel & 0xc0000000u)
+				| m10[0][pixel & 0x3ff]
+				| m10[1][(pixel >> 10) & 0x3ff]
+				| m10[2][(pixel >> 20) & 0x3ff];
+		}
+		(void)level;
+	}
+
+#if defined(SIMD_X86)
+	SIMD_TARGET_AVX2 static UINT applyRow8Avx2(uint32_t* row, UINT count, const uint32_t* c0, const uint32_t* c1, const uint32_t* c2) {
+		const auto mask = _mm256_set1_epi32(0xff);
+		const auto alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+		UINT i = 0;
+		for (; i + 8 <= count; i += 8) {
+			auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+			auto v0 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c0), _mm256_and_si256(pixels, mask), 4);
+			auto v1 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c1), _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask), 4);
+			auto v2 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c2), _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask), 4);
+			auto result = _mm256_or_si256(_mm256_and_si256(pixels, alpha), _mm256_or_si256(v0, _mm256_or_si256(v1, v2)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), result);
+		}
+		return i;
+	}
+
+	SIMD_TARGET_AVX2 static UINT applyRow10Avx2(uint32_t* row, UINT count, const uint32_t* c0, const uint32_t* c1, const uint32_t* c2) {
+		const auto mask = _mm256_set1_epi32(0x3ff);
+		const auto alpha = _mm256_set1_epi32(static_cast<int>(0xc0000000u));
+		UINT i = 0;
+		for (; i + 8 <= count; i += 8) {
+			auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+			auto v0 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c0), _mm256_and_si256(pixels, mask), 4);
+			auto v1 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c1), _mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask), 4);
+			auto v2 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c2), _mm256_and_si256(_mm256_srli_epi32(pixels, 20), mask), 4);
+			auto result = _mm256_or_si256(_mm256_and_si256(pixels, alpha), _mm256_or_si256(v0, _mm256_or_si256(v1, v2)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), result);
+		}
+		return i;
+	}
+#endif
+
+#if defined(SIMD_NEON)
+	// a lookup of 16 bytes from a 256 byte table with four 64 byte lookups.
+	static uint8x16_t lookupNeon(const uint8x16x4_t* table, uint8x16_t index) {
+		const auto step = vdupq_n_u8(64);
+		auto result = vqtbl4q_u8(table[0], index);
+		for (auto i = 1; i < 4; i++) {
+			index = vsubq_u8(index, step);
+			result = vqtbx4q_u8(result, table[i], index);
+		}
+		return result;
+	}
+
+	UINT applyRow8Neon(uint32_t* row, UINT count, bool bgra) const {
+		uint8x16x4_t tables[3][4];
+		for (auto c = 0; c < 3; c++) {
+			uint8_t bytes[256];
+			for (auto i = 0; i < 256; i++) {
+				bytes[i] = static_cast<uint8_t>(m8[c][i] >> (c * 8));
+			}
+			for (auto i = 0; i < 4; i++) {
+				tables[c][i] = vld1q_u8_x4(bytes + i * 64);
+			}
+		}
+		auto red = bgra ? 2 : 0;
+		UINT i = 0;
+		for (; i + 16 <= count; i += 16) {
+			auto bytes = reinterpret_cast<uint8_t*>(row + i);
+			auto pixels = vld4q_u8(bytes);
+			pixels.val[red] = lookupNeon(tables[0], pixels.val[red]);
+			pixels.val[1] = lookupNeon(tables[1], pixels.val[1]);
+			pixels.val[2 - red] = lookupNeon(tables[2], pixels.val[2 - red]);
+			vst4q_u8(bytes, pixels);
+		}
+		return i;
+	}
+#endif
+
+	std::array<uint32_t, 256>	m8[3];
+	std::array<uint32_t, 256>	m8Swapped[3];
+	std::array<uint32_t, 1024>	m10[3];
+};
\ No newline at end of file
@@ -0,0 +1,1029 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "simd_util.h"
+
+// ============================================================================
+// HDR Conversion
+//
+// Converts surfaces between the following HDR encodings which were introduced
+// with the DXGI 1.5 HDR and wide colour gamut support. All conversions go via
+// linear BT.2020 values in nits (cd/m^2).
+//
+//		HdrEncoding::ScRgb	-- R16G16B16A16_FLOAT, linear BT.709, 1.0 = 80 nits
+//		HdrEncoding::Hdr10	-- R10G10B10A2_UNORM, ST 2084 (PQ) BT.2020
+//		HdrEncoding::Hlg	-- R10G10B10A2_UNORM, ARIB STD-B67 (HLG) BT.2020
+//
+// HLG signals are displayed with a 1000 nits nominal peak and the BT.2100 OOTF
+// with the system gamma of 1.2. The scRGB values may be negative and outside
+// of the BT.2020 gamut, which is preserved unless the values are tone mapped.
+// Non-finite scRGB values are read as zero (NaN) or as the largest half value.
+//
+// 10-bit signals are decoded with exact tables. Other transfer functions use
+// fast polynomial approximations of log2 and exp2:
+//
+//		fastLog2	-- atanh series (t^9) with mantissa in [sqrt(0.5), sqrt(2))
+//		fastExp2	-- Taylor series (x^7) with fraction in [-0.5, 0.5]
+//
+// Measured against the double precision formulas with float inputs in [0, 1]
+// the maximum errors are as follows. PQ errors are dominated by the rounding
+// of the float base which is amplified by the m2 exponent. All are below the
+// half step of a 12-bit signal (1.2e-4) and the 10-bit signals are decoded and
+// encoded back into themselves.
+//
+//		pqEncode	-- 1.4e-5 absolute signal error
+//		pqDecode	-- 5.9e-5 relative linear error (above 1e-6)
+//		hlgEncode	-- 8.3e-8 absolute signal error
+//		hlgDecode	-- 2.1e-7 relative linear error (above 1e-6)
+//
+// The AVX2 (8 pixels) and NEON (4 pixels) kernels perform the same operations
+// as the scalar kernel, so the results are bit-exact. Other levels use the
+// scalar kernel.
+// ============================================================================
+
+// the supported HDR surface encodings.
+enum class HdrEncoding {
+	ScRgb,
+	Hdr10,
+	Hlg
+};
+
+// a utility to get string presentation of HdrEncoding.
+inline const char* hdrEncodingString(HdrEncoding encoding) {
+	switch (encoding) {
+	case HdrEncoding::ScRgb:
+		return "scRGB";
+	case HdrEncoding::Hdr10:
+		return "HDR10";
+	case HdrEncoding::Hlg:
+		return "HLG";
+	default:
+		return "unknown";
+	}
+}
+
+// a utility to get the surface format of the HDR encoding.
+inline DXGI_FORMAT hdrEncodingFormat(HdrEncoding encoding) {
+	return encoding == HdrEncoding::ScRgb ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R10G10B10A2_UNORM;
+}
+
+constexpr float SCRGB_WHITE_NITS = 80.0f;
+constexpr float PQ_PEAK_NITS = 10000.0f;
+constexpr float HLG_PEAK_NITS = 1000.0f;
+constexpr float HLG_SYSTEM_GAMMA = 1.2f;
+
+constexpr float PQ_M1 = 2610.0f / 16384.0f;
+constexpr float PQ_M2 = 2523.0f / 4096.0f * 128.0f;
+constexpr float PQ_C1 = 3424.0f / 4096.0f;
+constexpr float PQ_C2 = 2413.0f / 4096.0f * 32.0f;
+constexpr float PQ_C3 = 2392.0f / 4096.0f * 32.0f;
+
+constexpr float HLG_A = 0.17883277f;
+constexpr float HLG_B = 0.28466892f;
+constexpr float HLG_C = 0.55991073f;
+
+// the BT.2020 luminance coefficients.
+constexpr float BT2020_LUMA[3] = { 0.2627f, 0.6780f, 0.0593f };
+
+// the BT.709 to BT.2020 (BT.2087) matrix scaled from scRGB values into nits.
+constexpr float SCRGB_TO_BT2020_NITS[9] = {
+	0.6274039f * SCRGB_WHITE_NITS, 0.3292830f * SCRGB_WHITE_NITS, 0.0433131f * SCRGB_WHITE_NITS,
+	0.0690973f * SCRGB_WHITE_NITS, 0.9195404f * SCRGB_WHITE_NITS, 0.0113623f * SCRGB_WHITE_NITS,
+	0.0163914f * SCRGB_WHITE_NITS, 0.0880133f * SCRGB_WHITE_NITS, 0.8955953f * SCRGB_WHITE_NITS
+};
+
+// the BT.2020 to BT.709 matrix scaled from nits into scRGB values.
+constexpr float BT2020_NITS_TO_SCRGB[9] = {
+	1.6604910f / SCRGB_WHITE_NITS, -0.5876411f / SCRGB_WHITE_NITS, -0.0728499f / SCRGB_WHITE_NITS,
+	-0.1245505f / SCRGB_WHITE_NITS, 1.1328999f / SCRGB_WHITE_NITS, -0.0083494f / SCRGB_WHITE_NITS,
+	-0.0181508f / SCRGB_WHITE_NITS, -0.1005789f / SCRGB_WHITE_NITS, 1.1187297f / SCRGB_WHITE_NITS
+};
+
+// ============================================================================
+// Transfer functions
+// ============================================================================
+
+// the exact PQ signal of the linear value (1.0 = 10000 nits).
+inline double pqEncodeExact(double value) {
+	auto y = std::pow(std::min(std::max(value, 0.0), 1.0), static_cast<double>(PQ_M1));
+	return std::pow((PQ_C1 + PQ_C2 * y) / (1.0 + PQ_C3 * y), static_cast<double>(PQ_M2));
+}
+
+// the exact linear value (1.0 = 10000 nits) of the PQ signal.
+inline double pqDecodeExact(double signal) {
+	auto e = std::pow(std::min(std::max(signal, 0.0), 1.0), 1.0 / PQ_M2);
+	return std::pow(std::max(e - PQ_C1, 0.0) / (PQ_C2 - PQ_C3 * e), 1.0 / PQ_M1);
+}
+
+// the exact HLG signal of the linear scene value.
+inline double hlgEncodeExact(double value) {
+	value = std::min(std::max(value, 0.0), 1.0);
+	return value <= 1.0 / 12.0 ? std::sqrt(3.0 * value) : HLG_A * std::log(12.0 * value - HLG_B) + HLG_C;
+}
+
+// the exact linear scene value of the HLG signal.
+inline double hlgDecodeExact(double signal) {
+	signal = std::min(std::max(signal, 0.0), 1.0);
+	return signal <= 0.5 ? signal * signal / 3.0 : (std::exp((signal - HLG_C) / HLG_A) + HLG_B) / 12.0;
+}
+
+constexpr float LOG2_C1 = 2.8853900817779268f;
+constexpr float LOG2_C3 = 0.9617966939259756f;
+constexpr float LOG2_C5 = 0.5770780163555854f;
+constexpr float LOG2_C7 = 0.4121985831111324f;
+constexpr float LOG2_C9 = 0.3205988979753252f;
+
+constexpr float EXP2_C1 = 0.6931471805599453f;
+constexpr float EXP2_C2 = 0.2402265069591007f;
+constexpr float EXP2_C3 = 0.05550410866482158f;
+constexpr float EXP2_C4 = 0.009618129107628477f;
+constexpr float EXP2_C5 = 0.0013333558146428443f;
+constexpr float EXP2_C6 = 0.00015403530393381608f;
+constexpr float EXP2_C7 = 1.525273380405984e-05f;
+
+constexpr float HLG_LOG_SCALE = HLG_A * EXP2_C1;
+constexpr float HLG_EXP_SCALE = 1.0f / (HLG_A * EXP2_C1);
+constexpr float HLG_ONE_TWELFTH = 1.0f / 12.0f;
+constexpr float HLG_ONE_THIRD = 1.0f / 3.0f;
+
+// a utility to clamp the value into the range where NaNs become the minimum.
+inline float clampFloat(float value, float minimum, float maximum) {
+	return std::min(maximum, std::max(minimum, value));
+}
+
+// a utility to approximate the base two logarithm of a positive normal float.
+inline float fastLog2(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	// split the value into an exponent and a mantissa in [sqrt(0.5), sqrt(2)).
+	auto exponent = static_cast<int32_t>(bits - 0x3f3504f3u) >> 23;
+	bits -= static_cast<uint32_t>(exponent) << 23;
+	float mantissa;
+	std::memcpy(&mantissa, &bits, sizeof(mantissa));
+	auto t = (mantissa - 1.0f) / (mantissa + 1.0f);
+	auto t2 = t * t;
+	auto p = LOG2_C9;
+	p = p * t2 + LOG2_C7;
+	p = p * t2 + LOG2_C5;
+	p = p * t2 + LOG2_C3;
+	p = p * t2 + LOG2_C1;
+	return static_cast<float>(exponent) + p * t;
+}
+
+// a utility to approximate two raised to the given power (clamped to normals).
+inline float fastExp2(float value) {
+	value = clampFloat(value, -126.0f, 127.0f);
+	auto whole = static_cast<int32_t>(value + 126.5f) - 126;
+	auto f = value - static_cast<float>(whole);
+	auto p = EXP2_C7;
+	p = p * f + EXP2_C6;
+	p = p * f + EXP2_C5;
+	p = p * f + EXP2_C4;
+	p = p * f + EXP2_C3;
+	p = p * f + EXP2_C2;
+	p = p * f + EXP2_C1;
+	p = p * f + 1.0f;
+	auto bits = static_cast<uint32_t>(whole + 127) << 23;
+	float scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+// a utility to approximate a positive value raised to the given power.
+inline float fastPow(float value, float exponent) {
+	return fastExp2(exponent * fastLog2(std::max(FLT_MIN, value)));
+}
+
+// a utility to approximate the PQ signal of the linear value (1.0 = 10000 nits).
+inline float pqEncode(float value) {
+	auto y = fastPow(clampFloat(value, 0.0f, 1.0f), PQ_M1);
+	return fastPow((PQ_C1 + PQ_C2 * y) / (1.0f + PQ_C3 * y), PQ_M2);
+}
+
+// a utility to approximate the linear value (1.0 = 10000 nits) of the PQ signal.
+inline float pqDecode(float signal) {
+	auto e = fastPow(clampFloat(signal, 0.0f, 1.0f), 1.0f / PQ_M2);
+	return fastPow(std::max(0.0f, e - PQ_C1) / (PQ_C2 - PQ_C3 * e), 1.0f / PQ_M1);
+}
+
+// a utility to approximate the HLG signal of the linear scene value.
+inline float hlgEncode(float value) {
+	value = clampFloat(value, 0.0f, 1.0f);
+	auto low = std::sqrt(3.0f * value);
+	auto high = HLG_LOG_SCALE * fastLog2(std::max(FLT_MIN, 12.0f * value - HLG_B)) + HLG_C;
+	return value <= HLG_ONE_TWELFTH ? low : high;
+}
+
+// a utility to approximate the linear scene value of the HLG signal.
+inline float hlgDecode(float signal) {
+	signal = clampFloat(signal, 0.0f, 1.0f);
+	auto low = signal * signal * HLG_ONE_THIRD;
+	auto high = (fastExp2((signal - HLG_C) * HLG_EXP_SCALE) + HLG_B) * HLG_ONE_TWELFTH;
+	return signal <= 0.5f ? low : high;
+}
+
+// the linear values of all 10-bit PQ (nits) and HLG (scene) signals.
+struct HdrDecodeTables {
+	std::array<float, 1024>	pq;
+	std::array<float, 1024>	hlg;
+};
+
+// a utility to get the decode tables which are built once for the process.
+inline const HdrDecodeTables& hdrDecodeTables() {
+	static const auto tables = [] {
+		HdrDecodeTables result;
+		for (auto i = 0; i < 1024; i++) {
+			result.pq[i] = static_cast<float>(pqDecodeExact(i / 1023.0) * PQ_PEAK_NITS);
+			result.hlg[i] = static_cast<float>(hlgDecodeExact(i / 1023.0));
+		}
+		return result;
+	}();
+	return tables;
+}
+
+// ============================================================================
+// ToneMapping
+//
+// Compresses the luminance range of the content into the range of the display
+// with one of the following tone mapping operators.
+//
+//		ToneMapper::None		-- Values are kept as they are
+//		ToneMapper::Reinhard	-- Extended Reinhard with content peak as white
+//		ToneMapper::AcesFit		-- The Narkowicz fit of the ACES filmic curve
+//		ToneMapper::Bt2390		-- The BT.2390 EETF (Hermite knee in PQ space)
+//
+// Operators are applied to the largest channel of each pixel and the other
+// channels are scaled with the same ratio, so hues are preserved. Channels
+// are clamped into the BT.2020 gamut (negative values become zero) when an
+// operator is used. Content peak is mapped into the display peak.
+//
+// The Reinhard and ACES operators are skipped when the content peak fits into
+// the display. BT.2390 also raises the content black into the display black.
+// ============================================================================
+enum class ToneMapper {
+	None,
+	Reinhard,
+	AcesFit,
+	Bt2390
+};
+
+// a utility to get string presentation of ToneMapper.
+inline const char* toneMapperString(ToneMapper mapper) {
+	switch (mapper) {
+	case ToneMapper::None:
+		return "none";
+	case ToneMapper::Reinhard:
+		return "reinhard";
+	case ToneMapper::AcesFit:
+		return "aces-fit";
+	case ToneMapper::Bt2390:
+		return "bt2390";
+	default:
+		return "unknown";
+	}
+}
+
+// a description of the tone mapping from content into display luminances.
+struct ToneMapping {
+	ToneMapper	mapper;
+	float		contentMaxNits;
+	float		contentMinNits;
+	float		displayMaxNits;
+	float		displayMinNits;
+
+	static ToneMapping none() {
+		return { ToneMapper::None, PQ_PEAK_NITS, 0.0f, PQ_PEAK_NITS, 0.0f };
+	}
+
+	// build from the HDR10 metadata and the display luminances (e.g. DXGI_OUTPUT_DESC1).
+	static ToneMapping fromMetadata(ToneMapper mapper, const DXGI_HDR_METADATA_HDR10& metadata, float displayMaxNits, float displayMinNits = 0.0f) {
+		auto content = metadata.MaxContentLightLevel > 0 ? metadata.MaxContentLightLevel : metadata.MaxMasteringLuminance;
+		return {
+			mapper,
+			content > 0 ? static_cast<float>(content) : PQ_PEAK_NITS,
+			static_cast<float>(metadata.MinMasteringLuminance) * 0.0001f,
+			displayMaxNits,
+			displayMinNits
+		};
+	}
+};
+
+// the precalculated constants of the tone mapping for the kernels.
+struct ToneCurve {
+	ToneMapper	mapper;
+	float		displayNits;	// the display peak in nits.
+	float		invDisplayNits;	// the inverse of the display peak.
+	float		white;			// the Reinhard 1/w^2 or the ACES 1/f(w) scale.
+	float		blackPq;		// the PQ signal of the content black.
+	float		rangePq;		// the PQ signal range of the content.
+	float		invRangePq;		// the inverse of the PQ signal range.
+	float		knee;			// the BT.2390 knee start.
+	float		maxLum;			// the BT.2390 display peak.
+	float		minLum;			// the BT.2390 display black.
+};
+
+// a utility to evaluate the ACES filmic curve fit.
+inline float acesFit(float x) {
+	return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+// a utility to precalculate the constants of the tone mapping.
+inline ToneCurve makeToneCurve(const ToneMapping& mapping) {
+	ToneCurve curve = {};
+	curve.mapper = mapping.mapper;
+	curve.displayNits = mapping.displayMaxNits;
+	curve.invDisplayNits = 1.0f / mapping.displayMaxNits;
+	auto white = mapping.contentMaxNits / mapping.displayMaxNits;
+	if (curve.mapper == ToneMapper::Reinhard || curve.mapper == ToneMapper::AcesFit) {
+		if (white <= 1.0f) {
+			curve.mapper = ToneMapper::None;
+		}
+		curve.white = curve.mapper == ToneMapper::Reinhard ? 1.0f / (white * white) : 1.0f / acesFit(white);
+	} else if (curve.mapper == ToneMapper::Bt2390) {
+		auto black = pqEncodeExact(mapping.contentMinNits / PQ_PEAK_NITS);
+		auto range = pqEncodeExact(mapping.contentMaxNits / PQ_PEAK_NITS) - black;
+		auto maxLum = (pqEncodeExact(mapping.displayMaxNits / PQ_PEAK_NITS) - black) / range;
+		auto minLum = (pqEncodeExact(mapping.displayMinNits / PQ_PEAK_NITS) - black) / range;
+		curve.blackPq = static_cast<float>(black);
+		curve.rangePq = static_cast<float>(range);
+		curve.invRangePq = static_cast<float>(1.0 / range);
+		curve.maxLum = static_cast<float>(maxLum);
+		curve.minLum = static_cast<float>(std::max(minLum, 0.0));
+		curve.knee = static_cast<float>(std::max(1.5 * maxLum - 0.5, 0.0));
+	}
+	return curve;
+}
+
+// a utility to tone map the peak luminance (nits) of a pixel.
+inline float toneMapNits(float nits, const ToneCurve& curve) {
+	if (curve.mapper == ToneMapper::Bt2390) {
+		auto e1 = clampFloat((pqEncode(nits * (1.0f / PQ_PEAK_NITS)) - curve.blackPq) * curve.invRangePq, 0.0f, 1.0f);
+		auto t = (e1 - curve.knee) / (1.0f - curve.knee);
+		auto t2 = t * t;
+		auto t3 = t2 * t;
+		auto spline = (2.0f * t3 - 3.0f * t2 + 1.0f) * curve.knee
+			+ (t3 - 2.0f * t2 + t) * (1.0f - curve.knee)
+			+ (3.0f * t2 - 2.0f * t3) * curve.maxLum;
+		auto e2 = e1 > curve.knee ? spline : e1;
+		auto inverse = 1.0f - e2;
+		inverse = inverse * inverse;
+		auto e3 = e2 + curve.minLum * (inverse * inverse);
+		return pqDecode(e3 * curve.rangePq + curve.blackPq) * PQ_PEAK_NITS;
+	}
+	auto x = nits * curve.invDisplayNits;
+	auto y = curve.mapper == ToneMapper::Reinhard
+		? x * (1.0f + x * curve.white) / (1.0f + x)
+		: acesFit(x) * curve.white;
+	return std::min(1.0f, y) * curve.displayNits;
+}
+
+// ============================================================================
+// Scalar kernels
+// ============================================================================
+
+// a utility to replace NaNs with zero and infinities with the largest half value.
+inline float finiteHalf(float value) {
+	return clampFloat(value == value ? value : 0.0f, -65504.0f, 65504.0f);
+}
+
+// a utility to decode the pixel into linear BT.2020 nits and alpha.
+template <HdrEncoding Encoding>
+inline void decodeHdrPixel(const BYTE* src, const float* table, float* rgba) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		uint16_t pixel[4];
+		std::memcpy(pixel, src, sizeof(pixel));
+		auto r = finiteHalf(halfToFloat(pixel[0]));
+		auto g = finiteHalf(halfToFloat(pixel[1]));
+		auto b = finiteHalf(halfToFloat(pixel[2]));
+		auto& m = SCRGB_TO_BT2020_NITS;
+		rgba[0] = m[0] * r + m[1] * g + m[2] * b;
+		rgba[1] = m[3] * r + m[4] * g + m[5] * b;
+		rgba[2] = m[6] * r + m[7] * g + m[8] * b;
+		rgba[3] = halfToFloat(pixel[3]);
+	} else {
+		uint32_t pixel;
+		std::memcpy(&pixel, src, sizeof(pixel));
+		for (auto c = 0; c < 3; c++) {
+			rgba[c] = table[(pixel >> (c * 10)) & 0x3ff];
+		}
+		if constexpr (Encoding == HdrEncoding::Hlg) {
+			// the OOTF scales the scene values with their luminance.
+			auto luma = BT2020_LUMA[0] * rgba[0] + BT2020_LUMA[1] * rgba[1] + BT2020_LUMA[2] * rgba[2];
+			auto scale = fastPow(luma, HLG_SYSTEM_GAMMA - 1.0f) * HLG_PEAK_NITS;
+			for (auto c = 0; c < 3; c++) {
+				rgba[c] = rgba[c] * scale;
+			}
+		}
+		rgba[3] = unormToFloat(pixel >> 30, 3.0f);
+	}
+}
+
+// a utility to encode linear BT.2020 nits and alpha into the pixel.
+template <HdrEncoding Encoding>
+inline void encodeHdrPixel(const float* rgba, BYTE* dst) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		auto& m = BT2020_NITS_TO_SCRGB;
+		uint16_t pixel[4] = {
+			floatToHalf(m[0] * rgba[0] + m[1] * rgba[1] + m[2] * rgba[2]),
+			floatToHalf(m[3] * rgba[0] + m[4] * rgba[1] + m[5] * rgba[2]),
+			floatToHalf(m[6] * rgba[0] + m[7] * rgba[1] + m[8] * rgba[2]),
+			floatToHalf(rgba[3])
+		};
+		std::memcpy(dst, pixel, sizeof(pixel));
+	} else {
+		float rgb[3];
+		if constexpr (Encoding == HdrEncoding::Hdr10) {
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = pqEncode(rgba[c] * (1.0f / PQ_PEAK_NITS));
+			}
+		} else {
+			// the inverse OOTF turns the display values back into scene values.
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = clampFloat(rgba[c] * (1.0f / HLG_PEAK_NITS), 0.0f, 1.0f);
+			}
+			auto luma = BT2020_LUMA[0] * rgb[0] + BT2020_LUMA[1] * rgb[1] + BT2020_LUMA[2] * rgb[2];
+			auto scale = fastPow(luma, (1.0f - HLG_SYSTEM_GAMMA) / HLG_SYSTEM_GAMMA);
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = hlgEncode(rgb[c] * scale);
+			}
+		}
+		auto pixel = floatToUnorm(rgb[0], 1023.0f)
+			| (floatToUnorm(rgb[1], 1023.0f) << 10)
+			| (floatToUnorm(rgb[2], 1023.0f) << 20)
+			| (floatToUnorm(rgba[3], 3.0f) << 30);
+		std::memcpy(dst, &pixel, sizeof(pixel));
+	}
+}
+
+// a utility to tone map a pixel of linear BT.2020 nits.
+inline void toneMapPixel(float* rgba, const ToneCurve& curve) {
+	if (curve.mapper == ToneMapper::None) {
+		return;
+	}
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = std::max(0.0f, rgba[c]);
+	}
+	auto peak = std::max(rgba[0], std::max(rgba[1], rgba[2]));
+	auto scale = peak > 0.0f ? toneMapNits(peak, curve) / peak : 1.0f;
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = rgba[c] * scale;
+	}
+}
+
+// a utility to get the decode table of the 10-bit encoding.
+inline const float* hdrDecodeTable(HdrEncoding encoding) {
+	return encoding == HdrEncoding::Hdr10 ? hdrDecodeTables().pq.data() : hdrDecodeTables().hlg.data();
+}
+
+// a scalar kernel which converts pixels between the HDR encodings.
+template <HdrEncoding Src, HdrEncoding Dst>
+inline void convertHdrRowScalar(const BYTE* src, BYTE* dst, UINT count, const ToneCurve& curve) {
+	const auto srcSize = Src == HdrEncoding::ScRgb ? 8u : 4u;
+	const auto dstSize = Dst == HdrEncoding::ScRgb ? 8u : 4u;
+	auto table = hdrDecodeTable(Src);
+	for (UINT i = 0; i < count; i++) {
+		float rgba[4];
+		decodeHdrPixel<Src>(src + i * srcSize, table, rgba);
+		toneMapPixel(rgba, curve);
+		encodeHdrPixel<Dst>(rgba, dst + i * dstSize);
+	}
+}
+
+// ============================================================================
+// AVX2 kernels
+// ============================================================================
+#if defined(SIMD_X86)
+
+SIMD_TARGET_AVX2 inline __m256 clampAvx2(__m256 value, float minimum, float maximum) {
+	return _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(minimum)), _mm256_set1_ps(maximum));
+}
+
+SIMD_TARGET_AVX2 inline __m256 log2Avx2(__m256 value) {
+	auto bits = _mm256_castps_si256(value);
+	auto exponent = _mm256_srai_epi32(_mm256_sub_epi32(bits, _mm256_set1_epi32(0x3f3504f3)), 23);
+	auto mantissa = _mm256_castsi256_ps(_mm256_sub_epi32(bits, _mm256_slli_epi32(exponent, 23)));
+	auto one = _mm256_set1_ps(1.0f);
+	auto t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+	auto t2 = _mm256_mul_ps(t, t);
+	auto p = _mm256_set1_ps(LOG2_C9);
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C7));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C5));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C1));
+	return _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_mul_ps(p, t));
+}
+
+SIMD_TARGET_AVX2 inline __m256 exp2Avx2(__m256 value) {
+	value = clampAvx2(value, -126.0f, 127.0f);
+	auto whole = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(value, _mm256_set1_ps(126.5f))), _mm256_set1_epi32(126));
+	auto f = _mm256_sub_ps(value, _mm256_cvtepi32_ps(whole));
+	auto p = _mm256_set1_ps(EXP2_C7);
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C6));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C5));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C1));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+	auto scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(whole, _mm256_set1_epi32(127)), 23));
+	return _mm256_mul_ps(p, scale);
+}
+
+SIMD_TARGET_AVX2 inline __m256 powAvx2(__m256 value, float exponent) {
+	auto positive = _mm256_max_ps(value, _mm256_set1_ps(FLT_MIN));
+	return exp2Avx2(_mm256_mul_ps(_mm256_set1_ps(exponent), log2Avx2(positive)));
+}
+
+SIMD_TARGET_AVX2 inline __m256 pqEncodeAvx2(__m256 value) {
+	auto y = powAvx2(clampAvx2(value, 0.0f, 1.0f), PQ_M1);
+	auto numerator = _mm256_add_ps(_mm256_set1_ps(PQ_C1), _mm256_mul_ps(_mm256_set1_ps(PQ_C2), y));
+	auto denominator = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(PQ_C3), y));
+	return powAvx2(_mm256_div_ps(numerator, denominator), PQ_M2);
+}
+
+SIMD_TARGET_AVX2 inline __m256 pqDecodeAvx2(__m256 signal) {
+	auto e = powAvx2(clampAvx2(signal, 0.0f, 1.0f), 1.0f / PQ_M2);
+	auto numerator = _mm256_max_ps(_mm256_sub_ps(e, _mm256_set1_ps(PQ_C1)), _mm256_setzero_ps());
+	auto denominator = _mm256_sub_ps(_mm256_set1_ps(PQ_C2), _mm256_mul_ps(_mm256_set1_ps(PQ_C3), e));
+	return powAvx2(_mm256_div_ps(numerator, denominator), 1.0f / PQ_M1);
+}
+
+SIMD_TARGET_AVX2 inline __m256 hlgEncodeAvx2(__m256 value) {
+	value = clampAvx2(value, 0.0f, 1.0f);
+	auto low = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f), value));
+	auto x = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(12.0f), value), _mm256_set1_ps(HLG_B));
+	auto high = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(HLG_LOG_SCALE),
+		log2Avx2(_mm256_max_ps(x, _mm256_set1_ps(FLT_MIN)))), _mm256_set1_ps(HLG_C));
+	return _mm256_blendv_ps(high, low, _mm256_cmp_ps(value, _mm256_set1_ps(HLG_ONE_TWELFTH), _CMP_LE_OQ));
+}
+
+
+SIMD_TARGET_AVX2 inline __m256 dotAvx2(const float* m, __m256 r, __m256 g, __m256 b) {
+	auto rg = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), r), _mm256_mul_ps(_mm256_set1_ps(m[1]), g));
+	return _mm256_add_ps(rg, _mm256_mul_ps(_mm256_set1_ps(m[2]), b));
+}
+
+SIMD_TARGET_AVX2 inline __m256 finiteHalfAvx2(__m256 value) {
+	auto ordered = _mm256_cmp_ps(value, value, _CMP_ORD_Q);
+	return clampAvx2(_mm256_and_ps(value, ordered), -65504.0f, 65504.0f);
+}
+
+template <HdrEncoding Encoding>
+SIMD_TARGET_AVX2 inline void decodeHdrAvx2(const BYTE* src, const float* table, __m256* rgba) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		// group the channels of pixel pairs and transpose them into channels.
+		const auto pairs = _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+		auto in = reinterpret_cast<const __m128i*>(src);
+		auto q0 = _mm_shuffle_epi8(_mm_loadu_si128(in), pairs);
+		auto q1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), pairs);
+		auto q2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), pairs);
+		auto q3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), pairs);
+		auto rg01 = _mm_unpacklo_epi32(q0, q1);
+		auto ba01 = _mm_unpackhi_epi32(q0, q1);
+		auto rg23 = _mm_unpacklo_epi32(q2, q3);
+		auto ba23 = _mm_unpackhi_epi32(q2, q3);
+		auto r = finiteHalfAvx2(_mm256_cvtph_ps(_mm_unpacklo_epi64(rg01, rg23)));
+		auto g = finiteHalfAvx2(_mm256_cvtph_ps(_mm_unpackhi_epi64(rg01, rg23)));
+		auto b = finiteHalfAvx2(_mm256_cvtph_ps(_mm_unpacklo_epi64(ba01, ba23)));
+		rgba[0] = dotAvx2(SCRGB_TO_BT2020_NITS, r, g, b);
+		rgba[1] = dotAvx2(SCRGB_TO_BT2020_NITS + 3, r, g, b);
+		rgba[2] = dotAvx2(SCRGB_TO_BT2020_NITS + 6, r, g, b);
+		rgba[3] = _mm256_cvtph_ps(_mm_unpackhi_epi64(ba01, ba23));
+	} else {
+		const auto mask = _mm256_set1_epi32(0x3ff);
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		rgba[0] = _mm256_i32gather_ps(table, _mm256_and_si256(pixels, mask), 4);
+		rgba[1] = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask), 4);
+		rgba[2] = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 20), mask), 4);
+		if constexpr (Encoding == HdrEncoding::Hlg) {
+			auto luma = dotAvx2(BT2020_LUMA, rgba[0], rgba[1], rgba[2]);
+			auto ootf = _mm256_mul_ps(powAvx2(luma, HLG_SYSTEM_GAMMA - 1.0f), _mm256_set1_ps(HLG_PEAK_NITS));
+			for (auto c = 0; c < 3; c++) {
+				rgba[c] = _mm256_mul_ps(rgba[c], ootf);
+			}
+		}
+		rgba[3] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 30)), _mm256_set1_ps(1.0f / 3.0f));
+	}
+}
+
+template <HdrEncoding Encoding>
+SIMD_TARGET_AVX2 inline void encodeHdrAvx2(const __m256* rgba, BYTE* dst) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		auto r = _mm256_cvtps_ph(dotAvx2(BT2020_NITS_TO_SCRGB, rgba[0], rgba[1], rgba[2]), _MM_FROUND_TO_NEAREST_INT);
+		auto g = _mm256_cvtps_ph(dotAvx2(BT2020_NITS_TO_SCRGB + 3, rgba[0], rgba[1], rgba[2]), _MM_FROUND_TO_NEAREST_INT);
+		auto b = _mm256_cvtps_ph(dotAvx2(BT2020_NITS_TO_SCRGB + 6, rgba[0], rgba[1], rgba[2]), _MM_FROUND_TO_NEAREST_INT);
+		auto a = _mm256_cvtps_ph(rgba[3], _MM_FROUND_TO_NEAREST_INT);
+		auto rgLow = _mm_unpacklo_epi16(r, g);
+		auto baLow = _mm_unpacklo_epi16(b, a);
+		auto rgHigh = _mm_unpackhi_epi16(r, g);
+		auto baHigh = _mm_unpackhi_epi16(b, a);
+		auto out = reinterpret_cast<__m128i*>(dst);
+		_mm_storeu_si128(out, _mm_unpacklo_epi32(rgLow, baLow));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi32(rgLow, baLow));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi32(rgHigh, baHigh));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi32(rgHigh, baHigh));
+	} else {
+		__m256 rgb[3];
+		if constexpr (Encoding == HdrEncoding::Hdr10) {
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = pqEncodeAvx2(_mm256_mul_ps(rgba[c], _mm256_set1_ps(1.0f / PQ_PEAK_NITS)));
+			}
+		} else {
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = clampAvx2(_mm256_mul_ps(rgba[c], _mm256_set1_ps(1.0f / HLG_PEAK_NITS)), 0.0f, 1.0f);
+			}
+			auto luma = dotAvx2(BT2020_LUMA, rgb[0], rgb[1], rgb[2]);
+			auto ootf = powAvx2(luma, (1.0f - HLG_SYSTEM_GAMMA) / HLG_SYSTEM_GAMMA);
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = hlgEncodeAvx2(_mm256_mul_ps(rgb[c], ootf));
+			}
+		}
+		const auto scale = _mm256_set1_ps(1023.0f);
+		auto pixel = _mm256_or_si256(
+			_mm256_or_si256(quantizeAvx2(clampAvx2(rgb[0], 0.0f, 1.0f), scale),
+				_mm256_slli_epi32(quantizeAvx2(clampAvx2(rgb[1], 0.0f, 1.0f), scale), 10)),
+			_mm256_or_si256(_mm256_slli_epi32(quantizeAvx2(clampAvx2(rgb[2], 0.0f, 1.0f), scale), 20),
+				_mm256_slli_epi32(quantizeAvx2(clampAvx2(rgba[3], 0.0f, 1.0f), _mm256_set1_ps(3.0f)), 30)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), pixel);
+	}
+}
+
+SIMD_TARGET_AVX2 inline __m256 toneMapNitsAvx2(__m256 nits, const ToneCurve& curve) {
+	const auto one = _mm256_set1_ps(1.0f);
+	if (curve.mapper == ToneMapper::Bt2390) {
+		const auto knee = _mm256_set1_ps(curve.knee);
+		auto signal = pqEncodeAvx2(_mm256_mul_ps(nits, _mm256_set1_ps(1.0f / PQ_PEAK_NITS)));
+		auto e1 = clampAvx2(_mm256_mul_ps(_mm256_sub_ps(signal, _mm256_set1_ps(curve.blackPq)), _mm256_set1_ps(curve.invRangePq)), 0.0f, 1.0f);
+		auto t = _mm256_div_ps(_mm256_sub_ps(e1, knee), _mm256_sub_ps(one, knee));
+		auto t2 = _mm256_mul_ps(t, t);
+		auto t3 = _mm256_mul_ps(t2, t);
+		auto two = _mm256_set1_ps(2.0f);
+		auto three = _mm256_set1_ps(3.0f);
+		auto h0 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(two, t3), _mm256_mul_ps(three, t2)), one);
+		auto h1 = _mm256_add_ps(_mm256_sub_ps(t3, _mm256_mul_ps(two, t2)), t);
+		auto h2 = _mm256_sub_ps(_mm256_mul_ps(three, t2), _mm256_mul_ps(two, t3));
+		auto spline = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h0, knee), _mm256_mul_ps(h1, _mm256_sub_ps(one, knee))),
+			_mm256_mul_ps(h2, _mm256_set1_ps(curve.maxLum)));
+		auto e2 = _mm256_blendv_ps(e1, spline, _mm256_cmp_ps(e1, knee, _CMP_GT_OQ));
+		auto inverse = _mm256_sub_ps(one, e2);
+		inverse = _mm256_mul_ps(inverse, inverse);
+		auto e3 = _mm256_add_ps(e2, _mm256_mul_ps(_mm256_set1_ps(curve.minLum), _mm256_mul_ps(inverse, inverse)));
+		auto e4 = _mm256_add_ps(_mm256_mul_ps(e3, _mm256_set1_ps(curve.rangePq)), _mm256_set1_ps(curve.blackPq));
+		return _mm256_mul_ps(pqDecodeAvx2(e4), _mm256_set1_ps(PQ_PEAK_NITS));
+	}
+	auto x = _mm256_mul_ps(nits, _mm256_set1_ps(curve.invDisplayNits));
+	__m256 y;
+	if (curve.mapper == ToneMapper::Reinhard) {
+		auto numerator = _mm256_mul_ps(x, _mm256_add_ps(one, _mm256_mul_ps(x, _mm256_set1_ps(curve.white))));
+		y = _mm256_div_ps(numerator, _mm256_add_ps(one, x));
+	} else {
+		auto numerator = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(0.03f)));
+		auto denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f));
+		y = _mm256_mul_ps(_mm256_div_ps(numerator, denominator), _mm256_set1_ps(curve.white));
+	}
+	return _mm256_mul_ps(_mm256_min_ps(y, one), _mm256_set1_ps(curve.displayNits));
+}
+
+SIMD_TARGET_AVX2 inline void toneMapAvx2(__m256* rgba, const ToneCurve& curve) {
+	if (curve.mapper == ToneMapper::None) {
+		return;
+	}
+	const auto zero = _mm256_setzero_ps();
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = _mm256_max_ps(rgba[c], zero);
+	}
+	auto peak = _mm256_max_ps(rgba[0], _mm256_max_ps(rgba[1], rgba[2]));
+	auto ratio = _mm256_div_ps(toneMapNitsAvx2(peak, curve), peak);
+	auto scale = _mm256_blendv_ps(_mm256_set1_ps(1.0f), ratio, _mm256_cmp_ps(peak, zero, _CMP_GT_OQ));
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = _mm256_mul_ps(rgba[c], scale);
+	}
+}
+
+template <HdrEncoding Src, HdrEncoding Dst>
+SIMD_TARGET_AVX2 inline void convertHdrRowAvx2(const BYTE* src, BYTE* dst, UINT count, const ToneCurve& curve) {
+	const auto srcSize = Src == HdrEncoding::ScRgb ? 8u : 4u;
+	const auto dstSize = Dst == HdrEncoding::ScRgb ? 8u : 4u;
+	auto table = hdrDecodeTable(Src);
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 rgba[4];
+		decodeHdrAvx2<Src>(src + i * srcSize, table, rgba);
+		toneMapAvx2(rgba, curve);
+		encodeHdrAvx2<Dst>(rgba, dst + i * dstSize);
+	}
+	convertHdrRowScalar<Src, Dst>(src + i * srcSize, dst + i * dstSize, count - i, curve);
+}
+
+#endif
+
+// ============================================================================
+// NEON kernels
+// ============================================================================
+#if defined(SIMD_NEON)
+
+inline float32x4_t clampNeon(float32x4_t value, float minimum, float maximum) {
+	return vminnmq_f32(vmaxnmq_f32(value, vdupq_n_f32(minimum)), vdupq_n_f32(maximum));
+}
+
+inline float32x4_t log2Neon(float32x4_t value) {
+	auto bits = vreinterpretq_s32_f32(value);
+	auto exponent = vshrq_n_s32(vsubq_s32(bits, vdupq_n_s32(0x3f3504f3)), 23);
+	auto mantissa = vreinterpretq_f32_s32(vsubq_s32(bits, vshlq_n_s32(exponent, 23)));
+	auto one = vdupq_n_f32(1.0f);
+	auto t = vdivq_f32(vsubq_f32(mantissa, one), vaddq_f32(mantissa, one));
+	auto t2 = vmulq_f32(t, t);
+	auto p = vdupq_n_f32(LOG2_C9);
+	p = vaddq_f32(vmulq_f32(p, t2), vdupq_n_f32(LOG2_C7));
+	p = vaddq_f32(vmulq_f32(p, t2), vdupq_n_f32(LOG2_C5));
+	p = vaddq_f32(vmulq_f32(p, t2), vdupq_n_f32(LOG2_C3));
+	p = vaddq_f32(vmulq_f32(p, t2), vdupq_n_f32(LOG2_C1));
+	return vaddq_f32(vcvtq_f32_s32(exponent), vmulq_f32(p, t));
+}
+
+inline float32x4_t exp2Neon(float32x4_t value) {
+	value = clampNeon(value, -126.0f, 127.0f);
+	auto whole = vsubq_s32(vcvtq_s32_f32(vaddq_f32(value, vdupq_n_f32(126.5f))), vdupq_n_s32(126));
+	auto f = vsubq_f32(value, vcvtq_f32_s32(whole));
+	auto p = vdupq_n_f32(EXP2_C7);
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C6));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C5));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C4));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C3));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C2));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(EXP2_C1));
+	p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(1.0f));
+	auto scale = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(whole, vdupq_n_s32(127)), 23));
+	return vmulq_f32(p, scale);
+}
+
+inline float32x4_t powNeon(float32x4_t value, float exponent) {
+	auto positive = vmaxnmq_f32(value, vdupq_n_f32(FLT_MIN));
+	return exp2Neon(vmulq_f32(vdupq_n_f32(exponent), log2Neon(positive)));
+}
+
+inline float32x4_t pqEncodeNeon(float32x4_t value) {
+	auto y = powNeon(clampNeon(value, 0.0f, 1.0f), PQ_M1);
+	auto numerator = vaddq_f32(vdupq_n_f32(PQ_C1), vmulq_f32(vdupq_n_f32(PQ_C2), y));
+	auto denominator = vaddq_f32(vdupq_n_f32(1.0f), vmulq_f32(vdupq_n_f32(PQ_C3), y));
+	return powNeon(vdivq_f32(numerator, denominator), PQ_M2);
+}
+
+inline float32x4_t pqDecodeNeon(float32x4_t signal) {
+	auto e = powNeon(clampNeon(signal, 0.0f, 1.0f), 1.0f / PQ_M2);
+	auto numerator = vmaxnmq_f32(vsubq_f32(e, vdupq_n_f32(PQ_C1)), vdupq_n_f32(0.0f));
+	auto denominator = vsubq_f32(vdupq_n_f32(PQ_C2), vmulq_f32(vdupq_n_f32(PQ_C3), e));
+	return powNeon(vdivq_f32(numerator, denominator), 1.0f / PQ_M1);
+}
+
+inline float32x4_t hlgEncodeNeon(float32x4_t value) {
+	value = clampNeon(value, 0.0f, 1.0f);
+	auto low = vsqrtq_f32(vmulq_f32(vdupq_n_f32(3.0f), value));
+	auto x = vsubq_f32(vmulq_f32(vdupq_n_f32(12.0f), value), vdupq_n_f32(HLG_B));
+	auto high = vaddq_f32(vmulq_f32(vdupq_n_f32(HLG_LOG_SCALE),
+		log2Neon(vmaxnmq_f32(x, vdupq_n_f32(FLT_MIN)))), vdupq_n_f32(HLG_C));
+	return vbslq_f32(vcleq_f32(value, vdupq_n_f32(HLG_ONE_TWELFTH)), low, high);
+}
+
+
+inline float32x4_t dotNeon(const float* m, float32x4_t r, float32x4_t g, float32x4_t b) {
+	auto rg = vaddq_f32(vmulq_f32(vdupq_n_f32(m[0]), r), vmulq_f32(vdupq_n_f32(m[1]), g));
+	return vaddq_f32(rg, vmulq_f32(vdupq_n_f32(m[2]), b));
+}
+
+inline float32x4_t finiteHalfNeon(float32x4_t value) {
+	auto ordered = vceqq_f32(value, value);
+	return clampNeon(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(value), ordered)), -65504.0f, 65504.0f);
+}
+
+template <HdrEncoding Encoding>
+inline void decodeHdrNeon(const BYTE* src, const float* table, float32x4_t* rgba) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		auto pixels = vld4_u16(reinterpret_cast<const uint16_t*>(src));
+		auto r = finiteHalfNeon(vcvt_f32_f16(vreinterpret_f16_u16(pixels.val[0])));
+		auto g = finiteHalfNeon(vcvt_f32_f16(vreinterpret_f16_u16(pixels.val[1])));
+		auto b = finiteHalfNeon(vcvt_f32_f16(vreinterpret_f16_u16(pixels.val[2])));
+		rgba[0] = dotNeon(SCRGB_TO_BT2020_NITS, r, g, b);
+		rgba[1] = dotNeon(SCRGB_TO_BT2020_NITS + 3, r, g, b);
+		rgba[2] = dotNeon(SCRGB_TO_BT2020_NITS + 6, r, g, b);
+		rgba[3] = vcvt_f32_f16(vreinterpret_f16_u16(pixels.val[3]));
+	} else {
+		auto pixels = vld1q_u32(reinterpret_cast<const uint32_t*>(src));
+		uint32_t values[4];
+		vst1q_u32(values, pixels);
+		for (auto c = 0; c < 3; c++) {
+			float channel[4];
+			for (auto i = 0; i < 4; i++) {
+				channel[i] = table[(values[i] >> (c * 10)) & 0x3ff];
+			}
+			rgba[c] = vld1q_f32(channel);
+		}
+		if constexpr (Encoding == HdrEncoding::Hlg) {
+			auto luma = dotNeon(BT2020_LUMA, rgba[0], rgba[1], rgba[2]);
+			auto ootf = vmulq_f32(powNeon(luma, HLG_SYSTEM_GAMMA - 1.0f), vdupq_n_f32(HLG_PEAK_NITS));
+			for (auto c = 0; c < 3; c++) {
+				rgba[c] = vmulq_f32(rgba[c], ootf);
+			}
+		}
+		rgba[3] = vmulq_f32(vcvtq_f32_u32(vshrq_n_u32(pixels, 30)), vdupq_n_f32(1.0f / 3.0f));
+	}
+}
+
+template <HdrEncoding Encoding>
+inline void encodeHdrNeon(const float32x4_t* rgba, BYTE* dst) {
+	if constexpr (Encoding == HdrEncoding::ScRgb) {
+		uint16x4x4_t pixels;
+		pixels.val[0] = vreinterpret_u16_f16(vcvt_f16_f32(dotNeon(BT2020_NITS_TO_SCRGB, rgba[0], rgba[1], rgba[2])));
+		pixels.val[1] = vreinterpret_u16_f16(vcvt_f16_f32(dotNeon(BT2020_NITS_TO_SCRGB + 3, rgba[0], rgba[1], rgba[2])));
+		pixels.val[2] = vreinterpret_u16_f16(vcvt_f16_f32(dotNeon(BT2020_NITS_TO_SCRGB + 6, rgba[0], rgba[1], rgba[2])));
+		pixels.val[3] = vreinterpret_u16_f16(vcvt_f16_f32(rgba[3]));
+		vst4_u16(reinterpret_cast<uint16_t*>(dst), pixels);
+	} else {
+		float32x4_t rgb[3];
+		if constexpr (Encoding == HdrEncoding::Hdr10) {
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = pqEncodeNeon(vmulq_f32(rgba[c], vdupq_n_f32(1.0f / PQ_PEAK_NITS)));
+			}
+		} else {
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = clampNeon(vmulq_f32(rgba[c], vdupq_n_f32(1.0f / HLG_PEAK_NITS)), 0.0f, 1.0f);
+			}
+			auto luma = dotNeon(BT2020_LUMA, rgb[0], rgb[1], rgb[2]);
+			auto ootf = powNeon(luma, (1.0f - HLG_SYSTEM_GAMMA) / HLG_SYSTEM_GAMMA);
+			for (auto c = 0; c < 3; c++) {
+				rgb[c] = hlgEncodeNeon(vmulq_f32(rgb[c], ootf));
+			}
+		}
+		const auto scale = vdupq_n_f32(1023.0f);
+		auto pixel = vorrq_u32(
+			vorrq_u32(quantizeNeon(clampNeon(rgb[0], 0.0f, 1.0f), scale),
+				vshlq_n_u32(quantizeNeon(clampNeon(rgb[1], 0.0f, 1.0f), scale), 10)),
+			vorrq_u32(vshlq_n_u32(quantizeNeon(clampNeon(rgb[2], 0.0f, 1.0f), scale), 20),
+				vshlq_n_u32(quantizeNeon(clampNeon(rgba[3], 0.0f, 1.0f), vdupq_n_f32(3.0f)), 30)));
+		vst1q_u32(reinterpret_cast<uint32_t*>(dst), pixel);
+	}
+}
+
+inline float32x4_t toneMapNitsNeon(float32x4_t nits, const ToneCurve& curve) {
+	const auto one = vdupq_n_f32(1.0f);
+	if (curve.mapper == ToneMapper::Bt2390) {
+		const auto knee = vdupq_n_f32(curve.knee);
+		auto signal = pqEncodeNeon(vmulq_f32(nits, vdupq_n_f32(1.0f / PQ_PEAK_NITS)));
+		auto e1 = clampNeon(vmulq_f32(vsubq_f32(signal, vdupq_n_f32(curve.blackPq)), vdupq_n_f32(curve.invRangePq)), 0.0f, 1.0f);
+		auto t = vdivq_f32(vsubq_f32(e1, knee), vsubq_f32(one, knee));
+		auto t2 = vmulq_f32(t, t);
+		auto t3 = vmulq_f32(t2, t);
+		auto two = vdupq_n_f32(2.0f);
+		auto three = vdupq_n_f32(3.0f);
+		auto h0 = vaddq_f32(vsubq_f32(vmulq_f32(two, t3), vmulq_f32(three, t2)), one);
+		auto h1 = vaddq_f32(vsubq_f32(t3, vmulq_f32(two, t2)), t);
+		auto h2 = vsubq_f32(vmulq_f32(three, t2), vmulq_f32(two, t3));
+		auto spline = vaddq_f32(vaddq_f32(vmulq_f32(h0, knee), vmulq_f32(h1, vsubq_f32(one, knee))),
+			vmulq_f32(h2, vdupq_n_f32(curve.maxLum)));
+		auto e2 = vbslq_f32(vcgtq_f32(e1, knee), spline, e1);
+		auto inverse = vsubq_f32(one, e2);
+		inverse = vmulq_f32(inverse, inverse);
+		auto e3 = vaddq_f32(e2, vmulq_f32(vdupq_n_f32(curve.minLum), vmulq_f32(inverse, inverse)));
+		auto e4 = vaddq_f32(vmulq_f32(e3, vdupq_n_f32(curve.rangePq)), vdupq_n_f32(curve.blackPq));
+		return vmulq_f32(pqDecodeNeon(e4), vdupq_n_f32(PQ_PEAK_NITS));
+	}
+	auto x = vmulq_f32(nits, vdupq_n_f32(curve.invDisplayNits));
+	float32x4_t y;
+	if (curve.mapper == ToneMapper::Reinhard) {
+		auto numerator = vmulq_f32(x, vaddq_f32(one, vmulq_f32(x, vdupq_n_f32(curve.white))));
+		y = vdivq_f32(numerator, vaddq_f32(one, x));
+	} else {
+		auto numerator = vmulq_f32(x, vaddq_f32(vmulq_f32(vdupq_n_f32(2.51f), x), vdupq_n_f32(0.03f)));
+		auto denominator = vaddq_f32(vmulq_f32(x, vaddq_f32(vmulq_f32(vdupq_n_f32(2.43f), x), vdupq_n_f32(0.59f))), vdupq_n_f32(0.14f));
+		y = vmulq_f32(vdivq_f32(numerator, denominator), vdupq_n_f32(curve.white));
+	}
+	return vmulq_f32(vminq_f32(y, one), vdupq_n_f32(curve.displayNits));
+}
+
+inline void toneMapNeon(float32x4_t* rgba, const ToneCurve& curve) {
+	if (curve.mapper == ToneMapper::None) {
+		return;
+	}
+	const auto zero = vdupq_n_f32(0.0f);
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = vmaxq_f32(rgba[c], zero);
+	}
+	auto peak = vmaxq_f32(rgba[0], vmaxq_f32(rgba[1], rgba[2]));
+	auto ratio = vdivq_f32(toneMapNitsNeon(peak, curve), peak);
+	auto scale = vbslq_f32(vcgtq_f32(peak, zero), ratio, vdupq_n_f32(1.0f));
+	for (auto c = 0; c < 3; c++) {
+		rgba[c] = vmulq_f32(rgba[c], scale);
+	}
+}
+
+template <HdrEncoding Src, HdrEncoding Dst>
+inline void convertHdrRowNeon(const BYTE* src, BYTE* dst, UINT count, const ToneCurve& curve) {
+	const auto srcSize = Src == HdrEncoding::ScRgb ? 8u : 4u;
+	const auto dstSize = Dst == HdrEncoding::ScRgb ? 8u : 4u;
+	auto table = hdrDecodeTable(Src);
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t rgba[4];
+		decodeHdrNeon<Src>(src + i * srcSize, table, rgba);
+		toneMapNeon(rgba, curve);
+		encodeHdrNeon<Dst>(rgba, dst + i * dstSize);
+	}
+	convertHdrRowScalar<Src, Dst>(src + i * srcSize, dst + i * dstSize, count - i, curve);
+}
+
+#endif
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+// a function to convert a single row of pixels between the HDR encodings.
+typedef void(*HdrRowFunc)(const BYTE* src, BYTE* dst, UINT count, const ToneCurve& curve);
+
+// a utility to find the kernel for the given encodings and the SIMD level.
+template <HdrEncoding Src, HdrEncoding Dst>
+inline HdrRowFunc findHdrRow(SimdLevel level) {
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		return &convertHdrRowAvx2<Src, Dst>;
+	}
+#elif defined(SIMD_NEON)
+	if (level == SimdLevel::Neon) {
+		return &convertHdrRowNeon<Src, Dst>;
+	}
+#endif
+	(void)level;
+	return &convertHdrRowScalar<Src, Dst>;
+}
+
+// a utility to find the kernel for the given destination encoding.
+template <HdrEncoding Src>
+inline HdrRowFunc findHdrRow(HdrEncoding dst, SimdLevel level) {
+	switch (dst) {
+	case HdrEncoding::ScRgb:
+		return findHdrRow<Src, HdrEncoding::ScRgb>(level);
+	case HdrEncoding::Hdr10:
+		return findHdrRow<Src, HdrEncoding::Hdr10>(level);
+	default:
+		return findHdrRow<Src, HdrEncoding::Hlg>(level);
+	}
+}
+
+// a utility to find the kernel for the given encodings.
+inline HdrRowFunc findHdrRow(HdrEncoding src, HdrEncoding dst, SimdLevel level) {
+	switch (src) {
+	case HdrEncoding::ScRgb:
+		return findHdrRow<HdrEncoding::ScRgb>(dst, level);
+	case HdrEncoding::Hdr10:
+		return findHdrRow<HdrEncoding::Hdr10>(dst, level);
+	default:
+		return findHdrRow<HdrEncoding::Hlg>(dst, level);
+	}
+}
+
+// ============================================================================
+// HdrConverter
+//
+// Converts surfaces from the source encoding into the destination encoding
+// with the given tone mapping. The surface formats must match the encodings.
+//
+//   - convert		-- Convert the source view into the destination view
+//
+// Returns E_INVALIDARG if views are null or have different sizes.
+// Returns DXGI_ERROR_UNSUPPORTED if formats do not match the encodings.
+// ============================================================================
+class HdrConverter final {
+public:
+	HdrConverter(HdrEncoding src, HdrEncoding dst, const ToneMapping& toneMapping = ToneMapping::none())
+		: mSrc(src), mDst(dst), mCurve(makeToneCurve(toneMapping)) {
+	}
+
+	HRESULT convert(const SurfaceView& src, const SurfaceView& dst, SimdLevel level = bestSimdLevel()) const {
+		if (src.bits == nullptr || dst.bits == nullptr || src.width != dst.width || src.height != dst.height) {
+			return E_INVALIDARG;
+		} else if (src.format != hdrEncodingFormat(mSrc) || dst.format != hdrEncodingFormat(mDst)) {
+			return DXGI_ERROR_UNSUPPORTED;
+		}
+		auto convertRow = findHdrRow(mSrc, mDst, level);
+		for (UINT y = 0; y < src.height; y++) {
+			convertRow(src.bits + static_cast<ptrdiff_t>(y) * src.pitch,
+				dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch, src.width, mCurve);
+		}
+		return S_OK;
+	}
+
+	HdrEncoding source() const { return mSrc; }
+	HdrEncoding destination() const { return mDst; }
+	const ToneCurve& curve() const { return mCurve; }
+private:
+	HdrEncoding	mSrc;
+	HdrEncoding	mDst;
+	ToneCurve	mCurve;
+};
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+// ============================================================================
+// Result
+//
+// A non-throwing alternative for the check_hresult. A result holds either a
+// value or a failed HRESULT, and always the source location where it was made
+// so that the failures can be reported without any stack unwinding.
+//
+//		auto presented = RESULT_OF(swapchain->Present(0, 0));
+//		if (presented.classification() == HresultClass::Retryable) {
+//			continue;
+//		}
+//		check_hresult(presented);
+//
+// Each HRESULT is classified into one of the following classes.
+//
+//		Success		-- The call succeeded and the caller may proceed
+//		Retryable	-- The call did not complete now, but it can be retried
+//		Fatal		-- The call failed and it should not be retried as such
+//
+// Note that DXGI_STATUS_OCCLUDED and DXGI_STATUS_MODE_CHANGE_IN_PROGRESS are
+// successful codes (SUCCEEDED holds), but they are still classified retryable
+// as the presentation did not happen. DXGI_ERROR_DEVICE_RESET and the ACCESS_
+// LOST are retryable only after the device or the duplication is recreated.
+// The WAIT_TIMEOUT of the IDXGIKeyedMutex::AcquireSync is a successful code
+// as well, which is classified retryable.
+//
+// The success path only stores the code and the location, which are constants
+// known at the call site, so there is no allocation nor unwinding. The result
+// is still larger than a plain HRESULT (e.g. 32 bytes for Result<void> on x64)
+// and it is returned through memory. The errors.* benchmarks of dxgi-bench
+// compare it against exceptions and plain HRESULTs with various failure rates.
+// ============================================================================
+
+// a location in the source code.
+struct SourceLocation {
+	const char*	file;
+	uint32_t	line;
+	const char*	function;
+};
+
+// a macro to get the current source location.
+#define SOURCE_LOCATION SourceLocation{ __FILE__, static_cast<uint32_t>(__LINE__), __func__ }
+
+enum class HresultClass {
+	Success,
+	Retryable,
+	Fatal
+};
+
+// a utility to classify HRESULT as a success, a retryable or a fatal result.
+constexpr HresultClass classifyHresult(HRESULT result) {
+	switch (result) {
+	case DXGI_STATUS_OCCLUDED:
+	case DXGI_STATUS_MODE_CHANGE_IN_PROGRESS:
+	case DXGI_ERROR_WAS_STILL_DRAWING:
+	case DXGI_ERROR_WAIT_TIMEOUT:
+	case DXGI_ERROR_NOT_CURRENTLY_AVAILABLE:
+	case DXGI_ERROR_FRAME_STATISTICS_DISJOINT:
+	case DXGI_ERROR_DEVICE_RESET:
+	case DXGI_ERROR_ACCESS_LOST:
+	case DXGI_ERROR_SESSION_DISCONNECTED:
+	case WAIT_TIMEOUT:
+		return HresultClass::Retryable;
+	default:
+		return SUCCEEDED(result) ? HresultClass::Success : HresultClass::Fatal;
+	}
+}
+
+// a utility to get string presentation of HresultClass.
+inline const char* hresultClassString(HresultClass classification) {
+	switch (classification) {
+	case HresultClass::Success:		return "success";
+	case HresultClass::Retryable:	return "retryable";
+	case HresultClass::Fatal:		return "fatal";
+	default:						return "unknown";
+	}
+}
+
+// a result of a call which produces a value of the type T.
+template <typename T>
+class Result final {
+public:
+	Result(T value, SourceLocation location = {}) : mCode(S_OK), mLocation(location), mValue(std::move(value)) {}
+	Result(HRESULT code, T value, SourceLocation location) : mCode(code), mLocation(location), mValue(std::move(value)) {}
+
+	// make a failed result which does not hold any value.
+	static Result failure(HRESULT code, SourceLocation location) {
+		assert(FAILED(code));
+		return Result(location, code);
+	}
+
+	bool ok() const { return SUCCEEDED(mCode); }
+	explicit operator bool() const { return ok(); }
+
+	HRESULT code() const { return mCode; }
+	HresultClass classification() const { return classifyHresult(mCode); }
+	const SourceLocation& location() const { return mLocation; }
+
+	T& value() { assert(ok()); return *mValue; }
+	const T& value() const { assert(ok()); return *mValue; }
+	T valueOr(T fallback) const { return ok() ? *mValue : std::move(fallback); }
+private:
+	Result(SourceLocation location, HRESULT code) : mCode(code), mLocation(location) {}
+
+	HRESULT				mCode;
+	SourceLocation		mLocation;
+	std::optional<T>	mValue;
+};
+
+// a result of a call which does not produce a value.
+template <>
+class Result<void> final {
+public:
+	Result(HRESULT code = S_OK, SourceLocation location = {}) : mCode(code), mLocation(location) {}
+
+	bool ok() const { return SUCCEEDED(mCode); }
+	explicit operator bool() const { return ok(); }
+
+	HRESULT code() const { return mCode; }
+	HresultClass classification() const { return classifyHresult(mCode); }
+	const SourceLocation& location() const { return mLocation; }
+private:
+	HRESULT			mCode;
+	SourceLocation	mLocation;
+};
+
+// a macro to make a result of a HRESULT returning call at the current location.
+#define RESULT_OF(...) Result<void>((__VA_ARGS__), SOURCE_LOCATION)
+
+// a utility to append the result as "0x887a0005 fatal at file:line (function)" into the sink.
+template <typename Sink, typename T>
+inline void appendResult(Sink& sink, const Result<T>& result) {
+	appendHex(sink, static_cast<uint32_t>(result.code()));
+	sink.append(" ", 1);
+	appendString(sink, hresultClassString(result.classification()));
+	if (result.location().file != nullptr) {
+		appendString(sink, " at ");
+		appendString(sink, result.location().file);
+		sink.append(":", 1);
+		appendInt(sink, result.location().line);
+		appendString(sink, " (");
+		appendString(sink, result.location().function);
+		sink.append(")", 1);
+	}
+}
+
+// a utility to convert the result into a descriptive string.
+template <typename T>
+inline FixedString<256> resultString(const Result<T>& result) {
+	FixedString<256> string;
+	appendResult(string, result);
+	return string;
+}
\ No newline at end of file
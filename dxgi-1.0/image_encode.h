@@ -0,0 +1,522 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "simd_util.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// Image Encoding
+//
+// Encodes surfaces into image files for screenshots. Any format supported by
+// the format conversion is accepted and written as 8-bit RGBA pixels.
+//
+//		ImageFormat::Png	-- PNG with a zlib stream of fixed Huffman blocks
+//		ImageFormat::Qoi	-- QOI ("Quite OK Image"), a fast lossless format
+//
+// The rows are cut into chunks of IMAGE_CHUNK_ROWS rows which are converted
+// and compressed in parallel on the given pool (or one by one without it). A
+// chunk does not depend on the output of the others, so the chunk outputs are
+// simply concatenated and the files do not depend on the amount of threads.
+//
+// PNG rows use the Up filter. Each chunk is compressed into its own deflate
+// block (ended with an empty stored block to align it to a byte) and written
+// as its own IDAT chunk, so the CRCs are computed in parallel as well. The
+// Adler-32 checksums of the chunks are combined into the one of the stream.
+// Matches are found with a single entry hash table of 4-byte sequences within
+// the chunk, which trades some compression for speed (like zlib level 1).
+//
+// QOI chunks start their pixel runs and differences from the last pixel of
+// the previous chunk, as the decoder does. The colour index of a chunk only
+// refers to the entries which the chunk itself has written, as the decoder's
+// index still holds the pixels of the previous chunks.
+// ============================================================================
+
+// the image file formats.
+enum class ImageFormat {
+	Png,
+	Qoi
+};
+
+// a utility to convert ImageFormat into a string.
+inline const char* imageFormatString(ImageFormat format) {
+	switch (format) {
+	case ImageFormat::Png:
+		return "PNG";
+	case ImageFormat::Qoi:
+		return "QOI";
+	default:
+		return "unknown";
+	}
+}
+
+// the rows in each chunk which is encoded in parallel.
+constexpr UINT IMAGE_CHUNK_ROWS = 64;
+
+// ============================================================================
+// Checksums and bit output
+// ============================================================================
+
+// a utility to get the table of the CRC-32 used by PNG.
+inline const std::array<uint32_t, 256>& crc32Table() {
+	static const auto table = [] {
+		std::array<uint32_t, 256> result = {};
+		for (uint32_t i = 0; i < 256; i++) {
+			auto value = i;
+			for (auto bit = 0; bit < 8; bit++) {
+				value = (value & 1) != 0 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+			}
+			result[i] = value;
+		}
+		return result;
+	}();
+	return table;
+}
+
+// a utility to update the CRC-32 with the bytes (starting with 0).
+inline uint32_t crc32(uint32_t crc, const BYTE* data, size_t size) {
+	auto& table = crc32Table();
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// a utility to update the Adler-32 with the bytes (starting with 1).
+inline uint32_t adler32(uint32_t adler, const BYTE* data, size_t size) {
+	const uint32_t BASE = 65521;
+	const size_t NMAX = 5552;	// the most bytes which can be summed without an overflow.
+	uint32_t a = adler & 0xffff;
+	uint32_t b = adler >> 16;
+	while (size > 0) {
+		auto n = std::min(size, NMAX);
+		for (size_t i = 0; i < n; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= BASE;
+		b %= BASE;
+		data += n;
+		size -= n;
+	}
+	return a | (b << 16);
+}
+
+// a utility to combine the Adler-32 of two sequences when the second has the size.
+inline uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) {
+	const uint32_t BASE = 65521;
+	auto remainder = static_cast<uint32_t>(secondSize % BASE);
+	auto a = first & 0xffff;
+	auto b = (remainder * a) % BASE;
+	a += (second & 0xffff) + BASE - 1;
+	b += (first >> 16) + (second >> 16) + BASE - remainder;
+	a = a >= BASE ? a - BASE : a;
+	a = a >= BASE ? a - BASE : a;
+	b = b >= BASE * 2 ? b - BASE * 2 : b;
+	b = b >= BASE ? b - BASE : b;
+	return a | (b << 16);
+}
+
+// a utility to append a big-endian 32-bit value.
+inline void appendBigEndian(std::vector<BYTE>& out, uint32_t value) {
+	BYTE bytes[4] = { static_cast<BYTE>(value >> 24), static_cast<BYTE>(value >> 16), static_cast<BYTE>(value >> 8), static_cast<BYTE>(value) };
+	out.insert(out.end(), bytes, bytes + 4);
+}
+
+// a writer of the least significant bit first bit stream of deflate.
+class BitWriter final {
+public:
+	explicit BitWriter(std::vector<BYTE>& out) : mOut(out), mBits(0), mCount(0) {}
+
+	void write(uint32_t bits, UINT count) {
+		mBits |= static_cast<uint64_t>(bits) << mCount;
+		mCount += count;
+		while (mCount >= 8) {
+			mOut.push_back(static_cast<BYTE>(mBits));
+			mBits >>= 8;
+			mCount -= 8;
+		}
+	}
+
+	// pad the stream with zero bits to the next byte.
+	void align() {
+		if (mCount > 0) {
+			write(0, 8 - mCount);
+		}
+	}
+private:
+	std::vector<BYTE>&	mOut;
+	uint64_t			mBits;
+	UINT				mCount;
+};
+
+// ============================================================================
+// Deflate
+// ============================================================================
+
+// the fixed Huffman codes of deflate, bit reversed for the bit writer.
+struct FixedHuffman {
+	uint16_t	literal[288];
+	BYTE		literalBits[288];
+	uint16_t	distance[30];
+};
+
+// a utility to get the fixed Huffman codes.
+inline const FixedHuffman& fixedHuffman() {
+	static const auto codes = [] {
+		auto reverse = [](uint32_t code, UINT bits) {
+			uint32_t result = 0;
+			for (UINT i = 0; i < bits; i++) {
+				result = (result << 1) | ((code >> i) & 1);
+			}
+			return static_cast<uint16_t>(result);
+		};
+		FixedHuffman result = {};
+		for (uint32_t i = 0; i < 288; i++) {
+			uint32_t code, bits;
+			if (i < 144) {
+				code = 0x30 + i, bits = 8;
+			} else if (i < 256) {
+				code = 0x190 + i - 144, bits = 9;
+			} else if (i < 280) {
+				code = i - 256, bits = 7;
+			} else {
+				code = 0xc0 + i - 280, bits = 8;
+			}
+			result.literal[i] = reverse(code, bits);
+			result.literalBits[i] = static_cast<BYTE>(bits);
+		}
+		for (uint32_t i = 0; i < 30; i++) {
+			result.distance[i] = reverse(i, 5);
+		}
+		return result;
+	}();
+	return codes;
+}
+
+// a utility to write a match of the length (3 - 258) and the distance (1 - 32768).
+inline void writeDeflateMatch(BitWriter& writer, const FixedHuffman& codes, UINT length, UINT distance) {
+	static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const BYTE LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const BYTE DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	UINT code = 0;
+	while (code < 28 && LENGTH_BASE[code + 1] <= length) {
+		code++;
+	}
+	writer.write(codes.literal[257 + code], codes.literalBits[257 + code]);
+	writer.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+	code = 0;
+	while (code < 29 && DISTANCE_BASE[code + 1] <= distance) {
+		code++;
+	}
+	writer.write(codes.distance[code], 5);
+	writer.write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+// a utility to compress the data into a fixed Huffman deflate block, which is either the
+// final block of the stream or followed by an empty stored block to end at a byte.
+inline void deflateChunk(const BYTE* data, size_t size, bool final, std::vector<BYTE>& out) {
+	const UINT HASH_BITS = 15;
+	const UINT MIN_MATCH = 4;
+	const UINT MAX_MATCH = 258;
+	const size_t WINDOW = 32768;
+	auto& codes = fixedHuffman();
+	std::vector<int32_t> table(1u << HASH_BITS, -1);
+	BitWriter writer(out);
+	writer.write(final ? 1 : 0, 1);
+	writer.write(1, 2);
+
+	size_t i = 0;
+	while (i + MIN_MATCH <= size) {
+		uint32_t sequence;
+		std::memcpy(&sequence, data + i, sizeof(sequence));
+		auto hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		auto candidate = table[hash];
+		table[hash] = static_cast<int32_t>(i);
+		if (candidate >= 0 && i - candidate <= WINDOW && std::memcmp(data + candidate, data + i, MIN_MATCH) == 0) {
+			auto limit = std::min<size_t>(MAX_MATCH, size - i);
+			UINT length = MIN_MATCH;
+			while (length < limit && data[candidate + length] == data[i + length]) {
+				length++;
+			}
+			writeDeflateMatch(writer, codes, length, static_cast<UINT>(i - candidate));
+			i += length;
+		} else {
+			writer.write(codes.literal[data[i]], codes.literalBits[data[i]]);
+			i++;
+		}
+	}
+	for (; i < size; i++) {
+		writer.write(codes.literal[data[i]], codes.literalBits[data[i]]);
+	}
+	writer.write(codes.literal[256], codes.literalBits[256]);
+	if (!final) {
+		writer.write(0, 3);
+		writer.align();
+		const BYTE EMPTY_STORED[4] = { 0x00, 0x00, 0xff, 0xff };
+		out.insert(out.end(), EMPTY_STORED, EMPTY_STORED + 4);
+	}
+	writer.align();
+}
+
+// ============================================================================
+// Chunked encoding
+// ============================================================================
+
+// a utility to run the function for each chunk of the rows, in parallel with the pool.
+template <typename Function>
+inline void forEachChunk(ThreadPool* pool, UINT chunks, Function&& function) {
+	if (pool == nullptr) {
+		for (UINT i = 0; i < chunks; i++) {
+			function(i);
+		}
+	} else {
+		pool->parallelFor(chunks, function);
+	}
+}
+
+// a utility to convert the row of the view into 8-bit RGBA pixels.
+inline void readRgba8Row(const SurfaceView& src, ConvertRowFunc convertRow, UINT y, BYTE* dst) {
+	auto row = src.bits + static_cast<ptrdiff_t>(y) * src.pitch;
+	if (convertRow == nullptr) {
+		std::memcpy(dst, row, static_cast<size_t>(src.width) * 4);
+	} else {
+		convertRow(row, dst, src.width);
+	}
+}
+
+// a utility to find the kernel which converts rows of the view into RGBA8 (or null to copy them).
+inline HRESULT findRgba8Row(const SurfaceView& src, ConvertRowFunc* convertRow) {
+	auto layout = pixelLayout(src.format);
+	if (src.bits == nullptr || src.width == 0 || src.height == 0) {
+		return E_INVALIDARG;
+	} else if (layout == PixelLayout::Unknown) {
+		return DXGI_ERROR_UNSUPPORTED;
+	}
+	*convertRow = layout == PixelLayout::Rgba8 ? nullptr : findConvertRow(layout, PixelLayout::Rgba8, bestSimdLevel());
+	return S_OK;
+}
+
+// ============================================================================
+// encodePng
+//
+// Encodes the view into a PNG file with 8-bit RGBA pixels.
+//
+// Returns E_INVALIDARG if the view is null or empty.
+// Returns DXGI_ERROR_UNSUPPORTED if the format cannot be converted.
+// ============================================================================
+inline HRESULT encodePng(const SurfaceView& src, ThreadPool* pool, std::vector<BYTE>* out) {
+	ConvertRowFunc convertRow;
+	auto result = findRgba8Row(src, &convertRow);
+	if (FAILED(result) || out == nullptr) {
+		return out == nullptr ? E_INVALIDARG : result;
+	}
+
+	struct Chunk {
+		std::vector<BYTE>	idat;	// the complete IDAT chunk.
+		uint32_t			adler;
+		size_t				size;	// the size of the filtered data.
+	};
+	auto rowSize = static_cast<size_t>(src.width) * 4;
+	auto count = (src.height + IMAGE_CHUNK_ROWS - 1) / IMAGE_CHUNK_ROWS;
+	std::vector<Chunk> chunks(count);
+	forEachChunk(pool, count, [&](UINT index) {
+		auto begin = index * IMAGE_CHUNK_ROWS;
+		auto end = std::min(begin + IMAGE_CHUNK_ROWS, src.height);
+		std::vector<BYTE> previous(rowSize, 0);
+		std::vector<BYTE> current(rowSize);
+		std::vector<BYTE> filtered((rowSize + 1) * (end - begin));
+		if (begin > 0) {
+			readRgba8Row(src, convertRow, begin - 1, previous.data());
+		}
+		for (auto y = begin; y < end; y++) {
+			readRgba8Row(src, convertRow, y, current.data());
+			auto row = filtered.data() + (rowSize + 1) * (y - begin);
+			row[0] = 2;
+			for (size_t x = 0; x < rowSize; x++) {
+				row[x + 1] = static_cast<BYTE>(current[x] - previous[x]);
+			}
+			std::swap(previous, current);
+		}
+
+		auto& chunk = chunks[index];
+		chunk.idat.reserve(filtered.size() + filtered.size() / 8 + 64);
+		chunk.idat.resize(8);
+		std::memcpy(chunk.idat.data() + 4, "IDAT", 4);
+		if (index == 0) {
+			chunk.idat.push_back(0x78);	// deflate with a 32K window, fastest compression.
+			chunk.idat.push_back(0x01);
+		}
+		deflateChunk(filtered.data(), filtered.size(), index + 1 == count, chunk.idat);
+		auto length = static_cast<uint32_t>(chunk.idat.size() - 8);
+		chunk.idat[0] = static_cast<BYTE>(length >> 24);
+		chunk.idat[1] = static_cast<BYTE>(length >> 16);
+		chunk.idat[2] = static_cast<BYTE>(length >> 8);
+		chunk.idat[3] = static_cast<BYTE>(length);
+		appendBigEndian(chunk.idat, crc32(0, chunk.idat.data() + 4, chunk.idat.size() - 4));
+		chunk.adler = adler32(1, filtered.data(), filtered.size());
+		chunk.size = filtered.size();
+	});
+
+	auto writeChunk = [&](const char* type, const BYTE* data, uint32_t size) {
+		appendBigEndian(*out, size);
+		auto start = out->size();
+		out->insert(out->end(), type, type + 4);
+		out->insert(out->end(), data, data + size);
+		appendBigEndian(*out, crc32(0, out->data() + start, out->size() - start));
+	};
+	const BYTE SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	out->assign(SIGNATURE, SIGNATURE + 8);
+	std::vector<BYTE> header;
+	appendBigEndian(header, src.width);
+	appendBigEndian(header, src.height);
+	const BYTE FORMAT[5] = { 8, 6, 0, 0, 0 };	// 8-bit RGBA, deflate, adaptive filters, no interlace.
+	header.insert(header.end(), FORMAT, FORMAT + 5);
+	writeChunk("IHDR", header.data(), static_cast<uint32_t>(header.size()));
+
+	auto adler = chunks[0].adler;
+	for (UINT i = 0; i < count; i++) {
+		out->insert(out->end(), chunks[i].idat.begin(), chunks[i].idat.end());
+		adler = i > 0 ? adler32Combine(adler, chunks[i].adler, chunks[i].size) : adler;
+	}
+	std::vector<BYTE> trailer;
+	appendBigEndian(trailer, adler);
+	writeChunk("IDAT", trailer.data(), 4);
+	writeChunk("IEND", nullptr, 0);
+	return S_OK;
+}
+
+// ============================================================================
+// encodeQoi
+//
+// Encodes the view into a QOI file with 4 channels and the sRGB colour space.
+//
+// Returns E_INVALIDARG if the view is null or empty.
+// Returns DXGI_ERROR_UNSUPPORTED if the format cannot be converted.
+// ============================================================================
+inline HRESULT encodeQoi(const SurfaceView& src, ThreadPool* pool, std::vector<BYTE>* out) {
+	ConvertRowFunc convertRow;
+	auto result = findRgba8Row(src, &convertRow);
+	if (FAILED(result) || out == nullptr) {
+		return out == nullptr ? E_INVALIDARG : result;
+	}
+
+	auto count = (src.height + IMAGE_CHUNK_ROWS - 1) / IMAGE_CHUNK_ROWS;
+	std::vector<std::vector<BYTE>> chunks(count);
+	forEachChunk(pool, count, [&](UINT index) {
+		auto begin = index * IMAGE_CHUNK_ROWS;
+		auto end = std::min(begin + IMAGE_CHUNK_ROWS, src.height);
+		std::vector<BYTE> rgba(static_cast<size_t>(src.width) * 4);
+		uint32_t index64[64] = {};
+		uint64_t written = 0;	// the index entries written by this chunk.
+		uint32_t previous = 0xff000000u;
+		if (begin > 0) {
+			readRgba8Row(src, convertRow, begin - 1, rgba.data());
+			std::memcpy(&previous, rgba.data() + rgba.size() - 4, 4);
+		}
+
+		auto& chunk = chunks[index];
+		chunk.reserve(rgba.size() * (end - begin) / 2);
+		UINT run = 0;
+		for (auto y = begin; y < end; y++) {
+			readRgba8Row(src, convertRow, y, rgba.data());
+			for (UINT x = 0; x < src.width; x++) {
+				uint32_t pixel;
+				std::memcpy(&pixel, rgba.data() + x * 4, 4);
+				if (pixel == previous) {
+					run++;
+					if (run == 62) {
+						chunk.push_back(static_cast<BYTE>(0xc0 | (run - 1)));
+						run = 0;
+					}
+					continue;
+				}
+				if (run > 0) {
+					chunk.push_back(static_cast<BYTE>(0xc0 | (run - 1)));
+					run = 0;
+				}
+				auto r = static_cast<BYTE>(pixel), g = static_cast<BYTE>(pixel >> 8);
+				auto b = static_cast<BYTE>(pixel >> 16), a = static_cast<BYTE>(pixel >> 24);
+				auto hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+				if ((written >> hash & 1) != 0 && index64[hash] == pixel) {
+					chunk.push_back(static_cast<BYTE>(hash));
+				} else {
+					index64[hash] = pixel;
+					written |= 1ull << hash;
+					if (a == static_cast<BYTE>(previous >> 24)) {
+						auto dr = static_cast<int8_t>(r - static_cast<BYTE>(previous));
+						auto dg = static_cast<int8_t>(g - static_cast<BYTE>(previous >> 8));
+						auto db = static_cast<int8_t>(b - static_cast<BYTE>(previous >> 16));
+						auto drg = dr - dg;
+						auto dbg = db - dg;
+						if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+							chunk.push_back(static_cast<BYTE>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+						} else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+							chunk.push_back(static_cast<BYTE>(0x80 | (dg + 32)));
+							chunk.push_back(static_cast<BYTE>((drg + 8) << 4 | (dbg + 8)));
+						} else {
+							const BYTE op[4] = { 0xfe, r, g, b };
+							chunk.insert(chunk.end(), op, op + 4);
+						}
+					} else {
+						const BYTE op[5] = { 0xff, r, g, b, a };
+						chunk.insert(chunk.end(), op, op + 5);
+					}
+				}
+				previous = pixel;
+			}
+		}
+		if (run > 0) {
+			chunk.push_back(static_cast<BYTE>(0xc0 | (run - 1)));
+		}
+	});
+
+	out->assign({ 'q', 'o', 'i', 'f' });
+	appendBigEndian(*out, src.width);
+	appendBigEndian(*out, src.height);
+	out->push_back(4);
+	out->push_back(0);
+	for (auto& chunk : chunks) {
+		out->insert(out->end(), chunk.begin(), chunk.end());
+	}
+	const BYTE END[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	out->insert(out->end(), END, END + 8);
+	return S_OK;
+}
+
+// a utility to encode the view into the image format.
+inline HRESULT encodeImage(const SurfaceView& src, ImageFormat format, ThreadPool* pool, std::vector<BYTE>* out) {
+	return format == ImageFormat::Png ? encodePng(src, pool, out) : encodeQoi(src, pool, out);
+}
+
+// a utility to write the bytes into a file (fopen is deprecated by the MSVC).
+inline HRESULT writeImageFile(const std::string& path, const std::vector<BYTE>& data) {
+#if defined(_MSC_VER)
+	FILE* file = nullptr;
+	if (fopen_s(&file, path.c_str(), "wb") != 0) {
+		file = nullptr;
+	}
+#else
+	auto file = fopen(path.c_str(), "wb");
+#endif
+	if (file == nullptr) {
+		return E_FAIL;
+	}
+	auto result = fwrite(data.data(), 1, data.size(), file) == data.size() ? S_OK : E_FAIL;
+	if (fclose(file) != 0) {
+		result = E_FAIL;
+	}
+	return result;
+}
\ No newline at end of file
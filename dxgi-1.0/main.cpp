@@ -1,590 +1,1482 @@
-#include <vector>
-
-#include "com_util.h"
-#include "dxgi_util.h"
-#include "window.h"
-
-#include <dxgi.h>
-#include <d3d10.h>
-
-#pragma comment(lib, "dxgi.lib")
-#pragma comment(lib, "d3d10.lib")
-
-using namespace Microsoft::WRL; // ComPtr
-
-constexpr int WINDOW_WIDTH = 800;
-constexpr int WINDOW_HEIGHT = 600;
-
-// ============================================================================
-// IDXGIObject
-//
-// A base DXGI object type extended by all DXGI objects.
-//
-// Has following functions:
-//   - SetPrivateData			-- Set custom data
-//   - GetPrivateData			-- Get custom data or IUnknown-interface data
-//   - SetPrivateDataInterface	-- Set IUnknown-interface data
-//   - GetParent				-- Get reference to parent
-//
-// SetPrivateData can be also used to assign a special name for the object to
-// help object debugging with WKPDID_D3DDebugObjectName (in D3Dcommon.h).
-// GetPrivateData with GUID_DeviceType can be used to query the device type
-// from the display adapter object. Do not use it to set device type manually!
-//
-// Note that IUnknown-interface queried with GetPrivateData should be freed
-// manually with the Release function as COM reference get incremented when its
-// assigned to the target IDXGIObject with the SetPrivateDataInterface and each
-// time it gets queried with the GetPrivateData.
-//
-// Note that GetParent may fail if trying to query parent of an object which
-// does not support them e.g. try what gets thrown with IDXGIFactory ;)
-// ============================================================================
-void testObject(ComPtr<IDXGIObject> object) {
-	// assign a custom data into the target DXGI object.
-	auto data = "foobar";
-	auto guid = createGUID();
-	check_hresult(object->SetPrivateData(guid, strlen(data), data));
-
-	// retrieve a custom data from a DXGI object.
-	auto size = 128u;
-	char buffer[128];
-	check_hresult(object->GetPrivateData(guid, &size, buffer));
-	printf("data: %s\n", std::string(buffer, size).c_str());
-
-	// assign a IUnknown-derived interface into the target DXGI object.
-	ComPtr<IDXGIFactory> object2;
-	check_hresult(CreateDXGIFactory(IID_PPV_ARGS(&object2)));
-	auto guid2 = createGUID();
-	printf("object2 refs before attachment: %d\n", countRefs(object2));
-	check_hresult(object->SetPrivateDataInterface(guid2, object2.Get()));
-	printf("object2 refs after attachment: %d\n", countRefs(object2));
-
-	// retrieve the interface we just put into the target DXGI object.
-	IUnknown* item;
-	auto itemSize = sizeof(IUnknown); 
-	check_hresult(object->GetPrivateData(guid2, &itemSize, &item));
-	printf("same interface: %d\n", (item == object2.Get()));
-	printf("object2 refs after getting: %d\n", countRefs(object2));
-	item->Release();
-
-	// get a reference to the parent of the target DXGI object.
-	ComPtr<IDXGIFactory> parent;
-	check_hresult(object->GetParent(IID_PPV_ARGS(&parent)));
-	printf("parent DXGIFactory refCount: %d\n", countRefs(parent));
-}
-
-// ============================================================================
-// IDXGIOutput
-//
-//   - GetDesc						-- Get information about the output
-//   - GetFrameStatistics			-- Get information about rendered frames
-//	 - GetGammaControlCapabilities	-- Get information about gamma controls
-//   - ReleaseOwnership				-- [WARNING] Release the target output
-//   - TakeOwnership				-- [WARNING] Captures the target output
-//	 - GetGammaControl				-- Get the definitions for gamma
-//	 - SetGammaControl				-- Set the definitions for gamma
-//	 - GetDisplaySurface			-- Get the display surface
-//	 - SetDisplaySurface			-- [WARNING] Set the display surface
-//	 - WaitForVBlank				-- Wait for the next vertical blank
-//	 - FindClosestMatchingMode		-- Find closest mode for desired mode
-//	 - GetDisplayModeList			-- Find the list of modes
-//
-// Note that some additional information can be gathered by querying the output
-// information with GetMonitorInfo with the DXGI_OUTPUT_DESC.HMONITOR handle.
-// Most of the information is however already present in the DXGI_OUTPUT_DESC.
-//
-// Note that the TakeOwnership and RelaseOwnership are not typically used with
-// an application that uses a swap chain to present rendering. DXGI knows how
-// to automatically perform capture and release when swap chains are used. If
-// still called manually, the application may have unpredictable behavior.
-//
-// [WARNING] Following methods can be only used when ouput is in fullscreen.
-//
-//		GetGammaControlCapabilities
-//		GetGammaControl
-//		SetGammaControl
-//		GetDisplaySurface
-//		SetDisplaySurface
-//
-// Note that SetDisplaySurface is not manually used with an application which
-// uses swap chain for presenting. DXGI knows how to automatically use them.
-// ============================================================================
-void testOutput(ComPtr<IDXGIOutput> output) {
-	// get and print information about the output.
-	DXGI_OUTPUT_DESC desc;
-	check_hresult(output->GetDesc(&desc));
-	printf("==============================================================\n");
-	printf("name:          %ls\n", desc.DeviceName);
-	printf("hasDesktop:    %s\n", boolString(desc.AttachedToDesktop));
-	printf("rotation:      %s\n", rotationString(desc.Rotation));
-	printf("desktopCoords: %s\n", rectString(desc.DesktopCoordinates).c_str());
-
-	// get additional details from the HMONITOR pointer.
-	MONITORINFOEX info = {};
-	info.cbSize = sizeof(MONITORINFOEX);
-	if (GetMonitorInfo(desc.Monitor, &info) != 0) {
-		printf("device:        %ls\n", info.szDevice);
-		printf("monitorCoords: %s\n", rectString(info.rcMonitor).c_str());
-		printf("workCoords:    %s\n", rectString(info.rcWork).c_str());
-		printf("isPrimary:     %s\n", boolString(info.dwFlags & MONITORINFOF_PRIMARY));
-	}
-
-	// wait until the output makes next vertical blank call.
-	check_hresult(output->WaitForVBlank());
-
-	// enumerate the available display modes for the target format.
-	UINT modeCount = 0;
-	auto format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	check_hresult(output->GetDisplayModeList(format, 0, &modeCount, nullptr));
-	std::vector<DXGI_MODE_DESC> modes(modeCount);
-	check_hresult(output->GetDisplayModeList(format, 0, &modeCount, &modes[0]));
-	printf("display modes for format R8G8B8A8_UNORM:\n");
-	for (auto mode : modes) {
-		printf("  %dx%d\t\t%d/%d\tscaling: %s\t\tscanline-ordering: %s\n",
-			mode.Width, mode.Height,
-			mode.RefreshRate.Numerator, mode.RefreshRate.Denominator,
-			scalingString(mode.Scaling),
-			scanlineOrderingString(mode.ScanlineOrdering)
-			);
-	}
-
-	// a utility to find the closest matching display mode for a desired mode.
-	DXGI_MODE_DESC desiredMode;
-	DXGI_MODE_DESC closestMode;
-	desiredMode.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desiredMode.Width = 800;
-	desiredMode.Height = 600;
-	desiredMode.Scaling = DXGI_MODE_SCALING_CENTERED;
-	desiredMode.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE;
-	check_hresult(output->FindClosestMatchingMode(&desiredMode, &closestMode, nullptr));
-	printf("found the following closest matching mode for R8G8B8A8 UNORM 800 x 600:\n");
-	printf("  %dx%d\t\t%d/%d\tscaling: %s\t\tscanline-ordering: %s\n",
-		closestMode.Width, closestMode.Height,
-		closestMode.RefreshRate.Numerator, closestMode.RefreshRate.Denominator,
-		scalingString(closestMode.Scaling),
-		scanlineOrderingString(closestMode.ScanlineOrdering)
-	);
-
-	// get the gamma control settings (only when fullscreen).
-	/* these can be only managed when output is in fullscreen mode
-	DXGI_GAMMA_CONTROL gammaControl;
-	check_hresult(output->GetGammaControl(&gammaControl));
-	check_hresult(output->SetGammaControl(&gammaControl));
-	*/
-
-	// get information about recently rendered frames.
-	/* check how this works.... now it just returns error
-	DXGI_FRAME_STATISTICS stats;
-	check_hresult(output->GetFrameStatistics(&stats));
-	printf("stats.presentCount:        %d\n", stats.PresentCount);
-	printf("stats.presentRefreshCount: %d\n", stats.PresentRefreshCount);
-	printf("stats.syncGPUTime:		   %lld\n", stats.SyncGPUTime.QuadPart);
-	printf("stats.syncQPCTime:		   %lld\n", stats.SyncQPCTime.QuadPart);
-	printf("stats.syncRefreshCount:    %d\n", stats.SyncRefreshCount);
-	*/
-
-	// get details about the output's gamma control capabilities (only when fullscreen).
-	/* these can be only queried when output is in fullscreen mode
-	DXGI_GAMMA_CONTROL_CAPABILITIES caps;
-	check_hresult(output->GetGammaControlCapabilities(&caps));
-	printf("gammaCaps.maxConvertedValue:     %0.2f\n", caps.MaxConvertedValue);
-	printf("gammaCaps.minConvertedValue:     %0.2f\n", caps.MinConvertedValue);
-	printf("gammaCaps.numGammaControlPoints: %d\n", caps.NumGammaControlPoints);
-	printf("gammaCaps.scaleAndOffsetSupport: %s\n", boolString(caps.ScaleAndOffsetSupported));
-	*/
-
-	// these can be only used when output is in fullscreen mode
-	// output->GetDisplaySurfaceData();
-	// output->SetDisplaySurface
-
-	// [WARNING] not testing the following methods as they have unpredictable results.
-	// output->TakeOwnership()
-	// output->ReleaseOwnership()
-}
-
-// ============================================================================
-// IDXGIAdapter
-//
-//   - EnumOutputs			 -- Enumerate attached outputs (e.g. monitors)
-//   - GetDesc				 -- Get information about the adapter
-//   - CheckInterfaceSupport -- Check if adapter supports target D3D 10 device
-//
-// Note that CheckInterfaceSupport only works when checking againts Direct3D 10
-// device interfaces (e.g. D3D10Device). If used with Direct3D 11 or later, this
-// function will return DXGI_ERROR_UNSUPPORTED (see the documentation remarks).
-// ============================================================================
-void testAdapter(ComPtr<IDXGIAdapter> adapter) {
-	// get and print information about the adapter.
-	DXGI_ADAPTER_DESC desc;
-	check_hresult(adapter->GetDesc(&desc));
-	printf("==============================================================\n");
-	printf("description:   %ls\n", desc.Description);
-	printf("vendor-id:     %d\n", desc.VendorId);
-	printf("device-id:     %d\n", desc.DeviceId);
-	printf("sub-sys-id:    %d\n", desc.SubSysId);
-	printf("revision:      %d\n", desc.Revision);
-	printf("video-memory:  %u\n", desc.DedicatedVideoMemory);
-	printf("system-memory: %u\n", desc.DedicatedSystemMemory);
-	printf("shared-memory: %u\n", desc.SharedSystemMemory);
-	printf("luid:          %d:%d\n", desc.AdapterLuid.HighPart, desc.AdapterLuid.HighPart);
-
-	// check whether the adapter supports Direct3D 10 and get the driver version.
-	LARGE_INTEGER version;
-	check_hresult(adapter->CheckInterfaceSupport(__uuidof(ID3D10Device), &version));
-	printf("D3D-10 driver: %d.%d\n", version.HighPart, version.LowPart);
-
-	// iterate over the enumerated outputs.
-	ComPtr<IDXGIOutput> output;
-	for (auto i = 0u; adapter->EnumOutputs(i, &output) != DXGI_ERROR_NOT_FOUND; i++) {
-		testOutput(output);
-	}
-}
-
-// ============================================================================
-// IDXGIFactory
-//
-//	 - CreateSoftwareAdapter	-- Create a custom software DXGI adapter
-//	 - CreateSwapChain			-- Create a swap chain
-//	 - EnumAdapters				-- Enumerate display adapters
-//	 - GetWindowAssociation		-- Return the associated window HWND
-//	 - MakeWindowAssociation	-- Specify DXGI window association flags
-//
-// DXGI allows one to specify how DXGI is listening for the events from the
-// specified window. Typical association allows user to use ALT+ENTER to toggle
-// fullscreen window mode and PRINT SCREEN to capture screenshot. This default
-// behavior can be changed by using the following flags in the association.
-//
-//	DXGI_MWA_NO_WINDOW_CHANGES	-- DXGI will not listen message queue at all.
-//  DXGI_MWA_NO_ALT_ENTER		-- DXGI will not respond to ALT-ENTER.
-//  DXGI_MWA_NO_PRINT_SCREEN	-- DXGI will not respond to PRINT SCREEN.
-//
-// Note that second call to MakeWindowAssociation makes DXGI to stop listening
-// the previously associated window. NOTE that association parameters should be
-// given to a window which is already attached to DXGI e.g. with swap chain.
-//
-// Note that GetWindowAssociation returns null even when theres an associaton.
-//
-// Note that for some reason window association has no effect in Windows 10.
-// ============================================================================
-ComPtr<IDXGISwapChain> testFactory(Window& window, ComPtr<ID3D10Device> d3dDevice) {
-	ComPtr<IDXGIDevice> dd;
-	check_hresult(d3dDevice->QueryInterface(IID_PPV_ARGS(&dd)));
-
-	ComPtr<IDXGIAdapter> da;
-	check_hresult(dd->GetParent(IID_PPV_ARGS(&da)));
-
-	ComPtr<IDXGIFactory> factory;
-	check_hresult(da->GetParent(IID_PPV_ARGS(&factory)));
-
-	// enumerate the system's available display adapters.
-	UINT index = 0;
-	ComPtr<IDXGIAdapter> adapter;
-	while (factory->EnumAdapters(index, &adapter) != DXGI_ERROR_NOT_FOUND) {
-		testAdapter(adapter);
-		index++;
-	}
-
-	// create a swap chain by associating our window to target device.
-	ComPtr<IDXGISwapChain> swapChain;
-	DXGI_SWAP_CHAIN_DESC desc = {};
-	desc.BufferCount = 2;
-	desc.BufferDesc.Width = WINDOW_WIDTH;
-	desc.BufferDesc.Height = WINDOW_HEIGHT;
-	desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desc.BufferDesc.RefreshRate.Numerator = 60;
-	desc.BufferDesc.RefreshRate.Denominator = 1;
-	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	desc.OutputWindow = window.hwnd();
-	desc.SampleDesc.Quality = 0;
-	desc.SampleDesc.Count = 1;
-	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
-	desc.Flags = 0;
-	desc.Windowed = true;
-	check_hresult(factory->CreateSwapChain(d3dDevice.Get(), &desc, &swapChain));
-
-	// define how DXGI will monitor window message queue.
-	// auto flags = DXGI_MWA_NO_ALT_ENTER;
-	// check_hresult(factory->MakeWindowAssociation(window.hwnd(), flags));
-
-	check_hresult(factory->MakeWindowAssociation(window.hwnd(), DXGI_MWA_NO_ALT_ENTER));
-
-	// factory->GetWindowAssociation
-	HWND hwnd;
-	check_hresult(factory->GetWindowAssociation(&hwnd));
-	printf("found hwnd: %s\n", (hwnd != nullptr ? "yes" : "no"));
-
-	// ... factory->CreateSoftwareAdapter is being skipped.
-	return swapChain;
-}
-
-// ============================================================================
-// IDXGIDevice
-//
-//	 - GetAdapter				-- Get the wrapped adapter
-//	 - CreateSurface			-- [WARNING] create surface
-//	 - QueryResourceResidency	-- Get info how target resources reside
-//	 - SetGPUThreadPriority		-- Set the GPU thread priority
-//	 - GetGPUThreadPriority		-- Get the GPU thread priority
-//
-// [WARNING] CreateSurface function should not be used manually. DXGI will know
-// how to use it automatically whenever there is a possible need to use it.
-//
-// GPU priorities vary from -7 to 7, where 0 presents the normal priority. Note
-// that this function should be only used when application is fully profiled to
-// ensure that it behaves as intended. Otherwise, poor render speed can occur.
-//
-// QueryResourceResidency can be used to determine how and where the target
-// resources are being currently located. These IDXGIResources can be found
-// by querying the D3D generated resource with the QueryInterface function.
-// ============================================================================
-void testDevice(ComPtr<IDXGIDevice> device, ComPtr<IDXGIResource> resource) {
-	// get a reference to the wrapped DXGI adapter interface.
-	ComPtr<IDXGIAdapter> adapter;
-	check_hresult(device->GetAdapter(&adapter));
-	printf("device-adapter found: %s\n", (adapter ? "yes" : "no"));
-
-	// get and set the GPU thread priority.
-	auto gpuPriority = 0;
-	check_hresult(device->GetGPUThreadPriority(&gpuPriority));
-	printf("device-gpu-priority:  %d\n", gpuPriority);
-	check_hresult(device->SetGPUThreadPriority(gpuPriority));
-
-	// get the residence status of the target resources.
-	IUnknown* resources = { resource.Get() };
-	DXGI_RESIDENCY residencies[1];
-	check_hresult(device->QueryResourceResidency(&resources, residencies, 1));
-	printf("resource-residency: %s\n", residencyString(residencies[0]));
-}
-
-// ============================================================================
-// IDXGIResource
-//
-//	 - GetSharedHandle		-- Get the handle to shared resource
-//	 - GetUsage				-- Get the expected resource usage
-//	 - SetEvictionPolicy	-- Set the memory eviction policy
-//	 - GetEvictionPolicy	-- Get the current memory eviction policy
-//
-// Starting from Direct3D 11.1 GetSharedHandle should not be used anymore. The
-// IDXGIResource1::CreatedSharedHandle should be used to get new shared handle.
-//
-// Note that eviction value can vary between DXGI_RRESOURCE_PRIORITY_MINIMUM to
-// DXGI_RESOURCE_EVICTION_PRIORITY_MAXIMUM. There are some existing enumeration
-// values defined, but values other than enumerations are used when approriate.
-// ============================================================================
-void testResource(ComPtr<IDXGIResource> resource) {
-	// get the handle to shared resource.
-	HANDLE handle;
-	check_hresult(resource->GetSharedHandle(&handle));
-	printf("hasSharedHandle:  %s\n", (handle ? "yes": "no"));
-
-	// get the expected resource usage.
-	DXGI_USAGE usage;
-	check_hresult(resource->GetUsage(&usage));
-	printf("usage:            %s\n", usageString(usage).c_str());
-
-	// get and set the memory eviction priority.
-	UINT evictionPriority;
-	check_hresult(resource->GetEvictionPriority(&evictionPriority));
-	printf("evictionPriority: %d\n", evictionPriority);
-	check_hresult(resource->SetEvictionPriority(evictionPriority));
-}
-
-// ============================================================================
-// IDXGISurface
-//
-//	 - GetDesc	-- Get information about the surface
-//	 - Map		-- Get data pointer and deny GPU from accessing the surface
-//	 - Unmap	-- Release data pointer and allow GPPU to access the surface
-//
-// When data is being mapped to a surface, the surface must be locked from GPU
-// access. This happens when the Map function is being used. Mapping also takes
-// an additional flags definition that is used the specify CPU read-write flags.
-//
-//		DXGI_MAP_READ		-- Allow CPU read access.
-//		DXGI_MAP_WRITE		-- Allow CPU write access.
-//		DXGI_MAP_DISCARD	-- Discard previous contents of the surface.
-//
-// Remember always to unmap mapped resources so GPU may again have access them.
-// Note that the target resource must also have CPU access flag for the access.
-// ============================================================================
-void testSurface(ComPtr<IDXGISurface> surface) {
-	// get information about the surface.
-	DXGI_SURFACE_DESC desc;
-	check_hresult(surface->GetDesc(&desc));
-	printf("==============================================================\n");
-	printf("format: %d\n", desc.Format);
-	printf("width:  %d\n", desc.Width);
-	printf("height: %d\n", desc.Height);
-	printf("sample: %d:%d\n", desc.SampleDesc.Count, desc.SampleDesc.Quality);
-
-	// map and unmap the surface to edit the surface data.
-	DXGI_MAPPED_RECT rect = {};
-	check_hresult(surface->Map(&rect, DXGI_MAP_WRITE));
-	check_hresult(surface->Unmap());
-}
-
-// ============================================================================
-// IDXGISwapChain
-//
-//	 - GetBuffer			-- Get the buffer with the target index
-//	 - GetContainingOutput	-- Get output that contains majority of the view
-//	 - GetDesc				-- Get information about the swap chain
-//	 - GetFrameStatistics	-- Get performance statics 
-//	 - GetFullscreenState	-- Get the value and ouput whether in fullscreen
-//	 - GetLastPresentCount	-- Get the count of the times Present been called
-//	 - Present				-- Present the rendered image
-//	 - ResizeBuffers		-- Resize buffers
-//	 - ResizeTarget			-- Resize the target window
-//	 - SetFullscreenState	-- Set whether to show swap chain in fullscreen
-//
-// Note that GetFrameStatistics cannot be used with swap chains which use bit-
-// block transfer (bitblt) model and draw in windowed mode. This function must
-// be only used with flip models or with swap chains which use fullscreen mode.
-// However, it seems that even with those requirements satisfied the DXGI will
-// give the DXGI_ERROR_FRAME_STATISTICS_DISJOIN error when function is called.
-//
-// Note that there may be various amount of reasons why swap chain cannot turn
-// into fullscreen mode. DXGI documentation tells following kinds of reasons.
-//
-//		1. The application is running over terminal server.
-//		2. The output window is being occluded.
-//		3. The output window does not have keyboard focus.
-//		4. Another application is already in full-screen mode.
-//
-// If DXGI_STATUS_MODE_CHANGE_IN_PROGRESS is returned from SetFullscreenState
-// the application shouldn't treat it as an error but try to switch back later.
-//
-// The ResizeTarget can be used to either resize the size of the target window
-// or to change the display mode for the application when in fullscreen mode.
-// It's useful to pick the previous swap chain desc and use it as the basis.
-//
-// Note that Present may fail due a video card being physically removed from
-// the computers or a driver upgrade for the video card has been occured. Here
-// DXGI can return any of the following kinds of errors that should be checked.
-//
-//		S_OK						-- Everything went ok
-//		DXGI_ERROR_DEVICE_RESET		-- Device failed and should be re-created
-//		DXGI_ERROR_DEVICE_REMOVED	-- Device has been removed
-//		DXGI_STATUS_OCCLUDED		-- Window content is not visible
-//		D3DDDIERR_DEVICEREMOVED		-- Device driver has been upgraded
-//
-// Note that when using ResizeBuffers, all current references to buffers should
-// be released so nothing is bound to old buffers when new buffers are created.
-// With GDI compatible swap chains, all DC:s should be released.
-// ============================================================================
-void testSwapChain(ComPtr<IDXGISwapChain> swapchain) {
-	// get information about the swap chain.
-	DXGI_SWAP_CHAIN_DESC desc;
-	check_hresult(swapchain->GetDesc(&desc));
-	printf("==============================================================\n");
-	printf("bufferCount:    %d\n", desc.BufferCount);
-	printf("bufferUsage:    %s\n", usageString(desc.BufferUsage).c_str());
-	printf("bufferFormat:   %d\n", desc.BufferDesc.Format);
-	printf("bufferWidth:    %d\n", desc.BufferDesc.Width);
-	printf("bufferHeight:   %d\n", desc.BufferDesc.Height);
-	printf("bufferScaling:  %s\n", scalingString(desc.BufferDesc.Scaling));
-	printf("bufferScanline: %s\n", scanlineOrderingString(desc.BufferDesc.ScanlineOrdering));
-	printf("flags:          %d\n", desc.Flags);
-	printf("sampleCount:    %d\n", desc.SampleDesc.Count);
-	printf("sampleQuality:  %d\n", desc.SampleDesc.Quality);
-	printf("windowed:       %s\n", boolString(desc.Windowed));
-	printf("swapEffect:     %s\n", swapEffectString(desc.SwapEffect));
-	printf("windowHWND:     %p\n", &desc.OutputWindow);
-
-	// get a reference to the swap chain buffer with the target index.
-	ComPtr<IDXGISurface> buffer;
-	check_hresult(swapchain->GetBuffer(0, IID_PPV_ARGS(&buffer)));
-
-	// get a reference which contains the majority of the view.
-	ComPtr<IDXGIOutput> output;
-	check_hresult(swapchain->GetContainingOutput(&output));
-
-	// enable fullscreen mode.
-	check_hresult(swapchain->SetFullscreenState(true, output.Get()));
-
-	// get performance statistics about the last render frame.
-	/* TODO this is not working in Windows 10 even when in fullscreen.
-	DXGI_FRAME_STATISTICS stats;
-	check_hresult(swapchain->GetFrameStatistics(&stats));
-	printf("presentCount:        %d\n", stats.PresentCount);
-	printf("presentRefreshCount: %d\n", stats.PresentRefreshCount);
-	printf("syncGPUTime:         %lld\n", stats.SyncGPUTime.QuadPart);
-	printf("syncQPCTime:         %lld\n", stats.SyncQPCTime.QuadPart);
-	printf("syncRefreshCount:    %d\n", stats.SyncRefreshCount);
-	*/
-
-	// check whether swap chain is in fullscreen and also get the associated output.
-	BOOL fullscreen;
-	check_hresult(swapchain->GetFullscreenState(&fullscreen, &output));
-	printf("isFullscreen:   %s\n", boolString(fullscreen));
-
-	// check how many time Present (or Present1) has been called.
-	UINT presentCount;
-	check_hresult(swapchain->GetLastPresentCount(&presentCount));
-	printf("presentCount:   %d\n", presentCount);
-
-	// disable fullscreen mode.
-	check_hresult(swapchain->SetFullscreenState(false, nullptr));
-
-	// resize the target window.
-	DXGI_MODE_DESC modeDesc = desc.BufferDesc;
-	modeDesc.Width = 1024;
-	modeDesc.Height = 768;
-	check_hresult(swapchain->ResizeTarget(&modeDesc));
-}
-
-int main() {
-	// Hmm... we actually seem to need a window, D3D device and D3D resource for our tests.
-	Window window(WINDOW_WIDTH, WINDOW_HEIGHT);
-	ComPtr<ID3D10Device> d3dDevice;
-	check_hresult(D3D10CreateDevice(
-		0,
-		D3D10_DRIVER_TYPE_HARDWARE,
-		nullptr,
-		D3D10_CREATE_DEVICE_DEBUG,
-		D3D10_SDK_VERSION,
-		&d3dDevice)
-	);
-	D3D10_TEXTURE2D_DESC desc = {};
-	desc.Width = WINDOW_WIDTH;
-	desc.Height = WINDOW_HEIGHT;
-	desc.MipLevels = 1;
-	desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desc.SampleDesc.Count = 1;
-	desc.Usage = D3D10_USAGE_STAGING;
-	desc.BindFlags = 0;
-	desc.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
-	ComPtr<ID3D10Texture2D> texture;
-	check_hresult(d3dDevice->CreateTexture2D(&desc, nullptr, &texture));
-	ComPtr<IDXGIResource> resource;
-	check_hresult(texture->QueryInterface(IID_PPV_ARGS(&resource)));
-	ComPtr<IDXGIDevice> device;
-	ComPtr<IDXGISurface> surface;
-	ComPtr<IDXGIAdapter> adapter;
-	check_hresult(texture.As(&surface));
-	check_hresult(d3dDevice->QueryInterface(IID_PPV_ARGS(&device)));
-	check_hresult(device->GetParent(IID_PPV_ARGS(&adapter)));
-
-	testObject(adapter);
-	testDevice(device, resource);
-	testResource(resource);
-	testSurface(surface);
-	auto swapchain = testFactory(window, d3dDevice);
-	testSwapChain(swapchain);
-
-	MSG msg;
-	while (GetMessage(&msg, NULL, 0, 0) > 0) {
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
-
-		ComPtr<IDXGIOutput> output;
-		check_hresult(swapchain->GetContainingOutput(&output));
-
-		// TODO do neat stuff...?
-
-		check_hresult(swapchain->Present(0, 0));
-	}
-	
-	return 0;
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "call_trace.h"
+#include "com_util.h"
+#include "dxgi_util.h"
+#include "duplication_engine.h"
+#include "format_convert.h"
+#include "frame_limiter.h"
+#include "frame_pipeline.h"
+#include "frame_stats.h"
+#include "gamma.h"
+#include "hdr.h"
+#include "mode_catalog.h"
+#include "private_data.h"
+#include "resampler.h"
+#include "residency_manager.h"
+#include "resize_manager.h"
+#include "resource_trimmer.h"
+#include "screenshot.h"
+#include "shared_surface.h"
+#include "soft_swap_chain.h"
+#include "staging_pool.h"
+#include "vblank_clock.h"
+#include "yuv_convert.h"
+#include "window.h"
+
+#include <dxgi.h>
+#include <d3d10.h>
+
+#pragma comment(lib, "dxgi.lib")
+#pragma comment(lib, "d3d10.lib")
+
+using namespace Microsoft::WRL; // ComPtr
+
+constexpr int WINDOW_WIDTH = 800;
+constexpr int WINDOW_HEIGHT = 600;
+
+// ============================================================================
+// IDXGIObject
+//
+// A base DXGI object type extended by all DXGI objects.
+//
+// Has following functions:
+//   - SetPrivateData			-- Set custom data
+//   - GetPrivateData			-- Get custom data or IUnknown-interface data
+//   - SetPrivateDataInterface	-- Set IUnknown-interface data
+//   - GetParent				-- Get reference to parent
+//
+// SetPrivateData can be also used to assign a special name for the object to
+// help object debugging with WKPDID_D3DDebugObjectName (in D3Dcommon.h).
+// GetPrivateData with GUID_DeviceType can be used to query the device type
+// from the display adapter object. Do not use it to set device type manually!
+//
+// Note that IUnknown-interface queried with GetPrivateData should be freed
+// manually with the Release function as COM reference get incremented when its
+// assigned to the target IDXGIObject with the SetPrivateDataInterface and each
+// time it gets queried with the GetPrivateData.
+//
+// Note that GetParent may fail if trying to query parent of an object which
+// does not support them e.g. try what gets thrown with IDXGIFactory ;)
+// ============================================================================
+void testObject(Borrowed<IDXGIObject> object) {
+	// assign a custom data into the target DXGI object.
+	auto data = "foobar";
+	auto guid = createRandomGUID();
+	check_hresult(TRACE_CALL(object->SetPrivateData(guid, strlen(data), data)));
+
+	// retrieve a custom data from a DXGI object.
+	auto size = 128u;
+	char buffer[128];
+	check_hresult(TRACE_CALL(object->GetPrivateData(guid, &size, buffer)));
+	printf("data: %s\n", std::string(buffer, size).c_str());
+
+	// assign a IUnknown-derived interface into the target DXGI object.
+	ComPtr<IDXGIFactory> object2;
+	check_hresult(TRACE_CALL(CreateDXGIFactory(IID_PPV_ARGS(&object2))));
+	auto guid2 = createRandomGUID();
+	printf("object2 refs before attachment: %d\n", countRefs(object2));
+	check_hresult(TRACE_CALL(object->SetPrivateDataInterface(guid2, object2.Get())));
+	printf("object2 refs after attachment: %d\n", countRefs(object2));
+
+	// retrieve the interface we just put into the target DXGI object.
+	IUnknown* item;
+	auto itemSize = sizeof(IUnknown); 
+	check_hresult(TRACE_CALL(object->GetPrivateData(guid2, &itemSize, &item)));
+	printf("same interface: %d\n", (item == object2.Get()));
+	printf("object2 refs after getting: %d\n", countRefs(object2));
+	item->Release();
+
+	// get a reference to the parent of the target DXGI object.
+	ComPtr<IDXGIFactory> parent;
+	check_hresult(TRACE_CALL(object->GetParent(IID_PPV_ARGS(&parent))));
+	printf("parent DXGIFactory refCount: %d\n", countRefs(parent));
+}
+
+// ============================================================================
+// PrivateDataStore
+//
+// A portable version of the private data functions of the IDXGIObject. The
+// store holds a reference into the attached interfaces just like the DXGI, so
+// the reference counts printed here should behave as in the testObject above.
+// ============================================================================
+void testPrivateDataStore(Borrowed<IUnknown> object) {
+	PrivateDataStore store;
+	auto name = "debug-name";
+	auto guid = createRandomGUID();
+	check_hresult(TRACE_CALL(store.SetPrivateData(guid, static_cast<UINT>(strlen(name)), name)));
+
+	char buffer[PrivateDataStore::INLINE_CAPACITY];
+	auto size = static_cast<UINT>(sizeof(buffer));
+	check_hresult(TRACE_CALL(store.GetPrivateData(guid, &size, buffer)));
+	printf("data: %s\n", std::string(buffer, size).c_str());
+
+	auto guid2 = createRandomGUID();
+	printf("object refs before attachment: %d\n", countRefs(object));
+	check_hresult(TRACE_CALL(store.SetPrivateDataInterface(guid2, object.get())));
+	printf("object refs after attachment: %d\n", countRefs(object));
+	store.clear();
+	printf("object refs after clear: %d\n", countRefs(object));
+}
+
+// ============================================================================
+// IDXGIOutput
+//
+//   - GetDesc						-- Get information about the output
+//   - GetFrameStatistics			-- Get information about rendered frames
+//	 - GetGammaControlCapabilities	-- Get information about gamma controls
+//   - ReleaseOwnership				-- [WARNING] Release the target output
+//   - TakeOwnership				-- [WARNING] Captures the target output
+//	 - GetGammaControl				-- Get the definitions for gamma
+//	 - SetGammaControl				-- Set the definitions for gamma
+//	 - GetDisplaySurface			-- Get the display surface
+//	 - SetDisplaySurface			-- [WARNING] Set the display surface
+//	 - WaitForVBlank				-- Wait for the next vertical blank
+//	 - FindClosestMatchingMode		-- Find closest mode for desired mode
+//	 - GetDisplayModeList			-- Find the list of modes
+//
+// Note that some additional information can be gathered by querying the output
+// information with GetMonitorInfo with the DXGI_OUTPUT_DESC.HMONITOR handle.
+// Most of the information is however already present in the DXGI_OUTPUT_DESC.
+//
+// Note that the TakeOwnership and RelaseOwnership are not typically used with
+// an application that uses a swap chain to present rendering. DXGI knows how
+// to automatically perform capture and release when swap chains are used. If
+// still called manually, the application may have unpredictable behavior.
+//
+// [WARNING] Following methods can be only used when ouput is in fullscreen.
+//
+//		GetGammaControlCapabilities
+//		GetGammaControl
+//		SetGammaControl
+//		GetDisplaySurface
+//		SetDisplaySurface
+//
+// Note that SetDisplaySurface is not manually used with an application which
+// uses swap chain for presenting. DXGI knows how to automatically use them.
+// ============================================================================
+// a utility to find the display mode which the output currently uses for the desktop.
+HRESULT findDesktopMode(Borrowed<IDXGIOutput> output, DXGI_MODE_DESC* mode) {
+	DXGI_OUTPUT_DESC desc;
+	auto result = output->GetDesc(&desc);
+	if (FAILED(result)) {
+		return result;
+	}
+	DEVMODEW devMode = {};
+	devMode.dmSize = sizeof(devMode);
+	if (EnumDisplaySettingsW(desc.DeviceName, ENUM_CURRENT_SETTINGS, &devMode) == 0) {
+		return DXGI_ERROR_NOT_FOUND;
+	}
+	// the display frequencies 0 and 1 stand for the hardware default rate.
+	DXGI_MODE_DESC desired = {};
+	desired.Width = devMode.dmPelsWidth;
+	desired.Height = devMode.dmPelsHeight;
+	desired.RefreshRate.Numerator = devMode.dmDisplayFrequency > 1 ? devMode.dmDisplayFrequency : 0;
+	desired.RefreshRate.Denominator = devMode.dmDisplayFrequency > 1 ? 1 : 0;
+	desired.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	return output->FindClosestMatchingMode(&desired, mode, nullptr);
+}
+
+void testOutput(Borrowed<IDXGIOutput> output) {
+	// get and print information about the output.
+	DXGI_OUTPUT_DESC desc;
+	check_hresult(TRACE_CALL(output->GetDesc(&desc)));
+	QpcTimeSource time;
+	printf("==============================================================\n");
+	printf("name:          %ls\n", desc.DeviceName);
+	printf("hasDesktop:    %s\n", boolString(desc.AttachedToDesktop));
+	printf("rotation:      %s\n", rotationString(desc.Rotation));
+	printf("desktopCoords: %s\n", rectString(desc.DesktopCoordinates).c_str());
+
+	// get additional details from the HMONITOR pointer.
+	MONITORINFOEX info = {};
+	info.cbSize = sizeof(MONITORINFOEX);
+	if (GetMonitorInfo(desc.Monitor, &info) != 0) {
+		printf("device:        %ls\n", info.szDevice);
+		printf("monitorCoords: %s\n", rectString(info.rcMonitor).c_str());
+		printf("workCoords:    %s\n", rectString(info.rcWork).c_str());
+		printf("isPrimary:     %s\n", boolString(info.dwFlags & MONITORINFOF_PRIMARY));
+	}
+
+	// wait until the output makes next vertical blank call.
+	check_hresult(TRACE_CALL(output->WaitForVBlank()));
+
+	// estimate the true refresh period from the observed vblanks (the desktop mode rate is only a prior).
+	DXGI_MODE_DESC desktopMode;
+	check_hresult(TRACE_CALL(findDesktopMode(output, &desktopMode)));
+	OutputVBlankSource vblanks(output.get(), time);
+	VBlankClock clock(time.frequency(), desktopMode.RefreshRate);
+	while (!clock.locked()) {
+		int64_t ticks;
+		check_hresult(TRACE_CALL(vblanks.WaitForVBlank(&ticks)));
+		clock.addSample(ticks);
+	}
+	printf("refreshPeriod: %0.4f ms (nominal %0.4f ms)\n",
+		clock.period() * 1000.0 / time.frequency(), clock.nominalPeriod() * 1000.0 / time.frequency());
+
+	// wake up half a millisecond before the predicted vblank and check how close it was.
+	PreciseWaiter waiter(time);
+	auto vblank = waitBeforeVBlank(clock, waiter, time.frequency() / 2000);
+	auto woke = time.now();
+	int64_t observed;
+	check_hresult(TRACE_CALL(vblanks.WaitForVBlank(&observed)));
+	printf("vblankLead:    %0.3f ms (predicted %0.3f ms)\n",
+		ticksToMillis(observed - woke, time.frequency()), ticksToMillis(vblank - woke, time.frequency()));
+
+	// enumerate the available display modes for all formats just once.
+	DisplayModeCatalog catalog(output.get());
+	auto range = catalog.findRange(DXGI_FORMAT_R8G8B8A8_UNORM);
+	printf("display modes for all formats: %zu\n", catalog.size());
+	printf("display modes for format R8G8B8A8_UNORM:\n");
+	for (auto i = range.first; i < range.second; i++) {
+		auto mode = catalog.mode(i);
+		printf("  %dx%d\t\t%d/%d\tscaling: %s\t\tscanline-ordering: %s\n",
+			mode.Width, mode.Height,
+			mode.RefreshRate.Numerator, mode.RefreshRate.Denominator,
+			scalingString(mode.Scaling),
+			scanlineOrderingString(mode.ScanlineOrdering)
+			);
+	}
+
+	// a utility to find the closest matching display mode for a desired mode.
+	DXGI_MODE_DESC desiredMode = {};
+	DXGI_MODE_DESC closestMode;
+	desiredMode.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desiredMode.Width = 800;
+	desiredMode.Height = 600;
+	desiredMode.Scaling = DXGI_MODE_SCALING_CENTERED;
+	desiredMode.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE;
+	check_hresult(TRACE_CALL(output->FindClosestMatchingMode(&desiredMode, &closestMode, nullptr)));
+	printf("found the following closest matching mode for R8G8B8A8 UNORM 800 x 600:\n");
+	printf("  %dx%d\t\t%d/%d\tscaling: %s\t\tscanline-ordering: %s\n",
+		closestMode.Width, closestMode.Height,
+		closestMode.RefreshRate.Numerator, closestMode.RefreshRate.Denominator,
+		scalingString(closestMode.Scaling),
+		scanlineOrderingString(closestMode.ScanlineOrdering)
+	);
+
+	// the same query can be resolved in-process with the catalog.
+	check_hresult(TRACE_CALL(catalog.findClosest(desiredMode, &closestMode)));
+	printf("catalog found the following closest matching mode:\n");
+	printf("  %dx%d\t\t%d/%d\tscaling: %s\t\tscanline-ordering: %s\n",
+		closestMode.Width, closestMode.Height,
+		closestMode.RefreshRate.Numerator, closestMode.RefreshRate.Denominator,
+		scalingString(closestMode.Scaling),
+		scanlineOrderingString(closestMode.ScanlineOrdering)
+	);
+
+	// compare the cost of the DXGI round-trips against the in-process catalog.
+	const auto queries = 1000;
+	auto start = time.now();
+	for (auto i = 0; i < queries; i++) {
+		check_hresult(TRACE_CALL(output->FindClosestMatchingMode(&desiredMode, &closestMode, nullptr)));
+	}
+	auto dxgiTicks = time.now() - start;
+	start = time.now();
+	for (auto i = 0; i < queries; i++) {
+		check_hresult(TRACE_CALL(catalog.findClosest(desiredMode, &closestMode)));
+	}
+	auto catalogTicks = time.now() - start;
+	printf("FindClosestMatchingMode: %0.3f us/query\n", ticksToMillis(dxgiTicks, time.frequency()) * 1000.0 / queries);
+	printf("catalog.findClosest:     %0.3f us/query\n", ticksToMillis(catalogTicks, time.frequency()) * 1000.0 / queries);
+
+	// get the gamma control settings (only when fullscreen).
+	/* these can be only managed when output is in fullscreen mode
+	DXGI_GAMMA_CONTROL_CAPABILITIES gammaCaps;
+	check_hresult(TRACE_CALL(output->GetGammaControlCapabilities(&gammaCaps)));
+	DXGI_GAMMA_CONTROL gammaControl;
+	check_hresult(TRACE_CALL(output->GetGammaControl(&gammaControl)));
+	check_hresult(TRACE_CALL(buildGammaControl(GammaCurve::srgb(), &gammaCaps, &gammaControl)));
+	check_hresult(TRACE_CALL(output->SetGammaControl(&gammaControl)));
+	*/
+
+	// get information about recently rendered frames.
+	/* check how this works.... now it just returns error
+	DXGI_FRAME_STATISTICS stats;
+	check_hresult(TRACE_CALL(output->GetFrameStatistics(&stats)));
+	printf("stats.presentCount:        %d\n", stats.PresentCount);
+	printf("stats.presentRefreshCount: %d\n", stats.PresentRefreshCount);
+	printf("stats.syncGPUTime:		   %lld\n", stats.SyncGPUTime.QuadPart);
+	printf("stats.syncQPCTime:		   %lld\n", stats.SyncQPCTime.QuadPart);
+	printf("stats.syncRefreshCount:    %d\n", stats.SyncRefreshCount);
+	*/
+
+	// get details about the output's gamma control capabilities (only when fullscreen).
+	/* these can be only queried when output is in fullscreen mode
+	DXGI_GAMMA_CONTROL_CAPABILITIES caps;
+	check_hresult(TRACE_CALL(output->GetGammaControlCapabilities(&caps)));
+	printf("gammaCaps.maxConvertedValue:     %0.2f\n", caps.MaxConvertedValue);
+	printf("gammaCaps.minConvertedValue:     %0.2f\n", caps.MinConvertedValue);
+	printf("gammaCaps.numGammaControlPoints: %d\n", caps.NumGammaControlPoints);
+	printf("gammaCaps.scaleAndOffsetSupport: %s\n", boolString(caps.ScaleAndOffsetSupported));
+	*/
+
+	// these can be only used when output is in fullscreen mode
+	// output->GetDisplaySurfaceData();
+	// output->SetDisplaySurface
+
+	// [WARNING] not testing the following methods as they have unpredictable results.
+	// output->TakeOwnership()
+	// output->ReleaseOwnership()
+}
+
+// ============================================================================
+// IDXGIAdapter
+//
+//   - EnumOutputs			 -- Enumerate attached outputs (e.g. monitors)
+//   - GetDesc				 -- Get information about the adapter
+//   - CheckInterfaceSupport -- Check if adapter supports target D3D 10 device
+//
+// Note that CheckInterfaceSupport only works when checking againts Direct3D 10
+// device interfaces (e.g. D3D10Device). If used with Direct3D 11 or later, this
+// function will return DXGI_ERROR_UNSUPPORTED (see the documentation remarks).
+// ============================================================================
+void testAdapter(Borrowed<IDXGIAdapter> adapter) {
+	// get and print information about the adapter.
+	DXGI_ADAPTER_DESC desc;
+	check_hresult(TRACE_CALL(adapter->GetDesc(&desc)));
+	printf("==============================================================\n");
+	printf("description:   %ls\n", desc.Description);
+	printf("vendor-id:     %d\n", desc.VendorId);
+	printf("device-id:     %d\n", desc.DeviceId);
+	printf("sub-sys-id:    %d\n", desc.SubSysId);
+	printf("revision:      %d\n", desc.Revision);
+	printf("video-memory:  %u\n", desc.DedicatedVideoMemory);
+	printf("system-memory: %u\n", desc.DedicatedSystemMemory);
+	printf("shared-memory: %u\n", desc.SharedSystemMemory);
+	printf("luid:          %d:%d\n", desc.AdapterLuid.HighPart, desc.AdapterLuid.HighPart);
+
+	// check whether the adapter supports Direct3D 10 and get the driver version.
+	LARGE_INTEGER version;
+	check_hresult(TRACE_CALL(adapter->CheckInterfaceSupport(__uuidof(ID3D10Device), &version)));
+	printf("D3D-10 driver: %d.%d\n", version.HighPart, version.LowPart);
+
+	// get the video memory budget of this process (DXGI 1.4, Windows 10).
+	ComPtr<IDXGIAdapter3> adapter3;
+	if (SUCCEEDED(adapter->QueryInterface(IID_PPV_ARGS(&adapter3)))) {
+		AdapterBudgetSource budget(adapter3.Get());
+		DXGI_QUERY_VIDEO_MEMORY_INFO info;
+		check_hresult(TRACE_CALL(budget.QueryVideoMemoryInfo(&info)));
+		printf("budget:        %llu MB\n", info.Budget / (1024 * 1024));
+		printf("usage:         %llu MB\n", info.CurrentUsage / (1024 * 1024));
+	}
+
+	// iterate over the enumerated outputs.
+	ComPtr<IDXGIOutput> output;
+	for (auto i = 0u; adapter->EnumOutputs(i, &output) != DXGI_ERROR_NOT_FOUND; i++) {
+		testOutput(output);
+	}
+}
+
+// ============================================================================
+// IDXGIFactory
+//
+//	 - CreateSoftwareAdapter	-- Create a custom software DXGI adapter
+//	 - CreateSwapChain			-- Create a swap chain
+//	 - EnumAdapters				-- Enumerate display adapters
+//	 - GetWindowAssociation		-- Return the associated window HWND
+//	 - MakeWindowAssociation	-- Specify DXGI window association flags
+//
+// DXGI allows one to specify how DXGI is listening for the events from the
+// specified window. Typical association allows user to use ALT+ENTER to toggle
+// fullscreen window mode and PRINT SCREEN to capture screenshot. This default
+// behavior can be changed by using the following flags in the association.
+//
+//	DXGI_MWA_NO_WINDOW_CHANGES	-- DXGI will not listen message queue at all.
+//  DXGI_MWA_NO_ALT_ENTER		-- DXGI will not respond to ALT-ENTER.
+//  DXGI_MWA_NO_PRINT_SCREEN	-- DXGI will not respond to PRINT SCREEN.
+//
+// Note that second call to MakeWindowAssociation makes DXGI to stop listening
+// the previously associated window. NOTE that association parameters should be
+// given to a window which is already attached to DXGI e.g. with swap chain.
+//
+// Note that GetWindowAssociation returns null even when theres an associaton.
+//
+// Note that for some reason window association has no effect in Windows 10.
+// ============================================================================
+ComPtr<IDXGISwapChain> testFactory(Window& window, Borrowed<ID3D10Device> d3dDevice) {
+	ComPtr<IDXGIDevice> dd;
+	check_hresult(TRACE_CALL(d3dDevice->QueryInterface(IID_PPV_ARGS(&dd))));
+
+	ComPtr<IDXGIAdapter> da;
+	check_hresult(TRACE_CALL(dd->GetParent(IID_PPV_ARGS(&da))));
+
+	ComPtr<IDXGIFactory> factory;
+	check_hresult(TRACE_CALL(da->GetParent(IID_PPV_ARGS(&factory))));
+
+	// enumerate the system's available display adapters.
+	UINT index = 0;
+	ComPtr<IDXGIAdapter> adapter;
+	while (factory->EnumAdapters(index, &adapter) != DXGI_ERROR_NOT_FOUND) {
+		testAdapter(adapter);
+		index++;
+	}
+
+	// create a swap chain by associating our window to target device.
+	ComPtr<IDXGISwapChain> swapChain;
+	DXGI_SWAP_CHAIN_DESC desc = {};
+	desc.BufferCount = 2;
+	desc.BufferDesc.Width = WINDOW_WIDTH;
+	desc.BufferDesc.Height = WINDOW_HEIGHT;
+	desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.BufferDesc.RefreshRate.Numerator = 60;
+	desc.BufferDesc.RefreshRate.Denominator = 1;
+	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	desc.OutputWindow = window.hwnd();
+	desc.SampleDesc.Quality = 0;
+	desc.SampleDesc.Count = 1;
+	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+	desc.Flags = 0;
+	desc.Windowed = true;
+	check_hresult(TRACE_CALL(factory->CreateSwapChain(d3dDevice.get(), &desc, &swapChain)));
+
+	// define how DXGI will monitor window message queue.
+	// auto flags = DXGI_MWA_NO_ALT_ENTER;
+	// check_hresult(TRACE_CALL(factory->MakeWindowAssociation(window.hwnd(), flags)));
+
+	// PRINT SCREEN is handled by the ScreenshotPipeline of the present sink instead.
+	check_hresult(TRACE_CALL(factory->MakeWindowAssociation(window.hwnd(), DXGI_MWA_NO_ALT_ENTER | DXGI_MWA_NO_PRINT_SCREEN)));
+
+	// factory->GetWindowAssociation
+	HWND hwnd;
+	check_hresult(TRACE_CALL(factory->GetWindowAssociation(&hwnd)));
+	printf("found hwnd: %s\n", (hwnd != nullptr ? "yes" : "no"));
+
+	// ... factory->CreateSoftwareAdapter is being skipped.
+	return swapChain;
+}
+
+// ============================================================================
+// IDXGIDevice
+//
+//	 - GetAdapter				-- Get the wrapped adapter
+//	 - CreateSurface			-- [WARNING] create surface
+//	 - QueryResourceResidency	-- Get info how target resources reside
+//	 - SetGPUThreadPriority		-- Set the GPU thread priority
+//	 - GetGPUThreadPriority		-- Get the GPU thread priority
+//
+// [WARNING] CreateSurface function should not be used manually. DXGI will know
+// how to use it automatically whenever there is a possible need to use it.
+//
+// GPU priorities vary from -7 to 7, where 0 presents the normal priority. Note
+// that this function should be only used when application is fully profiled to
+// ensure that it behaves as intended. Otherwise, poor render speed can occur.
+//
+// QueryResourceResidency can be used to determine how and where the target
+// resources are being currently located. These IDXGIResources can be found
+// by querying the D3D generated resource with the QueryInterface function.
+// ============================================================================
+void testDevice(Borrowed<IDXGIDevice> device, Borrowed<IDXGIResource> resource) {
+	// get a reference to the wrapped DXGI adapter interface.
+	ComPtr<IDXGIAdapter> adapter;
+	check_hresult(TRACE_CALL(device->GetAdapter(&adapter)));
+	printf("device-adapter found: %s\n", (adapter ? "yes" : "no"));
+
+	// get and set the GPU thread priority.
+	auto gpuPriority = 0;
+	check_hresult(TRACE_CALL(device->GetGPUThreadPriority(&gpuPriority)));
+	printf("device-gpu-priority:  %d\n", gpuPriority);
+	check_hresult(TRACE_CALL(device->SetGPUThreadPriority(gpuPriority)));
+
+	// get the residence status of the target resources.
+	IUnknown* resources = { resource.get() };
+	DXGI_RESIDENCY residencies[1];
+	check_hresult(TRACE_CALL(device->QueryResourceResidency(&resources, residencies, 1)));
+	printf("resource-residency: %s\n", residencyString(residencies[0]));
+}
+
+// ============================================================================
+// IDXGIResource
+//
+//	 - GetSharedHandle		-- Get the handle to shared resource
+//	 - GetUsage				-- Get the expected resource usage
+//	 - SetEvictionPolicy	-- Set the memory eviction policy
+//	 - GetEvictionPolicy	-- Get the current memory eviction policy
+//
+// Starting from Direct3D 11.1 GetSharedHandle should not be used anymore. The
+// IDXGIResource1::CreatedSharedHandle should be used to get new shared handle.
+//
+// Note that eviction value can vary between DXGI_RRESOURCE_PRIORITY_MINIMUM to
+// DXGI_RESOURCE_EVICTION_PRIORITY_MAXIMUM. There are some existing enumeration
+// values defined, but values other than enumerations are used when approriate.
+// ============================================================================
+void testResource(Borrowed<IDXGIResource> resource) {
+	// get the handle to shared resource.
+	HANDLE handle;
+	check_hresult(TRACE_CALL(resource->GetSharedHandle(&handle)));
+	printf("hasSharedHandle:  %s\n", (handle ? "yes": "no"));
+
+	// get the expected resource usage.
+	DXGI_USAGE usage;
+	check_hresult(TRACE_CALL(resource->GetUsage(&usage)));
+	printf("usage:            %s\n", usageString(usage).c_str());
+
+	// get and set the memory eviction priority.
+	UINT evictionPriority;
+	check_hresult(TRACE_CALL(resource->GetEvictionPriority(&evictionPriority)));
+	printf("evictionPriority: %d\n", evictionPriority);
+	check_hresult(TRACE_CALL(resource->SetEvictionPriority(evictionPriority)));
+}
+
+// ============================================================================
+// IDXGISurface
+//
+//	 - GetDesc	-- Get information about the surface
+//	 - Map		-- Get data pointer and deny GPU from accessing the surface
+//	 - Unmap	-- Release data pointer and allow GPPU to access the surface
+//
+// When data is being mapped to a surface, the surface must be locked from GPU
+// access. This happens when the Map function is being used. Mapping also takes
+// an additional flags definition that is used the specify CPU read-write flags.
+//
+//		DXGI_MAP_READ		-- Allow CPU read access.
+//		DXGI_MAP_WRITE		-- Allow CPU write access.
+//		DXGI_MAP_DISCARD	-- Discard previous contents of the surface.
+//
+// Remember always to unmap mapped resources so GPU may again have access them.
+// Note that the target resource must also have CPU access flag for the access.
+// ============================================================================
+void testSurface(Borrowed<IDXGISurface> surface) {
+	// get information about the surface.
+	DXGI_SURFACE_DESC desc;
+	check_hresult(TRACE_CALL(surface->GetDesc(&desc)));
+	printf("==============================================================\n");
+	printf("format: %s\n", formatString(desc.Format));
+	printf("width:  %d\n", desc.Width);
+	printf("height: %d\n", desc.Height);
+	printf("sample: %d:%d\n", desc.SampleDesc.Count, desc.SampleDesc.Quality);
+
+	// build a BGRA gradient which is then converted into the surface format.
+	std::vector<BYTE> gradient(desc.Width * desc.Height * 4);
+	for (UINT y = 0; y < desc.Height; y++) {
+		for (UINT x = 0; x < desc.Width; x++) {
+			auto pixel = &gradient[(y * desc.Width + x) * 4];
+			pixel[0] = static_cast<BYTE>(x * 255 / desc.Width);
+			pixel[1] = static_cast<BYTE>(y * 255 / desc.Height);
+			pixel[2] = 0x80;
+			pixel[3] = 0xff;
+		}
+	}
+	DXGI_MAPPED_RECT source = { static_cast<INT>(desc.Width * 4), gradient.data() };
+
+	// map and unmap the surface to edit the surface data.
+	DXGI_MAPPED_RECT rect = {};
+	check_hresult(TRACE_CALL(surface->Map(&rect, DXGI_MAP_WRITE)));
+	check_hresult(TRACE_CALL(convertSurface(
+		surfaceView(source, desc.Width, desc.Height, DXGI_FORMAT_B8G8R8A8_UNORM),
+		surfaceView(rect, desc.Width, desc.Height, desc.Format))));
+
+	// apply the sRGB gamma ramp in software as the output is not in fullscreen.
+	DXGI_GAMMA_CONTROL gammaControl;
+	check_hresult(TRACE_CALL(buildGammaControl(GammaCurve::srgb(), nullptr, &gammaControl)));
+	check_hresult(TRACE_CALL(GammaLut(gammaControl).apply(surfaceView(rect, desc.Width, desc.Height, desc.Format))));
+	check_hresult(TRACE_CALL(surface->Unmap()));
+	printf("simd:   %s\n", simdLevelString(bestSimdLevel()));
+}
+
+// ============================================================================
+// StagingPool
+//
+// Streams CPU uploads through a ring of staging surfaces (see staging_pool.h)
+// instead of a single staging surface. With a single surface the CPU has to
+// wait for the GPU to finish the previous copy before each Map. Here 120 frames
+// are uploaded into a default usage texture with one and with three surfaces.
+// ============================================================================
+void testStagingPool(Borrowed<ID3D10Device> device) {
+	D3D10_TEXTURE2D_DESC desc = {};
+	desc.Width = WINDOW_WIDTH;
+	desc.Height = WINDOW_HEIGHT;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D10_USAGE_DEFAULT;
+	desc.BindFlags = D3D10_BIND_SHADER_RESOURCE;
+	ComPtr<ID3D10Texture2D> target;
+	check_hresult(TRACE_CALL(device->CreateTexture2D(&desc, nullptr, &target)));
+
+	std::vector<BYTE> pixels(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
+	DXGI_MAPPED_RECT source = { WINDOW_WIDTH * 4, pixels.data() };
+	QpcTimeSource time;
+	printf("==============================================================\n");
+	for (auto surfaces : { 1u, 3u }) {
+		D3D10StagingBackend backend(device.get());
+		StagingPool pool(backend, time, surfaces);
+		for (auto frame = 0; frame < 120; frame++) {
+			std::fill(pixels.begin(), pixels.end(), static_cast<BYTE>(frame));
+			check_hresult(TRACE_CALL(pool.upload(
+				surfaceView(source, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM),
+				DXGI_FORMAT_R8G8B8A8_UNORM,
+				[&](const StagingLease& lease) {
+					D3D10_BOX box = { 0, 0, 0, lease.width, lease.height, 1 };
+					device->CopySubresourceRegion(target.Get(), 0, 0, 0, 0, backend.texture(lease.surface), 0, &box);
+				})));
+		}
+		auto& stats = pool.stats();
+		printf("surfaces: %d\n", surfaces);
+		printf("waits:    %llu / %llu\n", stats.waits, stats.acquires);
+		printf("wait:     %.3f ms (max %.3f ms)\n",
+			ticksToMillis(stats.waitTicks, time.frequency()),
+			ticksToMillis(stats.maxWaitTicks, time.frequency()));
+	}
+}
+
+// ============================================================================
+// SharedSurface
+//
+// Hands 120 frames over between a producer and a consumer through a shared
+// surface (see shared_surface.h). The consumer opens the surface with the
+// exported handle, like another process would, and the two pass it back and
+// forth with the keys 0 and 1. The producer clears the surface and the consumer
+// composes it into its own texture, so the frame never goes through the CPU.
+// ============================================================================
+void testSharedSurface(Borrowed<ID3D10Device> device) {
+	std::shared_ptr<D3D10SharedSurface> producer;
+	std::shared_ptr<D3D10SharedSurface> consumer;
+	check_hresult(TRACE_CALL(D3D10SharedSurface::create(device.get(), WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM, &producer)));
+	check_hresult(TRACE_CALL(D3D10SharedSurface::open(device.get(), producer->sharedHandle(), &consumer)));
+	ComPtr<ID3D10RenderTargetView> view;
+	check_hresult(TRACE_CALL(device->CreateRenderTargetView(producer->texture(), nullptr, &view)));
+
+	D3D10_TEXTURE2D_DESC desc = {};
+	consumer->texture()->GetDesc(&desc);
+	desc.MiscFlags = 0;
+	ComPtr<ID3D10Texture2D> composed;
+	check_hresult(TRACE_CALL(device->CreateTexture2D(&desc, nullptr, &composed)));
+
+	printf("==============================================================\n");
+	printf("shared-handle:    %s\n", producer->sharedHandle() != nullptr ? "yes" : "no");
+	auto timeout = consumer->AcquireSync(1, 0);
+	printf("acquire-early:    %s\n", timeout == WAIT_TIMEOUT ? "timeout" : "acquired");
+
+	QpcTimeSource time;
+	auto start = time.now();
+	for (auto frame = 0; frame < 120; frame++) {
+		const FLOAT color[] = { frame / 120.0f, 0.0f, 0.0f, 1.0f };
+		check_hresult(TRACE_CALL(producer->AcquireSync(0, INFINITE)));
+		device->ClearRenderTargetView(view.Get(), color);
+		check_hresult(TRACE_CALL(producer->ReleaseSync(1)));
+		check_hresult(TRACE_CALL(consumer->AcquireSync(1, INFINITE)));
+		device->CopyResource(composed.Get(), consumer->texture());
+		check_hresult(TRACE_CALL(consumer->ReleaseSync(0)));
+	}
+	printf("handoff:          %.3f ms per frame\n", ticksToMillis(time.now() - start, time.frequency()) / 120);
+}
+
+// ============================================================================
+// IDXGISwapChain
+//
+//	 - GetBuffer			-- Get the buffer with the target index
+//	 - GetContainingOutput	-- Get output that contains majority of the view
+//	 - GetDesc				-- Get information about the swap chain
+//	 - GetFrameStatistics	-- Get performance statics 
+//	 - GetFullscreenState	-- Get the value and ouput whether in fullscreen
+//	 - GetLastPresentCount	-- Get the count of the times Present been called
+//	 - Present				-- Present the rendered image
+//	 - ResizeBuffers		-- Resize buffers
+//	 - ResizeTarget			-- Resize the target window
+//	 - SetFullscreenState	-- Set whether to show swap chain in fullscreen
+//
+// Note that GetFrameStatistics cannot be used with swap chains which use bit-
+// block transfer (bitblt) model and draw in windowed mode. This function must
+// be only used with flip models or with swap chains which use fullscreen mode.
+// However, it seems that even with those requirements satisfied the DXGI will
+// give the DXGI_ERROR_FRAME_STATISTICS_DISJOIN error when function is called.
+//
+// Note that there may be various amount of reasons why swap chain cannot turn
+// into fullscreen mode. DXGI documentation tells following kinds of reasons.
+//
+//		1. The application is running over terminal server.
+//		2. The output window is being occluded.
+//		3. The output window does not have keyboard focus.
+//		4. Another application is already in full-screen mode.
+//
+// If DXGI_STATUS_MODE_CHANGE_IN_PROGRESS is returned from SetFullscreenState
+// the application shouldn't treat it as an error but try to switch back later.
+//
+// The ResizeTarget can be used to either resize the size of the target window
+// or to change the display mode for the application when in fullscreen mode.
+// It's useful to pick the previous swap chain desc and use it as the basis.
+//
+// Note that Present may fail due a video card being physically removed from
+// the computers or a driver upgrade for the video card has been occured. Here
+// DXGI can return any of the following kinds of errors that should be checked.
+//
+//		S_OK						-- Everything went ok
+//		DXGI_ERROR_DEVICE_RESET		-- Device failed and should be re-created
+//		DXGI_ERROR_DEVICE_REMOVED	-- Device has been removed
+//		DXGI_STATUS_OCCLUDED		-- Window content is not visible
+//		D3DDDIERR_DEVICEREMOVED		-- Device driver has been upgraded
+//
+// Note that when using ResizeBuffers, all current references to buffers should
+// be released so nothing is bound to old buffers when new buffers are created.
+// With GDI compatible swap chains, all DC:s should be released.
+// ============================================================================
+void testSwapChain(Borrowed<IDXGISwapChain> swapchain) {
+	// get information about the swap chain.
+	DXGI_SWAP_CHAIN_DESC desc;
+	check_hresult(TRACE_CALL(swapchain->GetDesc(&desc)));
+	printf("==============================================================\n");
+	printf("bufferCount:    %d\n", desc.BufferCount);
+	printf("bufferUsage:    %s\n", usageString(desc.BufferUsage).c_str());
+	printf("bufferFormat:   %s\n", formatString(desc.BufferDesc.Format));
+	printf("bufferWidth:    %d\n", desc.BufferDesc.Width);
+	printf("bufferHeight:   %d\n", desc.BufferDesc.Height);
+	printf("bufferScaling:  %s\n", scalingString(desc.BufferDesc.Scaling));
+	printf("bufferScanline: %s\n", scanlineOrderingString(desc.BufferDesc.ScanlineOrdering));
+	printf("flags:          %s\n", swapChainFlagsString(desc.Flags).c_str());
+	printf("sampleCount:    %d\n", desc.SampleDesc.Count);
+	printf("sampleQuality:  %d\n", desc.SampleDesc.Quality);
+	printf("windowed:       %s\n", boolString(desc.Windowed));
+	printf("swapEffect:     %s\n", swapEffectString(desc.SwapEffect));
+	printf("windowHWND:     %p\n", &desc.OutputWindow);
+
+	// get a reference to the swap chain buffer with the target index.
+	ComPtr<IDXGISurface> buffer;
+	check_hresult(TRACE_CALL(swapchain->GetBuffer(0, IID_PPV_ARGS(&buffer))));
+
+	// get a reference which contains the majority of the view.
+	ComPtr<IDXGIOutput> output;
+	check_hresult(TRACE_CALL(swapchain->GetContainingOutput(&output)));
+
+	// enable fullscreen mode.
+	check_hresult(TRACE_CALL(swapchain->SetFullscreenState(true, output.Get())));
+
+	// get performance statistics about the last render frame.
+	/* TODO this is not working in Windows 10 even when in fullscreen.
+	DXGI_FRAME_STATISTICS stats;
+	check_hresult(TRACE_CALL(swapchain->GetFrameStatistics(&stats)));
+	printf("presentCount:        %d\n", stats.PresentCount);
+	printf("presentRefreshCount: %d\n", stats.PresentRefreshCount);
+	printf("syncGPUTime:         %lld\n", stats.SyncGPUTime.QuadPart);
+	printf("syncQPCTime:         %lld\n", stats.SyncQPCTime.QuadPart);
+	printf("syncRefreshCount:    %d\n", stats.SyncRefreshCount);
+	*/
+
+	// check whether swap chain is in fullscreen and also get the associated output.
+	BOOL fullscreen;
+	check_hresult(TRACE_CALL(swapchain->GetFullscreenState(&fullscreen, &output)));
+	printf("isFullscreen:   %s\n", boolString(fullscreen));
+
+	// check how many time Present (or Present1) has been called.
+	UINT presentCount;
+	check_hresult(TRACE_CALL(swapchain->GetLastPresentCount(&presentCount)));
+	printf("presentCount:   %d\n", presentCount);
+
+	// disable fullscreen mode.
+	check_hresult(TRACE_CALL(swapchain->SetFullscreenState(false, nullptr)));
+
+	// resize the target window.
+	DXGI_MODE_DESC modeDesc = desc.BufferDesc;
+	modeDesc.Width = 1024;
+	modeDesc.Height = 768;
+	check_hresult(TRACE_CALL(swapchain->ResizeTarget(&modeDesc)));
+
+	// resize the buffers into the new target size, as the WM_SIZE would do.
+	buffer.Reset();
+	QpcTimeSource time;
+	ResizeManager<IDXGISwapChain> resizer(swapchain.get(), time, defaultResizePolicy(time.frequency()));
+	resizer.requestResize(modeDesc.Width, modeDesc.Height);
+	check_hresult(TRACE_CALL(resizer.flush()));
+	printf("visibleSize:    %dx%d\n", resizer.width(), resizer.height());
+	printf("allocatedSize:  %dx%d\n", resizer.allocatedWidth(), resizer.allocatedHeight());
+}
+
+// ============================================================================
+// SoftwareSwapChain
+//
+// A CPU memory backed swap chain (see soft_swap_chain.h) which can be used to
+// compare how buffer counts and swap effects affect to presentation without a
+// real display hardware. Here a simulated 60 Hz output is being used with an
+// application that spends 5 ms on each frame before calling the Present.
+//
+// Note that the latency here means the time from the Present call to vblank
+// which actually shows the frame. Dropped frames were never shown at all.
+// ============================================================================
+void testSoftwareSwapChain() {
+	const DXGI_SWAP_EFFECT effects[] = {
+		DXGI_SWAP_EFFECT_SEQUENTIAL,
+		DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL,
+		DXGI_SWAP_EFFECT_FLIP_DISCARD
+	};
+	printf("==============================================================\n");
+	for (auto effect : effects) {
+		for (auto bufferCount = 2u; bufferCount <= 4u; bufferCount++) {
+			for (auto syncInterval = 0u; syncInterval <= 1u; syncInterval++) {
+				ManualTimeSource time;
+				DXGI_SWAP_CHAIN_DESC desc = {};
+				desc.BufferCount = bufferCount;
+				desc.BufferDesc.Width = WINDOW_WIDTH;
+				desc.BufferDesc.Height = WINDOW_HEIGHT;
+				desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				desc.SwapEffect = effect;
+				std::shared_ptr<SoftwareSwapChain> swapChain;
+				check_hresult(TRACE_CALL(SoftwareSwapChain::create(desc, time, &swapChain)));
+				for (auto i = 0; i < 600; i++) {
+					time.advance(5 * time.frequency() / 1000);
+					check_hresult(TRACE_CALL(swapChain->Present(syncInterval, 0)));
+				}
+
+				auto& summary = swapChain->summary();
+				auto frequency = time.frequency();
+				auto displayed = summary.displayed == 0 ? 1 : summary.displayed;
+				printf("%-16s buffers: %d sync: %d\tshown: %d\tdropped: %d\tqueue: %0.2f\tlatency: %0.2f ms\tblocked: %0.2f ms\n",
+					swapEffectString(effect), bufferCount, syncInterval,
+					summary.displayed, summary.dropped,
+					static_cast<double>(summary.totalQueueDepth) / summary.presents,
+					ticksToMillis(summary.totalLatencyTicks, frequency) / displayed,
+					ticksToMillis(summary.totalBlockedTicks, frequency) / summary.presents
+				);
+			}
+		}
+	}
+}
+
+// ============================================================================
+// ResidencyManager
+//
+// Simulates an application which streams through 200 textures (1.4 GB) with a
+// sliding working set of 61 textures, while another application takes 700 MB
+// more of the 1.5 GB video memory budget between the frames 300 and 900. The
+// eviction policies (see residency_manager.h) are compared by the amount of
+// stalls, i.e. textures that had to be restored when they were needed.
+// ============================================================================
+void testResidencyManager() {
+	const UINT64 MB = 1024 * 1024;
+	printf("==============================================================\n");
+	for (auto policy : { EvictionPolicy::Lru, EvictionPolicy::CostAware }) {
+		ManualTimeSource time;
+		SimulatedVideoMemory memory(1536 * MB);
+		ResidencyManager manager(memory, time, defaultResidencyDesc(policy));
+		std::vector<std::unique_ptr<SimulatedResource>> textures;
+		std::vector<ResidencyManager::Handle> handles;
+		for (auto i = 0; i < 200; i++) {
+			// every fourth texture is larger, and every third is expensive to restore.
+			auto size = (i % 4 == 0 ? 16 : 4) * MB;
+			auto cost = i % 3 == 0 ? 10.0 : 1.0;
+			auto restoreTicks = static_cast<int64_t>(cost * size / (4 * MB) * time.frequency() / 4000);
+			textures.push_back(std::make_unique<SimulatedResource>(memory, time, size, restoreTicks));
+			handles.push_back(manager.add(textures.back().get(), size, cost));
+		}
+
+		auto overBudget = 0;
+		for (auto frame = 0; frame < 1500; frame++) {
+			memory.setOtherUsage((frame >= 300 && frame < 900 ? 900 : 200) * MB);
+			auto center = frame / 4 % 200;
+			for (auto i = -30; i <= 30; i++) {
+				check_hresult(TRACE_CALL(manager.use(handles[(center + i + 200) % 200])));
+			}
+			check_hresult(TRACE_CALL(manager.update()));
+			overBudget += memory.usage() > memory.budget() ? 1 : 0;
+			time.advance(time.frequency() / 60);
+		}
+
+		auto& stats = manager.stats();
+		printf("%-10s evicted: %llu MB\trestored: %llu MB\tstalls: %llu (%0.1f ms)\tover budget: %d frames\n",
+			policy == EvictionPolicy::Lru ? "lru" : "cost-aware",
+			stats.evictedBytes / MB,
+			stats.restoredBytes / MB,
+			stats.stalls,
+			ticksToMillis(stats.stallTicks, time.frequency()),
+			overBudget);
+	}
+}
+
+// ============================================================================
+// ResourceTrimmer
+//
+// Simulates an application which cycles through 48 textures (192 MB) with a
+// sliding working set of 13 textures, while another application lowers the
+// memory limit to 96 MB between the frames 240 and 480. The textures live in
+// a DiscardableHeap (resource_trimmer.h), which discards the oldest offered
+// textures under the pressure, and the trimmer offers the textures which have
+// been idle for 60 frames. The re-uploaded contents are verified on each use.
+// ============================================================================
+void testResourceTrimmer() {
+	const UINT64 MB = 1024 * 1024;
+	printf("==============================================================\n");
+	for (auto trimmed : { false, true }) {
+		SteadyTimeSource time;
+		DiscardableHeap heap(256 * MB);
+		auto desc = defaultTrimmerDesc();
+		desc.idleFrames = 60;
+		ResourceTrimmer trimmer(time, desc);
+		std::vector<std::unique_ptr<HeapResource>> textures;
+		std::vector<ResourceTrimmer::Handle> handles;
+		for (auto i = 0; i < 48; i++) {
+			textures.push_back(std::make_unique<HeapResource>(heap, 4 * MB, 0x9e3779b9u * (i + 1)));
+			handles.push_back(trimmer.add(textures.back().get(), 4 * MB));
+		}
+		if (trimmed) {
+			check_hresult(TRACE_CALL(trimmer.start()));
+		}
+
+		// another application takes the memory between the frames 240 and 480.
+		auto overLimit = 0;
+		auto corrupted = 0;
+		auto next = time.now();
+		for (auto frame = 0; frame < 720; frame++) {
+			heap.setLimit((frame >= 240 && frame < 480 ? 96 : 256) * MB);
+			auto center = frame / 10;
+			for (auto i = -6; i <= 6; i++) {
+				auto index = (center + i + 48) % 48;
+				// check the contents of the textures which come back from the offer.
+				auto offered = trimmer.state(handles[index]) != OfferState::Resident;
+				check_hresult(TRACE_CALL(trimmer.use(handles[index])));
+				corrupted += offered && !textures[index]->valid() ? 1 : 0;
+			}
+			trimmer.endFrame();
+			overLimit += heap.committed() > heap.limit() ? 1 : 0;
+			next += time.frequency() / 500;
+			time.waitUntil(next);
+		}
+		trimmer.stop();
+		check_hresult(RESULT_OF(trimmer.result()));
+
+		auto stats = trimmer.stats();
+		printf("%-9s offered: %llu MB\tdiscarded: %llu MB\treclaimed: %llu\tre-uploaded: %llu (%0.1f ms)\tstalls: %llu (%0.1f ms)\tover limit: %d frames\tcorrupted: %d\n",
+			trimmed ? "trimmed" : "untrimmed",
+			stats.offeredBytes / MB,
+			stats.discardedBytes / MB,
+			stats.reclaims,
+			stats.discards,
+			ticksToMillis(stats.reuploadTicks, time.frequency()),
+			stats.stalls,
+			ticksToMillis(stats.stallTicks, time.frequency()),
+			overLimit,
+			corrupted);
+		printf("          trim passes: %llu (%0.1f us per pass)\tpeak committed: %llu MB\n",
+			stats.passes,
+			stats.passes == 0 ? 0.0 : ticksToMillis(stats.passTicks, time.frequency()) * 1000.0 / stats.passes,
+			heap.peakCommitted() / MB);
+	}
+}
+
+// ============================================================================
+// FrameLimiter
+//
+// Simulates a display at the refresh rate of the output's desktop mode where
+// the frames cost ~3 ms with a rare 6 ms spike and the input is sampled at the
+// start of each frame. A loop which starts a frame right after the previous
+// vblank shows the input a whole frame later, while the just-in-time limiter
+// (see frame_limiter.h) starts each frame only its predicted cost before the
+// deadline, trading a few misses for latency.
+// ============================================================================
+void testFrameLimiter(Borrowed<IDXGIOutput> output) {
+	DXGI_MODE_DESC desktopMode;
+	check_hresult(TRACE_CALL(findDesktopMode(output, &desktopMode)));
+	printf("==============================================================\n");
+	for (auto justInTime : { false, true }) {
+		ManualTimeSource time;
+		SyntheticVBlankSource display(time, desktopMode.RefreshRate, 0.0, 0);
+		VBlankClock clock(time.frequency(), desktopMode.RefreshRate);
+		while (!clock.locked()) {
+			int64_t ticks;
+			check_hresult(TRACE_CALL(display.WaitForVBlank(&ticks)));
+			clock.addSample(ticks);
+		}
+
+		FrameLimiterDesc desc = {};
+		desc.mode = PresentMode::VSync;
+		desc.presentLead = time.frequency() / 2000;
+		desc.safetyMargin = time.frequency() / 1000;
+		desc.percentile = 0.95;
+		FrameLimiter limiter(desc, time, &clock);
+		LatencyHistogram latency;
+		for (auto i = 0; i < 600; i++) {
+			if (justInTime) {
+				limiter.beginFrame();
+			}
+			auto start = time.now();
+			time.advance(static_cast<int64_t>(time.frequency() * (i % 50 == 0 ? 9.0 : 3.0 + i % 3 * 0.25) / 1000));
+			if (justInTime) {
+				limiter.endFrame();
+			}
+			auto shown = display.nextVBlank(time.now() + desc.presentLead - 1);
+			latency.record(static_cast<uint64_t>(shown - start));
+			if (!justInTime) {
+				time.waitUntil(shown);
+			}
+		}
+
+		auto report = latency.report();
+		printf("%-14s input-to-present p50: %0.2f ms\tp99: %0.2f ms\tmissed: %llu\n",
+			justInTime ? "just-in-time" : "after vblank",
+			ticksToMillis(report.p50, time.frequency()),
+			ticksToMillis(report.p99, time.frequency()),
+			limiter.missed());
+	}
+}
+
+// ============================================================================
+// FramePipeline
+//
+// Renders frames on worker threads and presents them on a present thread (see
+// frame_pipeline.h). Here a software swap chain with a 240 Hz refresh rate is
+// fed by two workers, whose render times vary between 1 and 6 milliseconds,
+// so that the effect of the maximum frame latency can be seen from the stage
+// timings: a higher latency hides the slow frames, but adds a queueing delay.
+// ============================================================================
+void testFramePipeline() {
+	printf("==============================================================\n");
+	for (auto latency = 1u; latency <= 4u; latency++) {
+		SteadyTimeSource time;
+		DXGI_SWAP_CHAIN_DESC desc = {};
+		desc.BufferCount = 3;
+		desc.BufferDesc.Width = WINDOW_WIDTH;
+		desc.BufferDesc.Height = WINDOW_HEIGHT;
+		desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.BufferDesc.RefreshRate.Numerator = 240;
+		desc.BufferDesc.RefreshRate.Denominator = 1;
+		desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+		std::shared_ptr<SoftwareSwapChain> swapChain;
+		check_hresult(TRACE_CALL(SoftwareSwapChain::create(desc, time, &swapChain)));
+		SoftwarePresentSink sink(*swapChain, 1);
+
+		FramePipelineDesc pipelineDesc = { WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, 2, latency };
+		FramePipeline pipeline(pipelineDesc, time, [](const PipelineFrame& frame) {
+			memset(frame.surface->data(), static_cast<int>(frame.index & 0xff), frame.surface->size());
+			std::this_thread::sleep_for(std::chrono::milliseconds(1 + frame.index * 7 % 6));
+			return S_OK;
+		}, sink);
+		check_hresult(TRACE_CALL(pipeline.start()));
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		pipeline.stop();
+		check_hresult(RESULT_OF(pipeline.result()));
+
+		auto report = pipeline.report();
+		auto frequency = time.frequency();
+		printf("latency: %d\tpresented: %llu\tdropped: %llu\tsurfaces: %llu\twait: %0.2f ms\trender: %0.2f ms\tqueue: %0.2f ms\tlatency p99: %0.2f ms\tinterval p99: %0.2f ms\n",
+			latency, report.presented, report.dropped, report.surfaces,
+			ticksToMillis(report.wait.mean, frequency),
+			ticksToMillis(report.render.mean, frequency),
+			ticksToMillis(report.queue.mean, frequency),
+			ticksToMillis(report.latency.p99, frequency),
+			ticksToMillis(report.interval.p99, frequency)
+		);
+	}
+}
+
+// ============================================================================
+// DuplicationEngine
+//
+// A CPU engine (see duplication_engine.h) which produces the same dirty and
+// move rectangles as the IDXGIOutputDuplication from consecutive frames. Here
+// a synthetic desktop contains a window whose contents scroll 24 pixels per
+// frame, which is reported as a single move rectangle and two dirty stripes.
+// ============================================================================
+void testDuplicationEngine() {
+	const UINT DOCUMENT_HEIGHT = 4096;
+	std::vector<BYTE> document(400 * DOCUMENT_HEIGHT * 4);
+	for (size_t i = 0; i < document.size(); i++) {
+		document[i] = static_cast<BYTE>((i * 2654435761u) >> 13);
+	}
+	std::vector<BYTE> desktop(WINDOW_WIDTH * WINDOW_HEIGHT * 4, 0x40);
+	DXGI_MAPPED_RECT rect = { WINDOW_WIDTH * 4, desktop.data() };
+	auto frame = surfaceView(rect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM);
+
+	printf("==============================================================\n");
+	DuplicationEngine engine(WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM);
+	for (auto i = 0u; i < 4; i++) {
+		for (auto y = 0u; y < 400; y++) {
+			auto src = &document[((i * 24 + y) % DOCUMENT_HEIGHT) * 400 * 4];
+			std::memcpy(&desktop[((100 + y) * WINDOW_WIDTH + 200) * 4], src, 400 * 4);
+		}
+		check_hresult(TRACE_CALL(engine.update(frame)));
+
+		UINT size = 0;
+		std::vector<RECT> dirtyRects(engine.dirtyRects().size());
+		std::vector<DXGI_OUTDUPL_MOVE_RECT> moveRects(engine.moveRects().size());
+		check_hresult(TRACE_CALL(engine.GetFrameDirtyRects(static_cast<UINT>(dirtyRects.size() * sizeof(RECT)), dirtyRects.data(), &size)));
+		check_hresult(TRACE_CALL(engine.GetFrameMoveRects(static_cast<UINT>(moveRects.size() * sizeof(DXGI_OUTDUPL_MOVE_RECT)), moveRects.data(), &size)));
+		printf("frame %d: %d/%d dirty tiles\n", i, engine.dirtyTiles(), engine.tileCount());
+		for (auto& move : moveRects) {
+			printf("\tmove:  (%ld, %ld) -> %s\n", move.SourcePoint.x, move.SourcePoint.y, rectString(move.DestinationRect).c_str());
+		}
+		for (auto& dirty : dirtyRects) {
+			printf("\tdirty: %s\n", rectString(dirty).c_str());
+		}
+	}
+}
+
+// ============================================================================
+// HdrConverter
+//
+// Converts a synthetic scRGB gradient (0 - 1000 nits) into an HDR10 surface
+// for a 600 nits display with the BT.2390 tone mapping and back into scRGB.
+// ============================================================================
+void testHdrConverter() {
+	std::vector<uint16_t> scrgb(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
+	for (auto i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+		auto value = floatToHalf(12.5f * (i % WINDOW_WIDTH) / (WINDOW_WIDTH - 1));
+		scrgb[i * 4] = scrgb[i * 4 + 1] = scrgb[i * 4 + 2] = value;
+		scrgb[i * 4 + 3] = floatToHalf(1.0f);
+	}
+	std::vector<uint32_t> hdr10(WINDOW_WIDTH * WINDOW_HEIGHT);
+	DXGI_MAPPED_RECT scrgbRect = { WINDOW_WIDTH * 8, reinterpret_cast<BYTE*>(scrgb.data()) };
+	DXGI_MAPPED_RECT hdr10Rect = { WINDOW_WIDTH * 4, reinterpret_cast<BYTE*>(hdr10.data()) };
+	auto scrgbView = surfaceView(scrgbRect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R16G16B16A16_FLOAT);
+	auto hdr10View = surfaceView(hdr10Rect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R10G10B10A2_UNORM);
+
+	DXGI_HDR_METADATA_HDR10 metadata = {};
+	metadata.MaxContentLightLevel = 1000;
+	auto toneMapping = ToneMapping::fromMetadata(ToneMapper::Bt2390, metadata, 600.0f);
+	check_hresult(TRACE_CALL(HdrConverter(HdrEncoding::ScRgb, HdrEncoding::Hdr10, toneMapping).convert(scrgbView, hdr10View)));
+	check_hresult(TRACE_CALL(HdrConverter(HdrEncoding::Hdr10, HdrEncoding::ScRgb).convert(hdr10View, scrgbView)));
+
+	printf("==============================================================\n");
+	printf("tone mapping:  %s (%.0f -> %.0f nits)\n", toneMapperString(toneMapping.mapper), toneMapping.contentMaxNits, toneMapping.displayMaxNits);
+	for (auto x = 0; x < WINDOW_WIDTH; x += WINDOW_WIDTH / 4) {
+		auto nits = 1000.0f * x / (WINDOW_WIDTH - 1);
+		auto pq = hdr10[x] & 0x3ff;
+		printf("%7.1f nits -> PQ %4u -> %7.1f nits\n", nits, pq, halfToFloat(scrgb[x * 4]) * SCRGB_WHITE_NITS);
+	}
+}
+
+// ============================================================================
+// YuvConverter
+//
+// Converts a synthetic RGBA gradient into NV12, P010 and YUY2 surfaces with
+// the BT.709 limited range matrix on a thread pool and back into RGBA, and
+// prints the largest channel error of the round trips.
+// ============================================================================
+void testYuvConverter() {
+	std::vector<uint32_t> rgba(WINDOW_WIDTH * WINDOW_HEIGHT);
+	for (auto y = 0; y < WINDOW_HEIGHT; y++) {
+		for (auto x = 0; x < WINDOW_WIDTH; x++) {
+			auto red = 255u * x / (WINDOW_WIDTH - 1);
+			auto green = 255u * y / (WINDOW_HEIGHT - 1);
+			rgba[y * WINDOW_WIDTH + x] = red | (green << 8) | ((255u - red) << 16) | 0xff000000u;
+		}
+	}
+	std::vector<uint32_t> result(rgba.size());
+	DXGI_MAPPED_RECT rgbaRect = { WINDOW_WIDTH * 4, reinterpret_cast<BYTE*>(rgba.data()) };
+	DXGI_MAPPED_RECT resultRect = { WINDOW_WIDTH * 4, reinterpret_cast<BYTE*>(result.data()) };
+	auto rgbaView = surfaceView(rgbaRect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM);
+	auto resultView = surfaceView(resultRect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM);
+
+	ThreadPool pool;
+	YuvConverter converter(YuvMatrix::Bt709, YuvRange::Limited);
+	printf("==============================================================\n");
+	printf("yuv:  %s %s range, %u threads, %s\n", yuvMatrixString(converter.matrix()), yuvRangeString(converter.range()),
+		pool.concurrency(), simdLevelString(bestSimdLevel()));
+	for (auto format : { DXGI_FORMAT_NV12, DXGI_FORMAT_P010, DXGI_FORMAT_YUY2 }) {
+		auto pitch = yuvRowSize(format, WINDOW_WIDTH);
+		std::vector<BYTE> yuv(yuvSurfaceSize(format, pitch, WINDOW_HEIGHT));
+		DXGI_MAPPED_RECT yuvRect = { static_cast<INT>(pitch), yuv.data() };
+		auto yuvView = surfaceView(yuvRect, WINDOW_WIDTH, WINDOW_HEIGHT, format);
+		check_hresult(TRACE_CALL(converter.convert(rgbaView, yuvView, &pool)));
+		check_hresult(TRACE_CALL(converter.convert(yuvView, resultView, &pool)));
+
+		auto maxError = 0;
+		for (size_t i = 0; i < rgba.size(); i++) {
+			for (auto shift = 0; shift < 32; shift += 8) {
+				auto error = static_cast<int>((rgba[i] >> shift) & 0xff) - static_cast<int>((result[i] >> shift) & 0xff);
+				maxError = std::max(maxError, std::abs(error));
+			}
+		}
+		printf("%-5s round trip: max error %d\n", formatString(format), maxError);
+	}
+}
+
+// ============================================================================
+// ScreenshotPipeline
+//
+// Captures every tenth of sixty synthetic frames into QOI files with memory
+// staging surfaces whose simulated copies take two milliseconds, and prints
+// the capture-to-file latencies and the cost of the captures on the present
+// thread (see screenshot.h).
+// ============================================================================
+void testScreenshotPipeline() {
+	QpcTimeSource time;
+	MemoryStagingBackend backend(time, 2 * time.frequency() / 1000);
+	ThreadPool pool;
+	std::mutex lock;
+	std::vector<ScreenshotResult> results;
+	ScreenshotDesc desc = { ImageFormat::Qoi, 3, [&](const ScreenshotResult& result) {
+		std::lock_guard<std::mutex> guard(lock);
+		results.push_back(result);
+	} };
+
+	std::vector<uint32_t> frame(WINDOW_WIDTH * WINDOW_HEIGHT);
+	ScreenshotStats stats;
+	{
+		ScreenshotPipeline screenshots(backend, pool, time, desc);
+		for (auto i = 0u; i < 60; i++) {
+			for (auto y = 0; y < WINDOW_HEIGHT; y++) {
+				for (auto x = 0; x < WINDOW_WIDTH; x++) {
+					frame[y * WINDOW_WIDTH + x] = ((x + i * 8) / 32 + y / 32) % 2 ? 0xffc04020u : 0xffe0e0e0u;
+				}
+			}
+			if (i % 10 != 0) {
+				screenshots.poll();
+				continue;
+			}
+			auto path = "screenshot-" + std::to_string(i) + ".qoi";
+			check_hresult(TRACE_CALL(screenshots.capture(WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, [&](const ScreenshotTarget& target) {
+				// the GPU would copy the back buffer here.
+				auto& surface = backend.surface(target.surface);
+				for (UINT y = 0; y < target.height; y++) {
+					memcpy(surface.data() + y * surface.pitch(), &frame[y * WINDOW_WIDTH], WINDOW_WIDTH * 4);
+				}
+			}, path)));
+		}
+		check_hresult(TRACE_CALL(screenshots.flush()));
+		stats = screenshots.stats();
+	}
+
+	printf("==============================================================\n");
+	printf("screenshots: %llu requested, %llu dropped, %llu written, %u surfaces, %u threads\n", stats.requests, stats.dropped,
+		stats.written, stats.surfaces, pool.concurrency());
+	printf("present thread: %.3f ms per call, %.3f ms at most\n",
+		ticksToMillis(stats.presentTicks, time.frequency()) / std::max<UINT64>(stats.presentCalls, 1),
+		ticksToMillis(stats.maxPresentTicks, time.frequency()));
+	for (auto& result : results) {
+		printf("\t%s: %zu bytes, encoded in %.3f ms, written %.3f ms after the capture\n", result.path.c_str(), result.bytes,
+			ticksToMillis(result.encodeTicks, time.frequency()), ticksToMillis(result.latencyTicks, time.frequency()));
+	}
+}
+
+// ============================================================================
+// Resampler
+//
+// Scales a synthetic 800 x 600 frame onto a 1920 x 1080 output as the display
+// scaler would do for each DXGI_MODE_SCALING and with the letterboxing, and
+// prints where the image lands and how long each filter takes on a pool.
+// ============================================================================
+void testResampler() {
+	const UINT OUTPUT_WIDTH = 1920;
+	const UINT OUTPUT_HEIGHT = 1080;
+	std::vector<uint32_t> frame(WINDOW_WIDTH * WINDOW_HEIGHT);
+	for (auto y = 0; y < WINDOW_HEIGHT; y++) {
+		for (auto x = 0; x < WINDOW_WIDTH; x++) {
+			frame[y * WINDOW_WIDTH + x] = (x / 16 + y / 16) % 2 ? 0xff2080e0u : 0xfff0f0f0u;
+		}
+	}
+	std::vector<uint32_t> output(OUTPUT_WIDTH * OUTPUT_HEIGHT);
+	DXGI_MAPPED_RECT frameRect = { WINDOW_WIDTH * 4, reinterpret_cast<BYTE*>(frame.data()) };
+	DXGI_MAPPED_RECT outputRect = { OUTPUT_WIDTH * 4, reinterpret_cast<BYTE*>(output.data()) };
+	auto frameView = surfaceView(frameRect, WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM);
+	auto outputView = surfaceView(outputRect, OUTPUT_WIDTH, OUTPUT_HEIGHT, DXGI_FORMAT_B8G8R8A8_UNORM);
+
+	QpcTimeSource time;
+	ThreadPool pool;
+	printf("==============================================================\n");
+	printf("resampler: %ux%u -> %ux%u, %u threads, %s\n", WINDOW_WIDTH, WINDOW_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT,
+		pool.concurrency(), simdLevelString(bestSimdLevel()));
+	for (auto scaling : { DXGI_MODE_SCALING_UNSPECIFIED, DXGI_MODE_SCALING_CENTERED, DXGI_MODE_SCALING_STRETCHED }) {
+		RECT srcRect;
+		RECT dstRect;
+		scalingRects(scalingMode(scaling), WINDOW_WIDTH, WINDOW_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT, &srcRect, &dstRect);
+		printf("%-12s -> %-11s %s\n", scalingString(scaling), scalingModeString(scalingMode(scaling)), rectString(dstRect).c_str());
+	}
+	for (auto filter : { ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3 }) {
+		// the first call builds the weight tables, which the following calls re-use.
+		Resampler resampler(ScalingMode::Letterboxed, filter);
+		check_hresult(TRACE_CALL(resampler.resample(frameView, outputView, &pool)));
+		const auto frames = 30;
+		auto start = time.now();
+		for (auto i = 0; i < frames; i++) {
+			check_hresult(TRACE_CALL(resampler.resample(frameView, outputView, &pool)));
+		}
+		printf("letterboxed %-8s: %.3f ms per frame\n", resampleFilterString(filter),
+			ticksToMillis(time.now() - start, time.frequency()) / frames);
+	}
+}
+
+// ============================================================================
+// DxgiPresentSink
+//
+// A present sink which uploads the rendered frames into the back buffer of a
+// DXGI swap chain and samples the frame statistics after each Present. It is
+// only called from the present thread of the pipeline, which is safe as the
+// device is not created with the D3D10_CREATE_DEVICE_SINGLETHREADED flag.
+//
+// A requested screenshot copies the back buffer into a readback surface of the
+// screenshot pipeline right before the Present, which never waits for it.
+// ============================================================================
+class DxgiPresentSink final : public PresentSink {
+public:
+	DxgiPresentSink(Borrowed<IDXGISwapChain> swapchain, Borrowed<ID3D10Device> device, FrameStatisticsRecorder& recorder,
+		D3D10StagingBackend& readback, ScreenshotPipeline& screenshots)
+		: mSwapChain(swapchain), mDevice(device), mRecorder(recorder), mReadback(readback), mScreenshots(screenshots),
+		mScreenshotRequested(false), mScreenshotCount(0) {}
+
+	// capture the back buffer of the next present into a file (e.g. on PRINT SCREEN).
+	void requestScreenshot() {
+		mScreenshotRequested = true;
+	}
+
+	HRESULT present(const PipelineFrame& frame) override {
+		ComPtr<ID3D10Texture2D> backBuffer;
+		auto result = TRACE_CALL(mSwapChain->GetBuffer(0, IID_PPV_ARGS(&backBuffer)));
+		if (FAILED(result)) {
+			return result;
+		}
+		mDevice->UpdateSubresource(backBuffer.Get(), 0, nullptr, frame.surface->data(), frame.surface->pitch(), 0);
+		if (mScreenshotRequested.exchange(false)) {
+			D3D10_TEXTURE2D_DESC desc;
+			backBuffer->GetDesc(&desc);
+			auto path = "screenshot-" + std::to_string(++mScreenshotCount) + ".png";
+			// a dropped capture is only traced, as the previous ones are still being written.
+			TRACE_CALL(mScreenshots.capture(desc.Width, desc.Height, desc.Format, [&](const ScreenshotTarget& target) {
+				D3D10_BOX box = { 0, 0, 0, target.width, target.height, 1 };
+				mDevice->CopySubresourceRegion(mReadback.texture(target.surface), 0, 0, 0, 0, backBuffer.Get(), 0, &box);
+			}, path));
+		} else {
+			mScreenshots.poll();
+		}
+		backBuffer.Reset();
+
+		// occluded or reset presents are not sampled, but retried with the next frame.
+		result = TRACE_CALL(mSwapChain->Present(0, 0));
+		if (classifyHresult(result) != HresultClass::Success) {
+			return result;
+		}
+
+		UINT presentCount;
+		DXGI_FRAME_STATISTICS stats = {};
+		result = TRACE_CALL(mSwapChain->GetLastPresentCount(&presentCount));
+		if (FAILED(result)) {
+			return result;
+		}
+		mRecorder.sample(presentCount, TRACE_CALL(mSwapChain->GetFrameStatistics(&stats)), stats);
+		return S_OK;
+	}
+private:
+	Borrowed<IDXGISwapChain>	mSwapChain;
+	Borrowed<ID3D10Device>		mDevice;
+	FrameStatisticsRecorder&	mRecorder;
+	D3D10StagingBackend&		mReadback;
+	ScreenshotPipeline&			mScreenshots;
+	std::atomic<bool>			mScreenshotRequested;
+	UINT						mScreenshotCount;
+};
+
+int main() {
+	// trace all the wrapped calls and write them into dxgi-1.0.trace on exit.
+	callTracer().setEnabled(true);
+
+	// Hmm... we actually seem to need a window, D3D device and D3D resource for our tests.
+	Window window(WINDOW_WIDTH, WINDOW_HEIGHT);
+	ComPtr<ID3D10Device> d3dDevice;
+	check_hresult(TRACE_CALL(D3D10CreateDevice(
+		0,
+		D3D10_DRIVER_TYPE_HARDWARE,
+		nullptr,
+		D3D10_CREATE_DEVICE_DEBUG,
+		D3D10_SDK_VERSION,
+		&d3dDevice)
+	));
+	D3D10_TEXTURE2D_DESC desc = {};
+	desc.Width = WINDOW_WIDTH;
+	desc.Height = WINDOW_HEIGHT;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D10_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+	ComPtr<ID3D10Texture2D> texture;
+	check_hresult(TRACE_CALL(d3dDevice->CreateTexture2D(&desc, nullptr, &texture)));
+	ComPtr<IDXGIResource> resource;
+	check_hresult(TRACE_CALL(texture->QueryInterface(IID_PPV_ARGS(&resource))));
+	ComPtr<IDXGIDevice> device;
+	ComPtr<IDXGISurface> surface;
+	ComPtr<IDXGIAdapter> adapter;
+	check_hresult(TRACE_CALL(texture.As(&surface)));
+	check_hresult(TRACE_CALL(d3dDevice->QueryInterface(IID_PPV_ARGS(&device))));
+	check_hresult(TRACE_CALL(device->GetParent(IID_PPV_ARGS(&adapter))));
+
+	testObject(adapter);
+	testPrivateDataStore(adapter);
+	testDevice(device, resource);
+	testResource(resource);
+	testSurface(surface);
+	testStagingPool(d3dDevice);
+	testSharedSurface(d3dDevice);
+	auto swapchain = testFactory(window, d3dDevice);
+	testSwapChain(swapchain);
+	testSoftwareSwapChain();
+	testResidencyManager();
+	testResourceTrimmer();
+	ComPtr<IDXGIOutput> output;
+	check_hresult(TRACE_CALL(adapter->EnumOutputs(0, &output)));
+	testFrameLimiter(output);
+	testFramePipeline();
+	testDuplicationEngine();
+	testHdrConverter();
+	testYuvConverter();
+	testScreenshotPipeline();
+	testResampler();
+
+	// sample the frame statistics after each present. Disjoints are only counted.
+	DXGI_SWAP_CHAIN_DESC swapchainDesc;
+	check_hresult(TRACE_CALL(swapchain->GetDesc(&swapchainDesc)));
+	QpcTimeSource time;
+	FrameStatisticsRecorder recorder(time, swapchainDesc.BufferDesc.RefreshRate);
+
+	// write the screenshots on a thread pool from surfaces which the CPU reads.
+	ThreadPool screenshotPool;
+	D3D10StagingBackend readback(d3dDevice.get(), D3D10_USAGE_STAGING, D3D10_CPU_ACCESS_READ);
+	ScreenshotPipeline screenshots(readback, screenshotPool, time);
+
+	// render and present on the pipeline threads, so that this thread only pumps the messages.
+	DxgiPresentSink sink(swapchain, d3dDevice, recorder, readback, screenshots);
+	FramePipelineDesc pipelineDesc = {
+		swapchainDesc.BufferDesc.Width,
+		swapchainDesc.BufferDesc.Height,
+		swapchainDesc.BufferDesc.Format,
+		2,
+		FramePipeline::DEFAULT_FRAME_LATENCY
+	};
+	FramePipeline pipeline(pipelineDesc, time, [](const PipelineFrame& frame) {
+		// TODO do neat stuff...?
+		memset(frame.surface->data(), static_cast<int>(frame.index & 0xff), frame.surface->size());
+		return S_OK;
+	}, sink);
+	check_hresult(TRACE_CALL(pipeline.start()));
+
+	MSG msg;
+	while (GetMessage(&msg, NULL, 0, 0) > 0) {
+		// PRINT SCREEN only sends the key up message.
+		if (msg.message == WM_KEYUP && msg.wParam == VK_SNAPSHOT) {
+			sink.requestScreenshot();
+		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+	pipeline.stop();
+	check_hresult(RESULT_OF(pipeline.result()));
+	check_hresult(TRACE_CALL(screenshots.flush()));
+	auto screenshotStats = screenshots.stats();
+
+	auto report = recorder.report();
+	auto pipelineReport = pipeline.report();
+	auto presentRetries = pipelineReport.retried;
+	printf("==============================================================\n");
+	printf("samples:        %llu\n", report.samples);
+	printf("disjoints:      %llu\n", report.disjoints);
+	printf("presentRetries: %llu\n", presentRetries);
+	printf("missedVBlanks:  %llu\n", report.missedVBlanks);
+	printf("refresh:        %0.3f ms\n", ticksToMillis(report.refreshTicks, time.frequency()));
+	printf("frameTime p50:  %0.3f ms\n", ticksToMillis(report.frameTime.p50, time.frequency()));
+	printf("frameTime p99:  %0.3f ms\n", ticksToMillis(report.frameTime.p99, time.frequency()));
+	printf("latency p50:    %0.3f ms\n", ticksToMillis(report.latency.p50, time.frequency()));
+	printf("latency p99:    %0.3f ms\n", ticksToMillis(report.latency.p99, time.frequency()));
+	printf("latency p99.9:  %0.3f ms\n", ticksToMillis(report.latency.p999, time.frequency()));
+	printf("render p99:     %0.3f ms\n", ticksToMillis(pipelineReport.render.p99, time.frequency()));
+	printf("queue p99:      %0.3f ms\n", ticksToMillis(pipelineReport.queue.p99, time.frequency()));
+	printf("present p99:    %0.3f ms\n", ticksToMillis(pipelineReport.present.p99, time.frequency()));
+	printf("screenshots:    %llu written, %llu dropped\n", screenshotStats.written, screenshotStats.dropped);
+	printf("screenshot max: %0.3f ms on the present thread\n", ticksToMillis(screenshotStats.maxPresentTicks, time.frequency()));
+
+	check_hresult(RESULT_OF(saveCallTrace("dxgi-1.0.trace")));
+	return 0;
 }
\ No newline at end of file
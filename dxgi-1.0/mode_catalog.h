@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "dxgi_shim.h"
+
+// ============================================================================
+// DisplayModeCatalog
+//
+// An in-process index of the display modes of an output. Modes for all of the
+// formats are enumerated only once and stored as a structure-of-arrays, which
+// is sorted by (format, scanline order, scaling, resolution, refresh rate).
+//
+//   - size / mode		-- Access the modes in the sorted order
+//   - findRange		-- Get the [begin, end) range of the modes of a format
+//   - findClosest		-- Resolve the closest matching mode like the DXGI
+//
+// Modes sharing the same format, scanline order and scaling are a partition
+// where each distinct resolution is a contiguous run of refresh rates. Each
+// partition also has its modes ordered by the refresh rate, so the closest
+// match costs O(P log n), where P is the (tiny) amount of partitions and n is
+// the amount of modes.
+//
+// The closest match follows the rules of the FindClosestMatchingMode. Fields
+// that are specified in the desired mode are resolved before unspecified ones
+// and similarly ranked fields are resolved in the following order.
+//
+//		1. ScanlineOrdering
+//		2. Scaling
+//		3. Format
+//		4. Resolution	-- The closest pixel count, ties go to the larger mode
+//		5. RefreshRate	-- The closest rate, ties go to the preferences below
+//
+// DXGI does not document the values picked for unspecified fields. Here the
+// progressive scanline, unspecified scaling, the lowest format, the largest
+// resolution (by pixels and then width) and the highest refresh rate are
+// preferred, in that order. The same preferences break the remaining ties.
+//
+// Note that like with DXGI, the desired Width and Height must be both either
+// zero or non-zero. The same applies to the refresh rate numerator and the
+// denominator. Otherwise DXGI_ERROR_INVALID_CALL is returned.
+// ============================================================================
+class DisplayModeCatalog final {
+public:
+	DisplayModeCatalog() = default;
+
+	explicit DisplayModeCatalog(const std::vector<DXGI_MODE_DESC>& modes) {
+		build(modes);
+	}
+
+#if defined(_WIN32)
+	// enumerate the display modes of all formats supported by the output.
+	explicit DisplayModeCatalog(IDXGIOutput* output) {
+		const UINT flags = DXGI_ENUM_MODES_INTERLACED | DXGI_ENUM_MODES_SCALING;
+		std::vector<DXGI_MODE_DESC> modes;
+		std::vector<DXGI_MODE_DESC> formatModes;
+		for (auto format = 1u; format <= DXGI_FORMAT_B4G4R4A4_UNORM; format++) {
+			// the mode list may change between the calls, so retry on MORE_DATA.
+			auto result = DXGI_ERROR_MORE_DATA;
+			UINT count = 0;
+			while (result == DXGI_ERROR_MORE_DATA) {
+				if (FAILED(output->GetDisplayModeList((DXGI_FORMAT)format, flags, &count, nullptr)) || count == 0) {
+					break;
+				}
+				formatModes.resize(count);
+				result = output->GetDisplayModeList((DXGI_FORMAT)format, flags, &count, formatModes.data());
+			}
+			if (SUCCEEDED(result) && count > 0) {
+				modes.insert(modes.end(), formatModes.begin(), formatModes.begin() + count);
+			}
+		}
+		build(modes);
+	}
+#endif
+
+	size_t size() const { return mWidths.size(); }
+
+	DXGI_MODE_DESC mode(size_t index) const {
+		DXGI_MODE_DESC mode = {};
+		mode.Width = mWidths[index];
+		mode.Height = mHeights[index];
+		mode.RefreshRate.Numerator = mRefreshNumerators[index];
+		mode.RefreshRate.Denominator = mRefreshDenominators[index];
+		mode.Format = (DXGI_FORMAT)mFormats[index];
+		mode.ScanlineOrdering = (DXGI_MODE_SCANLINE_ORDER)mScanlines[index];
+		mode.Scaling = (DXGI_MODE_SCALING)mScalings[index];
+		return mode;
+	}
+
+	// get the range of modes with the target format or an empty range.
+	std::pair<size_t, size_t> findRange(DXGI_FORMAT format) const {
+		auto begin = std::lower_bound(mFormats.begin(), mFormats.end(), (UINT)format);
+		auto end = std::upper_bound(begin, mFormats.end(), (UINT)format);
+		return { size_t(begin - mFormats.begin()), size_t(end - mFormats.begin()) };
+	}
+
+	HRESULT findClosest(const DXGI_MODE_DESC& desired, DXGI_MODE_DESC* closest) const {
+		if (closest == nullptr
+			|| (desired.Width == 0) != (desired.Height == 0)
+			|| (desired.RefreshRate.Numerator == 0) != (desired.RefreshRate.Denominator == 0)) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		if (mPartitions.empty()) {
+			return DXGI_ERROR_NOT_FOUND;
+		}
+
+		// pick the best partition by the specified fields and then by preferences.
+		auto filter = selectFilter(desired);
+		auto best = Match{};
+		auto bestPartition = &mPartitions[0];
+		for (auto& partition : mPartitions) {
+			if (!filter.accepts(partition)) {
+				continue;
+			}
+			auto match = matchPartition(partition, desired);
+			if (best.run == nullptr || isBetter(match, partition, best, *bestPartition, desired)) {
+				best = match;
+				bestPartition = &partition;
+			}
+		}
+		*closest = mode(best.index);
+		return S_OK;
+	}
+private:
+	struct Partition {
+		UINT	format;
+		UINT	scanline;
+		UINT	scaling;
+		size_t	runBegin;
+		size_t	runEnd;
+	};
+
+	// a contiguous run of modes with the same resolution in a partition.
+	struct Run {
+		uint64_t	pixels;
+		UINT		width;
+		UINT		height;
+		size_t		begin;
+		size_t		end;
+	};
+
+	struct Match {
+		const Run*	run;
+		size_t		index;
+		uint64_t	resolutionDistance;
+		double		refreshDistance;
+	};
+
+	static double refreshRate(UINT numerator, UINT denominator) {
+		return denominator == 0 ? 0.0 : static_cast<double>(numerator) / denominator;
+	}
+
+	// rank of an unspecified scanline order or scaling, smaller is preferred.
+	static UINT scanlineRank(UINT scanline) {
+		return scanline == DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE ? 0 : scanline + 1;
+	}
+
+	void build(std::vector<DXGI_MODE_DESC> modes) {
+		std::sort(modes.begin(), modes.end(), [](const DXGI_MODE_DESC& a, const DXGI_MODE_DESC& b) {
+			if (a.Format != b.Format) return a.Format < b.Format;
+			if (a.ScanlineOrdering != b.ScanlineOrdering) return a.ScanlineOrdering < b.ScanlineOrdering;
+			if (a.Scaling != b.Scaling) return a.Scaling < b.Scaling;
+			auto aPixels = uint64_t(a.Width) * a.Height;
+			auto bPixels = uint64_t(b.Width) * b.Height;
+			if (aPixels != bPixels) return aPixels < bPixels;
+			if (a.Width != b.Width) return a.Width < b.Width;
+			if (a.Height != b.Height) return a.Height < b.Height;
+			return refreshRate(a.RefreshRate.Numerator, a.RefreshRate.Denominator)
+				< refreshRate(b.RefreshRate.Numerator, b.RefreshRate.Denominator);
+		});
+
+		auto count = modes.size();
+		mFormats.resize(count);
+		mScanlines.resize(count);
+		mScalings.resize(count);
+		mWidths.resize(count);
+		mHeights.resize(count);
+		mRefreshNumerators.resize(count);
+		mRefreshDenominators.resize(count);
+		mRefreshRates.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			auto& mode = modes[i];
+			mFormats[i] = mode.Format;
+			mScanlines[i] = mode.ScanlineOrdering;
+			mScalings[i] = mode.Scaling;
+			mWidths[i] = mode.Width;
+			mHeights[i] = mode.Height;
+			mRefreshNumerators[i] = mode.RefreshRate.Numerator;
+			mRefreshDenominators[i] = mode.RefreshRate.Denominator;
+			mRefreshRates[i] = refreshRate(mode.RefreshRate.Numerator, mode.RefreshRate.Denominator);
+
+			// start a new partition and/or a resolution run when the key changes.
+			auto newPartition = i == 0
+				|| mFormats[i] != mFormats[i - 1]
+				|| mScanlines[i] != mScanlines[i - 1]
+				|| mScalings[i] != mScalings[i - 1];
+			if (newPartition) {
+				mPartitions.push_back({ mFormats[i], mScanlines[i], mScalings[i], mRuns.size(), mRuns.size() });
+			}
+			if (newPartition || mWidths[i] != mWidths[i - 1] || mHeights[i] != mHeights[i - 1]) {
+				mRuns.push_back({ uint64_t(mode.Width) * mode.Height, mode.Width, mode.Height, i, i });
+				mPartitions.back().runEnd++;
+			}
+			mRuns.back().end = i + 1;
+		}
+
+		// each partition has its modes also ordered by the refresh rate.
+		mRefreshOrder.resize(count);
+		for (auto& partition : mPartitions) {
+			auto begin = mRuns[partition.runBegin].begin;
+			auto end = mRuns[partition.runEnd - 1].end;
+			for (auto i = begin; i < end; i++) {
+				mRefreshOrder[i] = static_cast<UINT>(i);
+			}
+			std::stable_sort(mRefreshOrder.begin() + begin, mRefreshOrder.begin() + end, [this](UINT a, UINT b) {
+				return mRefreshRates[a] < mRefreshRates[b];
+			});
+		}
+	}
+
+	// specified enumeration fields filter partitions only if there is a match.
+	struct Filter {
+		bool	scanline;
+		bool	scaling;
+		bool	format;
+		UINT	scanlineValue;
+		UINT	scalingValue;
+		UINT	formatValue;
+
+		bool accepts(const Partition& partition, int fields = 3) const {
+			return (!scanline || fields < 1 || partition.scanline == scanlineValue)
+				&& (!scaling || fields < 2 || partition.scaling == scalingValue)
+				&& (!format || fields < 3 || partition.format == formatValue);
+		}
+	};
+
+	Filter selectFilter(const DXGI_MODE_DESC& desired) const {
+		Filter filter = {};
+		filter.scanlineValue = desired.ScanlineOrdering;
+		filter.scalingValue = desired.Scaling;
+		filter.formatValue = desired.Format;
+		auto anyMatch = [this, &filter](int fields) {
+			for (auto& partition : mPartitions) {
+				if (filter.accepts(partition, fields)) {
+					return true;
+				}
+			}
+			return false;
+		};
+		filter.scanline = desired.ScanlineOrdering != DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+		filter.scanline = filter.scanline && anyMatch(1);
+		filter.scaling = desired.Scaling != DXGI_MODE_SCALING_UNSPECIFIED;
+		filter.scaling = filter.scaling && anyMatch(2);
+		filter.format = desired.Format != DXGI_FORMAT_UNKNOWN;
+		filter.format = filter.format && anyMatch(3);
+		return filter;
+	}
+
+	// find the closest resolution and refresh rate within a partition.
+	Match matchPartition(const Partition& partition, const DXGI_MODE_DESC& desired) const {
+		auto first = mRuns.begin() + partition.runBegin;
+		auto last = mRuns.begin() + partition.runEnd;
+		auto match = Match{};
+		if (desired.Width != 0) {
+			// find the closest pixel count, where ties go to the larger one.
+			auto pixels = uint64_t(desired.Width) * desired.Height;
+			auto run = std::lower_bound(first, last, pixels, [](const Run& item, uint64_t pixels) {
+				return item.pixels < pixels;
+			});
+			if (run == last || (run != first && pixels - (run - 1)->pixels < run->pixels - pixels)) {
+				run--;
+			}
+			run = std::lower_bound(first, run, run->pixels, [](const Run& item, uint64_t pixels) {
+				return item.pixels < pixels;
+			});
+			match.resolutionDistance = run->pixels > pixels ? run->pixels - pixels : pixels - run->pixels;
+
+			// among the runs with the same pixel count prefer exact size, then rate and then the larger
+			// width (the later runs are wider, so they win the ties of the rate).
+			match = matchRefresh(*run, desired, match);
+			for (auto it = run + 1; it != last && it->pixels == run->pixels; ++it) {
+				auto candidate = matchRefresh(*it, desired, match);
+				if (!isExact(match, desired) && (isExact(candidate, desired) || candidate.refreshDistance <= match.refreshDistance)) {
+					match = candidate;
+				}
+			}
+			return match;
+		}
+
+		// a specified refresh rate is resolved before an unspecified resolution.
+		if (desired.RefreshRate.Numerator != 0) {
+			auto rate = refreshRate(desired.RefreshRate.Numerator, desired.RefreshRate.Denominator);
+			auto begin = mRefreshOrder.begin() + first->begin;
+			auto end = mRefreshOrder.begin() + (last - 1)->end;
+			auto byRate = [this](UINT index, double rate) { return mRefreshRates[index] < rate; };
+			// the last mode with a rate has the largest resolution.
+			auto largest = [&](double closestRate) {
+				return *(std::lower_bound(begin, end, std::nextafter(closestRate, closestRate + 1.0), byRate) - 1);
+			};
+			auto upper = std::lower_bound(begin, end, rate, byRate);
+			auto index = upper != end ? largest(mRefreshRates[*upper]) : 0;
+			if (upper == end || (upper != begin && rate - mRefreshRates[*(upper - 1)] <= mRefreshRates[*upper] - rate)) {
+				// equally close rates go to the larger resolution, and then to the higher rate.
+				auto lower = largest(mRefreshRates[*(upper - 1)]);
+				if (upper == end || rate - mRefreshRates[lower] < mRefreshRates[*upper] - rate || isLarger(lower, index)) {
+					index = lower;
+				}
+			}
+			auto closestRate = mRefreshRates[index];
+			match.run = &*(std::upper_bound(first, last, index, [](size_t index, const Run& item) {
+				return index < item.begin;
+			}) - 1);
+			match.index = index;
+			match.refreshDistance = closestRate > rate ? closestRate - rate : rate - closestRate;
+			return match;
+		}
+		return matchRefresh(*(last - 1), desired, match);
+	}
+
+	// compare the resolutions of two modes by their pixels and then widths.
+	bool isLarger(size_t a, size_t b) const {
+		auto aPixels = uint64_t(mWidths[a]) * mHeights[a];
+		auto bPixels = uint64_t(mWidths[b]) * mHeights[b];
+		return aPixels != bPixels ? aPixels > bPixels : mWidths[a] > mWidths[b];
+	}
+
+	static bool isExact(const Match& match, const DXGI_MODE_DESC& desired) {
+		return match.run->width == desired.Width && match.run->height == desired.Height;
+	}
+
+	// find the closest refresh rate from a run, as refresh rates are sorted in it.
+	Match matchRefresh(const Run& run, const DXGI_MODE_DESC& desired, Match match) const {
+		match.run = &run;
+		auto begin = mRefreshRates.begin() + run.begin;
+		auto end = mRefreshRates.begin() + run.end;
+		auto index = end - 1;
+		if (desired.RefreshRate.Numerator != 0) {
+			auto rate = refreshRate(desired.RefreshRate.Numerator, desired.RefreshRate.Denominator);
+			auto upper = std::lower_bound(begin, end, rate);
+			if (upper == end) {
+				index = upper - 1;
+			} else if (upper == begin) {
+				index = upper;
+			} else {
+				auto lower = upper - 1;
+				index = rate - *lower < *upper - rate ? lower : upper;
+			}
+			match.refreshDistance = *index > rate ? *index - rate : rate - *index;
+		}
+		match.index = static_cast<size_t>(index - mRefreshRates.begin());
+		return match;
+	}
+
+	bool isBetter(const Match& a, const Partition& aPartition, const Match& b, const Partition& bPartition, const DXGI_MODE_DESC& desired) const {
+		// specified fields first in the DXGI order.
+		if (desired.Width != 0) {
+			if (a.resolutionDistance != b.resolutionDistance) {
+				return a.resolutionDistance < b.resolutionDistance;
+			}
+			if (a.run->pixels != b.run->pixels) {
+				return a.run->pixels > b.run->pixels;
+			}
+			if (isExact(a, desired) != isExact(b, desired)) {
+				return isExact(a, desired);
+			}
+		}
+		if (desired.RefreshRate.Numerator != 0 && a.refreshDistance != b.refreshDistance) {
+			return a.refreshDistance < b.refreshDistance;
+		}
+		// then the unspecified fields in the same order.
+		if (scanlineRank(aPartition.scanline) != scanlineRank(bPartition.scanline)) {
+			return scanlineRank(aPartition.scanline) < scanlineRank(bPartition.scanline);
+		}
+		if (aPartition.scaling != bPartition.scaling) {
+			return aPartition.scaling < bPartition.scaling;
+		}
+		if (aPartition.format != bPartition.format) {
+			return aPartition.format < bPartition.format;
+		}
+		if (desired.Width == 0 && a.run->pixels != b.run->pixels) {
+			return a.run->pixels > b.run->pixels;
+		}
+		if (a.run->width != b.run->width) {
+			return a.run->width > b.run->width;
+		}
+		return mRefreshRates[a.index] > mRefreshRates[b.index];
+	}
+
+	std::vector<UINT>		mFormats;
+	std::vector<UINT>		mScanlines;
+	std::vector<UINT>		mScalings;
+	std::vector<UINT>		mWidths;
+	std::vector<UINT>		mHeights;
+	std::vector<UINT>		mRefreshNumerators;
+	std::vector<UINT>		mRefreshDenominators;
+	std::vector<double>		mRefreshRates;
+	std::vector<UINT>		mRefreshOrder;
+	std::vector<Partition>	mPartitions;
+	std::vector<Run>		mRuns;
+};
\ No newline at end of file
@@ -0,0 +1,424 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "dxgi_shim.h"
+#include "simd_util.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SSE2 is always available on x64 and it is enabled by default for x86 builds.
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PRIVATE_DATA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// ============================================================================
+// GuidGenerator
+//
+// A fast generator of random (version 4) GUIDs. Each thread has a generator
+// of its own (a xoshiro256** seeded from the std::random_device), so making a
+// new GUID takes a few nanoseconds instead of a call into the OS. Note that the
+// GUIDs are unique, but not unpredictable, so don't use them for any secrets.
+// ============================================================================
+class GuidGenerator final {
+public:
+	GuidGenerator() {
+		std::random_device device;
+		auto time = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+		auto seed = time ^ reinterpret_cast<uintptr_t>(this);
+		for (auto& state : mState) {
+			seed += 0x9e3779b97f4a7c15ull;
+			state = splitMix(seed ^ (static_cast<uint64_t>(device()) << 32 | device()));
+		}
+	}
+
+	GUID next() {
+		auto a = nextRandom();
+		auto b = nextRandom();
+		GUID guid;
+		guid.Data1 = static_cast<uint32_t>(a);
+		guid.Data2 = static_cast<uint16_t>(a >> 32);
+		guid.Data3 = static_cast<uint16_t>(((a >> 48) & 0x0fff) | 0x4000);	// version 4
+		std::memcpy(guid.Data4, &b, sizeof(guid.Data4));
+		guid.Data4[0] = static_cast<uint8_t>((guid.Data4[0] & 0x3f) | 0x80);	// RFC 4122 variant
+		return guid;
+	}
+private:
+	static uint64_t splitMix(uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+		return value ^ (value >> 31);
+	}
+
+	static uint64_t rotate(uint64_t value, int bits) {
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t nextRandom() {
+		auto result = rotate(mState[1] * 5, 7) * 9;
+		auto t = mState[1] << 17;
+		mState[2] ^= mState[0];
+		mState[3] ^= mState[1];
+		mState[1] ^= mState[2];
+		mState[0] ^= mState[3];
+		mState[2] ^= t;
+		mState[3] = rotate(mState[3], 45);
+		return result;
+	}
+
+	uint64_t mState[4];
+};
+
+// a utility to create a new random GUID with the generator of the calling thread.
+inline GUID createRandomGUID() {
+	thread_local GuidGenerator generator;
+	return generator.next();
+}
+
+// ============================================================================
+// PrivateDataStore
+//
+// A portable store for the private data of an object, which mimics the same
+// functions of the IDXGIObject. Data is copied into the store, and interfaces
+// are kept with a reference which is released when the data is replaced or
+// removed. GetPrivateData takes a new reference into the returned interface.
+//
+//   - SetPrivateData			-- Set (or remove with a null data) a copy of data
+//   - SetPrivateDataInterface	-- Set (or remove with a null) an interface
+//   - GetPrivateData			-- Get a copy of the data or the interface
+//
+// The store is an open addressing hash map in the style of the SwissTable.
+// Each slot has a control byte with 7 bits of the key hash, and the control
+// bytes of 16 slots are matched at once with SSE2 or NEON. Only the slots with
+// the matching bits are compared with the full GUID (also with a SIMD compare).
+// Payloads up to INLINE_CAPACITY bytes are kept within the 64 byte slots, so
+// the common small payloads (handles, pointers and short names) never allocate.
+// ============================================================================
+class PrivateDataStore final {
+public:
+	static constexpr UINT INLINE_CAPACITY = 40;
+
+	PrivateDataStore() : mCapacity(0), mSize(0), mUsed(0) {}
+
+	~PrivateDataStore() { clear(); }
+
+	PrivateDataStore(const PrivateDataStore&) = delete;
+	PrivateDataStore& operator=(const PrivateDataStore&) = delete;
+
+	HRESULT SetPrivateData(REFGUID name, UINT size, const void* data) {
+		if (data == nullptr) {
+			return size == 0 ? remove(name) : E_INVALIDARG;
+		}
+		// allocate before the insert, so a failure never leaves an empty entry behind.
+		BYTE* heap = nullptr;
+		if (size > INLINE_CAPACITY) {
+			heap = new (std::nothrow) BYTE[size];
+			if (heap == nullptr) {
+				return E_OUTOFMEMORY;
+			}
+			std::memcpy(heap, data, size);
+		}
+		auto entry = insert(name);
+		if (entry == nullptr) {
+			delete[] heap;
+			return E_OUTOFMEMORY;
+		}
+		releasePayload(*entry);
+		entry->size = size;
+		if (heap != nullptr) {
+			entry->kind = PayloadKind::Heap;
+			entry->heap = heap;
+		} else {
+			entry->kind = PayloadKind::Inline;
+			std::memcpy(entry->bytes, data, size);
+		}
+		return S_OK;
+	}
+
+	HRESULT SetPrivateDataInterface(REFGUID name, const IUnknown* unknown) {
+		if (unknown == nullptr) {
+			return remove(name);
+		}
+		auto entry = insert(name);
+		if (entry == nullptr) {
+			return E_OUTOFMEMORY;
+		}
+		// take the new reference first, as the old data may have the same object.
+		auto object = const_cast<IUnknown*>(unknown);
+		object->AddRef();
+		releasePayload(*entry);
+		entry->kind = PayloadKind::Interface;
+		entry->size = sizeof(IUnknown*);
+		entry->object = object;
+		return S_OK;
+	}
+
+	HRESULT GetPrivateData(REFGUID name, UINT* size, void* data) const {
+		if (size == nullptr) {
+			return E_INVALIDARG;
+		}
+		auto entry = find(name);
+		if (entry == nullptr) {
+			*size = 0;
+			return DXGI_ERROR_NOT_FOUND;
+		}
+		if (data == nullptr) {
+			*size = entry->size;
+			return S_OK;
+		}
+		if (*size < entry->size) {
+			*size = entry->size;
+			return DXGI_ERROR_MORE_DATA;
+		}
+		*size = entry->size;
+		switch (entry->kind) {
+		case PayloadKind::Interface:
+			entry->object->AddRef();
+			std::memcpy(data, &entry->object, sizeof(IUnknown*));
+			break;
+		case PayloadKind::Heap:
+			std::memcpy(data, entry->heap, entry->size);
+			break;
+		default:
+			std::memcpy(data, entry->bytes, entry->size);
+			break;
+		}
+		return S_OK;
+	}
+
+	// remove all the data and release all the interfaces.
+	void clear() {
+		for (size_t i = 0; i < mCapacity; i++) {
+			if (isFull(mControl[i])) {
+				releasePayload(mEntries[i]);
+			}
+			mControl[i] = EMPTY;
+		}
+		mSize = 0;
+		mUsed = 0;
+	}
+
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+private:
+	static constexpr uint8_t EMPTY = 0x80;
+	static constexpr uint8_t DELETED = 0xfe;
+	static constexpr size_t GROUP_SIZE = 16;
+
+	enum class PayloadKind : UINT {
+		Inline,
+		Heap,
+		Interface
+	};
+
+	struct Entry {
+		GUID		key;
+		UINT		size;
+		PayloadKind	kind;
+		union {
+			BYTE		bytes[INLINE_CAPACITY];
+			BYTE*		heap;
+			IUnknown*	object;
+		};
+	};
+
+	static_assert(sizeof(Entry) == 64, "PrivateDataStore entries must fill a cache line");
+
+	// full slots have the 7 bits of the hash, while empty and deleted have the highest bit set.
+	static bool isFull(uint8_t control) {
+		return (control & 0x80) == 0;
+	}
+
+	// a utility to hash the GUID (random GUIDs are already well distributed).
+	static uint64_t hash(REFGUID key) {
+		uint64_t words[2];
+		std::memcpy(words, &key, sizeof(words));
+		auto value = (words[0] ^ rotateWord(words[1], 29)) * 0x9e3779b97f4a7c15ull;
+		return value ^ (value >> 32);
+	}
+
+	static uint64_t rotateWord(uint64_t value, int bits) {
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static uint32_t lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+	}
+
+	// a utility to get a bit mask of the control bytes in a group which are equal to the value.
+	static uint32_t matchGroup(const uint8_t* control, uint8_t value) {
+#if defined(PRIVATE_DATA_SSE2)
+		auto group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(value)))));
+#elif defined(SIMD_NEON)
+		static const uint8_t BITS[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+		auto bits = vandq_u8(vceqq_u8(vld1q_u8(control), vdupq_n_u8(value)), vld1q_u8(BITS));
+		return vaddv_u8(vget_low_u8(bits)) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+#else
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP_SIZE; i++) {
+			mask |= (control[i] == value ? 1u : 0u) << i;
+		}
+		return mask;
+#endif
+	}
+
+	// a utility to get a bit mask of the empty or deleted control bytes in a group.
+	static uint32_t matchFree(const uint8_t* control) {
+#if defined(PRIVATE_DATA_SSE2)
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control))));
+#else
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP_SIZE; i++) {
+			mask |= static_cast<uint32_t>(control[i] >> 7) << i;
+		}
+		return mask;
+#endif
+	}
+
+	// a utility to compare two GUIDs with a single SIMD compare.
+	static bool keyEqual(REFGUID a, REFGUID b) {
+#if defined(PRIVATE_DATA_SSE2)
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a));
+		auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xffff;
+#elif defined(SIMD_NEON)
+		auto x = vld1q_u8(reinterpret_cast<const uint8_t*>(&a));
+		auto y = vld1q_u8(reinterpret_cast<const uint8_t*>(&b));
+		return vminvq_u8(vceqq_u8(x, y)) == 0xff;
+#else
+		return std::memcmp(&a, &b, sizeof(GUID)) == 0;
+#endif
+	}
+
+	// a utility to find the slot of the key (or the capacity if it's not found).
+	size_t findSlot(REFGUID key, uint64_t keyHash) const {
+		if (mCapacity == 0) {
+			return 0;
+		}
+		auto groupMask = mCapacity / GROUP_SIZE - 1;
+		auto group = static_cast<size_t>(keyHash >> 7) & groupMask;
+		auto tag = static_cast<uint8_t>(keyHash & 0x7f);
+		for (size_t step = 1; ; step++) {
+			auto control = &mControl[group * GROUP_SIZE];
+			for (auto match = matchGroup(control, tag); match != 0; match &= match - 1) {
+				auto slot = group * GROUP_SIZE + lowestBit(match);
+				if (keyEqual(mEntries[slot].key, key)) {
+					return slot;
+				}
+			}
+			if (matchGroup(control, EMPTY) != 0) {
+				return mCapacity;
+			}
+			group = (group + step) & groupMask;
+		}
+	}
+
+	const Entry* find(REFGUID key) const {
+		auto slot = findSlot(key, hash(key));
+		return slot < mCapacity ? &mEntries[slot] : nullptr;
+	}
+
+	// a utility to find the entry of the key or insert an empty entry for it.
+	Entry* insert(REFGUID key) {
+		auto keyHash = hash(key);
+		auto slot = findSlot(key, keyHash);
+		if (slot < mCapacity) {
+			return &mEntries[slot];
+		}
+		if ((mUsed + 1) * 8 > mCapacity * 7 && !rehash(mSize * 2 + 1)) {
+			return nullptr;
+		}
+		slot = freeSlot(keyHash);
+		if (mControl[slot] == EMPTY) {
+			mUsed++;
+		}
+		mSize++;
+		mControl[slot] = static_cast<uint8_t>(keyHash & 0x7f);
+		auto& entry = mEntries[slot];
+		entry.key = key;
+		entry.size = 0;
+		entry.kind = PayloadKind::Inline;
+		return &entry;
+	}
+
+	// a utility to find the first empty or deleted slot for the hash.
+	size_t freeSlot(uint64_t keyHash) const {
+		auto groupMask = mCapacity / GROUP_SIZE - 1;
+		auto group = static_cast<size_t>(keyHash >> 7) & groupMask;
+		for (size_t step = 1; ; step++) {
+			auto match = matchFree(&mControl[group * GROUP_SIZE]);
+			if (match != 0) {
+				return group * GROUP_SIZE + lowestBit(match);
+			}
+			group = (group + step) & groupMask;
+		}
+	}
+
+	HRESULT remove(REFGUID key) {
+		auto slot = findSlot(key, hash(key));
+		if (slot < mCapacity) {
+			releasePayload(mEntries[slot]);
+			mControl[slot] = DELETED;
+			mSize--;
+		}
+		return S_OK;
+	}
+
+	// a utility to grow the table to fit the given amount of entries (drops the deleted slots).
+	bool rehash(size_t entries) {
+		auto capacity = GROUP_SIZE;
+		while (capacity * 7 < entries * 8) {
+			capacity *= 2;
+		}
+		std::unique_ptr<uint8_t[]> control(new (std::nothrow) uint8_t[capacity]);
+		std::unique_ptr<Entry[]> slots(new (std::nothrow) Entry[capacity]);
+		if (control == nullptr || slots == nullptr) {
+			return false;
+		}
+		std::memset(control.get(), EMPTY, capacity);
+		std::swap(mControl, control);
+		std::swap(mEntries, slots);
+		auto oldCapacity = mCapacity;
+		mCapacity = capacity;
+		mUsed = mSize;
+		for (size_t i = 0; i < oldCapacity; i++) {
+			if (isFull(control[i])) {
+				auto slot = freeSlot(hash(slots[i].key));
+				mControl[slot] = control[i];
+				mEntries[slot] = slots[i];
+			}
+		}
+		return true;
+	}
+
+	static void releasePayload(Entry& entry) {
+		if (entry.kind == PayloadKind::Heap) {
+			delete[] entry.heap;
+		} else if (entry.kind == PayloadKind::Interface) {
+			entry.object->Release();
+		}
+		entry.kind = PayloadKind::Inline;
+		entry.size = 0;
+	}
+
+	std::unique_ptr<uint8_t[]>	mControl;
+	std::unique_ptr<Entry[]>	mEntries;
+	size_t						mCapacity;
+	size_t						mSize;
+	size_t						mUsed;	// full and deleted slots
+};
\ No newline at end of file
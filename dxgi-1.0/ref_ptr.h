@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "dxgi_shim.h"
+
+#if defined(_WIN32)
+#include <wrl/client.h> // ComPtr
+#endif
+
+// ============================================================================
+// Reference counting
+//
+// Every AddRef and Release is an atomic read-modify-write on the counter of
+// the object, so passing a ComPtr by value costs two atomics per call. When
+// many threads share the same adapters and outputs, the counters also bounce
+// between the caches of the cores. The following helpers avoid this traffic.
+//
+//		Borrowed	-- A non-owning interface pointer (for function parameters)
+//		RefPtr		-- An owning interface pointer which moves without atomics
+//		RefCounted	-- An intrusive IUnknown reference count for our objects
+//
+// Pass a Borrowed when the callee does not keep the object. The reference of
+// the caller keeps the object alive for the whole call, so nothing has to be
+// counted. A callee which wants to keep the object calls share, which takes a
+// new reference. Owners should be moved instead of copied where possible.
+//
+// RefCounted objects start with a single reference, which is adopted by the
+// makeRef. They can be also owned exclusively (e.g. with std::unique_ptr) as
+// long as they are never shared, as the count is not checked on destruction.
+// ============================================================================
+
+template <typename T>
+class RefPtr;
+
+// a non-owning pointer into an interface which is kept alive by the caller.
+template <typename T>
+class Borrowed final {
+public:
+	Borrowed(std::nullptr_t = nullptr) : mPointer(nullptr) {}
+	Borrowed(T* pointer) : mPointer(pointer) {}
+
+	template <typename U>
+	Borrowed(Borrowed<U> other) : mPointer(other.get()) {}
+
+	template <typename U>
+	Borrowed(const RefPtr<U>& owner) : mPointer(owner.get()) {}
+
+#if defined(_WIN32)
+	template <typename U>
+	Borrowed(const Microsoft::WRL::ComPtr<U>& owner) : mPointer(owner.Get()) {}
+#endif
+
+	T* get() const { return mPointer; }
+	T* operator->() const { return mPointer; }
+	T& operator*() const { return *mPointer; }
+	explicit operator bool() const { return mPointer != nullptr; }
+
+	// take a new reference into the object (to keep it after the call).
+	RefPtr<T> share() const { return RefPtr<T>(mPointer); }
+private:
+	T* mPointer;
+};
+
+// an owning pointer into an interface (like the ComPtr).
+template <typename T>
+class RefPtr final {
+public:
+	RefPtr(std::nullptr_t = nullptr) : mPointer(nullptr) {}
+
+	explicit RefPtr(T* pointer) : mPointer(pointer) {
+		if (mPointer != nullptr) {
+			mPointer->AddRef();
+		}
+	}
+
+	RefPtr(const RefPtr& other) : RefPtr(other.mPointer) {}
+	RefPtr(RefPtr&& other) noexcept : mPointer(other.detach()) {}
+
+	template <typename U>
+	RefPtr(const RefPtr<U>& other) : RefPtr(other.get()) {}
+
+	template <typename U>
+	RefPtr(RefPtr<U>&& other) noexcept : mPointer(other.detach()) {}
+
+	~RefPtr() { reset(); }
+
+	// copies take a new reference, while moves just swap the pointers.
+	RefPtr& operator=(RefPtr other) noexcept {
+		std::swap(mPointer, other.mPointer);
+		return *this;
+	}
+
+	// take over a reference which the caller already owns.
+	static RefPtr adopt(T* pointer) {
+		RefPtr result;
+		result.mPointer = pointer;
+		return result;
+	}
+
+	// give up the reference without releasing it.
+	T* detach() {
+		auto pointer = mPointer;
+		mPointer = nullptr;
+		return pointer;
+	}
+
+	void reset() {
+		if (mPointer != nullptr) {
+			detach()->Release();
+		}
+	}
+
+	// release the current reference and get the address for an out parameter.
+	T** addressOf() {
+		reset();
+		return &mPointer;
+	}
+
+	T* get() const { return mPointer; }
+	T* operator->() const { return mPointer; }
+	T& operator*() const { return *mPointer; }
+	explicit operator bool() const { return mPointer != nullptr; }
+
+	Borrowed<T> borrow() const { return Borrowed<T>(mPointer); }
+private:
+	T* mPointer;
+};
+
+// an intrusive implementation of the IUnknown for the type T (CRTP).
+template <typename T, typename Interface = IUnknown>
+class RefCounted : public Interface {
+public:
+	RefCounted(const RefCounted&) = delete;
+	RefCounted& operator=(const RefCounted&) = delete;
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+		if (object == nullptr) {
+			return E_POINTER;
+		}
+		if (!IsEqualGUID(riid, IID_IUnknown)) {
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+		AddRef();
+		*object = static_cast<IUnknown*>(this);
+		return S_OK;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override {
+		return mRefs.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override {
+		auto refs = mRefs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		if (refs == 0) {
+			delete static_cast<T*>(this);
+		}
+		return refs;
+	}
+protected:
+	RefCounted() : mRefs(1) {}
+	~RefCounted() = default;
+private:
+	std::atomic<ULONG> mRefs;
+};
+
+// a utility to create a new reference counted object.
+template <typename T, typename... Args>
+inline RefPtr<T> makeRef(Args&&... args) {
+	return RefPtr<T>::adopt(new T(std::forward<Args>(args)...));
+}
+
+// a utility to count COM object references.
+inline UINT countRefs(Borrowed<IUnknown> object) {
+	object->AddRef();
+	return static_cast<UINT>(object->Release());
+}
\ No newline at end of file
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "simd_util.h"
+#include "thread_pool.h"
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Resampling
+//
+// Scales a surface into another one as the display scaler would do with the
+// DXGI_MODE_SCALING of a mode, e.g. when a swap chain is rendered below the
+// native resolution of the output. The placement of the image is chosen with
+// the ScalingMode.
+//
+//		Centered	-- The image is not scaled but centered (and cropped if larger)
+//		Stretched	-- The image is stretched to cover the whole surface
+//		Letterboxed	-- The image is scaled to fit with its aspect ratio kept
+//
+// DXGI_MODE_SCALING_UNSPECIFIED is treated as stretched. The parts of the
+// destination which the image does not cover are filled with a border colour.
+//
+// The scaling is separable: each row is first resampled horizontally and the
+// resulting rows are then resampled vertically. The filter weights of both
+// axes are computed once into tables of 14-bit fixed point weights, which the
+// Resampler keeps until the sizes change. When the image is shrunk the filter
+// is widened by the scale, so that each destination pixel covers all of its
+// source pixels. Taps beyond the edges are folded onto the edge pixels.
+//
+//		Bilinear	-- The triangle filter with a radius of one pixel
+//		Bicubic		-- The Catmull-Rom cubic (a = -0.5) with a radius of two pixels
+//		Lanczos3	-- The three lobe windowed sinc with a radius of three pixels
+//
+// Only the 8-bit formats (RGBA8 and BGRA8 with their _SRGB variants) are
+// supported and the source and the destination must share the layout. The
+// stored values are filtered as they are, i.e. the colours are not linearised
+// and the alpha is expected to be premultiplied. Both passes round and clamp
+// into 8 bits, and all the arithmetic is integer, so the AVX2 kernels are
+// bit-exact with the scalar kernels. Other SIMD levels use the scalar kernels.
+//
+// The destination rows are cut into slices, which run in parallel when a
+// ThreadPool is given. A slice is processed in tiles of TILE_ROWS rows, and
+// the horizontally resampled rows are kept in a small ring of rows, so that
+// each source row is resampled once per slice and stays in the cache.
+// ============================================================================
+
+// the placement of the image in the destination.
+enum class ScalingMode {
+	Centered,
+	Stretched,
+	Letterboxed
+};
+
+// a utility to convert ScalingMode into a string.
+inline const char* scalingModeString(ScalingMode mode) {
+	switch (mode) {
+	case ScalingMode::Centered:
+		return "centered";
+	case ScalingMode::Stretched:
+		return "stretched";
+	case ScalingMode::Letterboxed:
+		return "letterboxed";
+	default:
+		return "unknown";
+	}
+}
+
+// a utility to get the scaling mode which implements the DXGI_MODE_SCALING.
+inline ScalingMode scalingMode(DXGI_MODE_SCALING scaling) {
+	return scaling == DXGI_MODE_SCALING_CENTERED ? ScalingMode::Centered : ScalingMode::Stretched;
+}
+
+// the reconstruction filters of the resampling.
+enum class ResampleFilter {
+	Bilinear,
+	Bicubic,
+	Lanczos3
+};
+
+// a utility to convert ResampleFilter into a string.
+inline const char* resampleFilterString(ResampleFilter filter) {
+	switch (filter) {
+	case ResampleFilter::Bilinear:
+		return "bilinear";
+	case ResampleFilter::Bicubic:
+		return "bicubic";
+	case ResampleFilter::Lanczos3:
+		return "lanczos3";
+	default:
+		return "unknown";
+	}
+}
+
+// a utility to get the radius of the filter in source pixels (when not shrinking).
+inline double resampleFilterRadius(ResampleFilter filter) {
+	switch (filter) {
+	case ResampleFilter::Bicubic:
+		return 2.0;
+	case ResampleFilter::Lanczos3:
+		return 3.0;
+	default:
+		return 1.0;
+	}
+}
+
+// a utility to evaluate the filter at the given distance from the centre.
+inline double resampleFilterWeight(ResampleFilter filter, double x) {
+	const double PI = 3.14159265358979323846;
+	x = std::fabs(x);
+	switch (filter) {
+	case ResampleFilter::Bilinear:
+		return x < 1.0 ? 1.0 - x : 0.0;
+	case ResampleFilter::Bicubic:
+		if (x < 1.0) {
+			return (1.5 * x - 2.5) * x * x + 1.0;
+		}
+		return x < 2.0 ? ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0 : 0.0;
+	case ResampleFilter::Lanczos3:
+		if (x < 1e-8) {
+			return 1.0;
+		}
+		return x < 3.0 ? 3.0 * std::sin(PI * x) * std::sin(PI * x / 3.0) / (PI * PI * x * x) : 0.0;
+	default:
+		return 0.0;
+	}
+}
+
+// a utility to get the source and the destination rectangles of the scaling mode.
+inline void scalingRects(ScalingMode mode, UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight, RECT* srcRect, RECT* dstRect) {
+	*srcRect = { 0, 0, static_cast<LONG>(srcWidth), static_cast<LONG>(srcHeight) };
+	*dstRect = { 0, 0, static_cast<LONG>(dstWidth), static_cast<LONG>(dstHeight) };
+	if (mode == ScalingMode::Centered) {
+		auto width = std::min(srcWidth, dstWidth);
+		auto height = std::min(srcHeight, dstHeight);
+		*srcRect = { static_cast<LONG>((srcWidth - width) / 2), static_cast<LONG>((srcHeight - height) / 2),
+			static_cast<LONG>((srcWidth - width) / 2 + width), static_cast<LONG>((srcHeight - height) / 2 + height) };
+		*dstRect = { static_cast<LONG>((dstWidth - width) / 2), static_cast<LONG>((dstHeight - height) / 2),
+			static_cast<LONG>((dstWidth - width) / 2 + width), static_cast<LONG>((dstHeight - height) / 2 + height) };
+	} else if (mode == ScalingMode::Letterboxed && srcWidth > 0 && srcHeight > 0) {
+		// fit the width unless the height would then overflow (compared without rounding).
+		auto fitWidth = static_cast<uint64_t>(dstWidth) * srcHeight <= static_cast<uint64_t>(dstHeight) * srcWidth;
+		auto width = fitWidth ? dstWidth : static_cast<UINT>((static_cast<uint64_t>(dstHeight) * srcWidth + srcHeight / 2) / srcHeight);
+		auto height = fitWidth ? static_cast<UINT>((static_cast<uint64_t>(dstWidth) * srcHeight + srcWidth / 2) / srcWidth) : dstHeight;
+		width = std::max(1u, std::min(width, dstWidth));
+		height = std::max(1u, std::min(height, dstHeight));
+		*dstRect = { static_cast<LONG>((dstWidth - width) / 2), static_cast<LONG>((dstHeight - height) / 2),
+			static_cast<LONG>((dstWidth - width) / 2 + width), static_cast<LONG>((dstHeight - height) / 2 + height) };
+	}
+}
+
+// ============================================================================
+// Weight tables
+// ============================================================================
+
+// the fixed point precision of the weights, which sum up to 1 << RESAMPLE_WEIGHT_BITS.
+constexpr int RESAMPLE_WEIGHT_BITS = 14;
+
+// the filter weights of an axis. Each destination pixel reads taps source pixels from its start,
+// which never reaches beyond the source. The taps are padded to a multiple of four with zeros.
+struct ResampleTable {
+	ResampleFilter			filter;
+	UINT					inSize;
+	UINT					outSize;
+	UINT					taps;
+	std::vector<UINT>		starts;		// the first source pixel of each destination pixel (never decreasing).
+	std::vector<int16_t>	weights;	// taps weights of each destination pixel.
+};
+
+// a utility to compute the weight table for scaling the given amount of pixels into another.
+inline void buildResampleTable(ResampleFilter filter, UINT inSize, UINT outSize, ResampleTable* table) {
+	const int ONE = 1 << RESAMPLE_WEIGHT_BITS;
+	auto scale = static_cast<double>(inSize) / outSize;
+	auto filterScale = std::max(scale, 1.0);
+	auto support = resampleFilterRadius(filter) * filterScale;
+	auto span = static_cast<UINT>(std::ceil(support)) * 2 + 1;
+	auto taps = std::min((span + 3) & ~3u, inSize);
+
+	table->filter = filter;
+	table->inSize = inSize;
+	table->outSize = outSize;
+	table->taps = taps;
+	table->starts.assign(outSize, 0);
+	table->weights.assign(static_cast<size_t>(outSize) * taps, 0);
+	std::vector<double> weights(inSize);
+	for (UINT i = 0; i < outSize; i++) {
+		// accumulate the weights of the source pixels within the support, folding the edges.
+		auto center = (i + 0.5) * scale - 0.5;
+		auto first = static_cast<int>(std::floor(center - support)) + 1;
+		auto last = static_cast<int>(std::ceil(center + support)) - 1;
+		auto lowest = static_cast<int>(inSize) - 1;
+		auto highest = 0;
+		auto total = 0.0;
+		for (auto x = first; x <= last; x++) {
+			auto weight = resampleFilterWeight(filter, (x - center) / filterScale);
+			if (weight == 0.0) {
+				continue;
+			}
+			auto index = std::min(std::max(x, 0), static_cast<int>(inSize) - 1);
+			lowest = std::min(lowest, index);
+			highest = std::max(highest, index);
+			weights[index] += weight;
+			total += weight;
+		}
+		if (lowest > highest) {
+			// a filter which misses all the pixels (never with these filters) takes the nearest one.
+			lowest = highest = std::min(std::max(static_cast<int>(center + 0.5), 0), static_cast<int>(inSize) - 1);
+			weights[lowest] = total = 1.0;
+		}
+
+		// place the window within the source and quantize the weights into it. The window is anchored
+		// to the support instead of the first nonzero weight, as the filters may be zero on its edges
+		// (e.g. the bicubic at exact source pixels), so the starts never go backwards.
+		auto start = std::min(static_cast<UINT>(std::max(first, 0)), inSize - taps);
+		auto row = &table->weights[static_cast<size_t>(i) * taps];
+		auto sum = 0;
+		auto largest = 0;
+		for (auto x = lowest; x <= highest; x++) {
+			auto tap = x - static_cast<int>(start);
+			row[tap] = static_cast<int16_t>(std::lround(weights[x] / total * ONE));
+			sum += row[tap];
+			largest = std::abs(row[tap]) > std::abs(row[largest]) ? tap : largest;
+			weights[x] = 0.0;
+		}
+		row[largest] = static_cast<int16_t>(row[largest] + ONE - sum);
+		table->starts[i] = start;
+	}
+}
+
+// ============================================================================
+// Scalar kernels
+// ============================================================================
+
+// a utility to round and clamp a fixed point sum into a byte.
+inline BYTE resampleByte(int32_t sum) {
+	sum = (sum + (1 << (RESAMPLE_WEIGHT_BITS - 1))) >> RESAMPLE_WEIGHT_BITS;
+	return static_cast<BYTE>(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+}
+
+// a function to resample a row of 8-bit pixels horizontally with the table.
+typedef void(*ResampleRowFunc)(const BYTE* src, BYTE* dst, const ResampleTable& table);
+// a function to blend the bytes of rows with the weights of a destination row.
+typedef void(*BlendRowsFunc)(const BYTE* const* rows, const int16_t* weights, UINT taps, BYTE* dst, UINT bytes);
+
+inline void resampleRowScalar(const BYTE* src, BYTE* dst, const ResampleTable& table) {
+	for (UINT i = 0; i < table.outSize; i++, dst += 4) {
+		auto pixels = src + static_cast<size_t>(table.starts[i]) * 4;
+		auto weights = &table.weights[static_cast<size_t>(i) * table.taps];
+		int32_t sums[4] = {};
+		for (UINT k = 0; k < table.taps; k++) {
+			for (auto c = 0; c < 4; c++) {
+				sums[c] += weights[k] * pixels[k * 4 + c];
+			}
+		}
+		for (auto c = 0; c < 4; c++) {
+			dst[c] = resampleByte(sums[c]);
+		}
+	}
+}
+
+inline void blendRowsScalar(const BYTE* const* rows, const int16_t* weights, UINT taps, BYTE* dst, UINT bytes) {
+	for (UINT x = 0; x < bytes; x++) {
+		int32_t sum = 0;
+		for (UINT k = 0; k < taps; k++) {
+			sum += weights[k] * rows[k][x];
+		}
+		dst[x] = resampleByte(sum);
+	}
+}
+
+// ============================================================================
+// SIMD kernels
+// ============================================================================
+#if defined(SIMD_X86)
+// four taps per step: the 16-bit channels of two pixels are interleaved in each lane for pmaddwd.
+SIMD_TARGET_AVX2 inline void resampleRowAvx2(const BYTE* src, BYTE* dst, const ResampleTable& table) {
+	const __m128i PAIRS = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+	const __m256i BROADCAST = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	const __m128i ROUND = _mm_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+	auto steps = table.taps / 4;
+	for (UINT i = 0; i < table.outSize; i++, dst += 4) {
+		auto pixels = src + static_cast<size_t>(table.starts[i]) * 4;
+		auto weights = &table.weights[static_cast<size_t>(i) * table.taps];
+		auto sum = _mm256_setzero_si256();
+		for (UINT step = 0; step < steps; step++) {
+			auto quad = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + step * 16)), PAIRS);
+			auto weight = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + step * 4));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_cvtepu8_epi16(quad),
+				_mm256_permutevar8x32_epi32(_mm256_castsi128_si256(weight), BROADCAST)));
+		}
+		int32_t tail[4] = {};
+		for (auto k = steps * 4; k < table.taps; k++) {
+			for (auto c = 0; c < 4; c++) {
+				tail[c] += weights[k] * pixels[k * 4 + c];
+			}
+		}
+		auto total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		total = _mm_add_epi32(total, _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)));
+		total = _mm_srai_epi32(_mm_add_epi32(total, ROUND), RESAMPLE_WEIGHT_BITS);
+		total = _mm_packus_epi16(_mm_packs_epi32(total, total), total);
+		auto packed = _mm_cvtsi128_si32(total);
+		std::memcpy(dst, &packed, 4);
+	}
+}
+
+// two rows per step: the bytes of the rows are interleaved into 16-bit pairs for pmaddwd.
+SIMD_TARGET_AVX2 inline void blendRowsAvx2(const BYTE* const* rows, const int16_t* weights, UINT taps, BYTE* dst, UINT bytes) {
+	const __m256i ROUND = _mm256_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+	const __m256i ZERO = _mm256_setzero_si256();
+	UINT x = 0;
+	for (; x + 32 <= bytes; x += 32) {
+		__m256i sums[4] = { ROUND, ROUND, ROUND, ROUND };
+		for (UINT k = 0; k < taps; k += 2) {
+			auto second = k + 1 < taps;
+			auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x));
+			auto b = second ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + x)) : ZERO;
+			auto pair = static_cast<uint16_t>(weights[k]) | (second ? static_cast<uint32_t>(static_cast<uint16_t>(weights[k + 1])) << 16 : 0u);
+			auto weight = _mm256_set1_epi32(static_cast<int>(pair));
+			auto low = _mm256_unpacklo_epi8(a, b);
+			auto high = _mm256_unpackhi_epi8(a, b);
+			sums[0] = _mm256_add_epi32(sums[0], _mm256_madd_epi16(_mm256_unpacklo_epi8(low, ZERO), weight));
+			sums[1] = _mm256_add_epi32(sums[1], _mm256_madd_epi16(_mm256_unpackhi_epi8(low, ZERO), weight));
+			sums[2] = _mm256_add_epi32(sums[2], _mm256_madd_epi16(_mm256_unpacklo_epi8(high, ZERO), weight));
+			sums[3] = _mm256_add_epi32(sums[3], _mm256_madd_epi16(_mm256_unpackhi_epi8(high, ZERO), weight));
+		}
+		for (auto& sum : sums) {
+			sum = _mm256_srai_epi32(sum, RESAMPLE_WEIGHT_BITS);
+		}
+		auto packed = _mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]), _mm256_packs_epi32(sums[2], sums[3]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+	}
+	for (; x < bytes; x++) {
+		int32_t sum = 0;
+		for (UINT k = 0; k < taps; k++) {
+			sum += weights[k] * rows[k][x];
+		}
+		dst[x] = resampleByte(sum);
+	}
+}
+#endif
+
+// a utility to find the fastest horizontal kernel for the SIMD level.
+inline ResampleRowFunc findResampleRow(SimdLevel level) {
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		return &resampleRowAvx2;
+	}
+#endif
+	(void)level;
+	return &resampleRowScalar;
+}
+
+// a utility to find the fastest vertical kernel for the SIMD level.
+inline BlendRowsFunc findBlendRows(SimdLevel level) {
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		return &blendRowsAvx2;
+	}
+#endif
+	(void)level;
+	return &blendRowsScalar;
+}
+
+// ============================================================================
+// Resampler
+//
+// Scales the source view into the destination view with the scaling mode and
+// the filter. The weight tables are built by the first call and re-used while
+// the sizes stay the same, so a resampler should be kept per swap chain. The
+// calls must not overlap, but each call may use a thread pool.
+//
+// Returns E_INVALIDARG if views are null or empty or share the same memory.
+// Returns DXGI_ERROR_UNSUPPORTED if the formats are not 8-bit or differ in layout.
+// ============================================================================
+class Resampler final {
+public:
+	static constexpr UINT TILE_ROWS = 32;
+
+	// the border is a pixel value of the format, which is opaque black by default.
+	Resampler(ScalingMode mode, ResampleFilter filter, uint32_t border = 0xff000000u)
+		: mMode(mode), mFilter(filter), mBorder(border), mColumns(), mRows() {}
+
+	HRESULT resample(const SurfaceView& src, const SurfaceView& dst, ThreadPool* pool = nullptr, SimdLevel level = bestSimdLevel()) {
+		if (src.bits == nullptr || dst.bits == nullptr || src.width == 0 || src.height == 0 || dst.width == 0 || dst.height == 0
+			|| src.bits == dst.bits) {
+			return E_INVALIDARG;
+		}
+		auto layout = pixelLayout(src.format);
+		if ((layout != PixelLayout::Rgba8 && layout != PixelLayout::Bgra8) || pixelLayout(dst.format) != layout) {
+			return DXGI_ERROR_UNSUPPORTED;
+		}
+		RECT srcRect;
+		RECT dstRect;
+		scalingRects(mMode, src.width, src.height, dst.width, dst.height, &srcRect, &dstRect);
+		auto srcWidth = static_cast<UINT>(srcRect.right - srcRect.left);
+		auto srcHeight = static_cast<UINT>(srcRect.bottom - srcRect.top);
+		auto width = static_cast<UINT>(dstRect.right - dstRect.left);
+		auto height = static_cast<UINT>(dstRect.bottom - dstRect.top);
+		auto origin = src.bits + static_cast<ptrdiff_t>(srcRect.top) * src.pitch + srcRect.left * 4;
+		auto copy = srcWidth == width && srcHeight == height;
+		if (!copy) {
+			prepare(mColumns, srcWidth, width);
+			prepare(mRows, srcHeight, height);
+		}
+		auto resampleRow = findResampleRow(level);
+		auto blendRows = findBlendRows(level);
+
+		parallelSlices(pool, dst.height, 1, [&](UINT begin, UINT end) {
+			// fill the borders of the slice.
+			for (auto y = begin; y < end; y++) {
+				auto row = reinterpret_cast<uint32_t*>(dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch);
+				auto inside = static_cast<LONG>(y) >= dstRect.top && static_cast<LONG>(y) < dstRect.bottom;
+				std::fill(row, row + (inside ? dstRect.left : dst.width), mBorder);
+				std::fill(row + (inside ? dstRect.right : dst.width), row + dst.width, mBorder);
+			}
+			auto first = std::max(static_cast<LONG>(begin), dstRect.top) - dstRect.top;
+			auto last = std::min(static_cast<LONG>(end), dstRect.bottom) - dstRect.top;
+			if (first >= last) {
+				return;
+			}
+			auto target = dst.bits + static_cast<ptrdiff_t>(dstRect.top) * dst.pitch + dstRect.left * 4;
+			if (copy) {
+				for (auto y = first; y < last; y++) {
+					std::memcpy(target + static_cast<ptrdiff_t>(y) * dst.pitch, origin + static_cast<ptrdiff_t>(y) * src.pitch, width * 4);
+				}
+			} else {
+				resampleSlice(origin, src.pitch, target, dst.pitch, static_cast<UINT>(first), static_cast<UINT>(last), resampleRow, blendRows);
+			}
+		});
+		return S_OK;
+	}
+
+	ScalingMode mode() const { return mMode; }
+	ResampleFilter filter() const { return mFilter; }
+private:
+	void prepare(ResampleTable& table, UINT inSize, UINT outSize) {
+		if (table.inSize != inSize || table.outSize != outSize || table.starts.empty()) {
+			buildResampleTable(mFilter, inSize, outSize, &table);
+		}
+	}
+
+	// resample the destination rows [first, last) of the scaled image tile by tile.
+	void resampleSlice(const BYTE* src, INT srcPitch, BYTE* dst, INT dstPitch, UINT first, UINT last,
+		ResampleRowFunc resampleRow, BlendRowsFunc blendRows) const {
+		auto rowBytes = mColumns.outSize * 4;
+		auto taps = mRows.taps;
+
+		// the ring holds the horizontally resampled source rows of a tile (source row r is at r % capacity).
+		UINT capacity = 0;
+		for (auto y = first; y < last; y += TILE_ROWS) {
+			auto end = std::min(y + TILE_ROWS, last);
+			capacity = std::max(capacity, mRows.starts[end - 1] + taps - mRows.starts[y]);
+		}
+		std::vector<BYTE> ring(static_cast<size_t>(capacity) * rowBytes);
+		std::vector<const BYTE*> rows(taps);
+		std::vector<int16_t> weights(taps);
+		UINT cachedEnd = 0;
+		auto cachedBegin = cachedEnd;
+
+		for (auto y = first; y < last; y += TILE_ROWS) {
+			auto end = std::min(y + TILE_ROWS, last);
+			auto needBegin = mRows.starts[y];
+			auto needEnd = mRows.starts[end - 1] + taps;
+			cachedBegin = std::max(cachedBegin, needBegin);
+			cachedEnd = std::max(cachedEnd, cachedBegin);
+			for (auto r = cachedEnd; r < needEnd; r++) {
+				resampleRow(src + static_cast<ptrdiff_t>(r) * srcPitch, &ring[static_cast<size_t>(r % capacity) * rowBytes], mColumns);
+			}
+			cachedEnd = needEnd;
+
+			// the padding taps of the rows are skipped, as only the columns need them.
+			for (auto row = y; row < end; row++) {
+				auto start = mRows.starts[row];
+				auto rowWeights = &mRows.weights[static_cast<size_t>(row) * taps];
+				UINT count = 0;
+				for (UINT k = 0; k < taps; k++) {
+					if (rowWeights[k] != 0) {
+						rows[count] = &ring[static_cast<size_t>((start + k) % capacity) * rowBytes];
+						weights[count++] = rowWeights[k];
+					}
+				}
+				blendRows(rows.data(), weights.data(), count, dst + static_cast<ptrdiff_t>(row) * dstPitch, rowBytes);
+			}
+		}
+	}
+
+	ScalingMode		mMode;
+	ResampleFilter	mFilter;
+	uint32_t		mBorder;
+	ResampleTable	mColumns;
+	ResampleTable	mRows;
+};
\ No newline at end of file
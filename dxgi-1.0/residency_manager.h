@@ -0,0 +1,417 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+
+#if defined(_WIN32)
+#include <wrl/client.h>
+#endif
+
+// ============================================================================
+// ResidencyManager
+//
+// Keeps the video memory used by the application inside the budget which the
+// OS gives to the process (IDXGIAdapter3::QueryVideoMemoryInfo, DXGI 1.4). If
+// the usage exceeds the budget, the OS starts to page the resources out by
+// itself, which shows up as long stalls at random frames. The manager tracks
+// the size, the last use and the restore cost of each registered resource and
+// once per frame does the following.
+//
+//		1. Query the budget and the current usage from the budget source
+//		2. Evict idle resources while the usage is above the target fraction
+//		3. Restore evicted resources while below the restore fraction, in the
+//		   order of their last use, but at most maxRestoreBytes per frame
+//		4. Set the eviction priorities by how long ago a resource was used
+//
+// Resources used within the protectFrames are never evicted. The other ones
+// are evicted in the order given by the policy.
+//
+//		Lru			-- The least recently used resource first
+//		CostAware	-- The highest (idle frames * size / restore cost) first, so
+//					   large and cheap to restore resources are evicted sooner
+//
+// A resource which is used while evicted is restored immediately, which is a
+// stall that the manager measures. The proactive restores of the step 3 are
+// there to avoid these stalls after the budget has grown back.
+//
+// Eviction priorities (SetEvictionPriority) tell the OS which resources to
+// page out first if the budget still gets exceeded, e.g. by other processes.
+//
+//		used in the last 2 frames	-- DXGI_RESOURCE_PRIORITY_HIGH
+//		used in the last 60 frames	-- DXGI_RESOURCE_PRIORITY_NORMAL
+//		used in the last 600 frames	-- DXGI_RESOURCE_PRIORITY_LOW
+//		otherwise					-- DXGI_RESOURCE_PRIORITY_MINIMUM
+//
+// The budget source is pluggable, so the manager can be driven with simulated
+// budget curves (SimulatedVideoMemory) on machines without a Windows display.
+// ============================================================================
+
+// a source of the video memory budget and the current usage of the process.
+class BudgetSource {
+public:
+	virtual ~BudgetSource() = default;
+	virtual HRESULT QueryVideoMemoryInfo(DXGI_QUERY_VIDEO_MEMORY_INFO* info) = 0;
+};
+
+// a resource which the residency manager can evict and restore.
+class ManagedResource {
+public:
+	virtual ~ManagedResource() = default;
+	virtual HRESULT SetEvictionPriority(UINT priority) = 0;
+	virtual HRESULT evict() = 0;	// release the video memory of the resource.
+	virtual HRESULT restore() = 0;	// recreate and re-upload the resource.
+};
+
+enum class EvictionPolicy {
+	Lru,
+	CostAware
+};
+
+struct ResidencyDesc {
+	EvictionPolicy	policy;
+	double			targetFraction;		// the fraction of the budget which may be used.
+	double			restoreFraction;	// restore evicted resources while below this fraction.
+	UINT64			maxRestoreBytes;	// bytes restored proactively per frame.
+	UINT			protectFrames;		// resources used within these frames are not evicted.
+};
+
+// a utility to get a description which uses 90% of the budget and restores 16 MB per frame.
+inline ResidencyDesc defaultResidencyDesc(EvictionPolicy policy) {
+	ResidencyDesc desc = {};
+	desc.policy = policy;
+	desc.targetFraction = 0.9;
+	desc.restoreFraction = 0.75;
+	desc.maxRestoreBytes = 16 * 1024 * 1024;
+	desc.protectFrames = 2;
+	return desc;
+}
+
+struct ResidencyStats {
+	uint64_t	frames;				// frames updated.
+	uint64_t	overBudgetFrames;	// frames which stayed above the target after evicting.
+	uint64_t	evictions;			// resources evicted.
+	uint64_t	evictedBytes;
+	uint64_t	restores;			// resources restored proactively.
+	uint64_t	restoredBytes;
+	uint64_t	stalls;				// resources restored on use.
+	uint64_t	stalledBytes;
+	int64_t		stallTicks;			// ticks spent in the restores on use.
+	uint64_t	priorityChanges;	// SetEvictionPriority calls made.
+};
+
+class ResidencyManager final {
+public:
+	typedef UINT Handle;
+	static constexpr Handle INVALID_HANDLE = ~0u;
+
+	ResidencyManager(BudgetSource& budget, TimeSource& time, const ResidencyDesc& desc)
+		: mBudget(budget), mTime(time), mDesc(desc), mStats(), mFrame(0), mResidentBytes(0) {
+		mInfo = {};
+	}
+
+	// register a resident resource with its size and a relative cost to restore it.
+	Handle add(ManagedResource* resource, UINT64 size, double restoreCost = 1.0) {
+		Entry entry = {};
+		entry.resource = resource;
+		entry.size = size;
+		entry.restoreCost = restoreCost > 0.0 ? restoreCost : 1.0;
+		entry.lastUse = mFrame;
+		entry.resident = true;
+		entry.priority = 0;
+		mResidentBytes += size;
+		if (!mFreeHandles.empty()) {
+			auto handle = mFreeHandles.back();
+			mFreeHandles.pop_back();
+			mEntries[handle] = entry;
+			return handle;
+		}
+		mEntries.push_back(entry);
+		return static_cast<Handle>(mEntries.size() - 1);
+	}
+
+	// unregister the resource (it is not evicted or restored any more).
+	void remove(Handle handle) {
+		auto& entry = mEntries[handle];
+		if (entry.resident) {
+			mResidentBytes -= entry.size;
+		}
+		entry = {};
+		mFreeHandles.push_back(handle);
+	}
+
+	// mark the resource used in this frame, and restore it if it has been evicted.
+	HRESULT use(Handle handle) {
+		auto& entry = mEntries[handle];
+		entry.lastUse = mFrame;
+		if (entry.resident) {
+			return S_OK;
+		}
+		auto start = mTime.now();
+		auto result = restore(entry);
+		mStats.stalls++;
+		mStats.stalledBytes += entry.size;
+		mStats.stallTicks += mTime.now() - start;
+		return result;
+	}
+
+	// evict and restore the resources against the current budget (once per frame).
+	HRESULT update() {
+		auto result = mBudget.QueryVideoMemoryInfo(&mInfo);
+		if (FAILED(result)) {
+			return result;
+		}
+		mStats.frames++;
+
+		// the current usage includes our own resident resources as well.
+		auto others = mInfo.CurrentUsage > mResidentBytes ? mInfo.CurrentUsage - mResidentBytes : 0;
+		auto target = limit(mDesc.targetFraction, others);
+		if (mResidentBytes > target) {
+			result = evictUntil(target);
+		} else {
+			result = restoreUntil(limit(mDesc.restoreFraction, others));
+		}
+		updatePriorities();
+		mFrame++;
+		return result;
+	}
+
+	bool resident(Handle handle) const { return mEntries[handle].resident; }
+	UINT64 residentBytes() const { return mResidentBytes; }
+	uint64_t frame() const { return mFrame; }
+	const DXGI_QUERY_VIDEO_MEMORY_INFO& lastInfo() const { return mInfo; }
+	const ResidencyStats& stats() const { return mStats; }
+private:
+	struct Entry {
+		ManagedResource*	resource;
+		UINT64				size;
+		double				restoreCost;
+		uint64_t			lastUse;
+		UINT				priority;
+		bool				resident;
+	};
+
+	UINT64 limit(double fraction, UINT64 others) const {
+		auto limit = static_cast<UINT64>(static_cast<double>(mInfo.Budget) * fraction);
+		return limit > others ? limit - others : 0;
+	}
+
+	double score(const Entry& entry) const {
+		auto idle = static_cast<double>(mFrame - entry.lastUse);
+		if (mDesc.policy == EvictionPolicy::Lru) {
+			return idle;
+		}
+		return idle * static_cast<double>(entry.size) / entry.restoreCost;
+	}
+
+	HRESULT evictUntil(UINT64 target) {
+		mCandidates.clear();
+		for (Handle i = 0; i < mEntries.size(); i++) {
+			auto& entry = mEntries[i];
+			if (entry.resource != nullptr && entry.resident && mFrame - entry.lastUse >= mDesc.protectFrames) {
+				mCandidates.push_back({ score(entry), i });
+			}
+		}
+		std::sort(mCandidates.begin(), mCandidates.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+		for (auto& candidate : mCandidates) {
+			if (mResidentBytes <= target) {
+				break;
+			}
+			auto& entry = mEntries[candidate.handle];
+			auto result = entry.resource->evict();
+			if (FAILED(result)) {
+				return result;
+			}
+			entry.resident = false;
+			mResidentBytes -= entry.size;
+			mStats.evictions++;
+			mStats.evictedBytes += entry.size;
+		}
+		if (mResidentBytes > target) {
+			mStats.overBudgetFrames++;
+		}
+		return S_OK;
+	}
+
+	HRESULT restoreUntil(UINT64 target) {
+		mCandidates.clear();
+		for (Handle i = 0; i < mEntries.size(); i++) {
+			auto& entry = mEntries[i];
+			if (entry.resource != nullptr && !entry.resident) {
+				mCandidates.push_back({ static_cast<double>(mFrame - entry.lastUse), i });
+			}
+		}
+		std::sort(mCandidates.begin(), mCandidates.end(), [](const Candidate& a, const Candidate& b) { return a.score < b.score; });
+		UINT64 restored = 0;
+		for (auto& candidate : mCandidates) {
+			auto& entry = mEntries[candidate.handle];
+			if (restored + entry.size > mDesc.maxRestoreBytes || mResidentBytes + entry.size > target) {
+				break;
+			}
+			auto result = restore(entry);
+			if (FAILED(result)) {
+				return result;
+			}
+			restored += entry.size;
+			mStats.restores++;
+			mStats.restoredBytes += entry.size;
+		}
+		return S_OK;
+	}
+
+	HRESULT restore(Entry& entry) {
+		auto result = entry.resource->restore();
+		if (FAILED(result)) {
+			return result;
+		}
+		entry.resident = true;
+		entry.priority = 0;
+		mResidentBytes += entry.size;
+		return S_OK;
+	}
+
+	void updatePriorities() {
+		for (auto& entry : mEntries) {
+			if (entry.resource == nullptr || !entry.resident) {
+				continue;
+			}
+			auto idle = mFrame - entry.lastUse;
+			UINT priority = idle < 2 ? DXGI_RESOURCE_PRIORITY_HIGH
+				: idle < 60 ? DXGI_RESOURCE_PRIORITY_NORMAL
+				: idle < 600 ? DXGI_RESOURCE_PRIORITY_LOW
+				: DXGI_RESOURCE_PRIORITY_MINIMUM;
+			if (entry.priority != priority && SUCCEEDED(entry.resource->SetEvictionPriority(priority))) {
+				entry.priority = priority;
+				mStats.priorityChanges++;
+			}
+		}
+	}
+
+	struct Candidate {
+		double	score;
+		Handle	handle;
+	};
+
+	BudgetSource&					mBudget;
+	TimeSource&						mTime;
+	ResidencyDesc					mDesc;
+	ResidencyStats					mStats;
+	DXGI_QUERY_VIDEO_MEMORY_INFO	mInfo;
+	uint64_t						mFrame;
+	UINT64							mResidentBytes;
+	std::vector<Entry>				mEntries;
+	std::vector<Handle>				mFreeHandles;
+	std::vector<Candidate>			mCandidates;
+};
+
+// ============================================================================
+// SimulatedVideoMemory
+//
+// A budget source which simulates the video memory of an adapter. The budget
+// and the usage of the other processes can be changed at any time (e.g. along
+// a curve) and the SimulatedResources allocate and release their memory from
+// it, so the usage always includes the resources of the application.
+// ============================================================================
+class SimulatedVideoMemory final : public BudgetSource {
+public:
+	explicit SimulatedVideoMemory(UINT64 budget) : mBudget(budget), mOthers(0), mUsage(0), mPeak(0) {}
+
+	HRESULT QueryVideoMemoryInfo(DXGI_QUERY_VIDEO_MEMORY_INFO* info) override {
+		if (info == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*info = {};
+		info->Budget = mBudget;
+		info->CurrentUsage = mUsage + mOthers;
+		info->AvailableForReservation = mBudget / 2;
+		return S_OK;
+	}
+
+	void setBudget(UINT64 budget) { mBudget = budget; }
+	void setOtherUsage(UINT64 usage) { mOthers = usage; }
+
+	void allocate(UINT64 size) {
+		mUsage += size;
+		mPeak = std::max(mPeak, mUsage);
+	}
+
+	void release(UINT64 size) { mUsage -= size; }
+
+	UINT64 budget() const { return mBudget; }
+	UINT64 usage() const { return mUsage + mOthers; }
+	UINT64 peakUsage() const { return mPeak; }
+private:
+	UINT64	mBudget;
+	UINT64	mOthers;
+	UINT64	mUsage;
+	UINT64	mPeak;
+};
+
+// a resource in the simulated video memory which costs the given ticks to restore.
+class SimulatedResource final : public ManagedResource {
+public:
+	SimulatedResource(SimulatedVideoMemory& memory, TimeSource& time, UINT64 size, int64_t restoreTicks)
+		: mMemory(memory), mTime(time), mSize(size), mRestoreTicks(restoreTicks), mResident(true), mPriority(DXGI_RESOURCE_PRIORITY_NORMAL) {
+		mMemory.allocate(mSize);
+	}
+
+	~SimulatedResource() {
+		if (mResident) {
+			mMemory.release(mSize);
+		}
+	}
+
+	HRESULT SetEvictionPriority(UINT priority) override {
+		mPriority = priority;
+		return S_OK;
+	}
+
+	HRESULT evict() override {
+		if (!mResident) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMemory.release(mSize);
+		mResident = false;
+		return S_OK;
+	}
+
+	HRESULT restore() override {
+		if (mResident) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mTime.waitUntil(mTime.now() + mRestoreTicks);
+		mMemory.allocate(mSize);
+		mResident = true;
+		return S_OK;
+	}
+
+	UINT64 size() const { return mSize; }
+	UINT priority() const { return mPriority; }
+	bool resident() const { return mResident; }
+private:
+	SimulatedVideoMemory&	mMemory;
+	TimeSource&				mTime;
+	UINT64					mSize;
+	int64_t					mRestoreTicks;
+	bool					mResident;
+	UINT					mPriority;
+};
+
+#if defined(_WIN32)
+// a budget source which queries the budget of an adapter (Windows 10 and DXGI 1.4).
+class AdapterBudgetSource final : public BudgetSource {
+public:
+	AdapterBudgetSource(IDXGIAdapter3* adapter, DXGI_MEMORY_SEGMENT_GROUP group = DXGI_MEMORY_SEGMENT_GROUP_LOCAL)
+		: mAdapter(adapter), mGroup(group) {}
+
+	HRESULT QueryVideoMemoryInfo(DXGI_QUERY_VIDEO_MEMORY_INFO* info) override {
+		return mAdapter->QueryVideoMemoryInfo(0, mGroup, info);
+	}
+private:
+	Microsoft::WRL::ComPtr<IDXGIAdapter3>	mAdapter;
+	DXGI_MEMORY_SEGMENT_GROUP				mGroup;
+};
+#endif
\ No newline at end of file
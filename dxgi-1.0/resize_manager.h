@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "dxgi_shim.h"
+#include "soft_swap_chain.h"
+#include "time_source.h"
+
+#if defined(_WIN32)
+#include <wrl/client.h>
+#endif
+
+// ============================================================================
+// ResizeManager
+//
+// Coalesces the resize requests of a window into as few ResizeBuffers calls
+// as possible. Dragging a window edge produces a WM_SIZE for each mouse move,
+// i.e. hundreds of resizes per second, and each ResizeBuffers reallocates all
+// the buffers of the swap chain. The manager combines the following methods.
+//
+//		Debounce	-- Apply a size only after the requests have been quiet for
+//					   the debounce time, or when the oldest pending request is
+//					   older than the max delay (so that live resizing updates)
+//		Envelope	-- Over-allocate the buffers with the growth factor and use
+//					   the source size to present only the visible sub-region
+//		Hysteresis	-- Shrink the buffers only when the visible area falls
+//					   below the shrink fraction of the allocated area
+//
+// The source size is set with the SetSourceSize of the IDXGISwapChain2 (from
+// Windows 8.1 with flip model swap chains) or the SoftwareSwapChain. If the
+// swap chain does not support it, the buffers are always resized exactly.
+//
+// A ResizeBuffers which fails (e.g. when the application still holds buffer
+// references) keeps the request pending, so it will be retried by the next
+// update. The application must render into the top-left width x height part
+// of the buffers, which is the part that will be shown.
+//
+//		case WM_SIZE:			manager.requestResize(LOWORD(lParam), HIWORD(lParam));
+//		case WM_EXITSIZEMOVE:	manager.flush();
+//		every frame:			manager.update(); render(manager.width(), manager.height());
+// ============================================================================
+struct ResizePolicy {
+	int64_t	debounceTicks;	// ticks the requests must be quiet before resizing.
+	int64_t	maxDelayTicks;	// ticks a pending request may wait at most.
+	double	growth;			// the over-allocation factor when the buffers grow.
+	double	shrinkFraction;	// the fraction of the allocated area which triggers a shrink.
+	UINT	alignment;		// the alignment of the allocated width and height.
+	UINT	maxWidth;		// the limit of the allocated width (or 0 for none).
+	UINT	maxHeight;		// the limit of the allocated height (or 0 for none).
+};
+
+// a utility to get a policy which resizes after 50 ms of quiet, or at least every 250 ms.
+inline ResizePolicy defaultResizePolicy(int64_t frequency) {
+	ResizePolicy policy = {};
+	policy.debounceTicks = frequency / 20;
+	policy.maxDelayTicks = frequency / 4;
+	policy.growth = 1.25;
+	policy.shrinkFraction = 0.5;
+	policy.alignment = 64;
+	return policy;
+}
+
+// counts of the resize requests and the work which they caused.
+struct ResizeStats {
+	uint64_t	requests;			// resize requests made by the application.
+	uint64_t	applied;			// sizes applied after the coalescing.
+	uint64_t	reallocations;		// ResizeBuffers calls made.
+	uint64_t	reallocatedBytes;	// bytes of buffers allocated by the ResizeBuffers calls.
+	uint64_t	failures;			// ResizeBuffers calls that failed (and were retried).
+};
+
+inline HRESULT setSourceSize(SoftwareSwapChain* swapchain, UINT width, UINT height) {
+	return swapchain->SetSourceSize(width, height);
+}
+
+#if defined(_WIN32)
+inline HRESULT setSourceSize(IDXGISwapChain* swapchain, UINT width, UINT height) {
+	Microsoft::WRL::ComPtr<IDXGISwapChain2> swapchain2;
+	if (FAILED(swapchain->QueryInterface(IID_PPV_ARGS(&swapchain2)))) {
+		return DXGI_ERROR_UNSUPPORTED;
+	}
+	return swapchain2->SetSourceSize(width, height);
+}
+#endif
+
+template <typename SwapChain>
+class ResizeManager final {
+public:
+	ResizeManager(SwapChain* swapchain, TimeSource& time, const ResizePolicy& policy)
+		: mSwapChain(swapchain), mTime(time), mPolicy(policy), mStats(), mPending(false), mFirstRequest(0), mLastRequest(0) {
+		mPolicy.alignment = mPolicy.alignment == 0 ? 1 : mPolicy.alignment;
+		mPolicy.growth = std::max(mPolicy.growth, 1.0);
+		DXGI_SWAP_CHAIN_DESC desc = {};
+		mSwapChain->GetDesc(&desc);
+		mAllocatedWidth = mWidth = mRequestWidth = desc.BufferDesc.Width;
+		mAllocatedHeight = mHeight = mRequestHeight = desc.BufferDesc.Height;
+		mSourceSize = SUCCEEDED(setSourceSize(mSwapChain, mWidth, mHeight));
+	}
+
+	// request the visible size to be changed (e.g. on WM_SIZE).
+	void requestResize(UINT width, UINT height) {
+		auto now = mTime.now();
+		mStats.requests++;
+		if (!mPending) {
+			mFirstRequest = now;
+		}
+		mPending = true;
+		mLastRequest = now;
+		mRequestWidth = std::max(width, 1u);
+		mRequestHeight = std::max(height, 1u);
+	}
+
+	// apply a pending request if it is due, and tell whether the size was changed.
+	HRESULT update(bool* resized = nullptr) {
+		auto now = mTime.now();
+		if (mPending && (now - mLastRequest >= mPolicy.debounceTicks || now - mFirstRequest >= mPolicy.maxDelayTicks)) {
+			return apply(resized);
+		}
+		if (resized != nullptr) {
+			*resized = false;
+		}
+		return S_OK;
+	}
+
+	// apply a pending request right away (e.g. on WM_EXITSIZEMOVE).
+	HRESULT flush(bool* resized = nullptr) {
+		if (!mPending) {
+			if (resized != nullptr) {
+				*resized = false;
+			}
+			return S_OK;
+		}
+		return apply(resized);
+	}
+
+	bool pending() const { return mPending; }
+	UINT width() const { return mWidth; }
+	UINT height() const { return mHeight; }
+	UINT allocatedWidth() const { return mAllocatedWidth; }
+	UINT allocatedHeight() const { return mAllocatedHeight; }
+	const ResizeStats& stats() const { return mStats; }
+private:
+	HRESULT apply(bool* resized) {
+		if (resized != nullptr) {
+			*resized = false;
+		}
+		auto width = mRequestWidth;
+		auto height = mRequestHeight;
+		if (width == mWidth && height == mHeight) {
+			mPending = false;
+			return S_OK;
+		}
+
+		auto area = static_cast<double>(width) * height;
+		auto allocatedArea = static_cast<double>(mAllocatedWidth) * mAllocatedHeight;
+		auto fits = width <= mAllocatedWidth && height <= mAllocatedHeight;
+		if (!mSourceSize || !fits || area < allocatedArea * mPolicy.shrinkFraction) {
+			auto allocatedWidth = mSourceSize ? envelope(width, mPolicy.maxWidth) : width;
+			auto allocatedHeight = mSourceSize ? envelope(height, mPolicy.maxHeight) : height;
+			auto result = mSwapChain->ResizeBuffers(0, allocatedWidth, allocatedHeight, DXGI_FORMAT_UNKNOWN, 0);
+			if (FAILED(result)) {
+				mStats.failures++;
+				return result;
+			}
+			DXGI_SWAP_CHAIN_DESC desc = {};
+			mSwapChain->GetDesc(&desc);
+			mStats.reallocations++;
+			mStats.reallocatedBytes += static_cast<uint64_t>(allocatedWidth) * allocatedHeight
+				* formatBytesPerPixel(desc.BufferDesc.Format) * std::max(desc.BufferCount, 1u);
+			mAllocatedWidth = allocatedWidth;
+			mAllocatedHeight = allocatedHeight;
+		}
+		if (mSourceSize) {
+			auto result = setSourceSize(mSwapChain, width, height);
+			if (FAILED(result)) {
+				return result;
+			}
+		}
+		mWidth = width;
+		mHeight = height;
+		mPending = false;
+		mStats.applied++;
+		if (resized != nullptr) {
+			*resized = true;
+		}
+		return S_OK;
+	}
+
+	// get the over-allocated and aligned size for the requested size.
+	UINT envelope(UINT size, UINT limit) const {
+		auto grown = static_cast<UINT>(size * mPolicy.growth);
+		grown = (grown + mPolicy.alignment - 1) / mPolicy.alignment * mPolicy.alignment;
+		if (limit != 0) {
+			grown = std::min(grown, std::max(limit, size));
+		}
+		return grown;
+	}
+
+	SwapChain*		mSwapChain;
+	TimeSource&		mTime;
+	ResizePolicy	mPolicy;
+	ResizeStats		mStats;
+	bool			mSourceSize;	// the swap chain supports the source size.
+	bool			mPending;
+	int64_t			mFirstRequest;
+	int64_t			mLastRequest;
+	UINT			mRequestWidth;
+	UINT			mRequestHeight;
+	UINT			mWidth;
+	UINT			mHeight;
+	UINT			mAllocatedWidth;
+	UINT			mAllocatedHeight;
+};
\ No newline at end of file
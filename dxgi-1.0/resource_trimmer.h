@@ -0,0 +1,592 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+
+#if defined(_WIN32)
+#include <wrl/client.h>
+#endif
+
+// ============================================================================
+// ResourceTrimmer
+//
+// Gives the memory of the idle resources back to the OS while the application
+// keeps running. DXGI 1.2 added the offering of resources: an offered resource
+// keeps its video memory only as long as the OS does not need it, and it must
+// be reclaimed before its next use. If the OS has taken the memory, the reclaim
+// tells that the contents have been discarded and they must be uploaded again.
+//
+//		Resident	-- The resource may be used as is
+//		Offering	-- The trimmer is offering the resource on its worker thread
+//		Offered		-- The OS may discard the contents at any time
+//		Reclaiming	-- The first use is reclaiming (and maybe re-uploading) it
+//
+// The trimmer tracks the last frame each registered resource was used in. Once
+// per frame its worker thread offers the resources which have been idle for
+// the idleFrames, the least recently used first, but at most maxOffersPerFrame
+// resources and maxOfferBytesPerFrame bytes, so the work of a single frame is
+// always bounded. The resources are reclaimed lazily, i.e. on their first use,
+// which is a stall that the trimmer measures together with the re-uploads.
+//
+//		every frame:		trimmer.use(handle) for each resource drawn
+//							trimmer.endFrame();
+//
+// Without start(), the trim() can be called once per frame on any thread. The
+// use() and endFrame() may be called from any thread, but a resource must not
+// be removed while it is being used.
+//
+// The OfferableResource is implemented with IDXGIDevice2 and IDXGIDevice4 on
+// Windows (DxgiOfferableResource), and with a DiscardableHeap of system memory
+// elsewhere, which discards the offered blocks when its limit is lowered.
+// ============================================================================
+
+// a resource which can be offered to the OS and reclaimed back.
+class OfferableResource {
+public:
+	virtual ~OfferableResource() = default;
+	virtual HRESULT offer(DXGI_OFFER_RESOURCE_PRIORITY priority) = 0;
+	virtual HRESULT reclaim(DXGI_RECLAIM_RESOURCE_RESULTS* result) = 0;
+	virtual HRESULT reupload() = 0;	// upload the contents again after a discard.
+};
+
+enum class OfferState {
+	Resident,
+	Offering,
+	Offered,
+	Reclaiming
+};
+
+// a utility to get string presentation of OfferState.
+inline const char* offerStateString(OfferState state) {
+	switch (state) {
+	case OfferState::Resident:		return "resident";
+	case OfferState::Offering:		return "offering";
+	case OfferState::Offered:		return "offered";
+	case OfferState::Reclaiming:	return "reclaiming";
+	default:						return "unknown";
+	}
+}
+
+struct TrimmerDesc {
+	UINT							idleFrames;				// frames a resource must be unused before it is offered.
+	UINT							maxOffersPerFrame;		// resources offered per frame at most.
+	UINT64							maxOfferBytesPerFrame;	// bytes offered per frame at most.
+	DXGI_OFFER_RESOURCE_PRIORITY	priority;				// the priority given to the offers.
+};
+
+// a utility to get a description which offers the resources unused for 120 frames.
+inline TrimmerDesc defaultTrimmerDesc() {
+	TrimmerDesc desc = {};
+	desc.idleFrames = 120;
+	desc.maxOffersPerFrame = 4;
+	desc.maxOfferBytesPerFrame = 32 * 1024 * 1024;
+	desc.priority = DXGI_OFFER_RESOURCE_PRIORITY_LOW;
+	return desc;
+}
+
+struct TrimmerStats {
+	uint64_t	frames;				// frames ended.
+	uint64_t	passes;				// trim passes made (at most one per frame).
+	int64_t		passTicks;			// ticks spent in the trim passes.
+	uint64_t	offers;				// resources offered.
+	uint64_t	offeredBytes;
+	uint64_t	reclaims;			// resources reclaimed with their contents.
+	uint64_t	reclaimedBytes;
+	uint64_t	discards;			// resources reclaimed after a discard.
+	uint64_t	discardedBytes;
+	int64_t		reuploadTicks;		// ticks spent in uploading the discarded contents.
+	uint64_t	stalls;				// first uses of the offered resources.
+	int64_t		stallTicks;			// ticks spent in the first uses (including re-uploads).
+};
+
+class ResourceTrimmer final {
+public:
+	typedef UINT Handle;
+	static constexpr Handle INVALID_HANDLE = ~0u;
+
+	ResourceTrimmer(TimeSource& time, const TrimmerDesc& desc)
+		: mTime(time), mDesc(desc), mStats(), mFrame(0), mOfferedBytes(0), mStopping(false), mResult(S_OK) {
+		mDesc.maxOffersPerFrame = std::max(mDesc.maxOffersPerFrame, 1u);
+	}
+
+	ResourceTrimmer(const ResourceTrimmer&) = delete;
+	ResourceTrimmer& operator=(const ResourceTrimmer&) = delete;
+
+	~ResourceTrimmer() { stop(); }
+
+	// start the worker thread which trims once per ended frame.
+	HRESULT start() {
+		if (mThread.joinable()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mStopping = false;
+		mThread = std::thread([this]() { workerLoop(); });
+		return S_OK;
+	}
+
+	// stop the worker thread after its current pass (the offered resources stay offered).
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mStopping = true;
+		}
+		mWake.notify_all();
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+	}
+
+	// register a resident resource with its size.
+	Handle add(OfferableResource* resource, UINT64 size) {
+		std::lock_guard<std::mutex> lock(mLock);
+		Entry entry = {};
+		entry.resource = resource;
+		entry.size = size;
+		entry.lastUse = mFrame;
+		entry.state = OfferState::Resident;
+		if (!mFreeHandles.empty()) {
+			auto handle = mFreeHandles.back();
+			mFreeHandles.pop_back();
+			mEntries[handle] = entry;
+			return handle;
+		}
+		mEntries.push_back(entry);
+		return static_cast<Handle>(mEntries.size() - 1);
+	}
+
+	// unregister the resource, and reclaim it if it has been offered.
+	HRESULT remove(Handle handle) {
+		auto result = use(handle);
+		std::lock_guard<std::mutex> lock(mLock);
+		mEntries[handle] = {};
+		mFreeHandles.push_back(handle);
+		return result;
+	}
+
+	// mark the resource used in this frame, and reclaim it if it has been offered.
+	HRESULT use(Handle handle) {
+		std::unique_lock<std::mutex> lock(mLock);
+		mEntries[handle].lastUse = mFrame;
+		if (mEntries[handle].state == OfferState::Resident) {
+			return S_OK;
+		}
+
+		// wait for an offer or a reclaim in progress before reclaiming.
+		auto start = mTime.now();
+		mChanged.wait(lock, [&]() {
+			auto state = mEntries[handle].state;
+			return state != OfferState::Offering && state != OfferState::Reclaiming;
+		});
+		if (mEntries[handle].state == OfferState::Resident) {
+			mStats.stalls++;
+			mStats.stallTicks += mTime.now() - start;
+			return S_OK;
+		}
+		mEntries[handle].state = OfferState::Reclaiming;
+		auto resource = mEntries[handle].resource;
+		auto size = mEntries[handle].size;
+		lock.unlock();
+
+		// reclaim without the lock, so the other resources can be used and offered meanwhile.
+		auto reclaim = DXGI_RECLAIM_RESOURCE_RESULT_OK;
+		auto result = resource->reclaim(&reclaim);
+		int64_t reuploadTicks = 0;
+		if (SUCCEEDED(result) && reclaim != DXGI_RECLAIM_RESOURCE_RESULT_OK) {
+			auto reuploadStart = mTime.now();
+			result = resource->reupload();
+			reuploadTicks = mTime.now() - reuploadStart;
+		}
+
+		lock.lock();
+		auto& entry = mEntries[handle];
+		entry.state = SUCCEEDED(result) ? OfferState::Resident : OfferState::Offered;
+		if (SUCCEEDED(result)) {
+			mOfferedBytes -= size;
+			if (reclaim == DXGI_RECLAIM_RESOURCE_RESULT_OK) {
+				mStats.reclaims++;
+				mStats.reclaimedBytes += size;
+			} else {
+				mStats.discards++;
+				mStats.discardedBytes += size;
+				mStats.reuploadTicks += reuploadTicks;
+			}
+		}
+		mStats.stalls++;
+		mStats.stallTicks += mTime.now() - start;
+		lock.unlock();
+		mChanged.notify_all();
+		return result;
+	}
+
+	// advance to the next frame and let the worker trim.
+	void endFrame() {
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mFrame++;
+			mStats.frames++;
+		}
+		mWake.notify_one();
+	}
+
+	// offer the idle resources, within the limits of a single frame.
+	HRESULT trim() {
+		auto start = mTime.now();
+		std::unique_lock<std::mutex> lock(mLock);
+		mCandidates.clear();
+		for (Handle i = 0; i < mEntries.size(); i++) {
+			auto& entry = mEntries[i];
+			if (entry.resource != nullptr && entry.state == OfferState::Resident && mFrame - entry.lastUse >= mDesc.idleFrames) {
+				mCandidates.push_back(i);
+			}
+		}
+		std::sort(mCandidates.begin(), mCandidates.end(), [this](Handle a, Handle b) { return mEntries[a].lastUse < mEntries[b].lastUse; });
+
+		// mark the whole batch, so that a use during the offers waits for it.
+		UINT64 bytes = 0;
+		mBatch.clear();
+		for (auto handle : mCandidates) {
+			auto& entry = mEntries[handle];
+			if (mBatch.size() >= mDesc.maxOffersPerFrame || (!mBatch.empty() && bytes + entry.size > mDesc.maxOfferBytesPerFrame)) {
+				break;
+			}
+			entry.state = OfferState::Offering;
+			mBatch.push_back({ handle, entry.resource, entry.size });
+			bytes += entry.size;
+		}
+		lock.unlock();
+
+		auto result = S_OK;
+		for (auto& offer : mBatch) {
+			auto offerResult = FAILED(result) ? result : offer.resource->offer(mDesc.priority);
+			lock.lock();
+			mEntries[offer.handle].state = SUCCEEDED(offerResult) ? OfferState::Offered : OfferState::Resident;
+			if (SUCCEEDED(offerResult)) {
+				mOfferedBytes += offer.size;
+				mStats.offers++;
+				mStats.offeredBytes += offer.size;
+			}
+			lock.unlock();
+			mChanged.notify_all();
+			result = offerResult;
+		}
+
+		lock.lock();
+		mStats.passes++;
+		mStats.passTicks += mTime.now() - start;
+		return result;
+	}
+
+	OfferState state(Handle handle) const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mEntries[handle].state;
+	}
+
+	// get the bytes which are currently offered.
+	UINT64 offeredBytes() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mOfferedBytes;
+	}
+
+	// get the first failure of the worker thread (S_OK if none).
+	HRESULT result() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mResult;
+	}
+
+	TrimmerStats stats() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mStats;
+	}
+private:
+	struct Entry {
+		OfferableResource*	resource;
+		UINT64				size;
+		uint64_t			lastUse;
+		OfferState			state;
+	};
+
+	struct Offer {
+		Handle				handle;
+		OfferableResource*	resource;
+		UINT64				size;
+	};
+
+	void workerLoop() {
+		uint64_t trimmed = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mLock);
+				mWake.wait(lock, [&]() { return mStopping || mFrame != trimmed; });
+				if (mStopping) {
+					return;
+				}
+				trimmed = mFrame;
+			}
+			auto result = trim();
+			if (FAILED(result)) {
+				std::lock_guard<std::mutex> lock(mLock);
+				mResult = SUCCEEDED(mResult) ? result : mResult;
+			}
+		}
+	}
+
+	TimeSource&					mTime;
+	TrimmerDesc					mDesc;
+	TrimmerStats				mStats;
+	uint64_t					mFrame;
+	UINT64						mOfferedBytes;
+	bool						mStopping;
+	HRESULT						mResult;
+	std::vector<Entry>			mEntries;
+	std::vector<Handle>			mFreeHandles;
+	std::vector<Handle>			mCandidates;
+	std::vector<Offer>			mBatch;
+	mutable std::mutex			mLock;
+	std::condition_variable		mChanged;	// signaled when an offer or a reclaim completes.
+	std::condition_variable		mWake;		// signaled when a frame ends or the trimmer stops.
+	std::thread					mThread;
+};
+
+// ============================================================================
+// DiscardableHeap
+//
+// A stand-in for the memory manager of the OS, so the trimmer can be exercised
+// on machines without a Windows display. The heap commits blocks of system
+// memory and keeps the offered blocks in the order of their offers. Whenever
+// the committed bytes exceed the limit (e.g. when the limit is lowered to act
+// like the memory pressure of other processes), the oldest offered blocks are
+// freed and a later reclaim of them reports that they have been discarded.
+// ============================================================================
+class DiscardableHeap final {
+public:
+	explicit DiscardableHeap(UINT64 limit) : mLimit(limit), mCommitted(0), mPeak(0), mOffered(0), mDiscarded(0) {}
+
+	// change the limit, and discard the offered blocks which no longer fit.
+	void setLimit(UINT64 limit) {
+		std::lock_guard<std::mutex> lock(mLock);
+		mLimit = limit;
+		enforce();
+	}
+
+	// allocate the memory of a block (the block is then resident).
+	void allocate(std::vector<BYTE>& block, UINT64 size) {
+		block.resize(static_cast<size_t>(size));
+		std::lock_guard<std::mutex> lock(mLock);
+		mCommitted += size;
+		mPeak = std::max(mPeak, mCommitted);
+		enforce();
+	}
+
+	// free the memory of a resident block.
+	void release(std::vector<BYTE>& block) {
+		std::lock_guard<std::mutex> lock(mLock);
+		mCommitted -= block.size();
+		std::vector<BYTE>().swap(block);
+	}
+
+	void offer(std::vector<BYTE>& block) {
+		std::lock_guard<std::mutex> lock(mLock);
+		mBlocks.push_back(&block);
+		mOffered += block.size();
+		enforce();
+	}
+
+	// take the block back, or tell that it has been discarded (and must be allocated again).
+	DXGI_RECLAIM_RESOURCE_RESULTS reclaim(std::vector<BYTE>& block) {
+		std::lock_guard<std::mutex> lock(mLock);
+		auto it = std::find(mBlocks.begin(), mBlocks.end(), &block);
+		if (it == mBlocks.end()) {
+			return DXGI_RECLAIM_RESOURCE_RESULT_DISCARDED;
+		}
+		mBlocks.erase(it);
+		mOffered -= block.size();
+		return DXGI_RECLAIM_RESOURCE_RESULT_OK;
+	}
+
+	UINT64 limit() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mLimit;
+	}
+
+	UINT64 committed() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mCommitted;
+	}
+
+	UINT64 peakCommitted() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mPeak;
+	}
+
+	// get the bytes of the offered blocks which have not been discarded.
+	UINT64 offeredBytes() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mOffered;
+	}
+
+	// get the bytes discarded in total.
+	UINT64 discardedBytes() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mDiscarded;
+	}
+private:
+	void enforce() {
+		while (mCommitted > mLimit && !mBlocks.empty()) {
+			auto block = mBlocks.front();
+			mBlocks.pop_front();
+			mCommitted -= block->size();
+			mOffered -= block->size();
+			mDiscarded += block->size();
+			std::vector<BYTE>().swap(*block);
+		}
+	}
+
+	UINT64							mLimit;
+	UINT64							mCommitted;
+	UINT64							mPeak;
+	UINT64							mOffered;
+	UINT64							mDiscarded;
+	std::deque<std::vector<BYTE>*>	mBlocks;
+	mutable std::mutex				mLock;
+};
+
+// a resource in a discardable heap, whose contents are generated from a seed on each upload.
+class HeapResource final : public OfferableResource {
+public:
+	HeapResource(DiscardableHeap& heap, UINT64 size, uint32_t seed) : mHeap(heap), mSize(size), mSeed(seed), mUploads(0), mOffered(false) {
+		upload();
+	}
+
+	// the heap only knows the offered blocks, so a resident block is released without the reclaim.
+	~HeapResource() {
+		if (mOffered) {
+			mHeap.reclaim(mData);
+		}
+		if (!mData.empty()) {
+			mHeap.release(mData);
+		}
+	}
+
+	HRESULT offer(DXGI_OFFER_RESOURCE_PRIORITY) override {
+		mHeap.offer(mData);
+		mOffered = true;
+		return S_OK;
+	}
+
+	HRESULT reclaim(DXGI_RECLAIM_RESOURCE_RESULTS* result) override {
+		if (result == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*result = mHeap.reclaim(mData);
+		mOffered = false;
+		return S_OK;
+	}
+
+	HRESULT reupload() override {
+		upload();
+		return S_OK;
+	}
+
+	// check that the contents match the seed (i.e. they were not lost without a discard).
+	bool valid() const {
+		if (mData.size() != mSize) {
+			return false;
+		}
+		auto words = reinterpret_cast<const uint32_t*>(mData.data());
+		auto state = mSeed;
+		for (size_t i = 0; i < mData.size() / 4; i++) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			if (words[i] != state) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	UINT64 size() const { return mSize; }
+	uint64_t uploads() const { return mUploads; }
+private:
+	void upload() {
+		mHeap.allocate(mData, mSize);
+		auto words = reinterpret_cast<uint32_t*>(mData.data());
+		auto state = mSeed;
+		for (size_t i = 0; i < mData.size() / 4; i++) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			words[i] = state;
+		}
+		mUploads++;
+	}
+
+	DiscardableHeap&	mHeap;
+	std::vector<BYTE>	mData;
+	UINT64				mSize;
+	uint32_t			mSeed;
+	uint64_t			mUploads;
+	bool				mOffered;
+};
+
+#if defined(_WIN32)
+// ============================================================================
+// DxgiOfferableResource
+//
+// Offers a D3D resource with IDXGIDevice4::OfferResources1 (DXGI 1.5), which
+// also allows the OS to decommit the memory, or with the OfferResources of the
+// IDXGIDevice2 (DXGI 1.2) on older systems. The upload function is called to
+// restore the contents after they have been discarded. Note that the resource
+// must not be bound to the pipeline when offered, and that render targets and
+// staging resources can not be offered.
+// ============================================================================
+class DxgiOfferableResource final : public OfferableResource {
+public:
+	typedef std::function<HRESULT()> UploadFunction;
+
+	DxgiOfferableResource(IDXGIDevice2* device, IDXGIResource* resource, UploadFunction upload)
+		: mDevice(device), mResource(resource), mUpload(std::move(upload)) {
+		mDevice.As(&mDevice4);
+	}
+
+	HRESULT offer(DXGI_OFFER_RESOURCE_PRIORITY priority) override {
+		IDXGIResource* resources[] = { mResource.Get() };
+		if (mDevice4) {
+			return mDevice4->OfferResources1(1, resources, priority, DXGI_OFFER_RESOURCE_FLAG_ALLOW_DECOMMIT);
+		}
+		return mDevice->OfferResources(1, resources, priority);
+	}
+
+	HRESULT reclaim(DXGI_RECLAIM_RESOURCE_RESULTS* result) override {
+		if (result == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		IDXGIResource* resources[] = { mResource.Get() };
+		if (mDevice4) {
+			return mDevice4->ReclaimResources1(1, resources, result);
+		}
+		BOOL discarded = FALSE;
+		auto hr = mDevice->ReclaimResources(1, resources, &discarded);
+		*result = discarded ? DXGI_RECLAIM_RESOURCE_RESULT_DISCARDED : DXGI_RECLAIM_RESOURCE_RESULT_OK;
+		return hr;
+	}
+
+	HRESULT reupload() override {
+		return mUpload ? mUpload() : S_OK;
+	}
+private:
+	Microsoft::WRL::ComPtr<IDXGIDevice2>	mDevice;
+	Microsoft::WRL::ComPtr<IDXGIDevice4>	mDevice4;
+	Microsoft::WRL::ComPtr<IDXGIResource>	mResource;
+	UploadFunction							mUpload;
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "image_encode.h"
+#include "staging_pool.h"
+#include "thread_pool.h"
+#include "time_source.h"
+
+// ============================================================================
+// ScreenshotPipeline
+//
+// Captures back buffers into image files without stalling the present thread.
+// A capture goes through the following stages.
+//
+//		Copying		-- The GPU copies the back buffer into a staging surface
+//		Encoding	-- A worker converts and encodes the mapped surface into a file
+//		Encoded		-- The surface waits to be unmapped and re-used
+//
+// The present thread calls capture right before the Present, which records
+// the copy with the given function and fences it. All the backend calls are
+// made on the present thread, but none of them blocks: poll (which capture
+// calls as well) maps only the surfaces whose fence has been completed and
+// unmaps the ones which the workers have encoded. It should be called once
+// per frame. The encoding itself is chunked by rows on the thread pool (see
+// image_encode.h). A pool without workers (e.g. on a single core) would make
+// poll encode on the present thread, so the pipeline then encodes on a worker
+// of its own, and the encoding of each file runs on that thread serially.
+//
+// Staging surfaces are pooled per size class like in the StagingPool. If all
+// the surfaces of a class are busy, the capture is dropped and capture returns
+// DXGI_ERROR_WAS_STILL_DRAWING instead of waiting. Only flush (e.g. before the
+// device is released) waits for the captures in flight.
+//
+// The backend must create CPU readable surfaces, e.g. the D3D10StagingBackend
+// with D3D10_CPU_ACCESS_READ or the MemoryStagingBackend.
+// ============================================================================
+
+// a staging surface which the GPU copy of a capture should write into.
+struct ScreenshotTarget {
+	UINT		surface;	// the backend surface identifier.
+	UINT		width;		// the captured width in pixels.
+	UINT		height;		// the captured height in pixels.
+	DXGI_FORMAT	format;		// the format of the surface.
+};
+
+// the outcome of a capture, which is given to the completion function.
+struct ScreenshotResult {
+	UINT64		id;				// the identifier given by capture.
+	HRESULT		result;			// the result of the encoding and the writing.
+	std::string	path;			// the path of the file.
+	size_t		bytes;			// the size of the file.
+	int64_t		encodeTicks;	// ticks spent converting, encoding and writing.
+	int64_t		latencyTicks;	// ticks from the capture until the file was written.
+};
+
+// details about the captures of the pipeline.
+struct ScreenshotStats {
+	UINT64	requests;			// the capture calls.
+	UINT64	dropped;			// captures dropped as the staging surfaces were busy.
+	UINT64	written;			// the written files.
+	UINT64	failed;				// captures which failed after they were accepted.
+	UINT64	presentCalls;		// capture and poll calls on the present thread.
+	int64_t	presentTicks;		// total ticks spent in capture and poll.
+	int64_t	maxPresentTicks;	// the longest capture or poll call.
+	UINT	surfaces;			// the created staging surfaces.
+};
+
+// the configuration of a screenshot pipeline.
+struct ScreenshotDesc {
+	ImageFormat										format;				// the format of the files.
+	UINT											surfacesPerClass;	// the captures of a size in flight at most.
+	std::function<void(const ScreenshotResult&)>	completion;			// called on a worker for each accepted capture.
+};
+
+// a utility to get a description which writes PNG files with three captures in flight.
+inline ScreenshotDesc defaultScreenshotDesc() {
+	return { ImageFormat::Png, 3, nullptr };
+}
+
+class ScreenshotPipeline final {
+public:
+	// a function to record the GPU copy from the back buffer into the target.
+	typedef std::function<void(const ScreenshotTarget&)> CopyFunc;
+
+	ScreenshotPipeline(StagingBackend& backend, ThreadPool& pool, TimeSource& time, const ScreenshotDesc& desc = defaultScreenshotDesc())
+		: mBackend(backend), mPool(pool), mTime(time), mDesc(desc), mStats(), mNextId(0),
+		mEncoder(pool.workers() > 0 ? nullptr : std::make_unique<ThreadPool>(1)) {
+		mDesc.surfacesPerClass = mDesc.surfacesPerClass > 0 ? mDesc.surfacesPerClass : 1;
+	}
+
+	~ScreenshotPipeline() {
+		flush();
+	}
+
+	ScreenshotPipeline(const ScreenshotPipeline&) = delete;
+	ScreenshotPipeline& operator=(const ScreenshotPipeline&) = delete;
+
+	// copy the back buffer of the given size into a staging surface and encode it into the path.
+	HRESULT capture(UINT width, UINT height, DXGI_FORMAT format, const CopyFunc& copy, const std::string& path, UINT64* id = nullptr) {
+		auto start = mTime.now();
+		pollSlots();
+		auto result = startCapture(width, height, format, copy, path, id);
+		account(start, true, result);
+		return result;
+	}
+
+	// hand the finished copies to the workers and recycle the encoded surfaces.
+	void poll() {
+		auto start = mTime.now();
+		pollSlots();
+		account(start, false, S_OK);
+	}
+
+	// wait until all the accepted captures have been written.
+	HRESULT flush() {
+		for (;;) {
+			pollSlots();
+			UINT64 fence = 0;
+			{
+				std::unique_lock<std::mutex> lock(mLock);
+				auto encoding = false;
+				for (auto& slot : mSlots) {
+					fence = slot->state == SlotState::Copying ? std::max(fence, slot->fence) : fence;
+					encoding = encoding || slot->state == SlotState::Encoding || slot->state == SlotState::Encoded;
+				}
+				if (fence == 0 && !encoding) {
+					return S_OK;
+				} else if (fence == 0) {
+					mIdle.wait(lock, [this] { return !anyEncoding(); });
+					continue;
+				}
+			}
+			auto result = mBackend.waitFor(fence);
+			if (FAILED(result)) {
+				return result;
+			}
+		}
+	}
+
+	ScreenshotStats stats() const {
+		std::lock_guard<std::mutex> lock(mLock);
+		return mStats;
+	}
+private:
+	enum class SlotState {
+		Free,
+		Copying,
+		Encoding,
+		Encoded
+	};
+
+	struct Slot {
+		UINT				surface;
+		UINT				classWidth;
+		UINT				classHeight;
+		DXGI_FORMAT			format;
+		SlotState			state;
+		UINT64				fence;
+		DXGI_MAPPED_RECT	rect;
+		UINT				width;
+		UINT				height;
+		UINT64				id;
+		std::string			path;
+		int64_t				start;
+	};
+
+	static UINT roundUp(UINT size) {
+		return (size + StagingPool::SIZE_GRANULARITY - 1) / StagingPool::SIZE_GRANULARITY * StagingPool::SIZE_GRANULARITY;
+	}
+
+	HRESULT startCapture(UINT width, UINT height, DXGI_FORMAT format, const CopyFunc& copy, const std::string& path, UINT64* id) {
+		if (width == 0 || height == 0 || pixelLayout(format) == PixelLayout::Unknown || !copy) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto classWidth = roundUp(width);
+		auto classHeight = roundUp(height);
+		Slot* found = nullptr;
+		UINT count = 0;
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			for (auto& slot : mSlots) {
+				if (slot->classWidth == classWidth && slot->classHeight == classHeight && slot->format == format) {
+					count++;
+					found = found == nullptr && slot->state == SlotState::Free ? slot.get() : found;
+				}
+			}
+		}
+		if (found == nullptr && count >= mDesc.surfacesPerClass) {
+			return DXGI_ERROR_WAS_STILL_DRAWING;
+		} else if (found == nullptr) {
+			auto slot = std::make_unique<Slot>();
+			auto result = mBackend.createSurface(classWidth, classHeight, format, &slot->surface);
+			if (FAILED(result)) {
+				return result;
+			}
+			slot->classWidth = classWidth;
+			slot->classHeight = classHeight;
+			slot->format = format;
+			slot->state = SlotState::Free;
+			found = slot.get();
+			std::lock_guard<std::mutex> lock(mLock);
+			mSlots.push_back(std::move(slot));
+			mStats.surfaces++;
+		}
+
+		// only the present thread changes a free slot, so the copy needs no lock.
+		copy({ found->surface, width, height, format });
+		found->fence = mBackend.signal();
+		found->width = width;
+		found->height = height;
+		found->id = ++mNextId;
+		found->path = path;
+		found->start = mTime.now();
+		std::lock_guard<std::mutex> lock(mLock);
+		found->state = SlotState::Copying;
+		if (id != nullptr) {
+			*id = found->id;
+		}
+		return S_OK;
+	}
+
+	void pollSlots() {
+		auto completed = mBackend.completedValue();
+		std::vector<ScreenshotResult> failures;
+		std::vector<Slot*> mapped;
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			for (auto& entry : mSlots) {
+				auto slot = entry.get();
+				if (slot->state == SlotState::Encoded) {
+					mBackend.unmap(slot->surface);
+					slot->state = SlotState::Free;
+				} else if (slot->state == SlotState::Copying && slot->fence <= completed) {
+					auto result = mBackend.map(slot->surface, DXGI_MAP_READ, &slot->rect);
+					if (FAILED(result)) {
+						slot->state = SlotState::Free;
+						mStats.failed++;
+						failures.push_back({ slot->id, result, slot->path, 0, 0, mTime.now() - slot->start });
+						continue;
+					}
+					slot->state = SlotState::Encoding;
+					mapped.push_back(slot);
+				}
+			}
+		}
+		for (auto slot : mapped) {
+			(mEncoder ? *mEncoder : mPool).submit([this, slot] { encode(slot); });
+		}
+		for (auto& failure : failures) {
+			if (mDesc.completion) {
+				mDesc.completion(failure);
+			}
+		}
+	}
+
+	// convert, encode and write the mapped surface on a worker.
+	void encode(Slot* slot) {
+		auto start = mTime.now();
+		std::vector<BYTE> data;
+		auto view = surfaceView(slot->rect, slot->width, slot->height, slot->format);
+		auto result = encodeImage(view, mDesc.format, &mPool, &data);
+		if (SUCCEEDED(result)) {
+			result = writeImageFile(slot->path, data);
+		}
+		auto end = mTime.now();
+		if (mDesc.completion) {
+			mDesc.completion({ slot->id, result, slot->path, data.size(), end - start, end - slot->start });
+		}
+		// the pipeline may be destroyed as soon as the slot is seen encoded, so notify under the lock.
+		std::lock_guard<std::mutex> lock(mLock);
+		slot->state = SlotState::Encoded;
+		mStats.written += SUCCEEDED(result) ? 1 : 0;
+		mStats.failed += SUCCEEDED(result) ? 0 : 1;
+		mIdle.notify_all();
+	}
+
+	bool anyEncoding() const {
+		for (auto& slot : mSlots) {
+			if (slot->state == SlotState::Encoding) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void account(int64_t start, bool request, HRESULT result) {
+		auto ticks = mTime.now() - start;
+		std::lock_guard<std::mutex> lock(mLock);
+		mStats.requests += request ? 1 : 0;
+		mStats.dropped += result == DXGI_ERROR_WAS_STILL_DRAWING ? 1 : 0;
+		mStats.presentCalls++;
+		mStats.presentTicks += ticks;
+		mStats.maxPresentTicks = std::max(mStats.maxPresentTicks, ticks);
+	}
+
+	StagingBackend&						mBackend;
+	ThreadPool&							mPool;
+	TimeSource&							mTime;
+	ScreenshotDesc						mDesc;
+	mutable std::mutex					mLock;
+	std::condition_variable				mIdle;
+	std::vector<std::unique_ptr<Slot>>	mSlots;
+	ScreenshotStats						mStats;
+	UINT64								mNextId;
+	std::unique_ptr<ThreadPool>			mEncoder;	// a worker of its own if the pool has none (destroyed first).
+};
\ No newline at end of file
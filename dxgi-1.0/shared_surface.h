@@ -0,0 +1,435 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#include <d3d10.h>
+#include <wrl/client.h>
+#endif
+
+// ============================================================================
+// SharedSurface
+//
+// A surface whose memory is shared between processes, so a producer (e.g. a
+// capture process) can hand the frames to a consumer (e.g. a compositor)
+// without copying them. The access is coordinated with a keyed mutex like the
+// IDXGIKeyedMutex of the DXGI 1.1 synchronized shared surfaces.
+//
+//   - GetDesc		-- Get information about the surface
+//   - AcquireSync	-- Wait until the surface is released with the given key
+//   - ReleaseSync	-- Release the surface for the acquirer of the given key
+//
+// The key of the release decides who may acquire next, so the processes can
+// pass the surface back and forth without any other synchronization. Initially
+// the surface is released with the key 0.
+//
+//		producer:	AcquireSync(0, INFINITE); render(); ReleaseSync(1);
+//		consumer:	AcquireSync(1, INFINITE); compose(); ReleaseSync(0);
+//
+// AcquireSync gives the following results (note that both WAIT_ codes are
+// successful HRESULTs, so the result must be compared with S_OK).
+//
+//		S_OK			-- The surface was acquired
+//		WAIT_TIMEOUT	-- The surface was not released with the key in time
+//		WAIT_ABANDONED	-- The holder went away without a release, so the
+//						   contents are undefined and the surface should be
+//						   created again
+//
+// The surface is acquired by a handle (an opened SharedSurface) and not by a
+// thread, and a handle may not acquire the surface twice. The backends are
+// D3D10SharedSurface on Windows (a D3D10 texture with a keyed mutex) and
+// PosixSharedSurface on Linux (POSIX shared memory and a futex).
+// ============================================================================
+class SharedSurface {
+public:
+	virtual ~SharedSurface() = default;
+	virtual HRESULT GetDesc(DXGI_SURFACE_DESC* desc) = 0;
+	virtual HRESULT AcquireSync(UINT64 key, DWORD milliseconds) = 0;
+	virtual HRESULT ReleaseSync(UINT64 key) = 0;
+};
+
+#if defined(__linux__)
+// ============================================================================
+// PosixSharedSurface
+//
+// A shared surface in a POSIX shared memory object, which is exported with
+// its name (like "/capture-0") instead of a handle. The memory starts with a
+// header which holds the description and the state of the keyed mutex, and is
+// followed by the rows of the surface, each aligned to ROW_ALIGNMENT bytes.
+//
+// The keyed mutex is a lock word and the key of the latest release. Each
+// release bumps a generation word, which is the futex the acquirers sleep on,
+// and wakes them only if someone is waiting, so an uncontended handoff costs
+// no system calls. The waiters check every ABANDON_CHECK_MS whether the holder
+// process is still alive. Like in DXGI, also closing a handle which holds the
+// surface abandons it.
+//
+// The mapped memory is accessed with Map and Unmap, which require the surface
+// to be acquired by this handle. The creator removes the name when it closes
+// its handle, but the memory stays valid until all the handles are closed.
+// ============================================================================
+class PosixSharedSurface final : public SharedSurface {
+public:
+	static constexpr UINT ROW_ALIGNMENT = 64;
+	static constexpr DWORD ABANDON_CHECK_MS = 100;
+
+	// create a new shared memory object with the name.
+	static HRESULT create(const std::string& name, UINT width, UINT height, DXGI_FORMAT format, std::shared_ptr<PosixSharedSurface>* surface) {
+		auto bytesPerPixel = formatBytesPerPixel(format);
+		if (surface == nullptr || width == 0 || height == 0 || bytesPerPixel == 0) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto pitch = (width * bytesPerPixel + ROW_ALIGNMENT - 1) & ~(ROW_ALIGNMENT - 1);
+		auto size = HEADER_SIZE + static_cast<size_t>(pitch) * height;
+		auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) {
+			return errnoResult();
+		}
+		if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+			auto result = errnoResult();
+			close(fd);
+			shm_unlink(name.c_str());
+			return result;
+		}
+		std::shared_ptr<PosixSharedSurface> result(new PosixSharedSurface(name, fd, true));
+		auto hr = result->map(size);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		// the object is zero filled, so only the description needs to be written.
+		auto header = result->mHeader;
+		header->width = width;
+		header->height = height;
+		header->pitch = pitch;
+		header->format = format;
+		header->size = size;
+		header->magic.store(MAGIC, std::memory_order_release);
+		*surface = result;
+		return S_OK;
+	}
+
+	// open a shared memory object created by another handle (e.g. in another process).
+	static HRESULT open(const std::string& name, std::shared_ptr<PosixSharedSurface>* surface) {
+		if (surface == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto fd = shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0) {
+			return errnoResult();
+		}
+		std::shared_ptr<PosixSharedSurface> result(new PosixSharedSurface(name, fd, false));
+		struct stat status = {};
+		if (fstat(fd, &status) != 0) {
+			return errnoResult();
+		}
+		if (static_cast<size_t>(status.st_size) < HEADER_SIZE) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto hr = result->map(static_cast<size_t>(status.st_size));
+		if (FAILED(hr)) {
+			return hr;
+		}
+		auto header = result->mHeader;
+		if (header->magic.load(std::memory_order_acquire) != MAGIC || header->size != static_cast<size_t>(status.st_size)) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*surface = result;
+		return S_OK;
+	}
+
+	PosixSharedSurface(const PosixSharedSurface&) = delete;
+	PosixSharedSurface& operator=(const PosixSharedSurface&) = delete;
+
+	~PosixSharedSurface() {
+		if (mHeader != nullptr) {
+			if (mHeld) {
+				mHeader->abandoned.store(1, std::memory_order_seq_cst);
+				wake();
+			}
+			munmap(mHeader, mSize);
+		}
+		if (mFile >= 0) {
+			close(mFile);
+		}
+		if (mCreator) {
+			shm_unlink(mName.c_str());
+		}
+	}
+
+	HRESULT GetDesc(DXGI_SURFACE_DESC* desc) override {
+		if (desc == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		desc->Width = mHeader->width;
+		desc->Height = mHeader->height;
+		desc->Format = mHeader->format;
+		desc->SampleDesc.Count = 1;
+		desc->SampleDesc.Quality = 0;
+		return S_OK;
+	}
+
+	HRESULT AcquireSync(UINT64 key, DWORD milliseconds) override {
+		if (mHeld) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto& header = *mHeader;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+		for (;;) {
+			if (header.abandoned.load(std::memory_order_acquire) != 0) {
+				return WAIT_ABANDONED;
+			}
+			auto generation = header.generation.load(std::memory_order_seq_cst);
+			if (header.key.load(std::memory_order_relaxed) == key) {
+				uint32_t expected = 0;
+				if (header.locked.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+					// the key is written only while locked, so now it is stable.
+					if (header.key.load(std::memory_order_relaxed) == key) {
+						header.owner.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+						mHeld = true;
+						return S_OK;
+					}
+					header.locked.store(0, std::memory_order_release);
+					wake();
+					continue;
+				}
+			}
+
+			auto slice = static_cast<int64_t>(ABANDON_CHECK_MS) * 1000000;
+			if (milliseconds != INFINITE) {
+				auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (remaining <= 0) {
+					return WAIT_TIMEOUT;
+				}
+				slice = std::min<int64_t>(slice, remaining);
+			}
+			header.waiters.fetch_add(1, std::memory_order_seq_cst);
+			timespec timeout = { static_cast<time_t>(slice / 1000000000), static_cast<long>(slice % 1000000000) };
+			auto woken = syscall(SYS_futex, &header.generation, FUTEX_WAIT, generation, &timeout, nullptr, 0) == 0 || errno != ETIMEDOUT;
+			header.waiters.fetch_sub(1, std::memory_order_seq_cst);
+			if (!woken && ownerDied()) {
+				header.abandoned.store(1, std::memory_order_seq_cst);
+				wake();
+				return WAIT_ABANDONED;
+			}
+		}
+	}
+
+	HRESULT ReleaseSync(UINT64 key) override {
+		if (!mHeld || mMapped) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mHeld = false;
+		mHeader->owner.store(0, std::memory_order_relaxed);
+		mHeader->key.store(key, std::memory_order_relaxed);
+		mHeader->locked.store(0, std::memory_order_release);
+		wake();
+		return S_OK;
+	}
+
+	HRESULT Map(DXGI_MAPPED_RECT* rect, UINT flags) {
+		if (rect == nullptr || flags == 0 || !mHeld || mMapped) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMapped = true;
+		rect->Pitch = static_cast<INT>(mHeader->pitch);
+		rect->pBits = reinterpret_cast<BYTE*>(mHeader) + HEADER_SIZE;
+		return S_OK;
+	}
+
+	HRESULT Unmap() {
+		if (!mMapped) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMapped = false;
+		return S_OK;
+	}
+
+	const std::string& name() const { return mName; }
+	UINT pitch() const { return mHeader->pitch; }
+	size_t size() const { return mSize - HEADER_SIZE; }
+private:
+	static constexpr uint32_t MAGIC = 0x46525344;	// "DSRF"
+	static constexpr size_t HEADER_SIZE = 4096;
+
+	// the header at the beginning of the shared memory (all the processes must agree on it).
+	struct Header {
+		std::atomic<uint32_t>	magic;		// written last by the creator.
+		UINT					width;
+		UINT					height;
+		UINT					pitch;
+		DXGI_FORMAT				format;
+		size_t					size;		// the size of the whole object.
+		alignas(64) std::atomic<uint32_t>	locked;
+		std::atomic<uint32_t>	generation;	// the futex, which is bumped by each release.
+		std::atomic<uint32_t>	waiters;
+		std::atomic<uint32_t>	abandoned;
+		std::atomic<int32_t>	owner;		// the process which holds the surface.
+		std::atomic<uint64_t>	key;		// the key of the latest release.
+	};
+	static_assert(sizeof(Header) <= HEADER_SIZE, "the header must fit before the rows");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+	PosixSharedSurface(const std::string& name, int file, bool creator)
+		: mName(name), mFile(file), mCreator(creator), mHeld(false), mMapped(false), mHeader(nullptr), mSize(0) {}
+
+	static HRESULT errnoResult() {
+		switch (errno) {
+		case ENOENT:	return DXGI_ERROR_NOT_FOUND;
+		case EEXIST:	return DXGI_ERROR_NAME_ALREADY_EXISTS;
+		case ENOMEM:	return E_OUTOFMEMORY;
+		case EINVAL:	return E_INVALIDARG;
+		default:		return E_FAIL;
+		}
+	}
+
+	HRESULT map(size_t size) {
+		auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+		if (memory == MAP_FAILED) {
+			return errnoResult();
+		}
+		mHeader = static_cast<Header*>(memory);
+		mSize = size;
+		return S_OK;
+	}
+
+	void wake() {
+		mHeader->generation.fetch_add(1, std::memory_order_seq_cst);
+		if (mHeader->waiters.load(std::memory_order_seq_cst) != 0) {
+			syscall(SYS_futex, &mHeader->generation, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+		}
+	}
+
+	bool ownerDied() const {
+		auto owner = mHeader->owner.load(std::memory_order_relaxed);
+		return mHeader->locked.load(std::memory_order_acquire) != 0 && owner != 0 && kill(owner, 0) != 0 && errno == ESRCH;
+	}
+
+	std::string	mName;
+	int			mFile;
+	bool		mCreator;
+	bool		mHeld;
+	bool		mMapped;
+	Header*		mHeader;
+	size_t		mSize;		// the size of the mapping.
+};
+#endif
+
+#if defined(_WIN32)
+// ============================================================================
+// D3D10SharedSurface
+//
+// A D3D10 texture created with the D3D10_RESOURCE_MISC_SHARED_KEYEDMUTEX, so
+// it can be opened by the other devices and processes with the handle of the
+// IDXGIResource::GetSharedHandle. The keyed mutex is the IDXGIKeyedMutex of the
+// texture. The texture is a render target and a shader resource, so both the
+// producer and the consumer access it on the GPU without any copies.
+// ============================================================================
+class D3D10SharedSurface final : public SharedSurface {
+public:
+	static HRESULT create(ID3D10Device* device, UINT width, UINT height, DXGI_FORMAT format, std::shared_ptr<D3D10SharedSurface>* surface) {
+		if (device == nullptr || surface == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		D3D10_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D10_USAGE_DEFAULT;
+		desc.BindFlags = D3D10_BIND_RENDER_TARGET | D3D10_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = D3D10_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+		Microsoft::WRL::ComPtr<ID3D10Texture2D> texture;
+		auto result = device->CreateTexture2D(&desc, nullptr, &texture);
+		if (FAILED(result)) {
+			return result;
+		}
+		return wrap(texture, surface);
+	}
+
+	// open a surface with the handle which was exported by another device or process.
+	static HRESULT open(ID3D10Device* device, HANDLE handle, std::shared_ptr<D3D10SharedSurface>* surface) {
+		if (device == nullptr || surface == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		Microsoft::WRL::ComPtr<ID3D10Texture2D> texture;
+		auto result = device->OpenSharedResource(handle, IID_PPV_ARGS(&texture));
+		if (FAILED(result)) {
+			return result;
+		}
+		return wrap(texture, surface);
+	}
+
+	HRESULT GetDesc(DXGI_SURFACE_DESC* desc) override {
+		if (desc == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		D3D10_TEXTURE2D_DESC textureDesc = {};
+		mTexture->GetDesc(&textureDesc);
+		desc->Width = textureDesc.Width;
+		desc->Height = textureDesc.Height;
+		desc->Format = textureDesc.Format;
+		desc->SampleDesc = textureDesc.SampleDesc;
+		return S_OK;
+	}
+
+	HRESULT AcquireSync(UINT64 key, DWORD milliseconds) override {
+		return mMutex->AcquireSync(key, milliseconds);
+	}
+
+	HRESULT ReleaseSync(UINT64 key) override {
+		return mMutex->ReleaseSync(key);
+	}
+
+	// get the handle which is given to the other processes.
+	HANDLE sharedHandle() const { return mHandle; }
+	ID3D10Texture2D* texture() const { return mTexture.Get(); }
+private:
+	static HRESULT wrap(const Microsoft::WRL::ComPtr<ID3D10Texture2D>& texture, std::shared_ptr<D3D10SharedSurface>* surface) {
+		std::shared_ptr<D3D10SharedSurface> result(new D3D10SharedSurface());
+		result->mTexture = texture;
+		Microsoft::WRL::ComPtr<IDXGIResource> resource;
+		auto hr = texture.As(&resource);
+		if (SUCCEEDED(hr)) {
+			hr = resource->GetSharedHandle(&result->mHandle);
+		}
+		if (SUCCEEDED(hr)) {
+			hr = texture.As(&result->mMutex);
+		}
+		if (FAILED(hr)) {
+			return hr;
+		}
+		*surface = result;
+		return S_OK;
+	}
+
+	D3D10SharedSurface() : mHandle(nullptr) {}
+
+	Microsoft::WRL::ComPtr<ID3D10Texture2D>	mTexture;
+	Microsoft::WRL::ComPtr<IDXGIKeyedMutex>	mMutex;
+	HANDLE									mHandle;
+};
+#endif
\ No newline at end of file
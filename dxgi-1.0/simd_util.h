@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// ============================================================================
+// SIMD kernels are compiled for the following instruction set levels and the
+// best available level is selected at runtime with the detectSimdLevel.
+//
+//		SimdLevel::Scalar	-- Plain C++ which works everywhere
+//		SimdLevel::Sse41	-- x86 with SSE 4.1
+//		SimdLevel::Avx2		-- x86 with AVX2 and F16C
+//		SimdLevel::Neon		-- ARM64 Advanced SIMD (always available)
+//
+// With GCC and Clang the x86 kernels are tagged with the SIMD_TARGET_SSE41 and
+// SIMD_TARGET_AVX2 attributes, so the project itself can still be compiled for
+// the baseline architecture. MSVC allows the intrinsics without any flags.
+//
+// Note that kernels should perform the same IEEE operations in the same order
+// as their scalar counterparts, so that all levels give bit-exact results.
+// ============================================================================
+enum class SimdLevel {
+	Scalar,
+	Sse41,
+	Avx2,
+	Neon
+};
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#endif
+
+// a utility to detect the best SIMD level supported by the running CPU.
+inline SimdLevel detectSimdLevel() {
+#if defined(SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	auto maxLeaf = info[0];
+	__cpuid(info, 1);
+	auto sse41 = (info[2] & (1 << 19)) != 0;
+	auto f16c = (info[2] & (1 << 29)) != 0;
+	auto osxsave = (info[2] & (1 << 27)) != 0;
+	auto avx2 = false;
+	if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	if (avx2 && f16c) {
+		return SimdLevel::Avx2;
+	}
+	return sse41 ? SimdLevel::Sse41 : SimdLevel::Scalar;
+#elif defined(SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+		return SimdLevel::Avx2;
+	}
+	return __builtin_cpu_supports("sse4.1") ? SimdLevel::Sse41 : SimdLevel::Scalar;
+#elif defined(SIMD_NEON)
+	return SimdLevel::Neon;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+// a utility to get the best SIMD level once and cache it for the process.
+inline SimdLevel bestSimdLevel() {
+	static const auto level = detectSimdLevel();
+	return level;
+}
+
+// a utility to get string presentation of SimdLevel.
+inline const char* simdLevelString(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Scalar:
+		return "scalar";
+	case SimdLevel::Sse41:
+		return "sse4.1";
+	case SimdLevel::Avx2:
+		return "avx2";
+	case SimdLevel::Neon:
+		return "neon";
+	default:
+		return "unknown";
+	}
+}
+
+// a utility to convert a 32-bit float into a 16-bit float (round to nearest even).
+inline uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	auto sign = (bits >> 16) & 0x8000u;
+	bits &= 0x7fffffffu;
+	if (bits >= 0x47800000u) {
+		// too large values become infinity and NaNs keep the upper payload bits.
+		return static_cast<uint16_t>(sign | (bits > 0x7f800000u ? 0x7e00u | ((bits >> 13) & 0x3ffu) : 0x7c00u));
+	}
+	if (bits < 0x38800000u) {
+		// subnormal results are rounded by the FPU with a magic float addition.
+		const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float magic;
+		float shifted;
+		std::memcpy(&magic, &magicBits, sizeof(magic));
+		std::memcpy(&shifted, &bits, sizeof(shifted));
+		shifted += magic;
+		std::memcpy(&bits, &shifted, sizeof(bits));
+		return static_cast<uint16_t>(sign | (bits - magicBits));
+	}
+	auto odd = (bits >> 13) & 1u;
+	bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + odd;
+	return static_cast<uint16_t>(sign | (bits >> 13));
+}
+
+// a utility to convert a 16-bit float into a 32-bit float (always exact).
+inline float halfToFloat(uint16_t value) {
+	auto sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+	auto exponent = (value >> 10) & 0x1fu;
+	auto mantissa = static_cast<uint32_t>(value & 0x3ffu);
+	uint32_t bits;
+	if (exponent == 0x1f) {
+		// NaNs are always converted into the quiet NaNs.
+		bits = sign | 0x7f800000u | (mantissa << 13) | (mantissa != 0 ? 0x400000u : 0);
+	} else if (exponent != 0) {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	} else if (mantissa == 0) {
+		bits = sign;
+	} else {
+		exponent = 113;
+		while ((mantissa & 0x400u) == 0) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+	}
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+#if defined(SIMD_X86)
+SIMD_TARGET_SSE41 inline bool bytesEqualSse41(const uint8_t* a, const uint8_t* b, size_t size) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+			return false;
+		}
+	}
+	return std::memcmp(a + i, b + i, size - i) == 0;
+}
+
+SIMD_TARGET_AVX2 inline bool bytesEqualAvx2(const uint8_t* a, const uint8_t* b, size_t size) {
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		auto x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		auto y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		auto x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32));
+		auto y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+		auto diff = _mm256_or_si256(_mm256_xor_si256(x0, y0), _mm256_xor_si256(x1, y1));
+		if (!_mm256_testz_si256(diff, diff)) {
+			return false;
+		}
+	}
+	return bytesEqualSse41(a + i, b + i, size - i);
+}
+#endif
+
+#if defined(SIMD_NEON)
+inline bool bytesEqualNeon(const uint8_t* a, const uint8_t* b, size_t size) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		auto diff = veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+		if (vmaxvq_u8(diff) != 0) {
+			return false;
+		}
+	}
+	return std::memcmp(a + i, b + i, size - i) == 0;
+}
+#endif
+
+// a utility to compare two byte ranges with the SIMD level (like memcmp == 0).
+inline bool bytesEqual(const void* a, const void* b, size_t size, SimdLevel level) {
+	auto x = static_cast<const uint8_t*>(a);
+	auto y = static_cast<const uint8_t*>(b);
+	switch (level) {
+#if defined(SIMD_X86)
+	case SimdLevel::Avx2:
+		return bytesEqualAvx2(x, y, size);
+	case SimdLevel::Sse41:
+		return bytesEqualSse41(x, y, size);
+#elif defined(SIMD_NEON)
+	case SimdLevel::Neon:
+		return bytesEqualNeon(x, y, size);
+#endif
+	default:
+		return std::memcmp(x, y, size) == 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,484 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+#include "ref_ptr.h"
+#include "time_source.h"
+
+// ============================================================================
+// SoftwareSurface
+//
+// A CPU memory backed 2D surface which mimics the IDXGISurface Map and Unmap
+// functions. Rows are aligned to 64 bytes, so the pitch given by the Map may
+// be larger than the width multiplied with the size of a pixel in the format.
+// Surfaces are reference counted, so swap chain buffers can be shared cheaply.
+// ============================================================================
+class SoftwareSurface final : public RefCounted<SoftwareSurface> {
+public:
+	static constexpr UINT ROW_ALIGNMENT = 64;
+
+	SoftwareSurface(UINT width, UINT height, DXGI_FORMAT format)
+		: mWidth(width), mHeight(height), mFormat(format), mMapped(false) {
+		auto rowSize = width * formatBytesPerPixel(format);
+		mPitch = (rowSize + ROW_ALIGNMENT - 1) & ~(ROW_ALIGNMENT - 1);
+		mData.resize(static_cast<size_t>(mPitch) * height);
+	}
+
+	HRESULT Map(DXGI_MAPPED_RECT* rect, UINT flags) {
+		if (rect == nullptr || flags == 0 || mMapped) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMapped = true;
+		rect->Pitch = static_cast<INT>(mPitch);
+		rect->pBits = mData.data();
+		return S_OK;
+	}
+
+	HRESULT Unmap() {
+		if (!mMapped) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mMapped = false;
+		return S_OK;
+	}
+
+	UINT width() const { return mWidth; }
+	UINT height() const { return mHeight; }
+	UINT pitch() const { return mPitch; }
+	DXGI_FORMAT format() const { return mFormat; }
+	BYTE* data() { return mData.data(); }
+	const BYTE* data() const { return mData.data(); }
+	size_t size() const { return mData.size(); }
+private:
+	UINT				mWidth;
+	UINT				mHeight;
+	UINT				mPitch;
+	DXGI_FORMAT			mFormat;
+	bool				mMapped;
+	std::vector<BYTE>	mData;
+};
+
+// a single entry in the software swap chain present history.
+struct PresentRecord {
+	UINT	presentCount;	// the present count given for the frame.
+	UINT	syncInterval;	// the sync interval given for the frame.
+	UINT	queueDepth;		// frames waiting for a scan-out after the present.
+	int64_t	presentTime;	// time when Present was called.
+	int64_t	blockedTicks;	// time Present was blocked for a free buffer.
+	int64_t	scanoutTime;	// time of the vblank showing the frame (or -1).
+	UINT	scanoutRefresh;	// the refresh count of the vblank showing the frame.
+	bool	dropped;		// frame was replaced before it was ever shown.
+};
+
+// accumulated details about all presents made with a software swap chain.
+struct PresentSummary {
+	UINT	presents;
+	UINT	displayed;
+	UINT	dropped;
+	UINT	maxQueueDepth;
+	int64_t	totalQueueDepth;
+	int64_t	totalLatencyTicks;
+	int64_t	maxLatencyTicks;
+	int64_t	totalBlockedTicks;
+	UINT	allocations;		// buffers allocated (on creation and on each resize).
+	int64_t	allocatedBytes;		// bytes allocated for all the buffers.
+};
+
+// ============================================================================
+// SoftwareSwapChain
+//
+// A CPU memory backed swap chain which implements the IDXGISwapChain subset
+// that is used by this sandbox. Vertical blanks are simulated from the given
+// time source with the DXGI_SWAP_CHAIN_DESC.BufferDesc.RefreshRate (defaults
+// to 60 Hz) so presentation behaves like a real N-buffered swap chain.
+//
+//   - GetDesc				-- Get information about the swap chain
+//   - GetBuffer			-- Get the buffer with the target index
+//   - Present				-- Queue the back buffer for a scan-out
+//   - ResizeBuffers		-- Re-create buffers with a new size or count
+//   - SetSourceSize		-- Show only the top-left part of the buffers
+//   - GetSourceSize		-- Get the size of the shown part of the buffers
+//   - GetLastPresentCount	-- Get the count of the times Present been called
+//   - GetFrameStatistics	-- Get information about the last shown frame
+//
+// Buffers rotate in the following way. One buffer is being shown on screen
+// and the remaining ones are either queued for a scan-out or free to render.
+// Present queues the current back buffer and blocks the caller only when no
+// buffer is free, i.e. when all buffers are either queued or on the screen, or
+// when there already are MAX_FRAME_LATENCY frames waiting in the queue.
+//
+// Each queued frame stays on the screen for at least SyncInterval vblanks.
+// Swap effects differ from each other in the following way.
+//
+//		DXGI_SWAP_EFFECT_DISCARD			-- Blit into front, drop stale frames
+//		DXGI_SWAP_EFFECT_SEQUENTIAL			-- Blit into front, show all frames
+//		DXGI_SWAP_EFFECT_FLIP_DISCARD		-- Flip, drop stale frames
+//		DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL	-- Flip, show all frames
+//
+// With the discard effects a frame presented with zero sync interval replaces
+// any frames that still wait in the queue, and only buffer 0 can be accessed.
+// Sequential effects preserve the buffer contents and allow the application
+// to access older buffers with indices 1..N-1 in the presentation order.
+//
+// Note that DXGI_PRESENT_ALLOW_TEARING with zero sync interval makes the flip
+// model swap chains show the frame immediately without waiting for a vblank.
+//
+// Like in DXGI, all references to the buffers must be released before using
+// the ResizeBuffers. Otherwise it will fail with DXGI_ERROR_INVALID_CALL. The
+// source size (like IDXGISwapChain2::SetSourceSize) lets the application to
+// use a smaller region of the buffers without reallocating them. It is reset
+// into the full buffer size by the ResizeBuffers.
+//
+// Swap chains are made with the create, which fails with the INVALID_CALL for
+// flip models with less than two buffers (like the DXGI), as a flip model keeps
+// one of its buffers on the screen and the first Present would never return.
+// ============================================================================
+class SoftwareSwapChain final {
+public:
+	static constexpr UINT MAX_BUFFERS = 16;
+	static constexpr UINT MAX_SYNC_INTERVAL = 4;
+	static constexpr UINT MAX_FRAME_LATENCY = 3;
+	static constexpr UINT HISTORY_SIZE = 1024;
+
+	// create a swap chain, which fails like the ResizeBuffers for a flip model with less than two buffers.
+	static HRESULT create(const DXGI_SWAP_CHAIN_DESC& desc, TimeSource& time, std::shared_ptr<SoftwareSwapChain>* swapChain) {
+		auto flip = desc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL || desc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		if (swapChain == nullptr || desc.BufferCount > MAX_BUFFERS || (desc.BufferCount < 2 && flip)) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		swapChain->reset(new SoftwareSwapChain(desc, time));
+		return S_OK;
+	}
+
+	HRESULT GetDesc(DXGI_SWAP_CHAIN_DESC* desc) const {
+		if (desc == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*desc = mDesc;
+		return S_OK;
+	}
+
+	HRESULT GetBuffer(UINT index, RefPtr<SoftwareSurface>* surface) {
+		auto count = static_cast<UINT>(mBuffers.size());
+		if (surface == nullptr || index >= count || (index > 0 && isDiscard())) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		// sequential buffers are always released in the presentation order.
+		*surface = mBuffers[(mFree.front() + index) % count];
+		return S_OK;
+	}
+
+	HRESULT Present(UINT syncInterval, UINT flags) {
+		if (syncInterval > MAX_SYNC_INTERVAL) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto now = mTime.now();
+		advance(now);
+		if ((flags & DXGI_PRESENT_TEST) != 0) {
+			return S_OK;
+		}
+
+		// block until the queue has space for a new frame.
+		waitWhile([this]() { return mQueue.size() >= MAX_FRAME_LATENCY; });
+
+		// blit models copy the back buffer into the front buffer immediately.
+		auto back = mFree.front();
+		if (!mSingleBuffer) {
+			mFree.pop_front();
+		}
+		if (!isFlip()) {
+			auto& src = *mBuffers[back];
+			std::memcpy(mFront->data(), src.data(), src.size());
+		}
+
+		// queue the frame and drop the stale frames when using discard effects.
+		mPresentCount++;
+		auto& record = mHistory[mPresentCount % HISTORY_SIZE];
+		record = {};
+		record.presentCount = mPresentCount;
+		record.syncInterval = syncInterval;
+		record.presentTime = now;
+		record.scanoutTime = -1;
+		if (isDiscard() && syncInterval == 0) {
+			while (!mQueue.empty()) {
+				dropFrame(mQueue.front());
+				mQueue.pop_front();
+			}
+		}
+		mQueue.push_back({ back, mPresentCount, syncInterval });
+		record.queueDepth = static_cast<UINT>(mQueue.size());
+
+		// tearing allows flip model frames to be shown without waiting for vblank.
+		if (isFlip() && syncInterval == 0 && (flags & DXGI_PRESENT_ALLOW_TEARING) != 0) {
+			showNextFrame(now);
+		}
+
+		// block until a vblank has released a buffer for the next frame.
+		waitWhile([this]() { return mFree.empty(); });
+		record.blockedTicks = mTime.now() - now;
+
+		mSummary.presents++;
+		mSummary.totalQueueDepth += record.queueDepth;
+		mSummary.totalBlockedTicks += record.blockedTicks;
+		if (record.queueDepth > mSummary.maxQueueDepth) {
+			mSummary.maxQueueDepth = record.queueDepth;
+		}
+		return S_OK;
+	}
+
+	HRESULT ResizeBuffers(UINT bufferCount, UINT width, UINT height, DXGI_FORMAT format, UINT flags) {
+		if (bufferCount > MAX_BUFFERS || (bufferCount == 1 && isFlip())) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		for (auto& buffer : mBuffers) {
+			if (countRefs(buffer) > 1) {
+				return DXGI_ERROR_INVALID_CALL;
+			}
+		}
+		if (bufferCount != 0) {
+			mDesc.BufferCount = bufferCount;
+		}
+		if (width != 0) {
+			mDesc.BufferDesc.Width = width;
+		}
+		if (height != 0) {
+			mDesc.BufferDesc.Height = height;
+		}
+		if (format != DXGI_FORMAT_UNKNOWN) {
+			mDesc.BufferDesc.Format = format;
+		}
+		mDesc.Flags = flags;
+
+		// frames which are still waiting in the queue will never get shown.
+		for (auto& frame : mQueue) {
+			dropFrame(frame);
+		}
+		createBuffers();
+		return S_OK;
+	}
+
+	HRESULT SetSourceSize(UINT width, UINT height) {
+		if (width == 0 || height == 0 || width > mDesc.BufferDesc.Width || height > mDesc.BufferDesc.Height) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		mSourceWidth = width;
+		mSourceHeight = height;
+		return S_OK;
+	}
+
+	HRESULT GetSourceSize(UINT* width, UINT* height) const {
+		if (width == nullptr || height == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*width = mSourceWidth;
+		*height = mSourceHeight;
+		return S_OK;
+	}
+
+	HRESULT GetLastPresentCount(UINT* presentCount) const {
+		if (presentCount == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*presentCount = mPresentCount;
+		return S_OK;
+	}
+
+	HRESULT GetFrameStatistics(DXGI_FRAME_STATISTICS* stats) {
+		if (stats == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		advance(mTime.now());
+		if (mScreen == NONE) {
+			return DXGI_ERROR_FRAME_STATISTICS_DISJOINT;
+		}
+		stats->PresentCount = mScreenPresent;
+		stats->PresentRefreshCount = mScreenRefresh;
+		stats->SyncRefreshCount = mRefreshCount;
+		stats->SyncQPCTime.QuadPart = vblankTime(mRefreshCount);
+		stats->SyncGPUTime.QuadPart = 0;
+		return S_OK;
+	}
+
+	// get the present record for the target present count if it's still stored.
+	const PresentRecord* presentRecord(UINT presentCount) const {
+		auto& record = mHistory[presentCount % HISTORY_SIZE];
+		return (presentCount != 0 && record.presentCount == presentCount) ? &record : nullptr;
+	}
+
+	const PresentSummary& summary() const { return mSummary; }
+	TimeSource& timeSource() const { return mTime; }
+
+	// get the time of the vblank with the target refresh count.
+	int64_t vblankTime(UINT refreshCount) const {
+		auto& rate = mDesc.BufferDesc.RefreshRate;
+		auto ticks = static_cast<double>(refreshCount) * mTime.frequency() * rate.Denominator / rate.Numerator;
+		return mOrigin + static_cast<int64_t>(ticks);
+	}
+private:
+	SoftwareSwapChain(const DXGI_SWAP_CHAIN_DESC& desc, TimeSource& time)
+		: mDesc(desc), mTime(time), mPresentCount(0), mRefreshCount(0), mScreen(NONE), mScreenRefreshes(0) {
+		auto& rate = mDesc.BufferDesc.RefreshRate;
+		if (rate.Numerator == 0 || rate.Denominator == 0) {
+			rate.Numerator = 60;
+			rate.Denominator = 1;
+		}
+		mOrigin = mTime.now();
+		mSummary = {};
+		mHistory = {};
+		createBuffers();
+	}
+
+	static constexpr UINT NONE = ~0u;
+
+	struct Frame {
+		UINT buffer;
+		UINT presentCount;
+		UINT syncInterval;
+	};
+
+	bool isFlip() const {
+		return mDesc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD
+			|| mDesc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+	}
+
+	bool isDiscard() const {
+		return mDesc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD
+			|| mDesc.SwapEffect == DXGI_SWAP_EFFECT_DISCARD;
+	}
+
+	void createBuffers() {
+		auto& mode = mDesc.BufferDesc;
+		auto count = mDesc.BufferCount == 0 ? 1 : mDesc.BufferCount;
+		mBuffers.clear();
+		mFree.clear();
+		mQueue.clear();
+		for (auto i = 0u; i < count; i++) {
+			mBuffers.push_back(makeRef<SoftwareSurface>(mode.Width, mode.Height, mode.Format));
+			mFree.push_back(i);
+		}
+		mFront = isFlip() ? nullptr : std::make_unique<SoftwareSurface>(mode.Width, mode.Height, mode.Format);
+		mScreen = NONE;
+		mSourceWidth = mode.Width;
+		mSourceHeight = mode.Height;
+		auto allocations = count + (mFront != nullptr ? 1 : 0);
+		mSummary.allocations += allocations;
+		mSummary.allocatedBytes += static_cast<int64_t>(mBuffers[0]->size()) * allocations;
+
+		// a flip model swap chain keeps one of its own buffers on the screen.
+		// blit models have a separate front buffer, so allow a single buffer.
+		mSingleBuffer = !isFlip() && count == 1;
+	}
+
+	void dropFrame(const Frame& frame) {
+		releaseBuffer(frame.buffer);
+		mSummary.dropped++;
+		if (auto record = findRecord(frame.presentCount)) {
+			record->dropped = true;
+		}
+	}
+
+	PresentRecord* findRecord(UINT presentCount) {
+		return const_cast<PresentRecord*>(presentRecord(presentCount));
+	}
+
+	void releaseBuffer(UINT buffer) {
+		if (!mSingleBuffer) {
+			mFree.push_back(buffer);
+		}
+	}
+
+	// block the caller over vblanks as long as the given condition holds.
+	template<typename Condition>
+	void waitWhile(Condition condition) {
+		while (condition()) {
+			auto vblank = vblankTime(mRefreshCount + 1);
+			mTime.waitUntil(vblank);
+			auto now = mTime.now();
+			advance(now > vblank ? now : vblank);
+		}
+	}
+
+	// move the oldest queued frame on the screen at the target time.
+	void showNextFrame(int64_t time) {
+		auto frame = mQueue.front();
+		mQueue.pop_front();
+		if (mScreen != NONE) {
+			releaseBuffer(mScreen);
+		}
+		mScreen = frame.buffer;
+		mScreenPresent = frame.presentCount;
+		mScreenRefresh = mRefreshCount;
+		mScreenInterval = frame.syncInterval;
+		mScreenRefreshes = 0;
+
+		auto latency = int64_t(0);
+		if (auto record = findRecord(frame.presentCount)) {
+			record->scanoutTime = time;
+			record->scanoutRefresh = mRefreshCount;
+			latency = time - record->presentTime;
+		}
+		mSummary.displayed++;
+		mSummary.totalLatencyTicks += latency;
+		if (latency > mSummary.maxLatencyTicks) {
+			mSummary.maxLatencyTicks = latency;
+		}
+	}
+
+	// process all vblanks which have occured before or at the target time.
+	void advance(int64_t now) {
+		while (vblankTime(mRefreshCount + 1) <= now) {
+			// skip directly over the idle vblanks when nothing is waiting.
+			if (mQueue.empty()) {
+				auto& rate = mDesc.BufferDesc.RefreshRate;
+				auto elapsed = static_cast<double>(now - mOrigin) * rate.Numerator / (rate.Denominator * static_cast<double>(mTime.frequency()));
+				auto target = static_cast<UINT>(elapsed);
+				while (vblankTime(target) > now) {
+					target--;
+				}
+				while (vblankTime(target + 1) <= now) {
+					target++;
+				}
+				mScreenRefreshes += target - mRefreshCount;
+				mRefreshCount = target;
+				break;
+			}
+			mRefreshCount++;
+			mScreenRefreshes++;
+			if (mScreen != NONE && mScreenRefreshes < mScreenInterval) {
+				continue;
+			}
+			// zero sync interval discard frames are replaced by the newest one.
+			while (isDiscard() && mQueue.size() > 1 && mQueue.front().syncInterval == 0) {
+				dropFrame(mQueue.front());
+				mQueue.pop_front();
+			}
+			showNextFrame(vblankTime(mRefreshCount));
+		}
+	}
+
+	DXGI_SWAP_CHAIN_DESC							mDesc;
+	TimeSource&										mTime;
+	int64_t											mOrigin;
+	UINT											mPresentCount;
+	UINT											mRefreshCount;
+	std::vector<RefPtr<SoftwareSurface>>			mBuffers;
+	std::unique_ptr<SoftwareSurface>				mFront;
+	std::deque<UINT>								mFree;
+	std::deque<Frame>								mQueue;
+	bool											mSingleBuffer;
+	UINT											mScreen;
+	UINT											mScreenPresent;
+	UINT											mScreenRefresh;
+	UINT											mScreenInterval;
+	UINT											mScreenRefreshes;
+	UINT											mSourceWidth;
+	UINT											mSourceHeight;
+	PresentSummary									mSummary;
+	std::array<PresentRecord, HISTORY_SIZE>			mHistory;
+};
\ No newline at end of file
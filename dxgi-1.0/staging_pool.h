@@ -0,0 +1,439 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "dxgi_shim.h"
+#include "dxgi_util.h"
+#include "format_convert.h"
+#include "soft_swap_chain.h"
+#include "time_source.h"
+
+#if defined(_WIN32)
+#include <d3d10.h>
+#include "com_util.h"
+#endif
+
+// ============================================================================
+// StagingBackend
+//
+// An abstraction over the CPU writable surfaces used by the StagingPool and
+// over the fence which tells when the GPU has finished reading them. Fence
+// values grow by one with each signal and complete in the signalling order.
+//
+//   - supportsDiscard	-- Whether map accepts the DXGI_MAP_DISCARD flag
+//   - createSurface	-- Create a new surface and get its identifier
+//   - map				-- Map the surface with the DXGI_MAP_* flags
+//   - unmap			-- Unmap the surface
+//   - signal			-- Signal a new fence value after submitted copies
+//   - completedValue	-- Get the highest completed fence value
+//   - waitFor			-- Block until the fence value has been completed
+// ============================================================================
+class StagingBackend {
+public:
+	virtual ~StagingBackend() = default;
+	virtual bool supportsDiscard() const = 0;
+	virtual HRESULT createSurface(UINT width, UINT height, DXGI_FORMAT format, UINT* surface) = 0;
+	virtual HRESULT map(UINT surface, UINT flags, DXGI_MAPPED_RECT* rect) = 0;
+	virtual HRESULT unmap(UINT surface) = 0;
+	virtual UINT64 signal() = 0;
+	virtual UINT64 completedValue() = 0;
+	virtual HRESULT waitFor(UINT64 value) = 0;
+};
+
+// ============================================================================
+// MemoryStagingBackend
+//
+// A backend which keeps the surfaces in CPU memory and simulates the GPU with
+// the given time source. Each signalled fence value completes the given amount
+// of ticks after the signal, but never before the previously signalled value.
+// With a ManualTimeSource the waiting simply jumps the time forward.
+// ============================================================================
+class MemoryStagingBackend final : public StagingBackend {
+public:
+	MemoryStagingBackend(TimeSource& time, int64_t latencyTicks, bool discard = false)
+		: mTime(time), mLatencyTicks(latencyTicks), mDiscard(discard), mSignalled(0), mCompleted(0) {}
+
+	bool supportsDiscard() const override { return mDiscard; }
+
+	HRESULT createSurface(UINT width, UINT height, DXGI_FORMAT format, UINT* surface) override {
+		if (surface == nullptr || width == 0 || height == 0 || formatBytesPerPixel(format) == 0) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		*surface = static_cast<UINT>(mSurfaces.size());
+		mSurfaces.push_back(std::make_unique<SoftwareSurface>(width, height, format));
+		return S_OK;
+	}
+
+	HRESULT map(UINT surface, UINT flags, DXGI_MAPPED_RECT* rect) override {
+		if (surface >= mSurfaces.size() || ((flags & DXGI_MAP_DISCARD) != 0 && !mDiscard)) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		return mSurfaces[surface]->Map(rect, flags);
+	}
+
+	HRESULT unmap(UINT surface) override {
+		if (surface >= mSurfaces.size()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		return mSurfaces[surface]->Unmap();
+	}
+
+	UINT64 signal() override {
+		auto completion = mTime.now() + mLatencyTicks;
+		if (!mPending.empty() && mPending.back() > completion) {
+			completion = mPending.back();
+		}
+		mPending.push_back(completion);
+		return ++mSignalled;
+	}
+
+	UINT64 completedValue() override {
+		auto now = mTime.now();
+		while (!mPending.empty() && mPending.front() <= now) {
+			mPending.pop_front();
+			mCompleted++;
+		}
+		return mCompleted;
+	}
+
+	HRESULT waitFor(UINT64 value) override {
+		if (value > mSignalled) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		if (value > completedValue()) {
+			mTime.waitUntil(mPending[static_cast<size_t>(value - mCompleted - 1)]);
+			completedValue();
+		}
+		return S_OK;
+	}
+
+	SoftwareSurface& surface(UINT surface) { return *mSurfaces[surface]; }
+private:
+	TimeSource&										mTime;
+	int64_t											mLatencyTicks;
+	bool											mDiscard;
+	UINT64											mSignalled;
+	UINT64											mCompleted;
+	std::deque<int64_t>								mPending;
+	std::vector<std::unique_ptr<SoftwareSurface>>	mSurfaces;
+};
+
+#if defined(_WIN32)
+// ============================================================================
+// D3D10StagingBackend
+//
+// A backend which uses D3D10 textures and D3D10_QUERY_EVENT queries as fences.
+// Textures are created with D3D10_USAGE_STAGING by default. D3D10_USAGE_DYNAMIC
+// textures can be mapped with DXGI_MAP_DISCARD, in which case the driver gives
+// a fresh memory for the CPU while the GPU is still reading the old contents.
+// Staging textures created with D3D10_CPU_ACCESS_READ are used for readbacks
+// instead (e.g. by the ScreenshotPipeline) and are mapped with DXGI_MAP_READ.
+// ============================================================================
+class D3D10StagingBackend final : public StagingBackend {
+public:
+	D3D10StagingBackend(ID3D10Device* device, D3D10_USAGE usage = D3D10_USAGE_STAGING, UINT cpuAccess = D3D10_CPU_ACCESS_WRITE)
+		: mDevice(device), mUsage(usage), mCpuAccess(cpuAccess), mSignalled(0), mCompleted(0) {}
+
+	bool supportsDiscard() const override { return mUsage == D3D10_USAGE_DYNAMIC; }
+
+	HRESULT createSurface(UINT width, UINT height, DXGI_FORMAT format, UINT* surface) override {
+		if (surface == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		D3D10_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = mUsage;
+		desc.BindFlags = mUsage == D3D10_USAGE_DYNAMIC ? D3D10_BIND_SHADER_RESOURCE : 0;
+		desc.CPUAccessFlags = mCpuAccess;
+		Microsoft::WRL::ComPtr<ID3D10Texture2D> texture;
+		Microsoft::WRL::ComPtr<IDXGISurface> dxgiSurface;
+		auto result = mDevice->CreateTexture2D(&desc, nullptr, &texture);
+		if (SUCCEEDED(result)) {
+			result = texture.As(&dxgiSurface);
+		}
+		if (FAILED(result)) {
+			return result;
+		}
+		*surface = static_cast<UINT>(mTextures.size());
+		mTextures.push_back(texture);
+		mSurfaces.push_back(dxgiSurface);
+		return S_OK;
+	}
+
+	HRESULT map(UINT surface, UINT flags, DXGI_MAPPED_RECT* rect) override {
+		if (surface >= mSurfaces.size()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		return mSurfaces[surface]->Map(rect, flags);
+	}
+
+	HRESULT unmap(UINT surface) override {
+		if (surface >= mSurfaces.size()) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		return mSurfaces[surface]->Unmap();
+	}
+
+	UINT64 signal() override {
+		D3D10_QUERY_DESC desc = { D3D10_QUERY_EVENT, 0 };
+		Microsoft::WRL::ComPtr<ID3D10Query> query;
+		check_hresult(RESULT_OF(mDevice->CreateQuery(&desc, &query)));
+		query->End();
+		mPending.push_back(query);
+		return ++mSignalled;
+	}
+
+	UINT64 completedValue() override {
+		while (!mPending.empty() && mPending.front()->GetData(nullptr, 0, D3D10_ASYNC_GETDATA_DONOTFLUSH) == S_OK) {
+			mPending.pop_front();
+			mCompleted++;
+		}
+		return mCompleted;
+	}
+
+	HRESULT waitFor(UINT64 value) override {
+		if (value > mSignalled) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		while (completedValue() < value) {
+			// the first query must be flushed or it might never complete.
+			auto result = mPending.front()->GetData(nullptr, 0, 0);
+			if (FAILED(result)) {
+				return result;
+			}
+			if (result == S_FALSE) {
+				YieldProcessor();
+			}
+		}
+		return S_OK;
+	}
+
+	ID3D10Texture2D* texture(UINT surface) { return mTextures[surface].Get(); }
+private:
+	Microsoft::WRL::ComPtr<ID3D10Device>					mDevice;
+	D3D10_USAGE												mUsage;
+	UINT													mCpuAccess;
+	UINT64													mSignalled;
+	UINT64													mCompleted;
+	std::deque<Microsoft::WRL::ComPtr<ID3D10Query>>			mPending;
+	std::vector<Microsoft::WRL::ComPtr<ID3D10Texture2D>>	mTextures;
+	std::vector<Microsoft::WRL::ComPtr<IDXGISurface>>		mSurfaces;
+};
+#endif
+
+// a surface mapped for writing with StagingPool::acquire.
+struct StagingLease {
+	UINT				surface;	// the backend surface identifier.
+	UINT				width;		// the requested width in pixels.
+	UINT				height;		// the requested height in pixels.
+	DXGI_FORMAT			format;		// the format of the surface.
+	DXGI_MAPPED_RECT	rect;		// the mapped surface memory.
+	uint64_t			sizeClass;	// the size class of the surface.
+	UINT				slot;		// the slot within the size class.
+
+	SurfaceView view() const { return surfaceView(rect, width, height, format); }
+};
+
+// details about how the producers have used a staging pool.
+struct StagingPoolStats {
+	UINT64	acquires;		// the number of acquired surfaces.
+	UINT64	waits;			// acquires which had to wait for the GPU.
+	UINT64	discards;		// acquires which re-used a surface with a discard.
+	UINT64	growths;		// acquires which exceeded the class surface limit.
+	int64_t	waitTicks;		// total ticks spent waiting for the GPU.
+	int64_t	maxWaitTicks;	// the longest wait for the GPU.
+	UINT	surfaces;		// the number of surfaces created by the pool.
+	UINT64	bytes;			// the approximate size of the created surfaces.
+};
+
+// ============================================================================
+// StagingPool
+//
+// Streams CPU uploads through a ring of staging surfaces per size class, so a
+// producer does not need to wait for the GPU to finish reading a surface that
+// was written in the previous frame. A size class is identified by the format
+// and the requested size rounded up to SIZE_GRANULARITY pixels.
+//
+//   - acquire	-- Get a mapped surface which the GPU no longer reads
+//   - submit	-- Unmap the surface, copy it on the GPU and fence the surface
+//   - cancel	-- Unmap the surface without using it
+//   - upload	-- Acquire, copy rows from a source view and submit
+//
+// Surfaces are re-used in the ring order. Acquire selects the first surface
+// whose fence has been completed. If there is none, the pool either creates a
+// new surface (up to surfacesPerClass), maps the oldest one with DXGI_MAP_
+// DISCARD when the backend supports it, or blocks until the GPU has finished
+// with the oldest surface. Waits are reported with the pool statistics.
+//
+// The pool is not thread-safe, so each producer thread should use its own.
+// ============================================================================
+class StagingPool final {
+public:
+	static constexpr UINT SIZE_GRANULARITY = 128;
+
+	// a function to record the GPU copy from the unmapped staging surface.
+	typedef std::function<void(const StagingLease&)> CopyFunc;
+
+	StagingPool(StagingBackend& backend, TimeSource& time, UINT surfacesPerClass = 3)
+		: mBackend(backend), mTime(time), mSurfacesPerClass(surfacesPerClass > 0 ? surfacesPerClass : 1) {
+		mStats = {};
+	}
+
+	HRESULT acquire(UINT width, UINT height, DXGI_FORMAT format, StagingLease* lease) {
+		auto bytesPerPixel = formatBytesPerPixel(format);
+		if (lease == nullptr || width == 0 || height == 0 || bytesPerPixel == 0) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto classWidth = roundUp(width);
+		auto classHeight = roundUp(height);
+		auto key = (static_cast<uint64_t>(format) << 48) | (static_cast<uint64_t>(classWidth) << 24) | classHeight;
+		auto& sizeClass = mClasses[key];
+
+		// find the first surface in the ring order which is no longer in flight.
+		auto completed = mBackend.completedValue();
+		auto count = static_cast<UINT>(sizeClass.slots.size());
+		auto found = NONE;
+		auto oldest = NONE;
+		for (UINT i = 0; i < count && found == NONE; i++) {
+			auto index = (sizeClass.cursor + i) % count;
+			auto& slot = sizeClass.slots[index];
+			if (slot.leased) {
+				continue;
+			} else if (slot.fence <= completed) {
+				found = index;
+			} else if (oldest == NONE || slot.fence < sizeClass.slots[oldest].fence) {
+				oldest = index;
+			}
+		}
+
+		// create a new surface, discard the oldest one or wait for the GPU.
+		auto flags = static_cast<UINT>(DXGI_MAP_WRITE);
+		if (found == NONE && (count < mSurfacesPerClass || oldest == NONE)) {
+			Slot slot = {};
+			auto result = mBackend.createSurface(classWidth, classHeight, format, &slot.surface);
+			if (FAILED(result)) {
+				return result;
+			}
+			found = count;
+			sizeClass.slots.push_back(slot);
+			mStats.surfaces++;
+			mStats.bytes += static_cast<UINT64>(classWidth) * classHeight * bytesPerPixel;
+			mStats.growths += count >= mSurfacesPerClass ? 1 : 0;
+		} else if (found == NONE && mBackend.supportsDiscard()) {
+			found = oldest;
+			flags |= DXGI_MAP_DISCARD;
+			mStats.discards++;
+		} else if (found == NONE) {
+			found = oldest;
+			auto start = mTime.now();
+			auto result = mBackend.waitFor(sizeClass.slots[found].fence);
+			if (FAILED(result)) {
+				return result;
+			}
+			auto waited = mTime.now() - start;
+			mStats.waits++;
+			mStats.waitTicks += waited;
+			mStats.maxWaitTicks = waited > mStats.maxWaitTicks ? waited : mStats.maxWaitTicks;
+		}
+
+		auto& slot = sizeClass.slots[found];
+		DXGI_MAPPED_RECT rect = {};
+		auto result = mBackend.map(slot.surface, flags, &rect);
+		if (FAILED(result)) {
+			return result;
+		}
+		slot.leased = true;
+		sizeClass.cursor = found + 1;
+		mStats.acquires++;
+		*lease = { slot.surface, width, height, format, rect, key, found };
+		return S_OK;
+	}
+
+	HRESULT submit(StagingLease& lease, const CopyFunc& copy, UINT64* fence = nullptr) {
+		auto slot = findSlot(lease);
+		if (slot == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto result = mBackend.unmap(slot->surface);
+		if (FAILED(result)) {
+			return result;
+		}
+		if (copy) {
+			copy(lease);
+		}
+		slot->fence = mBackend.signal();
+		slot->leased = false;
+		if (fence != nullptr) {
+			*fence = slot->fence;
+		}
+		return S_OK;
+	}
+
+	HRESULT cancel(StagingLease& lease) {
+		auto slot = findSlot(lease);
+		if (slot == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		slot->leased = false;
+		return mBackend.unmap(slot->surface);
+	}
+
+	HRESULT upload(const SurfaceView& src, DXGI_FORMAT format, const CopyFunc& copy, UINT64* fence = nullptr) {
+		StagingLease lease;
+		auto result = acquire(src.width, src.height, format, &lease);
+		if (FAILED(result)) {
+			return result;
+		}
+		// the rows are copied with the pitch of both sides and converted if necessary.
+		result = convertSurface(src, lease.view());
+		if (FAILED(result)) {
+			cancel(lease);
+			return result;
+		}
+		return submit(lease, copy, fence);
+	}
+
+	const StagingPoolStats& stats() const { return mStats; }
+private:
+	static constexpr UINT NONE = ~0u;
+
+	struct Slot {
+		UINT	surface;
+		UINT64	fence;
+		bool	leased;
+	};
+
+	struct SizeClass {
+		std::vector<Slot>	slots;
+		UINT				cursor = 0;
+	};
+
+	static UINT roundUp(UINT size) {
+		return (size + SIZE_GRANULARITY - 1) / SIZE_GRANULARITY * SIZE_GRANULARITY;
+	}
+
+	Slot* findSlot(const StagingLease& lease) {
+		auto it = mClasses.find(lease.sizeClass);
+		if (it == mClasses.end() || lease.slot >= it->second.slots.size()) {
+			return nullptr;
+		}
+		auto& slot = it->second.slots[lease.slot];
+		return slot.leased && slot.surface == lease.surface ? &slot : nullptr;
+	}
+
+	StagingBackend&							mBackend;
+	TimeSource&								mTime;
+	UINT									mSurfacesPerClass;
+	std::unordered_map<uint64_t, SizeClass>	mClasses;
+	StagingPoolStats						mStats;
+};
\ No newline at end of file
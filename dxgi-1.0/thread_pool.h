@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dxgi_shim.h"
+
+// ============================================================================
+// ThreadPool
+//
+// A fixed set of worker threads for the CPU heavy surface work (e.g. format
+// conversion or image encoding). Work is given to the pool either as single
+// jobs or as a parallel loop over indices.
+//
+//		submit		-- Queue a job which is run by one of the workers
+//		parallelFor	-- Run a task for each index and wait until all are done
+//
+// The thread which calls parallelFor runs the tasks as well, so a loop makes
+// progress even when all the workers are busy or when the pool has no workers
+// at all. Indices are taken one at a time from a shared counter, so a slice
+// which takes longer than the others does not hold back the rest of the loop.
+// The destructor runs the queued jobs before it joins the workers. The
+// parallelSlices utility cuts the rows of a surface into slices for a loop.
+// ============================================================================
+class ThreadPool final {
+public:
+	// create the pool with the given amount of workers.
+	explicit ThreadPool(UINT workers = defaultWorkers()) : mStopping(false) {
+		for (UINT i = 0; i < workers; i++) {
+			mThreads.emplace_back([this] { run(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mStopping = true;
+		}
+		mWake.notify_all();
+		for (auto& thread : mThreads) {
+			thread.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// a utility to get one worker less than the hardware threads, as the caller works as well.
+	static UINT defaultWorkers() {
+		auto threads = std::thread::hardware_concurrency();
+		return threads > 1 ? threads - 1 : 0;
+	}
+
+	// queue the job to be run by one of the workers.
+	void submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mJobs.push_back(std::move(job));
+		}
+		mWake.notify_one();
+	}
+
+	// run the task for each index in [0, count) and return when all of them are done.
+	void parallelFor(UINT count, const std::function<void(UINT)>& task) {
+		if (count == 0) {
+			return;
+		}
+		auto loop = std::make_shared<Loop>(task, count);
+		auto helpers = std::min(workers(), count - 1);
+		if (helpers > 0) {
+			{
+				std::lock_guard<std::mutex> lock(mLock);
+				for (UINT i = 0; i < helpers; i++) {
+					mJobs.push_back([loop] { runLoop(*loop); });
+				}
+			}
+			mWake.notify_all();
+		}
+		runLoop(*loop);
+		std::unique_lock<std::mutex> lock(loop->lock);
+		loop->finished.wait(lock, [&] { return loop->done == loop->count; });
+	}
+
+	UINT workers() const { return static_cast<UINT>(mThreads.size()); }
+	// the amount of threads which run a parallel loop (the workers and the caller).
+	UINT concurrency() const { return workers() + 1; }
+private:
+	// the shared state of a parallel loop, which outlives the call for late helpers.
+	struct Loop {
+		Loop(const std::function<void(UINT)>& task, UINT count) : task(task), count(count), next(0), done(0) {}
+
+		std::function<void(UINT)>	task;
+		UINT						count;
+		std::atomic<UINT>			next;
+		UINT						done;
+		std::mutex					lock;
+		std::condition_variable		finished;
+	};
+
+	static void runLoop(Loop& loop) {
+		UINT completed = 0;
+		for (auto i = loop.next++; i < loop.count; i = loop.next++) {
+			loop.task(i);
+			completed++;
+		}
+		if (completed > 0) {
+			std::lock_guard<std::mutex> lock(loop.lock);
+			loop.done += completed;
+			if (loop.done == loop.count) {
+				loop.finished.notify_all();
+			}
+		}
+	}
+
+	void run() {
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mLock);
+				mWake.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+				if (mJobs.empty()) {
+					return;
+				}
+				job = std::move(mJobs.front());
+				mJobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::mutex							mLock;
+	std::condition_variable				mWake;
+	std::deque<std::function<void()>>	mJobs;
+	std::vector<std::thread>			mThreads;
+	bool								mStopping;
+};
+
+// a utility to run the function over slices of the rows [0, rows) which begin at multiples of the
+// alignment. Each thread of the pool gets a few slices for balance, and nothing is split without a pool.
+template <typename Function>
+inline void parallelSlices(ThreadPool* pool, UINT rows, UINT alignment, Function&& function) {
+	const UINT SLICES_PER_THREAD = 4;
+	const UINT MIN_SLICE_ROWS = 16;
+	if (pool == nullptr || pool->workers() == 0 || rows <= MIN_SLICE_ROWS) {
+		function(0u, rows);
+		return;
+	}
+	auto sliceRows = (rows + pool->concurrency() * SLICES_PER_THREAD - 1) / (pool->concurrency() * SLICES_PER_THREAD);
+	sliceRows = std::max(sliceRows, MIN_SLICE_ROWS);
+	sliceRows = (sliceRows + alignment - 1) / alignment * alignment;
+	auto slices = (rows + sliceRows - 1) / sliceRows;
+	pool->parallelFor(slices, [&](UINT slice) {
+		function(slice * sliceRows, std::min(rows, (slice + 1) * sliceRows));
+	});
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TIME_SOURCE_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// ============================================================================
+// TimeSource
+//
+// An abstraction over the clock that is used by the software implementations
+// in this sandbox. All values are expressed as 64-bit ticks where the tick
+// frequency is told by the frequency function (like QueryPerformanceCounter).
+//
+//   - now			-- Get the current time in ticks
+//   - waitUntil	-- Block the caller until the given tick has been reached
+//   - frequency	-- Get the amount of ticks per second
+//
+// The steady implementation uses std::chrono::steady_clock with a nanosecond
+// resolution, so the values are comparable with DXGI SyncQPCTime values only
+// after they have been scaled with the corresponding tick frequencies.
+// The QPC implementation (Windows only) uses the same ticks as the DXGI does.
+// ============================================================================
+class TimeSource {
+public:
+	virtual ~TimeSource() = default;
+	virtual int64_t now() = 0;
+	virtual void waitUntil(int64_t ticks) = 0;
+	virtual int64_t frequency() const = 0;
+};
+
+// a utility to convert ticks into nanoseconds, which splits the whole seconds
+// off first so that long waits with a GHz frequency do not overflow.
+inline std::chrono::nanoseconds ticksToNanos(int64_t ticks, int64_t frequency) {
+	return std::chrono::seconds(ticks / frequency) + std::chrono::nanoseconds(ticks % frequency * 1000000000 / frequency);
+}
+
+class SteadyTimeSource final : public TimeSource {
+public:
+	int64_t now() override {
+		auto time = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+	}
+
+	void waitUntil(int64_t ticks) override {
+		auto duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ticks));
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(duration));
+	}
+
+	int64_t frequency() const override { return 1000000000; }
+};
+
+#if defined(_WIN32)
+// a time source which uses the same QueryPerformanceCounter ticks as the DXGI.
+class QpcTimeSource final : public TimeSource {
+public:
+	QpcTimeSource() {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		mFrequency = frequency.QuadPart;
+	}
+
+	int64_t now() override {
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+	}
+
+	void waitUntil(int64_t ticks) override {
+		auto remaining = ticks - now();
+		if (remaining > 0) {
+			auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(ticksToNanos(remaining, mFrequency)).count();
+			Sleep(static_cast<DWORD>(millis < INFINITE ? millis : INFINITE - 1));
+		}
+		while (now() < ticks) {
+			YieldProcessor();
+		}
+	}
+
+	int64_t frequency() const override { return mFrequency; }
+private:
+	int64_t mFrequency;
+};
+#endif
+
+#if defined(TIME_SOURCE_TSC)
+// a time source which reads the x86 time stamp counter directly. It is the
+// cheapest clock to read (a few nanoseconds), but its frequency is measured
+// against the steady clock on construction (which takes ~10 milliseconds).
+// Note that this assumes an invariant TSC, as in all the recent x86 CPUs.
+class TscTimeSource final : public TimeSource {
+public:
+	TscTimeSource() {
+		auto clockStart = std::chrono::steady_clock::now();
+		auto tscStart = __rdtsc();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		auto tscEnd = __rdtsc();
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStart).count();
+		mFrequency = static_cast<int64_t>(static_cast<double>(tscEnd - tscStart) / elapsed);
+	}
+
+	int64_t now() override { return static_cast<int64_t>(__rdtsc()); }
+
+	void waitUntil(int64_t ticks) override {
+		auto remaining = ticks - now();
+		if (remaining > 0) {
+			std::this_thread::sleep_for(ticksToNanos(remaining, mFrequency));
+		}
+		while (now() < ticks) {
+			std::this_thread::yield();
+		}
+	}
+
+	int64_t frequency() const override { return mFrequency; }
+private:
+	int64_t mFrequency;
+};
+#endif
+
+// ============================================================================
+// ManualTimeSource
+//
+// A synthetic time source which only moves when it is told to do so. Waiting
+// simply jumps the time forward, which makes it possible to simulate minutes
+// of presentation in milliseconds without touching a real display hardware.
+// ============================================================================
+class ManualTimeSource final : public TimeSource {
+public:
+	explicit ManualTimeSource(int64_t frequency = 1000000000) : mNow(0), mFrequency(frequency) {}
+
+	int64_t now() override { return mNow; }
+
+	void waitUntil(int64_t ticks) override {
+		if (ticks > mNow) {
+			mNow = ticks;
+		}
+	}
+
+	int64_t frequency() const override { return mFrequency; }
+
+	void advance(int64_t ticks) { mNow += ticks; }
+private:
+	int64_t mNow;
+	int64_t mFrequency;
+};
+
+// a utility to convert a time source tick count into milliseconds.
+inline double ticksToMillis(int64_t ticks, int64_t frequency) {
+	return static_cast<double>(ticks) * 1000.0 / static_cast<double>(frequency);
+}
\ No newline at end of file
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+
+#include "dxgi_shim.h"
+#include "time_source.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#endif
+
+#if defined(_WIN32)
+#include <wrl/client.h>
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+// ============================================================================
+// VBlankClock
+//
+// Estimates the true refresh period and phase of a display from the observed
+// vertical blank timestamps. The refresh rate in the DXGI_MODE_DESC is only a
+// nominal value (e.g. 60/1 for a display running at 59.951 Hz), and the times
+// when a thread wakes up from the WaitForVBlank are noisy and always late, so
+// neither can be used as such to predict when the next vblank will happen.
+//
+// Each observed timestamp t is given a vblank count n, which is the count of
+// the previous sample plus the amount of the elapsed periods. The clock fits
+// the line t = phase + n * period with least squares over the latest WINDOW
+// samples, where the nominal period from the mode is used as a prior so that
+// the estimate is sane already after the first couple of samples.
+//
+//		period = (Sxy + PRIOR_WEIGHT * nominal) / (Sxx + PRIOR_WEIGHT)
+//
+// Timestamps which are further than OUTLIER_FRACTION of a period away from
+// the fitted line (e.g. a late wake-up after a context switch) are rejected.
+// If MAX_REJECTS timestamps in a row are rejected, the display must have been
+// changed (e.g. a mode change), so the clock starts over from the nominal.
+//
+// Note that the phase includes the average wake-up latency of the observer,
+// which is fine as long as the same observer is used for the scheduling.
+// ============================================================================
+class VBlankClock final {
+public:
+	static constexpr UINT WINDOW = 128;
+	static constexpr UINT MIN_SAMPLES = 8;
+	static constexpr UINT MAX_REJECTS = 8;
+	static constexpr double PRIOR_WEIGHT = 4.0;
+	static constexpr double OUTLIER_FRACTION = 0.25;
+
+	VBlankClock(int64_t frequency, DXGI_RATIONAL refreshRate) {
+		if (refreshRate.Numerator == 0 || refreshRate.Denominator == 0) {
+			refreshRate.Numerator = 60;
+			refreshRate.Denominator = 1;
+		}
+		mNominal = static_cast<double>(frequency) * refreshRate.Denominator / refreshRate.Numerator;
+		mRejected = 0;
+		reset();
+	}
+
+	// forget all the samples and start over from the nominal period.
+	void reset() {
+		mCount = 0;
+		mNext = 0;
+		mRejects = 0;
+		mPeriod = mNominal;
+		mBaseCount = 0;
+		mBaseTicks = 0;
+		mBaseOffset = 0.0;
+	}
+
+	// add an observed vblank timestamp, or return false if it was rejected.
+	bool addSample(int64_t ticks) {
+		if (mCount == 0) {
+			push(0, ticks);
+			return true;
+		}
+		auto& last = mSamples[(mNext + WINDOW - 1) % WINDOW];
+		auto periods = std::llround(static_cast<double>(ticks - last.ticks) / mPeriod);
+		auto count = last.count + periods;
+		auto residual = static_cast<double>(ticks - mBaseTicks) - mBaseOffset - (count - mBaseCount) * mPeriod;
+		if (periods <= 0 || (mCount >= MIN_SAMPLES && std::fabs(residual) > OUTLIER_FRACTION * mPeriod)) {
+			mRejected++;
+			if (++mRejects >= MAX_REJECTS) {
+				reset();
+				push(0, ticks);
+			}
+			return false;
+		}
+		mRejects = 0;
+		push(count, ticks);
+		return true;
+	}
+
+	// check whether enough samples have been collected for the predictions.
+	bool locked() const { return mCount >= MIN_SAMPLES; }
+
+	double nominalPeriod() const { return mNominal; }
+	double period() const { return mPeriod; }
+	uint64_t rejected() const { return mRejected; }
+
+	// get the predicted time of the first vblank after the given time.
+	int64_t nextVBlank(int64_t ticks) const {
+		auto elapsed = static_cast<double>(ticks - mBaseTicks) - mBaseOffset;
+		auto periods = std::floor(elapsed / mPeriod) + 1.0;
+		auto vblank = mBaseTicks + static_cast<int64_t>(std::llround(mBaseOffset + periods * mPeriod));
+		return vblank > ticks ? vblank : mBaseTicks + static_cast<int64_t>(std::llround(mBaseOffset + (periods + 1.0) * mPeriod));
+	}
+private:
+	struct Sample {
+		int64_t	count;
+		int64_t	ticks;
+	};
+
+	void push(int64_t count, int64_t ticks) {
+		mSamples[mNext] = { count, ticks };
+		mNext = (mNext + 1) % WINDOW;
+		mCount = mCount < WINDOW ? mCount + 1 : WINDOW;
+		fit(count, ticks);
+	}
+
+	// fit the line relative to the newest sample, so that the doubles keep their precision.
+	void fit(int64_t baseCount, int64_t baseTicks) {
+		double meanX = 0.0;
+		double meanY = 0.0;
+		for (UINT i = 0; i < mCount; i++) {
+			meanX += static_cast<double>(mSamples[i].count - baseCount);
+			meanY += static_cast<double>(mSamples[i].ticks - baseTicks);
+		}
+		meanX /= mCount;
+		meanY /= mCount;
+
+		double sxx = 0.0;
+		double sxy = 0.0;
+		for (UINT i = 0; i < mCount; i++) {
+			auto x = static_cast<double>(mSamples[i].count - baseCount) - meanX;
+			auto y = static_cast<double>(mSamples[i].ticks - baseTicks) - meanY;
+			sxx += x * x;
+			sxy += x * y;
+		}
+		mPeriod = (sxy + PRIOR_WEIGHT * mNominal) / (sxx + PRIOR_WEIGHT);
+		mBaseCount = baseCount;
+		mBaseTicks = baseTicks;
+		mBaseOffset = meanY - mPeriod * meanX;
+	}
+
+	double						mNominal;
+	double						mPeriod;
+	std::array<Sample, WINDOW>	mSamples;
+	UINT						mCount;
+	UINT						mNext;
+	UINT						mRejects;
+	uint64_t					mRejected;
+	int64_t						mBaseCount;		// the vblank count of the newest sample.
+	int64_t						mBaseTicks;		// the timestamp of the newest sample.
+	double						mBaseOffset;	// the fitted vblank time at the base count.
+};
+
+// ============================================================================
+// PreciseWaiter
+//
+// Waits until a target time with a sub-100 microsecond accuracy by combining
+// an OS sleep with a spin. The sleep is aimed a bit before the target as the
+// OS timers tend to oversleep (~50 us with the Linux timer slack, and up to a
+// scheduler quantum with the Windows Sleep), and the rest is spent spinning.
+//
+//		Linux	-- clock_nanosleep with CLOCK_MONOTONIC
+//		Windows	-- A high resolution waitable timer (Windows 10 1803+)
+//		Other	-- std::this_thread::sleep_for
+//
+// The spin time adapts to the measured oversleeps. It is kept at the average
+// oversleep plus four times its average deviation, so that a rare long delay
+// (e.g. a preemption) does not make every following wait spin for long. The
+// spin yields the processor, so it does not starve the other threads.
+// ============================================================================
+class PreciseWaiter final {
+public:
+	static constexpr int64_t MIN_SPIN_MICROS = 20;
+	static constexpr int64_t MAX_SPIN_MICROS = 4000;
+	static constexpr int64_t INITIAL_SPIN_MICROS = 1000;
+
+	explicit PreciseWaiter(TimeSource& time) : mTime(time) {
+		mMinSpin = microsToTicks(MIN_SPIN_MICROS);
+		mMaxSpin = microsToTicks(MAX_SPIN_MICROS);
+		mSpin = microsToTicks(INITIAL_SPIN_MICROS);
+		mOversleep = mSpin / 2;
+		mDeviation = mSpin / 8;
+#if defined(_WIN32)
+		mTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+	}
+
+	PreciseWaiter(const PreciseWaiter&) = delete;
+	PreciseWaiter& operator=(const PreciseWaiter&) = delete;
+
+	~PreciseWaiter() {
+#if defined(_WIN32)
+		if (mTimer != nullptr) {
+			CloseHandle(mTimer);
+		}
+#endif
+	}
+
+	// wait until the target time and get the amount of ticks the wait was late.
+	int64_t waitUntil(int64_t ticks) {
+		auto sleepTarget = ticks - mSpin;
+		auto now = mTime.now();
+		if (sleepTarget > now) {
+			sleep(sleepTarget - now);
+			now = mTime.now();
+			auto oversleep = now - sleepTarget;
+			auto deviation = oversleep > mOversleep ? oversleep - mOversleep : mOversleep - oversleep;
+			mOversleep += (oversleep - mOversleep) / 16;
+			mDeviation += (deviation - mDeviation) / 16;
+			mSpin = mOversleep + 4 * mDeviation + mMinSpin;
+			mSpin = mSpin < mMinSpin ? mMinSpin : (mSpin > mMaxSpin ? mMaxSpin : mSpin);
+		}
+		while (now < ticks) {
+			std::this_thread::yield();
+			now = mTime.now();
+		}
+		return now - ticks;
+	}
+
+	TimeSource& time() const { return mTime; }
+	int64_t spinTicks() const { return mSpin; }
+private:
+	int64_t microsToTicks(int64_t micros) const { return micros * mTime.frequency() / 1000000; }
+
+	void sleep(int64_t ticks) {
+		auto nanos = static_cast<int64_t>(static_cast<double>(ticks) * 1e9 / mTime.frequency());
+#if defined(__linux__)
+		timespec request = { static_cast<time_t>(nanos / 1000000000), static_cast<long>(nanos % 1000000000) };
+		timespec remaining = {};
+		while (clock_nanosleep(CLOCK_MONOTONIC, 0, &request, &remaining) == EINTR) {
+			request = remaining;
+		}
+#elif defined(_WIN32)
+		if (mTimer != nullptr) {
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -(nanos / 100);
+			if (SetWaitableTimer(mTimer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+				WaitForSingleObject(mTimer, INFINITE);
+				return;
+			}
+		}
+		Sleep(static_cast<DWORD>(nanos / 1000000));
+#else
+		std::this_thread::sleep_for(std::chrono::nanoseconds(nanos));
+#endif
+	}
+
+	TimeSource&	mTime;
+	int64_t		mSpin;
+	int64_t		mOversleep;		// the average oversleep.
+	int64_t		mDeviation;		// the average deviation of the oversleeps.
+	int64_t		mMinSpin;
+	int64_t		mMaxSpin;
+#if defined(_WIN32)
+	HANDLE		mTimer;
+#endif
+};
+
+// a source of the vertical blank timestamps.
+class VBlankSource {
+public:
+	virtual ~VBlankSource() = default;
+
+	// block until the next vertical blank and get the time when it was observed.
+	virtual HRESULT WaitForVBlank(int64_t* ticks) = 0;
+};
+
+// ============================================================================
+// SyntheticVBlankSource
+//
+// A display which refreshes with the given rate, drifted by the given parts
+// per million, and whose vblanks are observed late by a random amount up to
+// the given jitter. This allows testing the clock on a headless machine, and
+// the exact period and origin are known so that the estimates can be checked.
+// ============================================================================
+class SyntheticVBlankSource final : public VBlankSource {
+public:
+	SyntheticVBlankSource(TimeSource& time, DXGI_RATIONAL refreshRate, double driftPpm, int64_t jitterTicks, uint32_t seed = 1)
+		: mTime(time), mJitter(jitterTicks), mRandom(seed) {
+		mPeriod = static_cast<double>(time.frequency()) * refreshRate.Denominator / refreshRate.Numerator * (1.0 + driftPpm * 1e-6);
+		mOrigin = time.now();
+	}
+
+	HRESULT WaitForVBlank(int64_t* ticks) override {
+		if (ticks == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto vblank = nextVBlank(mTime.now());
+		mTime.waitUntil(vblank);
+		auto jitter = mJitter > 0 ? static_cast<int64_t>(mRandom() % static_cast<uint64_t>(mJitter + 1)) : 0;
+		*ticks = vblank + jitter;
+		return S_OK;
+	}
+
+	double period() const { return mPeriod; }
+
+	// get the exact time of the first vblank after the given time.
+	int64_t nextVBlank(int64_t ticks) const {
+		auto periods = std::floor(static_cast<double>(ticks - mOrigin) / mPeriod) + 1.0;
+		auto vblank = mOrigin + static_cast<int64_t>(std::llround(periods * mPeriod));
+		return vblank > ticks ? vblank : mOrigin + static_cast<int64_t>(std::llround((periods + 1.0) * mPeriod));
+	}
+private:
+	TimeSource&		mTime;
+	double			mPeriod;
+	int64_t			mOrigin;
+	int64_t			mJitter;
+	std::mt19937_64	mRandom;
+};
+
+#if defined(_WIN32)
+// a source which waits for the vblanks of a DXGI output.
+class OutputVBlankSource final : public VBlankSource {
+public:
+	OutputVBlankSource(IDXGIOutput* output, TimeSource& time) : mOutput(output), mTime(time) {}
+
+	HRESULT WaitForVBlank(int64_t* ticks) override {
+		if (ticks == nullptr) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto result = mOutput->WaitForVBlank();
+		*ticks = mTime.now();
+		return result;
+	}
+private:
+	Microsoft::WRL::ComPtr<IDXGIOutput>	mOutput;
+	TimeSource&							mTime;
+};
+#endif
+
+// a utility to wait until the given lead time before the next predicted vblank, which is returned.
+inline int64_t waitBeforeVBlank(const VBlankClock& clock, PreciseWaiter& waiter, int64_t leadTicks) {
+	auto vblank = clock.nextVBlank(waiter.time().now() + leadTicks);
+	waiter.waitUntil(vblank - leadTicks);
+	return vblank;
+}
\ No newline at end of file
@@ -0,0 +1,765 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "dxgi_shim.h"
+#include "format_convert.h"
+#include "simd_util.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// YUV Conversion
+//
+// Converts surfaces between the YUV formats used by video decoders and video
+// processors (e.g. the IDXGIDecodeSwapChain and the multi-plane overlays) and
+// the RGB formats of the format conversion (RGBA8, BGRA8, R10G10B10A2 and FP16).
+// The YUV surfaces are described with the same SurfaceView as the RGB ones.
+//
+//		NV12	-- 4:2:0, 8-bit Y plane followed by an interleaved UV plane
+//		P010	-- 4:2:0, as NV12 with 16-bit codes in the high 10 bits
+//		YUY2	-- 4:2:2, packed Y0 U Y1 V bytes for each pair of pixels
+//		AYUV	-- 4:4:4, packed V U Y A bytes for each pixel
+//		Y410	-- 4:4:4, packed 10-bit U Y V and 2-bit alpha for each pixel
+//
+// The planar formats are laid out as the Map of a DXGI surface lays them out,
+// i.e. the chroma plane (of height / 2 rows) follows the luma plane directly
+// at bits + pitch * height and uses the same pitch. The width of the 4:2:0 and
+// 4:2:2 surfaces and the height of the 4:2:0 surfaces must be even.
+//
+// The colour matrix is chosen with YuvMatrix (BT.601, BT.709 or BT.2020 non-
+// constant luminance) and the code range with YuvRange. Limited range codes
+// put black at 16 and white at 235 (chroma 16 to 240), scaled up for 10 bits.
+// Full range codes use the whole range of the bit depth.
+//
+// Chroma is down-sampled with a box filter (the average of the 2x2 or 2x1
+// pixels) and up-sampled by replicating it to the pixels which it covers.
+// RGB values are clamped to [0, 1] before they are encoded into YUV and codes
+// are rounded to nearest. Decoded FP16 values are not clamped, so limited
+// range codes below black and above white are kept.
+//
+// Surfaces are converted in slices of rows, which run in parallel when a
+// ThreadPool is given. The AVX2 kernels (8 pixels) perform the same float
+// operations as the scalar kernels, so the results are bit-exact. Other SIMD
+// levels use the scalar kernels.
+// ============================================================================
+
+// the colour matrices between RGB and YUV.
+enum class YuvMatrix {
+	Bt601,
+	Bt709,
+	Bt2020
+};
+
+// a utility to convert YuvMatrix into a string.
+inline const char* yuvMatrixString(YuvMatrix matrix) {
+	switch (matrix) {
+	case YuvMatrix::Bt601:
+		return "BT.601";
+	case YuvMatrix::Bt709:
+		return "BT.709";
+	case YuvMatrix::Bt2020:
+		return "BT.2020";
+	default:
+		return "unknown";
+	}
+}
+
+// the code ranges of the YUV values.
+enum class YuvRange {
+	Full,
+	Limited
+};
+
+// a utility to convert YuvRange into a string.
+inline const char* yuvRangeString(YuvRange range) {
+	switch (range) {
+	case YuvRange::Full:
+		return "full";
+	case YuvRange::Limited:
+		return "limited";
+	default:
+		return "unknown";
+	}
+}
+
+// the memory layouts of the supported YUV formats.
+enum class YuvLayout {
+	Unknown,
+	Nv12,
+	P010,
+	Yuy2,
+	Ayuv,
+	Y410
+};
+
+// a utility to get the memory layout of the YUV format.
+inline YuvLayout yuvLayout(DXGI_FORMAT format) {
+	switch (format) {
+	case DXGI_FORMAT_NV12:
+		return YuvLayout::Nv12;
+	case DXGI_FORMAT_P010:
+		return YuvLayout::P010;
+	case DXGI_FORMAT_YUY2:
+		return YuvLayout::Yuy2;
+	case DXGI_FORMAT_AYUV:
+		return YuvLayout::Ayuv;
+	case DXGI_FORMAT_Y410:
+		return YuvLayout::Y410;
+	default:
+		return YuvLayout::Unknown;
+	}
+}
+
+// a utility to get the bits of the codes of the layout.
+constexpr UINT yuvBits(YuvLayout layout) {
+	return layout == YuvLayout::P010 || layout == YuvLayout::Y410 ? 10 : 8;
+}
+
+// a utility to get the bytes of the luma row for each pixel (the chroma rows of 4:2:0 use the same).
+constexpr UINT yuvPixelSize(YuvLayout layout) {
+	return layout == YuvLayout::Nv12 ? 1 : (layout == YuvLayout::Ayuv || layout == YuvLayout::Y410 ? 4 : 2);
+}
+
+// a utility to tell whether the layout has a separate chroma plane of half height.
+constexpr bool yuvPlanar(YuvLayout layout) {
+	return layout == YuvLayout::Nv12 || layout == YuvLayout::P010;
+}
+
+// a utility to get the bytes of a row of the YUV format (or 0 if the format is not YUV).
+inline UINT yuvRowSize(DXGI_FORMAT format, UINT width) {
+	auto layout = yuvLayout(format);
+	return layout == YuvLayout::Unknown ? 0 : width * yuvPixelSize(layout);
+}
+
+// a utility to get the bytes of a YUV surface with the pitch, including the chroma plane.
+inline size_t yuvSurfaceSize(DXGI_FORMAT format, UINT pitch, UINT height) {
+	auto size = static_cast<size_t>(pitch) * height;
+	return yuvPlanar(yuvLayout(format)) ? size + size / 2 : size;
+}
+
+// the constants of a matrix and a range for a bit depth.
+struct YuvCoefficients {
+	float	yOffset;	// the luma code of black.
+	float	yRange;		// the luma codes from black to white.
+	float	yScale;		// 1 / yRange.
+	float	cOffset;	// the chroma code of zero.
+	float	cRange;		// the chroma codes from -0.5 to 0.5.
+	float	cScale;		// 1 / cRange.
+	float	maxCode;	// the largest code of the bit depth.
+	float	kr;			// the weights of red, green and blue in luma.
+	float	kg;
+	float	kb;
+	float	uScale;		// 0.5 / (1 - kb), which turns B - Y into U.
+	float	vScale;		// 0.5 / (1 - kr), which turns R - Y into V.
+	float	rv;			// the weight of V in red.
+	float	gu;			// the weights of U and V in green.
+	float	gv;
+	float	bu;			// the weight of U in blue.
+};
+
+// a utility to build the constants of the matrix and the range for the bits.
+inline YuvCoefficients yuvCoefficients(YuvMatrix matrix, YuvRange range, UINT bits) {
+	double kr, kb;
+	switch (matrix) {
+	case YuvMatrix::Bt601:
+		kr = 0.299, kb = 0.114;
+		break;
+	case YuvMatrix::Bt2020:
+		kr = 0.2627, kb = 0.0593;
+		break;
+	default:
+		kr = 0.2126, kb = 0.0722;
+		break;
+	}
+	auto kg = 1.0 - kr - kb;
+	auto scale = static_cast<double>(1u << (bits - 8));
+	auto maxCode = static_cast<double>((1u << bits) - 1);
+	auto limited = range == YuvRange::Limited;
+
+	YuvCoefficients k = {};
+	k.yOffset = static_cast<float>(limited ? 16.0 * scale : 0.0);
+	k.yRange = static_cast<float>(limited ? 219.0 * scale : maxCode);
+	k.yScale = static_cast<float>(1.0 / k.yRange);
+	k.cOffset = static_cast<float>(128.0 * scale);
+	k.cRange = static_cast<float>(limited ? 224.0 * scale : maxCode);
+	k.cScale = static_cast<float>(1.0 / k.cRange);
+	k.maxCode = static_cast<float>(maxCode);
+	k.kr = static_cast<float>(kr);
+	k.kg = static_cast<float>(kg);
+	k.kb = static_cast<float>(kb);
+	k.uScale = static_cast<float>(0.5 / (1.0 - kb));
+	k.vScale = static_cast<float>(0.5 / (1.0 - kr));
+	k.rv = static_cast<float>(2.0 * (1.0 - kr));
+	k.gu = static_cast<float>(-2.0 * kb * (1.0 - kb) / kg);
+	k.gv = static_cast<float>(-2.0 * kr * (1.0 - kr) / kg);
+	k.bu = static_cast<float>(2.0 * (1.0 - kb));
+	return k;
+}
+
+// ============================================================================
+// Scalar kernels
+// ============================================================================
+
+// a utility to read a 16-bit or a 32-bit value from unaligned memory.
+template <typename T>
+inline T readValue(const BYTE* src) {
+	T value;
+	std::memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+// a utility to write a 16-bit or a 32-bit value into unaligned memory.
+template <typename T>
+inline void writeValue(BYTE* dst, T value) {
+	std::memcpy(dst, &value, sizeof(value));
+}
+
+// a utility to quantize a normalized value into a code with the offset and the range.
+inline uint32_t quantizeCode(float value, float offset, float range, float maximum) {
+	value = value * range + offset;
+	value = value > 0.0f ? (value < maximum ? value : maximum) : 0.0f;
+	return static_cast<uint32_t>(value + 0.5f);
+}
+
+// a utility to decode the pixel at x of the layout into RGBA floats.
+template <YuvLayout Layout>
+inline void decodeYuvPixel(const BYTE* luma, const BYTE* chroma, UINT x, const YuvCoefficients& k, float* rgba) {
+	uint32_t codes[3];
+	auto alpha = 1.0f;
+	auto pair = x & ~1u;
+	if constexpr (Layout == YuvLayout::Nv12) {
+		codes[0] = luma[x];
+		codes[1] = chroma[pair];
+		codes[2] = chroma[pair + 1];
+	} else if constexpr (Layout == YuvLayout::P010) {
+		codes[0] = readValue<uint16_t>(luma + x * 2) >> 6;
+		codes[1] = readValue<uint16_t>(chroma + pair * 2) >> 6;
+		codes[2] = readValue<uint16_t>(chroma + pair * 2 + 2) >> 6;
+	} else if constexpr (Layout == YuvLayout::Yuy2) {
+		codes[0] = luma[x * 2];
+		codes[1] = chroma[pair * 2 + 1];
+		codes[2] = chroma[pair * 2 + 3];
+	} else if constexpr (Layout == YuvLayout::Ayuv) {
+		auto pixel = readValue<uint32_t>(luma + x * 4);
+		codes[0] = (pixel >> 16) & 0xff;
+		codes[1] = (pixel >> 8) & 0xff;
+		codes[2] = pixel & 0xff;
+		alpha = unormToFloat(pixel >> 24, 255.0f);
+	} else {
+		auto pixel = readValue<uint32_t>(luma + x * 4);
+		codes[0] = (pixel >> 10) & 0x3ff;
+		codes[1] = pixel & 0x3ff;
+		codes[2] = (pixel >> 20) & 0x3ff;
+		alpha = unormToFloat(pixel >> 30, 3.0f);
+	}
+	auto y = (static_cast<float>(codes[0]) - k.yOffset) * k.yScale;
+	auto u = (static_cast<float>(codes[1]) - k.cOffset) * k.cScale;
+	auto v = (static_cast<float>(codes[2]) - k.cOffset) * k.cScale;
+	rgba[0] = y + k.rv * v;
+	rgba[1] = y + k.gu * u + k.gv * v;
+	rgba[2] = y + k.bu * u;
+	rgba[3] = alpha;
+}
+
+// a utility to turn RGB floats into the normalized luma and chroma of the matrix.
+inline void rgbToYuv(const float* rgba, const YuvCoefficients& k, float* yuv) {
+	float rgb[3];
+	for (auto c = 0; c < 3; c++) {
+		rgb[c] = rgba[c] > 0.0f ? (rgba[c] < 1.0f ? rgba[c] : 1.0f) : 0.0f;
+	}
+	yuv[0] = k.kr * rgb[0] + k.kg * rgb[1] + k.kb * rgb[2];
+	yuv[1] = (rgb[2] - yuv[0]) * k.uScale;
+	yuv[2] = (rgb[0] - yuv[0]) * k.vScale;
+}
+
+// a scalar kernel which converts a row of YUV pixels into RGB pixels.
+template <YuvLayout Src, PixelLayout Dst>
+inline void yuvToRgbRowScalar(const BYTE* luma, const BYTE* chroma, BYTE* dst, UINT count, const YuvCoefficients& k) {
+	const UINT CHUNK = 64;
+	float rgba[CHUNK * 4];
+	const auto dstSize = Dst == PixelLayout::Rgba16f ? 8u : 4u;
+	for (UINT i = 0; i < count; i += CHUNK) {
+		auto n = count - i < CHUNK ? count - i : CHUNK;
+		for (UINT j = 0; j < n; j++) {
+			decodeYuvPixel<Src>(luma, chroma, i + j, k, rgba + j * 4);
+		}
+		encodePixels<Dst>(rgba, dst + i * dstSize, n);
+	}
+}
+
+// a scalar kernel which converts rows of RGB pixels into YUV pixels. The 4:2:0
+// layouts convert two rows into two luma rows and a chroma row, while the other
+// layouts only use the first rows (and their chroma is in the luma row).
+template <PixelLayout Src, YuvLayout Dst>
+inline void rgbToYuvRowScalar(const BYTE* src0, const BYTE* src1, BYTE* luma0, BYTE* luma1, BYTE* chroma,
+	UINT count, const YuvCoefficients& k) {
+	const UINT CHUNK = 64;
+	const auto srcSize = Src == PixelLayout::Rgba16f ? 8u : 4u;
+	const auto rows = yuvPlanar(Dst) ? 2 : 1;
+	float rgba[2][CHUNK * 4];
+	float yuv[2][CHUNK * 3];
+	for (UINT i = 0; i < count; i += CHUNK) {
+		auto n = count - i < CHUNK ? count - i : CHUNK;
+		for (auto row = 0; row < rows; row++) {
+			decodePixels<Src>((row == 0 ? src0 : src1) + i * srcSize, rgba[row], n);
+			for (UINT j = 0; j < n; j++) {
+				rgbToYuv(rgba[row] + j * 4, k, yuv[row] + j * 3);
+			}
+		}
+		for (UINT j = 0; j < n; j++) {
+			auto x = i + j;
+			auto p = yuv[0] + j * 3;
+			auto y = quantizeCode(p[0], k.yOffset, k.yRange, k.maxCode);
+			if constexpr (Dst == YuvLayout::Nv12 || Dst == YuvLayout::P010) {
+				auto q = yuv[1] + j * 3;
+				auto y1 = quantizeCode(q[0], k.yOffset, k.yRange, k.maxCode);
+				uint32_t u = 0, v = 0;
+				if ((x & 1) == 0) {
+					u = quantizeCode(((p[1] + q[1]) + (p[4] + q[4])) * 0.25f, k.cOffset, k.cRange, k.maxCode);
+					v = quantizeCode(((p[2] + q[2]) + (p[5] + q[5])) * 0.25f, k.cOffset, k.cRange, k.maxCode);
+				}
+				if constexpr (Dst == YuvLayout::Nv12) {
+					luma0[x] = static_cast<BYTE>(y);
+					luma1[x] = static_cast<BYTE>(y1);
+					if ((x & 1) == 0) {
+						chroma[x] = static_cast<BYTE>(u);
+						chroma[x + 1] = static_cast<BYTE>(v);
+					}
+				} else {
+					writeValue(luma0 + x * 2, static_cast<uint16_t>(y << 6));
+					writeValue(luma1 + x * 2, static_cast<uint16_t>(y1 << 6));
+					if ((x & 1) == 0) {
+						writeValue(chroma + x * 2, static_cast<uint16_t>(u << 6));
+						writeValue(chroma + x * 2 + 2, static_cast<uint16_t>(v << 6));
+					}
+				}
+			} else if constexpr (Dst == YuvLayout::Yuy2) {
+				luma0[x * 2] = static_cast<BYTE>(y);
+				if ((x & 1) == 0) {
+					chroma[x * 2 + 1] = static_cast<BYTE>(quantizeCode((p[1] + p[4]) * 0.5f, k.cOffset, k.cRange, k.maxCode));
+					chroma[x * 2 + 3] = static_cast<BYTE>(quantizeCode((p[2] + p[5]) * 0.5f, k.cOffset, k.cRange, k.maxCode));
+				}
+			} else {
+				auto u = quantizeCode(p[1], k.cOffset, k.cRange, k.maxCode);
+				auto v = quantizeCode(p[2], k.cOffset, k.cRange, k.maxCode);
+				auto alpha = rgba[0][j * 4 + 3];
+				if constexpr (Dst == YuvLayout::Ayuv) {
+					writeValue(luma0 + x * 4, v | (u << 8) | (y << 16) | (floatToUnorm(alpha, 255.0f) << 24));
+				} else {
+					writeValue(luma0 + x * 4, u | (y << 10) | (v << 20) | (floatToUnorm(alpha, 3.0f) << 30));
+				}
+			}
+		}
+	}
+}
+
+// ============================================================================
+// AVX2 kernels
+// ============================================================================
+#if defined(SIMD_X86)
+
+SIMD_TARGET_AVX2 inline __m256 clampUnitAvx2(__m256 value) {
+	return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+SIMD_TARGET_AVX2 inline __m256i quantizeUnormAvx2(__m256 value, float maximum) {
+	auto scaled = _mm256_mul_ps(clampUnitAvx2(value), _mm256_set1_ps(maximum));
+	return _mm256_cvttps_epi32(_mm256_add_ps(scaled, _mm256_set1_ps(0.5f)));
+}
+
+SIMD_TARGET_AVX2 inline __m256i quantizeCodeAvx2(__m256 value, float offset, float range, float maximum) {
+	value = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(range)), _mm256_set1_ps(offset));
+	value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(maximum));
+	return _mm256_cvttps_epi32(_mm256_add_ps(value, _mm256_set1_ps(0.5f)));
+}
+
+// pack 8 codes into 16-bit values.
+SIMD_TARGET_AVX2 inline __m128i packCodesAvx2(__m256i codes) {
+	return _mm_packus_epi32(_mm256_castsi256_si128(codes), _mm256_extracti128_si256(codes, 1));
+}
+
+// load the codes and the alpha of 8 pixels.
+template <YuvLayout Layout>
+SIMD_TARGET_AVX2 inline void loadYuvAvx2(const BYTE* luma, const BYTE* chroma, __m256i* codes, __m256* alpha) {
+	*alpha = _mm256_set1_ps(1.0f);
+	if constexpr (Layout == YuvLayout::Nv12) {
+		auto uv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma));
+		codes[0] = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma)));
+		codes[1] = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uv, _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1)));
+		codes[2] = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uv, _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1)));
+	} else if constexpr (Layout == YuvLayout::P010) {
+		auto y = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma)), 6);
+		auto uv = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma)), 6);
+		codes[0] = _mm256_cvtepu16_epi32(y);
+		codes[1] = _mm256_cvtepu16_epi32(_mm_shuffle_epi8(uv, _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13)));
+		codes[2] = _mm256_cvtepu16_epi32(_mm_shuffle_epi8(uv, _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15)));
+	} else if constexpr (Layout == YuvLayout::Yuy2) {
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma));
+		codes[0] = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(pixels, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1)));
+		codes[1] = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(pixels, _mm_setr_epi8(1, 1, 5, 5, 9, 9, 13, 13, -1, -1, -1, -1, -1, -1, -1, -1)));
+		codes[2] = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(pixels, _mm_setr_epi8(3, 3, 7, 7, 11, 11, 15, 15, -1, -1, -1, -1, -1, -1, -1, -1)));
+	} else if constexpr (Layout == YuvLayout::Ayuv) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(luma));
+		auto mask = _mm256_set1_epi32(0xff);
+		codes[0] = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask);
+		codes[1] = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+		codes[2] = _mm256_and_si256(pixels, mask);
+		*alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)), _mm256_set1_ps(1.0f / 255.0f));
+	} else {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(luma));
+		auto mask = _mm256_set1_epi32(0x3ff);
+		codes[0] = _mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask);
+		codes[1] = _mm256_and_si256(pixels, mask);
+		codes[2] = _mm256_and_si256(_mm256_srli_epi32(pixels, 20), mask);
+		*alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 30)), _mm256_set1_ps(1.0f / 3.0f));
+	}
+}
+
+// store 8 RGBA pixels of the layout.
+template <PixelLayout Layout>
+SIMD_TARGET_AVX2 inline void storeRgbaAvx2(const __m256* rgba, BYTE* dst) {
+	if constexpr (Layout == PixelLayout::Rgba8 || Layout == PixelLayout::Bgra8) {
+		auto red = quantizeUnormAvx2(rgba[0], 255.0f);
+		auto blue = quantizeUnormAvx2(rgba[2], 255.0f);
+		auto c0 = Layout == PixelLayout::Rgba8 ? red : blue;
+		auto c2 = Layout == PixelLayout::Rgba8 ? blue : red;
+		auto pixels = _mm256_or_si256(_mm256_or_si256(c0, _mm256_slli_epi32(quantizeUnormAvx2(rgba[1], 255.0f), 8)),
+			_mm256_or_si256(_mm256_slli_epi32(c2, 16), _mm256_slli_epi32(quantizeUnormAvx2(rgba[3], 255.0f), 24)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), pixels);
+	} else if constexpr (Layout == PixelLayout::Rgb10a2) {
+		auto rg = _mm256_or_si256(quantizeUnormAvx2(rgba[0], 1023.0f), _mm256_slli_epi32(quantizeUnormAvx2(rgba[1], 1023.0f), 10));
+		auto ba = _mm256_or_si256(_mm256_slli_epi32(quantizeUnormAvx2(rgba[2], 1023.0f), 20), _mm256_slli_epi32(quantizeUnormAvx2(rgba[3], 3.0f), 30));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(rg, ba));
+	} else {
+		auto rgLow = _mm256_unpacklo_ps(rgba[0], rgba[1]);
+		auto baLow = _mm256_unpacklo_ps(rgba[2], rgba[3]);
+		auto rgHigh = _mm256_unpackhi_ps(rgba[0], rgba[1]);
+		auto baHigh = _mm256_unpackhi_ps(rgba[2], rgba[3]);
+		auto p0 = _mm256_shuffle_ps(rgLow, baLow, _MM_SHUFFLE(1, 0, 1, 0));		// pixels 0 and 4
+		auto p1 = _mm256_shuffle_ps(rgLow, baLow, _MM_SHUFFLE(3, 2, 3, 2));		// pixels 1 and 5
+		auto p2 = _mm256_shuffle_ps(rgHigh, baHigh, _MM_SHUFFLE(1, 0, 1, 0));	// pixels 2 and 6
+		auto p3 = _mm256_shuffle_ps(rgHigh, baHigh, _MM_SHUFFLE(3, 2, 3, 2));	// pixels 3 and 7
+		auto out = reinterpret_cast<__m128i*>(dst);
+		_mm_storeu_si128(out, _mm256_cvtps_ph(_mm256_permute2f128_ps(p0, p1, 0x20), _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128(out + 1, _mm256_cvtps_ph(_mm256_permute2f128_ps(p2, p3, 0x20), _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128(out + 2, _mm256_cvtps_ph(_mm256_permute2f128_ps(p0, p1, 0x31), _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128(out + 3, _mm256_cvtps_ph(_mm256_permute2f128_ps(p2, p3, 0x31), _MM_FROUND_TO_NEAREST_INT));
+	}
+}
+
+// load 8 RGBA pixels of the layout as floats.
+template <PixelLayout Layout>
+SIMD_TARGET_AVX2 inline void loadRgbaAvx2(const BYTE* src, __m256* rgba) {
+	if constexpr (Layout == PixelLayout::Rgba8 || Layout == PixelLayout::Bgra8) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		auto mask = _mm256_set1_epi32(0xff);
+		auto scale = _mm256_set1_ps(1.0f / 255.0f);
+		auto c0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(pixels, mask)), scale);
+		auto c2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask)), scale);
+		rgba[0] = Layout == PixelLayout::Rgba8 ? c0 : c2;
+		rgba[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask)), scale);
+		rgba[2] = Layout == PixelLayout::Rgba8 ? c2 : c0;
+		rgba[3] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)), scale);
+	} else if constexpr (Layout == PixelLayout::Rgb10a2) {
+		auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		auto mask = _mm256_set1_epi32(0x3ff);
+		auto scale = _mm256_set1_ps(1.0f / 1023.0f);
+		rgba[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(pixels, mask)), scale);
+		rgba[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask)), scale);
+		rgba[2] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 20), mask)), scale);
+		rgba[3] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 30)), _mm256_set1_ps(1.0f / 3.0f));
+	} else {
+		auto in = reinterpret_cast<const __m128i*>(src);
+		auto q0 = _mm256_cvtph_ps(_mm_loadu_si128(in));		// pixels 0 and 1
+		auto q1 = _mm256_cvtph_ps(_mm_loadu_si128(in + 1));	// pixels 2 and 3
+		auto q2 = _mm256_cvtph_ps(_mm_loadu_si128(in + 2));	// pixels 4 and 5
+		auto q3 = _mm256_cvtph_ps(_mm_loadu_si128(in + 3));	// pixels 6 and 7
+		auto a = _mm256_permute2f128_ps(q0, q2, 0x20);		// pixels 0 and 4
+		auto b = _mm256_permute2f128_ps(q0, q2, 0x31);		// pixels 1 and 5
+		auto c = _mm256_permute2f128_ps(q1, q3, 0x20);		// pixels 2 and 6
+		auto d = _mm256_permute2f128_ps(q1, q3, 0x31);		// pixels 3 and 7
+		auto rg01 = _mm256_unpacklo_ps(a, b);
+		auto rg23 = _mm256_unpacklo_ps(c, d);
+		auto ba01 = _mm256_unpackhi_ps(a, b);
+		auto ba23 = _mm256_unpackhi_ps(c, d);
+		rgba[0] = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(1, 0, 1, 0));
+		rgba[1] = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(3, 2, 3, 2));
+		rgba[2] = _mm256_shuffle_ps(ba01, ba23, _MM_SHUFFLE(1, 0, 1, 0));
+		rgba[3] = _mm256_shuffle_ps(ba01, ba23, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+}
+
+// turn clamped RGB floats into the normalized luma and chroma of the matrix.
+SIMD_TARGET_AVX2 inline void rgbToYuvAvx2(const __m256* rgba, const YuvCoefficients& k, __m256* yuv) {
+	auto r = clampUnitAvx2(rgba[0]);
+	auto g = clampUnitAvx2(rgba[1]);
+	auto b = clampUnitAvx2(rgba[2]);
+	auto rg = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(k.kr), r), _mm256_mul_ps(_mm256_set1_ps(k.kg), g));
+	yuv[0] = _mm256_add_ps(rg, _mm256_mul_ps(_mm256_set1_ps(k.kb), b));
+	yuv[1] = _mm256_mul_ps(_mm256_sub_ps(b, yuv[0]), _mm256_set1_ps(k.uScale));
+	yuv[2] = _mm256_mul_ps(_mm256_sub_ps(r, yuv[0]), _mm256_set1_ps(k.vScale));
+}
+
+// average the chroma of pairs of pixels into codes in the U0 V0 U1 V1 ... order.
+SIMD_TARGET_AVX2 inline __m256i pairChromaAvx2(__m256 u, __m256 v, float weight, const YuvCoefficients& k) {
+	auto uv = _mm256_mul_ps(_mm256_hadd_ps(u, v), _mm256_set1_ps(weight));
+	return quantizeCodeAvx2(_mm256_permute_ps(uv, _MM_SHUFFLE(3, 1, 2, 0)), k.cOffset, k.cRange, k.maxCode);
+}
+
+template <YuvLayout Src, PixelLayout Dst>
+SIMD_TARGET_AVX2 inline void yuvToRgbRowAvx2(const BYTE* luma, const BYTE* chroma, BYTE* dst, UINT count, const YuvCoefficients& k) {
+	const auto pixelSize = yuvPixelSize(Src);
+	const auto dstSize = Dst == PixelLayout::Rgba16f ? 8u : 4u;
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i codes[3];
+		__m256 rgba[4];
+		loadYuvAvx2<Src>(luma + i * pixelSize, chroma + i * pixelSize, codes, &rgba[3]);
+		auto y = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(codes[0]), _mm256_set1_ps(k.yOffset)), _mm256_set1_ps(k.yScale));
+		auto u = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(codes[1]), _mm256_set1_ps(k.cOffset)), _mm256_set1_ps(k.cScale));
+		auto v = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(codes[2]), _mm256_set1_ps(k.cOffset)), _mm256_set1_ps(k.cScale));
+		rgba[0] = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(k.rv), v));
+		rgba[1] = _mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(k.gu), u)), _mm256_mul_ps(_mm256_set1_ps(k.gv), v));
+		rgba[2] = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(k.bu), u));
+		storeRgbaAvx2<Dst>(rgba, dst + i * dstSize);
+	}
+	yuvToRgbRowScalar<Src, Dst>(luma + i * pixelSize, chroma + i * pixelSize, dst + i * dstSize, count - i, k);
+}
+
+template <PixelLayout Src, YuvLayout Dst>
+SIMD_TARGET_AVX2 inline void rgbToYuvRowAvx2(const BYTE* src0, const BYTE* src1, BYTE* luma0, BYTE* luma1, BYTE* chroma,
+	UINT count, const YuvCoefficients& k) {
+	const auto pixelSize = yuvPixelSize(Dst);
+	const auto srcSize = Src == PixelLayout::Rgba16f ? 8u : 4u;
+	UINT i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 rgba[4];
+		__m256 yuv[3];
+		loadRgbaAvx2<Src>(src0 + i * srcSize, rgba);
+		rgbToYuvAvx2(rgba, k, yuv);
+		auto y = quantizeCodeAvx2(yuv[0], k.yOffset, k.yRange, k.maxCode);
+		if constexpr (Dst == YuvLayout::Nv12 || Dst == YuvLayout::P010) {
+			__m256 rgba1[4];
+			__m256 yuv1[3];
+			loadRgbaAvx2<Src>(src1 + i * srcSize, rgba1);
+			rgbToYuvAvx2(rgba1, k, yuv1);
+			auto y1 = quantizeCodeAvx2(yuv1[0], k.yOffset, k.yRange, k.maxCode);
+			auto uv = pairChromaAvx2(_mm256_add_ps(yuv[1], yuv1[1]), _mm256_add_ps(yuv[2], yuv1[2]), 0.25f, k);
+			if constexpr (Dst == YuvLayout::Nv12) {
+				auto y16 = packCodesAvx2(y);
+				auto y116 = packCodesAvx2(y1);
+				auto uv16 = packCodesAvx2(uv);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(luma0 + i), _mm_packus_epi16(y16, y16));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(luma1 + i), _mm_packus_epi16(y116, y116));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(chroma + i), _mm_packus_epi16(uv16, uv16));
+			} else {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(luma0 + i * 2), _mm_slli_epi16(packCodesAvx2(y), 6));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(luma1 + i * 2), _mm_slli_epi16(packCodesAvx2(y1), 6));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(chroma + i * 2), _mm_slli_epi16(packCodesAvx2(uv), 6));
+			}
+		} else if constexpr (Dst == YuvLayout::Yuy2) {
+			auto y16 = packCodesAvx2(y);
+			auto uv16 = packCodesAvx2(pairChromaAvx2(yuv[1], yuv[2], 0.5f, k));
+			auto pixels = _mm_packus_epi16(_mm_unpacklo_epi16(y16, uv16), _mm_unpackhi_epi16(y16, uv16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(luma0 + i * 2), pixels);
+		} else {
+			auto u = quantizeCodeAvx2(yuv[1], k.cOffset, k.cRange, k.maxCode);
+			auto v = quantizeCodeAvx2(yuv[2], k.cOffset, k.cRange, k.maxCode);
+			__m256i pixels;
+			if constexpr (Dst == YuvLayout::Ayuv) {
+				pixels = _mm256_or_si256(_mm256_or_si256(v, _mm256_slli_epi32(u, 8)),
+					_mm256_or_si256(_mm256_slli_epi32(y, 16), _mm256_slli_epi32(quantizeUnormAvx2(rgba[3], 255.0f), 24)));
+			} else {
+				pixels = _mm256_or_si256(_mm256_or_si256(u, _mm256_slli_epi32(y, 10)),
+					_mm256_or_si256(_mm256_slli_epi32(v, 20), _mm256_slli_epi32(quantizeUnormAvx2(rgba[3], 3.0f), 30)));
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(luma0 + i * 4), pixels);
+		}
+	}
+	rgbToYuvRowScalar<Src, Dst>(src0 + i * srcSize, src1 + i * srcSize, luma0 + i * pixelSize, luma1 + i * pixelSize,
+		chroma + i * pixelSize, count - i, k);
+}
+
+#endif
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+// a function to convert a row of YUV pixels (the chroma row is the luma row of packed layouts).
+typedef void(*YuvToRgbRowFunc)(const BYTE* luma, const BYTE* chroma, BYTE* dst, UINT count, const YuvCoefficients& k);
+
+// a function to convert rows of RGB pixels (only the first rows are used by non-4:2:0 layouts).
+typedef void(*RgbToYuvRowFunc)(const BYTE* src0, const BYTE* src1, BYTE* luma0, BYTE* luma1, BYTE* chroma,
+	UINT count, const YuvCoefficients& k);
+
+// a utility to find the YUV to RGB kernel for the given layouts and the SIMD level.
+template <YuvLayout Src, PixelLayout Dst>
+inline YuvToRgbRowFunc findYuvToRgbRow(SimdLevel level) {
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		return &yuvToRgbRowAvx2<Src, Dst>;
+	}
+#endif
+	(void)level;
+	return &yuvToRgbRowScalar<Src, Dst>;
+}
+
+// a utility to find the YUV to RGB kernel for the given destination layout.
+template <YuvLayout Src>
+inline YuvToRgbRowFunc findYuvToRgbRow(PixelLayout dst, SimdLevel level) {
+	switch (dst) {
+	case PixelLayout::Rgba8:
+		return findYuvToRgbRow<Src, PixelLayout::Rgba8>(level);
+	case PixelLayout::Bgra8:
+		return findYuvToRgbRow<Src, PixelLayout::Bgra8>(level);
+	case PixelLayout::Rgb10a2:
+		return findYuvToRgbRow<Src, PixelLayout::Rgb10a2>(level);
+	case PixelLayout::Rgba16f:
+		return findYuvToRgbRow<Src, PixelLayout::Rgba16f>(level);
+	default:
+		return nullptr;
+	}
+}
+
+// a utility to find the YUV to RGB kernel for the given layouts.
+inline YuvToRgbRowFunc findYuvToRgbRow(YuvLayout src, PixelLayout dst, SimdLevel level) {
+	switch (src) {
+	case YuvLayout::Nv12:
+		return findYuvToRgbRow<YuvLayout::Nv12>(dst, level);
+	case YuvLayout::P010:
+		return findYuvToRgbRow<YuvLayout::P010>(dst, level);
+	case YuvLayout::Yuy2:
+		return findYuvToRgbRow<YuvLayout::Yuy2>(dst, level);
+	case YuvLayout::Ayuv:
+		return findYuvToRgbRow<YuvLayout::Ayuv>(dst, level);
+	case YuvLayout::Y410:
+		return findYuvToRgbRow<YuvLayout::Y410>(dst, level);
+	default:
+		return nullptr;
+	}
+}
+
+// a utility to find the RGB to YUV kernel for the given layouts and the SIMD level.
+template <PixelLayout Src, YuvLayout Dst>
+inline RgbToYuvRowFunc findRgbToYuvRow(SimdLevel level) {
+#if defined(SIMD_X86)
+	if (level == SimdLevel::Avx2) {
+		return &rgbToYuvRowAvx2<Src, Dst>;
+	}
+#endif
+	(void)level;
+	return &rgbToYuvRowScalar<Src, Dst>;
+}
+
+// a utility to find the RGB to YUV kernel for the given destination layout.
+template <PixelLayout Src>
+inline RgbToYuvRowFunc findRgbToYuvRow(YuvLayout dst, SimdLevel level) {
+	switch (dst) {
+	case YuvLayout::Nv12:
+		return findRgbToYuvRow<Src, YuvLayout::Nv12>(level);
+	case YuvLayout::P010:
+		return findRgbToYuvRow<Src, YuvLayout::P010>(level);
+	case YuvLayout::Yuy2:
+		return findRgbToYuvRow<Src, YuvLayout::Yuy2>(level);
+	case YuvLayout::Ayuv:
+		return findRgbToYuvRow<Src, YuvLayout::Ayuv>(level);
+	case YuvLayout::Y410:
+		return findRgbToYuvRow<Src, YuvLayout::Y410>(level);
+	default:
+		return nullptr;
+	}
+}
+
+// a utility to find the RGB to YUV kernel for the given layouts.
+inline RgbToYuvRowFunc findRgbToYuvRow(PixelLayout src, YuvLayout dst, SimdLevel level) {
+	switch (src) {
+	case PixelLayout::Rgba8:
+		return findRgbToYuvRow<PixelLayout::Rgba8>(dst, level);
+	case PixelLayout::Bgra8:
+		return findRgbToYuvRow<PixelLayout::Bgra8>(dst, level);
+	case PixelLayout::Rgb10a2:
+		return findRgbToYuvRow<PixelLayout::Rgb10a2>(dst, level);
+	case PixelLayout::Rgba16f:
+		return findRgbToYuvRow<PixelLayout::Rgba16f>(dst, level);
+	default:
+		return nullptr;
+	}
+}
+
+// ============================================================================
+// YuvConverter
+//
+// Converts surfaces between a YUV format and an RGB format with the matrix and
+// the range. Exactly one of the views must have a YUV format. The rows are cut
+// into slices which are converted on the given pool (or on the caller without
+// one). The slices of 4:2:0 surfaces are cut at even rows, so each of them has
+// its own chroma rows.
+//
+//   - convert		-- Convert the source view into the destination view
+//
+// Returns E_INVALIDARG if views are null, have different sizes or have an odd
+// size which the chroma sub-sampling of the YUV format does not allow.
+// Returns DXGI_ERROR_UNSUPPORTED if the formats are not a YUV and RGB pair.
+// ============================================================================
+class YuvConverter final {
+public:
+	YuvConverter(YuvMatrix matrix, YuvRange range) : mMatrix(matrix), mRange(range) {}
+
+	HRESULT convert(const SurfaceView& src, const SurfaceView& dst, ThreadPool* pool = nullptr, SimdLevel level = bestSimdLevel()) const {
+		if (src.bits == nullptr || dst.bits == nullptr || src.width != dst.width || src.height != dst.height) {
+			return E_INVALIDARG;
+		}
+		auto srcYuv = yuvLayout(src.format);
+		auto dstYuv = yuvLayout(dst.format);
+		auto layout = srcYuv != YuvLayout::Unknown ? srcYuv : dstYuv;
+		auto planar = yuvPlanar(layout);
+		if ((srcYuv == YuvLayout::Unknown) == (dstYuv == YuvLayout::Unknown)) {
+			return DXGI_ERROR_UNSUPPORTED;
+		} else if ((layout == YuvLayout::Nv12 || layout == YuvLayout::P010 || layout == YuvLayout::Yuy2) && src.width % 2 != 0) {
+			return E_INVALIDARG;
+		} else if (planar && src.height % 2 != 0) {
+			return E_INVALIDARG;
+		}
+		auto k = yuvCoefficients(mMatrix, mRange, yuvBits(layout));
+		auto alignment = planar ? 2u : 1u;
+
+		if (srcYuv != YuvLayout::Unknown) {
+			auto convertRow = findYuvToRgbRow(srcYuv, pixelLayout(dst.format), level);
+			if (convertRow == nullptr) {
+				return DXGI_ERROR_UNSUPPORTED;
+			}
+			auto chroma = src.bits + static_cast<ptrdiff_t>(src.height) * src.pitch;
+			parallelSlices(pool, src.height, alignment, [&](UINT begin, UINT end) {
+				for (auto y = begin; y < end; y++) {
+					auto luma = src.bits + static_cast<ptrdiff_t>(y) * src.pitch;
+					convertRow(luma, planar ? chroma + static_cast<ptrdiff_t>(y / 2) * src.pitch : luma,
+						dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch, src.width, k);
+				}
+			});
+		} else {
+			auto convertRow = findRgbToYuvRow(pixelLayout(src.format), dstYuv, level);
+			if (convertRow == nullptr) {
+				return DXGI_ERROR_UNSUPPORTED;
+			}
+			auto chroma = dst.bits + static_cast<ptrdiff_t>(dst.height) * dst.pitch;
+			parallelSlices(pool, src.height, alignment, [&](UINT begin, UINT end) {
+				for (auto y = begin; y < end; y += alignment) {
+					auto y1 = y + alignment - 1;
+					auto luma = dst.bits + static_cast<ptrdiff_t>(y) * dst.pitch;
+					convertRow(src.bits + static_cast<ptrdiff_t>(y) * src.pitch, src.bits + static_cast<ptrdiff_t>(y1) * src.pitch,
+						luma, dst.bits + static_cast<ptrdiff_t>(y1) * dst.pitch,
+						planar ? chroma + static_cast<ptrdiff_t>(y / 2) * dst.pitch : luma, src.width, k);
+				}
+			});
+		}
+		return S_OK;
+	}
+
+	YuvMatrix matrix() const { return mMatrix; }
+	YuvRange range() const { return mRange; }
+private:
+	YuvMatrix	mMatrix;
+	YuvRange	mRange;
+};
\ No newline at end of file
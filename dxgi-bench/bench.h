@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../dxgi-1.0/call_trace.h"
+#include "../dxgi-1.0/dxgi_shim.h"
+#include "../dxgi-1.0/simd_util.h"
+#include "../dxgi-1.0/time_source.h"
+
+// a macro to keep the compiler from inlining (and removing) the measured functions.
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+// ============================================================================
+// Benchmark Harness
+//
+// A registry of named benchmarks and a runner which measures them with the
+// same method, so results are comparable between runs, machines and driver
+// versions. Each benchmark has a setup function which creates its fixture
+// and gives back a body that the runner calls once per sample.
+//
+//		Warmup		-- The body runs until the warmup time has passed
+//		Calibrate	-- The iterations per sample are chosen to last the sample time
+//		Sample		-- The body runs the calibrated iterations for each sample
+//
+// The body runs the measured operation BenchState::iterations times and the
+// runner divides the elapsed time with the iterations. Benchmarks which
+// measure something else than their own duration (e.g. a latency observed
+// within a simulation) give the value of the sample with setValue instead,
+// in which case the body is run with a single iteration. Additional values
+// can be reported with counter, and their means over the samples are kept.
+//
+// Each benchmark is marked with the backend it ran against: "dxgi" for the
+// real DXGI (Windows), "software" for the CPU implementations which stand in
+// for it (e.g. the SoftwareSwapChain) and "cpu" for the pure CPU utilities,
+// which are the same on all platforms. The results can be printed as a table
+// and written as a JSON document (see writeBenchJson).
+// ============================================================================
+
+// the values given by a benchmark body for a single sample.
+class BenchState final {
+public:
+	explicit BenchState(uint64_t iterations) : mIterations(iterations), mValue(-1.0) {}
+
+	// the amount of the operations the body should run.
+	uint64_t iterations() const { return mIterations; }
+
+	// give the value of the sample in the unit of the benchmark instead of the elapsed time.
+	void setValue(double value) { mValue = value; }
+
+	// report an additional named value of the sample.
+	void counter(const std::string& name, double value) { mCounters[name] = value; }
+
+	double value() const { return mValue; }
+	const std::map<std::string, double>& counters() const { return mCounters; }
+private:
+	uint64_t						mIterations;
+	double							mValue;
+	std::map<std::string, double>	mCounters;
+};
+
+// a function which runs the measured operation for a sample.
+typedef std::function<HRESULT(BenchState& state)> BenchBody;
+// a function which creates the fixture of a benchmark and gives back its body.
+typedef std::function<HRESULT(BenchBody* body)> BenchSetup;
+
+// a registered benchmark.
+struct Benchmark {
+	std::string	name;		// a dot separated name, e.g. "format.rgba8-bgra8.1080p".
+	std::string	backend;	// "dxgi", "software" or "cpu".
+	std::string	unit;		// the unit of the values, "ns" for the elapsed time per operation.
+	double		bytes;		// the bytes processed by an operation for the throughput, or zero.
+	bool		custom;		// whether the body gives the values itself with setValue.
+	BenchSetup	setup;
+};
+
+// the statistics of the samples of a benchmark.
+struct BenchStats {
+	double	min;
+	double	max;
+	double	mean;
+	double	median;
+	double	p90;
+	double	stddev;
+};
+
+// a utility to compute the statistics of the sample values.
+inline BenchStats benchStats(std::vector<double> values) {
+	BenchStats stats = {};
+	if (values.empty()) {
+		return stats;
+	}
+	std::sort(values.begin(), values.end());
+	auto percentile = [&](double p) {
+		auto position = p * (values.size() - 1);
+		auto lower = static_cast<size_t>(position);
+		auto upper = std::min(lower + 1, values.size() - 1);
+		return values[lower] + (values[upper] - values[lower]) * (position - lower);
+	};
+	stats.min = values.front();
+	stats.max = values.back();
+	stats.median = percentile(0.5);
+	stats.p90 = percentile(0.9);
+	for (auto value : values) {
+		stats.mean += value / values.size();
+	}
+	for (auto value : values) {
+		stats.stddev += (value - stats.mean) * (value - stats.mean);
+	}
+	stats.stddev = values.size() > 1 ? std::sqrt(stats.stddev / (values.size() - 1)) : 0.0;
+	return stats;
+}
+
+// the outcome of a benchmark run.
+struct BenchResult {
+	const Benchmark*				benchmark;
+	HRESULT							result;		// the first failure of the setup or the body.
+	uint64_t						iterations;	// the iterations per sample.
+	std::vector<double>				samples;	// the values of the samples.
+	BenchStats						stats;
+	std::map<std::string, double>	counters;	// the means of the counters over the samples.
+};
+
+// the configuration of a benchmark run.
+struct BenchConfig {
+	std::string	filter;			// run only the benchmarks whose name contains the filter.
+	UINT		samples;		// the samples taken of each benchmark.
+	double		warmupMillis;	// the time to run each benchmark before sampling.
+	double		sampleMillis;	// the time which each sample should last at least.
+	std::string	label;			// a free text stored into the results (e.g. a commit or a driver).
+};
+
+// a utility to get the default configuration.
+inline BenchConfig defaultBenchConfig() {
+	return { "", 15, 100.0, 20.0, "" };
+}
+
+// ============================================================================
+// BenchRegistry
+//
+// Holds the benchmarks in the order of their registration and runs them. The
+// fixture of a benchmark only lives during its run, so the memory of large
+// surfaces is given back before the next benchmark is set up.
+// ============================================================================
+class BenchRegistry final {
+public:
+	// register a benchmark whose body runs the given iterations and is timed by the runner.
+	void add(const std::string& name, const std::string& backend, double bytes, BenchSetup setup) {
+		mBenchmarks.push_back({ name, backend, "ns", bytes, false, std::move(setup) });
+	}
+
+	// register a benchmark whose body gives its value in the unit with setValue.
+	void addCustom(const std::string& name, const std::string& backend, const std::string& unit, BenchSetup setup) {
+		mBenchmarks.push_back({ name, backend, unit, 0.0, true, std::move(setup) });
+	}
+
+	const std::vector<Benchmark>& benchmarks() const { return mBenchmarks; }
+
+	// run the benchmarks which match the filter and report each result once it is ready.
+	std::vector<BenchResult> run(const BenchConfig& config, const std::function<void(const BenchResult&)>& report = nullptr) const {
+		std::vector<BenchResult> results;
+		for (auto& benchmark : mBenchmarks) {
+			if (!config.filter.empty() && benchmark.name.find(config.filter) == std::string::npos) {
+				continue;
+			}
+			results.push_back(runOne(benchmark, config));
+			if (report) {
+				report(results.back());
+			}
+		}
+		return results;
+	}
+private:
+	BenchResult runOne(const Benchmark& benchmark, const BenchConfig& config) const {
+		BenchResult result = {};
+		result.benchmark = &benchmark;
+		BenchBody body;
+		result.result = benchmark.setup(&body);
+		if (FAILED(result.result) || !body) {
+			result.result = FAILED(result.result) ? result.result : E_FAIL;
+			return result;
+		}
+
+		// warm up with doubling iterations, which also calibrates the iterations per sample.
+		SteadyTimeSource time;
+		uint64_t iterations = 1;
+		double elapsed = 0.0;
+		double perIteration = 0.0;
+		do {
+			BenchState state(iterations);
+			auto start = time.now();
+			result.result = body(state);
+			auto ticks = static_cast<double>(time.now() - start);
+			if (FAILED(result.result)) {
+				return result;
+			}
+			elapsed += ticks;
+			perIteration = ticks / iterations;
+			iterations = benchmark.custom ? 1 : iterations * 2;
+		} while (elapsed < config.warmupMillis * 1e6);
+		result.iterations = benchmark.custom ? 1 : std::max<uint64_t>(1, static_cast<uint64_t>(config.sampleMillis * 1e6 / std::max(perIteration, 1.0)));
+
+		std::map<std::string, double> sums;
+		for (UINT i = 0; i < config.samples; i++) {
+			BenchState state(result.iterations);
+			auto start = time.now();
+			result.result = body(state);
+			auto ticks = static_cast<double>(time.now() - start);
+			if (FAILED(result.result)) {
+				return result;
+			}
+			result.samples.push_back(state.value() >= 0.0 ? state.value() : ticks / result.iterations);
+			for (auto& counter : state.counters()) {
+				sums[counter.first] += counter.second;
+			}
+		}
+		for (auto& sum : sums) {
+			result.counters[sum.first] = sum.second / config.samples;
+		}
+		result.stats = benchStats(result.samples);
+		return result;
+	}
+
+	std::vector<Benchmark>	mBenchmarks;
+};
+
+// a utility to get the throughput of the result in megabytes per second, or zero.
+inline double benchThroughput(const BenchResult& result) {
+	auto& benchmark = *result.benchmark;
+	return benchmark.bytes > 0.0 && benchmark.unit == "ns" && result.stats.median > 0.0
+		? benchmark.bytes / result.stats.median * 1e9 / (1024.0 * 1024.0) : 0.0;
+}
+
+// a utility to print the result as a row of a table.
+inline void printBenchResult(const BenchResult& result) {
+	auto& benchmark = *result.benchmark;
+	if (FAILED(result.result)) {
+		printf("%-44s %-8s failed (0x%08x)\n", benchmark.name.c_str(), benchmark.backend.c_str(), static_cast<uint32_t>(result.result));
+		return;
+	}
+	printf("%-44s %-8s %12.1f %12.1f %8.1f%% %-3s", benchmark.name.c_str(), benchmark.backend.c_str(), result.stats.median,
+		result.stats.min, result.stats.mean > 0.0 ? 100.0 * result.stats.stddev / result.stats.mean : 0.0, benchmark.unit.c_str());
+	auto throughput = benchThroughput(result);
+	if (throughput > 0.0) {
+		printf(" %10.1f MB/s", throughput);
+	}
+	for (auto& counter : result.counters) {
+		printf(" %s=%.3g", counter.first.c_str(), counter.second);
+	}
+	printf("\n");
+}
+
+// a description of the machine and the build which produced the results.
+struct BenchEnvironment {
+	std::string					platform;	// "windows" or "linux".
+	std::string					compiler;
+	std::string					simd;		// the best SIMD level of the processor.
+	UINT						threads;	// the hardware threads.
+	std::vector<std::string>	adapters;	// a line per adapter with its driver version.
+};
+
+// a utility to describe the environment of the process (the adapters are filled by the caller).
+inline BenchEnvironment benchEnvironment() {
+	BenchEnvironment environment = {};
+#if defined(_WIN32)
+	environment.platform = "windows";
+#elif defined(__linux__)
+	environment.platform = "linux";
+#else
+	environment.platform = "unknown";
+#endif
+#if defined(_MSC_VER)
+	environment.compiler = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+	environment.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+	environment.compiler = "gcc " __VERSION__;
+#endif
+	environment.simd = simdLevelString(bestSimdLevel());
+	environment.threads = std::thread::hardware_concurrency();
+	return environment;
+}
+
+// a utility to write a number as JSON, which has no representation for infinities or NaNs.
+inline void writeJsonNumber(FILE* file, double value) {
+	if (std::isfinite(value)) {
+		fprintf(file, "%.9g", value);
+	} else {
+		fprintf(file, "null");
+	}
+}
+
+// a utility to write the results with their environment as a JSON document.
+inline HRESULT writeBenchJson(FILE* file, const BenchEnvironment& environment, const BenchConfig& config, const std::vector<BenchResult>& results) {
+	char timestamp[32] = {};
+	auto now = std::time(nullptr);
+	std::tm utc = {};
+#if defined(_MSC_VER)
+	gmtime_s(&utc, &now);
+#else
+	gmtime_r(&now, &utc);
+#endif
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+	fprintf(file, "{\n\"schema\":1,\n\"timestamp\":\"%s\",\n\"label\":", timestamp);
+	writeJsonString(file, config.label);
+	fprintf(file, ",\n\"environment\":{\"platform\":");
+	writeJsonString(file, environment.platform);
+	fprintf(file, ",\"compiler\":");
+	writeJsonString(file, environment.compiler);
+	fprintf(file, ",\"simd\":");
+	writeJsonString(file, environment.simd);
+	fprintf(file, ",\"threads\":%u,\"adapters\":[", environment.threads);
+	for (size_t i = 0; i < environment.adapters.size(); i++) {
+		fprintf(file, "%s", i == 0 ? "" : ",");
+		writeJsonString(file, environment.adapters[i]);
+	}
+	fprintf(file, "]},\n\"config\":{\"samples\":%u,\"warmupMillis\":", config.samples);
+	writeJsonNumber(file, config.warmupMillis);
+	fprintf(file, ",\"sampleMillis\":");
+	writeJsonNumber(file, config.sampleMillis);
+	fprintf(file, ",\"filter\":");
+	writeJsonString(file, config.filter);
+	fprintf(file, "},\n\"benchmarks\":[");
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& result = results[i];
+		auto& benchmark = *result.benchmark;
+		fprintf(file, "%s\n{\"name\":", i == 0 ? "" : ",");
+		writeJsonString(file, benchmark.name);
+		fprintf(file, ",\"backend\":");
+		writeJsonString(file, benchmark.backend);
+		fprintf(file, ",\"unit\":");
+		writeJsonString(file, benchmark.unit);
+		fprintf(file, ",\"result\":\"0x%08x\",\"iterations\":%llu,\"samples\":[",
+			static_cast<uint32_t>(result.result), static_cast<unsigned long long>(result.iterations));
+		for (size_t j = 0; j < result.samples.size(); j++) {
+			fprintf(file, "%s", j == 0 ? "" : ",");
+			writeJsonNumber(file, result.samples[j]);
+		}
+		const std::pair<const char*, double> stats[] = {
+			{ "min", result.stats.min },
+			{ "max", result.stats.max },
+			{ "mean", result.stats.mean },
+			{ "median", result.stats.median },
+			{ "p90", result.stats.p90 },
+			{ "stddev", result.stats.stddev },
+			{ "bytes", benchmark.bytes },
+			{ "throughputMBs", benchThroughput(result) }
+		};
+		fprintf(file, "]");
+		for (auto& stat : stats) {
+			fprintf(file, ",\"%s\":", stat.first);
+			writeJsonNumber(file, stat.second);
+		}
+		fprintf(file, ",\"counters\":{");
+		auto first = true;
+		for (auto& counter : result.counters) {
+			fprintf(file, "%s", first ? "" : ",");
+			writeJsonString(file, counter.first);
+			fprintf(file, ":");
+			writeJsonNumber(file, counter.second);
+			first = false;
+		}
+		fprintf(file, "}}");
+	}
+	fprintf(file, "\n]\n}\n");
+	return ferror(file) ? E_FAIL : S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,2308 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "../dxgi-1.0/adapter_topology.h"
+#include "../dxgi-1.0/call_trace.h"
+#include "../dxgi-1.0/dxgi_util.h"
+#include "../dxgi-1.0/duplication_engine.h"
+#include "../dxgi-1.0/format_convert.h"
+#include "../dxgi-1.0/frame_limiter.h"
+#include "../dxgi-1.0/frame_pipeline.h"
+#include "../dxgi-1.0/frame_stats.h"
+#include "../dxgi-1.0/gamma.h"
+#include "../dxgi-1.0/hdr.h"
+#include "../dxgi-1.0/hresult.h"
+#include "../dxgi-1.0/image_encode.h"
+#include "../dxgi-1.0/mode_catalog.h"
+#include "../dxgi-1.0/private_data.h"
+#include "../dxgi-1.0/ref_ptr.h"
+#include "../dxgi-1.0/resampler.h"
+#include "../dxgi-1.0/resize_manager.h"
+#include "../dxgi-1.0/resource_trimmer.h"
+#include "../dxgi-1.0/screenshot.h"
+#include "../dxgi-1.0/shared_surface.h"
+#include "../dxgi-1.0/soft_swap_chain.h"
+#include "../dxgi-1.0/staging_pool.h"
+#include "../dxgi-1.0/thread_pool.h"
+#include "../dxgi-1.0/time_source.h"
+#include "../dxgi-1.0/vblank_clock.h"
+#include "../dxgi-1.0/yuv_convert.h"
+
+#if defined(_WIN32)
+#include "../dxgi-1.0/com_util.h"
+#include "../dxgi-1.0/window.h"
+
+#include <dxgi.h>
+#include <d3d10.h>
+
+#pragma comment(lib, "dxgi.lib")
+#pragma comment(lib, "d3d10.lib")
+
+using namespace Microsoft::WRL; // ComPtr
+#endif
+
+// ============================================================================
+// # dxgi-bench
+// A benchmark executable which measures the DXGI calls and the CPU utilities
+// of the sandbox with the same harness (see bench.h), so that the results of
+// different runs, machines and driver versions can be compared with scripts.
+//
+//		dxgi-bench [--list] [--filter <text>] [--samples <count>]
+//			[--warmup-ms <millis>] [--sample-ms <millis>] [--label <text>]
+//			[--output <results.json>]
+//
+// On Windows the DXGI benchmarks run against the first adapter and its first
+// output. Elsewhere the same operations run against the software backends,
+// e.g. the SoftwareSwapChain and the MemoryStagingBackend. The benchmarks of
+// the CPU utilities are the same on all platforms. The results are printed as
+// a table and written as JSON into dxgi-bench.json unless otherwise given.
+//
+// There is no build file for platforms other than Windows. On Linux the tool
+// can be built with e.g. the following command.
+//
+//		g++ -std=c++17 -O2 -pthread dxgi-bench/main.cpp -o dxgi-bench/dxgi-bench
+// ============================================================================
+
+constexpr UINT WINDOW_WIDTH = 800;
+constexpr UINT WINDOW_HEIGHT = 600;
+
+// a utility to get the thread pool shared by the benchmarks of the threaded utilities.
+inline ThreadPool& benchPool() {
+	static ThreadPool pool;
+	return pool;
+}
+
+// a utility to get the SIMD levels to benchmark, i.e. the best one and the scalar baseline.
+inline std::vector<SimdLevel> benchSimdLevels() {
+	std::vector<SimdLevel> levels = { bestSimdLevel() };
+	if (bestSimdLevel() != SimdLevel::Scalar) {
+		levels.push_back(SimdLevel::Scalar);
+	}
+	return levels;
+}
+
+// an image in CPU memory with a smooth deterministic content.
+struct BenchImage {
+	std::vector<BYTE>	data;
+	SurfaceView			view;
+};
+
+// a utility to get the size of a tightly packed image of any RGB or YUV format.
+inline size_t benchImageSize(UINT width, UINT height, DXGI_FORMAT format) {
+	if (yuvLayout(format) != YuvLayout::Unknown) {
+		return yuvSurfaceSize(format, yuvRowSize(format, width), height);
+	}
+	return static_cast<size_t>(width) * formatBytesPerPixel(format) * height;
+}
+
+// a utility to create a tightly packed image of any RGB or YUV format.
+inline std::shared_ptr<BenchImage> makeBenchImage(UINT width, UINT height, DXGI_FORMAT format) {
+	auto image = std::make_shared<BenchImage>();
+	auto yuv = yuvLayout(format) != YuvLayout::Unknown;
+	auto pitch = yuv ? yuvRowSize(format, width) : width * formatBytesPerPixel(format);
+	image->data.resize(benchImageSize(width, height, format));
+	auto size = image->data.size();
+	for (size_t y = 0; y < size / pitch; y++) {
+		auto row = image->data.data() + y * pitch;
+		if (format == DXGI_FORMAT_R16G16B16A16_FLOAT) {
+			// scRGB values up to 160 nits, so the HDR benchmarks go through the tone mapping.
+			auto values = reinterpret_cast<uint16_t*>(row);
+			for (UINT i = 0; i < width * 4; i++) {
+				values[i] = floatToHalf(i % 4 == 3 ? 1.0f : ((i / 4 + y) % 256) / 255.0f * 2.0f);
+			}
+		} else {
+			// the 8-bit formats are opaque like the back buffers usually are.
+			auto opaque = format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM;
+			for (UINT i = 0; i < pitch; i++) {
+				row[i] = opaque && i % 4 == 3 ? 0xff : static_cast<BYTE>(i / 4 + y * 3 + (i % 4) * 64);
+			}
+		}
+	}
+	image->view = { image->data.data(), static_cast<INT>(pitch), width, height, format };
+	return image;
+}
+
+// a utility to build a mode list of a monitor with all the formats, scalings and scanline orders (11k+ modes).
+inline std::vector<DXGI_MODE_DESC> syntheticModes() {
+	const DXGI_FORMAT formats[] = {
+		DXGI_FORMAT_R16G16B16A16_FLOAT,
+		DXGI_FORMAT_R10G10B10A2_UNORM,
+		DXGI_FORMAT_R8G8B8A8_UNORM,
+		DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+		DXGI_FORMAT_B8G8R8A8_UNORM,
+		DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+	};
+	const UINT sizes[][2] = {
+		{ 640, 480 }, { 720, 480 }, { 720, 576 }, { 800, 600 }, { 1024, 768 }, { 1152, 864 }, { 1176, 664 },
+		{ 1280, 720 }, { 1280, 768 }, { 1280, 800 }, { 1280, 960 }, { 1280, 1024 }, { 1360, 768 }, { 1366, 768 },
+		{ 1440, 900 }, { 1600, 900 }, { 1600, 1024 }, { 1680, 1050 }, { 1920, 1080 }, { 1920, 1200 },
+		{ 2560, 1080 }, { 2560, 1440 }, { 3440, 1440 }, { 3840, 2160 }
+	};
+	const DXGI_RATIONAL rates[] = {
+		{ 24000, 1001 }, { 24, 1 }, { 25, 1 }, { 30, 1 }, { 50, 1 }, { 60000, 1001 }, { 60, 1 },
+		{ 75, 1 }, { 100, 1 }, { 120, 1 }, { 144, 1 }, { 165, 1 }, { 240, 1 }
+	};
+	const DXGI_MODE_SCALING scalings[] = { DXGI_MODE_SCALING_UNSPECIFIED, DXGI_MODE_SCALING_CENTERED, DXGI_MODE_SCALING_STRETCHED };
+	const DXGI_MODE_SCANLINE_ORDER scanlines[] = { DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE, DXGI_MODE_SCANLINE_ORDER_UPPER_FIELD_FIRST };
+	std::vector<DXGI_MODE_DESC> modes;
+	for (auto format : formats) {
+		for (auto& size : sizes) {
+			for (auto& rate : rates) {
+				for (auto scaling : scalings) {
+					for (auto scanline : scanlines) {
+						DXGI_MODE_DESC mode = {};
+						mode.Width = size[0];
+						mode.Height = size[1];
+						mode.RefreshRate = rate;
+						mode.Format = format;
+						mode.ScanlineOrdering = scanline;
+						mode.Scaling = scaling;
+						modes.push_back(mode);
+					}
+				}
+			}
+		}
+	}
+	return modes;
+}
+
+// a utility to find the closest mode with a linear scan over all the modes (the baseline of the catalog).
+inline HRESULT findClosestLinear(const std::vector<DXGI_MODE_DESC>& modes, const DXGI_MODE_DESC& desired, DXGI_MODE_DESC* closest) {
+	if (modes.empty()) {
+		return DXGI_ERROR_NOT_FOUND;
+	}
+	auto refreshRate = [](const DXGI_RATIONAL& rate) {
+		return rate.Denominator == 0 ? 0.0 : static_cast<double>(rate.Numerator) / rate.Denominator;
+	};
+	auto desiredPixels = uint64_t(desired.Width) * desired.Height;
+	auto desiredRate = refreshRate(desired.RefreshRate);
+
+	// rank the specified fields first in the DXGI order and then the preferences for the unspecified ones.
+	auto rank = [&](const DXGI_MODE_DESC& mode) {
+		auto pixels = uint64_t(mode.Width) * mode.Height;
+		auto rate = refreshRate(mode.RefreshRate);
+		auto sized = desired.Width != 0;
+		return std::make_tuple(
+			desired.ScanlineOrdering != DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED && mode.ScanlineOrdering != desired.ScanlineOrdering,
+			desired.Scaling != DXGI_MODE_SCALING_UNSPECIFIED && mode.Scaling != desired.Scaling,
+			desired.Format != DXGI_FORMAT_UNKNOWN && mode.Format != desired.Format,
+			sized ? (pixels > desiredPixels ? pixels - desiredPixels : desiredPixels - pixels) : 0,
+			sized ? ~pixels : 0,
+			sized && (mode.Width != desired.Width || mode.Height != desired.Height),
+			desired.RefreshRate.Numerator != 0 ? std::abs(rate - desiredRate) : 0.0,
+			mode.ScanlineOrdering == DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE ? 0u : mode.ScanlineOrdering + 1u,
+			mode.Scaling,
+			mode.Format,
+			~pixels,
+			~mode.Width,
+			-rate);
+	};
+	auto best = &modes[0];
+	auto bestRank = rank(*best);
+	for (auto& mode : modes) {
+		auto modeRank = rank(mode);
+		if (modeRank < bestRank) {
+			best = &mode;
+			bestRank = modeRank;
+		}
+	}
+	*closest = *best;
+	return S_OK;
+}
+
+// a utility to get the mode which the mode queries look for.
+// a utility to check that the catalog finds the same modes as the linear scan for random queries over the modes and
+// their portrait variants (which have the same pixels with another width, so they exercise the tie-breaks).
+inline HRESULT checkClosestEquivalence(const std::vector<DXGI_MODE_DESC>& landscape, UINT queries) {
+	auto modes = landscape;
+	for (auto& mode : landscape) {
+		if (mode.Width != mode.Height) {
+			modes.push_back(mode);
+			std::swap(modes.back().Width, modes.back().Height);
+		}
+	}
+	DisplayModeCatalog catalog(modes);
+	uint32_t random = 0x9e3779b9u;
+	auto next = [&random](uint32_t range) {
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		return random % range;
+	};
+	for (UINT i = 0; i < queries; i++) {
+		DXGI_MODE_DESC desired = {};
+		if (next(4) != 0) {
+			auto& mode = modes[next(static_cast<uint32_t>(modes.size()))];
+			desired.Width = next(2) != 0 ? mode.Width : 320 + next(3840);
+			desired.Height = next(2) != 0 ? mode.Height : 240 + next(2160);
+		}
+		if (next(2) != 0) {
+			desired.RefreshRate = { 20 + next(240), 1 };
+		}
+		desired.Format = next(2) != 0 ? modes[next(static_cast<uint32_t>(modes.size()))].Format : DXGI_FORMAT_UNKNOWN;
+		desired.ScanlineOrdering = static_cast<DXGI_MODE_SCANLINE_ORDER>(next(3));
+		desired.Scaling = static_cast<DXGI_MODE_SCALING>(next(3));
+		DXGI_MODE_DESC expected;
+		DXGI_MODE_DESC found;
+		auto result = catalog.findClosest(desired, &expected);
+		if (SUCCEEDED(result)) {
+			result = findClosestLinear(modes, desired, &found);
+		}
+		if (FAILED(result)) {
+			return result;
+		} else if (memcmp(&expected, &found, sizeof(found)) != 0) {
+			return E_FAIL;
+		}
+	}
+	return S_OK;
+}
+
+inline DXGI_MODE_DESC desiredBenchMode() {
+	DXGI_MODE_DESC mode = {};
+	mode.Width = 1700;
+	mode.Height = 1000;
+	mode.RefreshRate = { 100, 1 };
+	mode.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	mode.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_PROGRESSIVE;
+	mode.Scaling = DXGI_MODE_SCALING_CENTERED;
+	return mode;
+}
+
+// a utility to build the adapters of a machine with an integrated and a discrete GPU.
+inline std::vector<AdapterInfo> syntheticAdapters() {
+	std::vector<AdapterInfo> adapters(3);
+	for (size_t i = 0; i < adapters.size(); i++) {
+		auto& desc = adapters[i].desc;
+		desc.VendorId = i == 0 ? 0x8086 : (i == 1 ? 0x10de : 0x1414);
+		desc.DeviceId = 0x1000 + static_cast<UINT>(i);
+		desc.DedicatedVideoMemory = i == 1 ? 8ull << 30 : 0;
+		desc.SharedSystemMemory = 16ull << 30;
+		desc.AdapterLuid.LowPart = 0x1000 + static_cast<DWORD>(i);
+		for (UINT j = 0; j < (i == 2 ? 0u : 2u); j++) {
+			DXGI_OUTPUT_DESC output = {};
+			output.DesktopCoordinates = { static_cast<LONG>(j * 1920), 0, static_cast<LONG>((j + 1) * 1920), 1080 };
+			output.AttachedToDesktop = true;
+			output.Rotation = DXGI_MODE_ROTATION_IDENTITY;
+			adapters[i].outputs.push_back(output);
+		}
+	}
+	return adapters;
+}
+
+// a utility to wait until the present with the count has been shown (or a second has passed).
+template <typename GetStatistics, typename Idle>
+inline HRESULT waitPresented(UINT presentCount, TimeSource& time, GetStatistics getStatistics, Idle idle) {
+	auto deadline = time.now() + time.frequency();
+	for (;;) {
+		DXGI_FRAME_STATISTICS stats = {};
+		auto result = getStatistics(&stats);
+		if (FAILED(result) && result != DXGI_ERROR_FRAME_STATISTICS_DISJOINT) {
+			return result;
+		} else if (SUCCEEDED(result) && stats.PresentCount >= presentCount) {
+			return S_OK;
+		} else if (time.now() > deadline) {
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+		idle();
+	}
+}
+
+#if defined(_WIN32)
+// ============================================================================
+// DXGI Context
+//
+// The DXGI objects shared by the benchmarks which run against the real DXGI.
+// These are created on the first use. If something is not available (e.g.
+// no output is attached to the adapter) the benchmarks which need it fail
+// with the stored result instead of the whole run.
+// ============================================================================
+struct DxgiContext {
+	ComPtr<IDXGIFactory1>	factory;
+	ComPtr<IDXGIAdapter1>	adapter;
+	ComPtr<IDXGIOutput>		output;
+	ComPtr<ID3D10Device>	device;
+	HRESULT					result;
+	HRESULT					outputResult;
+};
+
+inline DxgiContext& dxgiContext() {
+	static DxgiContext context = []() {
+		DxgiContext context = {};
+		context.result = CreateDXGIFactory1(IID_PPV_ARGS(&context.factory));
+		if (SUCCEEDED(context.result)) {
+			context.result = context.factory->EnumAdapters1(0, &context.adapter);
+		}
+		if (SUCCEEDED(context.result)) {
+			context.result = D3D10CreateDevice(context.adapter.Get(), D3D10_DRIVER_TYPE_HARDWARE, nullptr, 0, D3D10_SDK_VERSION, &context.device);
+		}
+		context.outputResult = SUCCEEDED(context.result) ? context.adapter->EnumOutputs(0, &context.output) : context.result;
+		return context;
+	}();
+	return context;
+}
+
+// a utility to convert a wide string of DXGI into UTF-8.
+inline std::string utf8String(const WCHAR* text) {
+	auto size = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+	if (size <= 1) {
+		return std::string();
+	}
+	std::string result(static_cast<size_t>(size), '\0');
+	WideCharToMultiByte(CP_UTF8, 0, text, -1, &result[0], size, nullptr, nullptr);
+	result.resize(static_cast<size_t>(size) - 1);
+	return result;
+}
+
+// a utility to describe the adapters with their driver versions for the results.
+inline std::vector<std::string> describeAdapters() {
+	std::vector<std::string> adapters;
+	ComPtr<IDXGIFactory1> factory;
+	if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory)))) {
+		return adapters;
+	}
+	ComPtr<IDXGIAdapter1> adapter;
+	for (auto i = 0u; factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; i++) {
+		DXGI_ADAPTER_DESC1 desc;
+		LARGE_INTEGER version = {};
+		char text[160];
+		adapter->GetDesc1(&desc);
+		adapter->CheckInterfaceSupport(__uuidof(ID3D10Device), &version);
+		snprintf(text, sizeof(text), " (vendor 0x%04x, device 0x%04x, driver %u.%u.%u.%u)", desc.VendorId, desc.DeviceId,
+			HIWORD(version.HighPart), LOWORD(version.HighPart), HIWORD(version.LowPart), LOWORD(version.LowPart));
+		adapters.push_back(utf8String(desc.Description) + text);
+	}
+	return adapters;
+}
+
+// a utility to dispatch the messages of the windows of this thread.
+inline void pumpMessages() {
+	MSG msg;
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+// a utility to create a CPU accessible 1080p staging texture and get its surface.
+inline HRESULT createStagingSurface(ComPtr<IDXGISurface>* surface) {
+	auto& context = dxgiContext();
+	if (FAILED(context.result)) {
+		return context.result;
+	}
+	D3D10_TEXTURE2D_DESC desc = {};
+	desc.Width = 1920;
+	desc.Height = 1080;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D10_USAGE_STAGING;
+	desc.CPUAccessFlags = D3D10_CPU_ACCESS_READ | D3D10_CPU_ACCESS_WRITE;
+	ComPtr<ID3D10Texture2D> texture;
+	auto result = context.device->CreateTexture2D(&desc, nullptr, &texture);
+	return SUCCEEDED(result) ? texture.As(surface) : result;
+}
+
+// a window with a swap chain of the shared device.
+struct DxgiPresentFixture {
+	std::unique_ptr<Window>	window;
+	ComPtr<IDXGISwapChain>	swapChain;
+	QpcTimeSource			time;
+};
+
+inline HRESULT createPresentFixture(std::shared_ptr<DxgiPresentFixture>* fixture) {
+	auto& context = dxgiContext();
+	if (FAILED(context.result)) {
+		return context.result;
+	}
+	auto created = std::make_shared<DxgiPresentFixture>();
+	created->window = std::make_unique<Window>(WINDOW_WIDTH, WINDOW_HEIGHT);
+	DXGI_SWAP_CHAIN_DESC desc = {};
+	desc.BufferCount = 2;
+	desc.BufferDesc.Width = WINDOW_WIDTH;
+	desc.BufferDesc.Height = WINDOW_HEIGHT;
+	desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	desc.OutputWindow = created->window->hwnd();
+	desc.SampleDesc.Count = 1;
+	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	desc.Windowed = true;
+	auto result = context.factory->CreateSwapChain(context.device.Get(), &desc, &created->swapChain);
+	if (FAILED(result)) {
+		return result;
+	}
+	pumpMessages();
+	*fixture = created;
+	return S_OK;
+}
+#endif
+
+// a utility to create a software swap chain of the window size (three buffers, so that the presents without vsync never block).
+inline HRESULT createBenchSwapChain(TimeSource& time, UINT refreshRate, std::shared_ptr<SoftwareSwapChain>* swapChain) {
+	DXGI_SWAP_CHAIN_DESC desc = {};
+	desc.BufferCount = 3;
+	desc.BufferDesc.Width = WINDOW_WIDTH;
+	desc.BufferDesc.Height = WINDOW_HEIGHT;
+	desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.BufferDesc.RefreshRate = { refreshRate, 1 };
+	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	desc.SampleDesc.Count = 1;
+	desc.Windowed = true;
+	return SoftwareSwapChain::create(desc, time, swapChain);
+}
+
+// ============================================================================
+// Enumeration
+//
+// The cost of finding the adapters, outputs and display modes. The DXGI calls
+// go to the kernel and the driver, which is why the AdapterTopologyService and
+// the DisplayModeCatalog cache their results. The software variants measure
+// the same work on synthetic adapters and modes.
+// ============================================================================
+inline void registerEnumerationBenchmarks(BenchRegistry& registry) {
+#if defined(_WIN32)
+	registry.add("enumeration.adapters", "dxgi", 0.0, [](BenchBody* body) {
+		*body = [](BenchState& state) {
+			size_t outputs = 0;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				for (auto& adapter : enumerateAdapters()) {
+					outputs += adapter.outputs.size();
+				}
+			}
+			state.counter("outputs", static_cast<double>(outputs) / state.iterations());
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.modes", "dxgi", 0.0, [](BenchBody* body) {
+		auto& context = dxgiContext();
+		if (FAILED(context.outputResult)) {
+			return context.outputResult;
+		}
+		auto modes = std::make_shared<std::vector<DXGI_MODE_DESC>>();
+		*body = [modes](BenchState& state) {
+			auto output = dxgiContext().output.Get();
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				UINT count = 0;
+				auto result = output->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, 0, &count, nullptr);
+				if (SUCCEEDED(result)) {
+					modes->resize(count);
+					result = output->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, 0, &count, modes->data());
+				}
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			state.counter("modes", static_cast<double>(modes->size()));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.catalogBuild", "dxgi", 0.0, [](BenchBody* body) {
+		auto& context = dxgiContext();
+		if (FAILED(context.outputResult)) {
+			return context.outputResult;
+		}
+		*body = [](BenchState& state) {
+			size_t modes = 0;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				DisplayModeCatalog catalog(dxgiContext().output.Get());
+				modes = catalog.size();
+			}
+			state.counter("modes", static_cast<double>(modes));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.findClosest", "dxgi", 0.0, [](BenchBody* body) {
+		auto& context = dxgiContext();
+		if (FAILED(context.outputResult)) {
+			return context.outputResult;
+		}
+		*body = [](BenchState& state) {
+			auto desired = desiredBenchMode();
+			DXGI_MODE_DESC closest;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = dxgiContext().output->FindClosestMatchingMode(&desired, &closest, nullptr);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+#endif
+
+	// the service wakes up its thread, enumerates, sorts and diffs on each refresh.
+#if defined(_WIN32)
+	const auto topologyBackend = "dxgi";
+#else
+	const auto topologyBackend = "software";
+#endif
+	registry.add("enumeration.topologyRefresh", topologyBackend, 0.0, [](BenchBody* body) {
+		struct Fixture {
+			ManualAdapterChangeSource				source;
+			std::unique_ptr<AdapterTopologyService>	service;
+		};
+		auto fixture = std::make_shared<Fixture>();
+#if defined(_WIN32)
+		AdapterTopologyService::Enumerator enumerator = enumerateAdapters;
+#else
+		auto adapters = syntheticAdapters();
+		AdapterTopologyService::Enumerator enumerator = [adapters]() { return adapters; };
+#endif
+		fixture->service = std::make_unique<AdapterTopologyService>(enumerator, fixture->source);
+		*body = [fixture](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				fixture->source.notify();
+				if (!fixture->service->waitIdle(std::chrono::seconds(1))) {
+					return DXGI_ERROR_WAIT_TIMEOUT;
+				}
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.topologyDiff", "cpu", 0.0, [](BenchBody* body) {
+		auto from = std::make_shared<AdapterTopology>();
+		auto to = std::make_shared<AdapterTopology>();
+		from->version = 1;
+		from->adapters = syntheticAdapters();
+		to->version = 2;
+		to->adapters = from->adapters;
+		to->adapters[1].outputs.pop_back();
+		*body = [from, to](BenchState& state) {
+			size_t changes = 0;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				changes += diffTopology(*from, *to).changed.size();
+			}
+			return changes == state.iterations() ? S_OK : E_FAIL;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.modes", "software", 0.0, [](BenchBody* body) {
+		auto catalog = std::make_shared<DisplayModeCatalog>(syntheticModes());
+		auto modes = std::make_shared<std::vector<DXGI_MODE_DESC>>();
+		*body = [catalog, modes](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto range = catalog->findRange(DXGI_FORMAT_R8G8B8A8_UNORM);
+				modes->clear();
+				for (auto j = range.first; j < range.second; j++) {
+					modes->push_back(catalog->mode(j));
+				}
+			}
+			state.counter("modes", static_cast<double>(modes->size()));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.catalogBuild", "software", 0.0, [](BenchBody* body) {
+		auto modes = std::make_shared<std::vector<DXGI_MODE_DESC>>(syntheticModes());
+		*body = [modes](BenchState& state) {
+			size_t size = 0;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				DisplayModeCatalog catalog(*modes);
+				size = catalog.size();
+			}
+			state.counter("modes", static_cast<double>(size));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("enumeration.findClosest", "software", 0.0, [](BenchBody* body) {
+#if defined(_WIN32)
+		// compare the catalog with the real DXGI using the same modes.
+		auto& context = dxgiContext();
+		auto catalog = SUCCEEDED(context.outputResult)
+			? std::make_shared<DisplayModeCatalog>(context.output.Get())
+			: std::make_shared<DisplayModeCatalog>(syntheticModes());
+#else
+		auto catalog = std::make_shared<DisplayModeCatalog>(syntheticModes());
+#endif
+		*body = [catalog](BenchState& state) {
+			auto desired = desiredBenchMode();
+			DXGI_MODE_DESC closest;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = catalog->findClosest(desired, &closest);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			state.counter("modes", static_cast<double>(catalog->size()));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	// the same query with a linear scan over the same modes, which must find the same mode.
+	registry.add("enumeration.findClosestLinear", "software", 0.0, [](BenchBody* body) {
+#if defined(_WIN32)
+		auto& context = dxgiContext();
+		auto catalog = SUCCEEDED(context.outputResult)
+			? DisplayModeCatalog(context.output.Get())
+			: DisplayModeCatalog(syntheticModes());
+#else
+		DisplayModeCatalog catalog(syntheticModes());
+#endif
+		auto modes = std::make_shared<std::vector<DXGI_MODE_DESC>>();
+		for (size_t i = 0; i < catalog.size(); i++) {
+			modes->push_back(catalog.mode(i));
+		}
+		auto desired = desiredBenchMode();
+		DXGI_MODE_DESC expected;
+		DXGI_MODE_DESC found;
+		auto result = catalog.findClosest(desired, &expected);
+		if (SUCCEEDED(result)) {
+			result = findClosestLinear(*modes, desired, &found);
+		}
+		if (SUCCEEDED(result)) {
+			result = checkClosestEquivalence(syntheticModes(), 20000);
+		}
+		if (FAILED(result)) {
+			return result;
+		} else if (memcmp(&expected, &found, sizeof(found)) != 0) {
+			return E_FAIL;
+		}
+		*body = [modes](BenchState& state) {
+			auto desired = desiredBenchMode();
+			DXGI_MODE_DESC closest;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = findClosestLinear(*modes, desired, &closest);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			state.counter("modes", static_cast<double>(modes->size()));
+			return S_OK;
+		};
+		return S_OK;
+	});
+}
+
+// ============================================================================
+// Map
+//
+// The cost of mapping surfaces into the CPU and the throughput of moving a
+// 1080p frame through a mapped surface. The software surfaces are plain CPU
+// memory, so they show the lower bound which the driver can be compared to.
+// ============================================================================
+inline void registerMapBenchmarks(BenchRegistry& registry) {
+	const auto frameBytes = 1920.0 * 1080.0 * 4.0;
+
+	// copy the frame into the mapped surface or out of it with the pitches of both.
+	auto copyRows = [](const DXGI_MAPPED_RECT& rect, BenchImage& image, bool write) {
+		auto rowSize = static_cast<size_t>(image.view.width) * 4;
+		for (UINT y = 0; y < image.view.height; y++) {
+			auto mapped = rect.pBits + static_cast<size_t>(y) * rect.Pitch;
+			auto local = image.data.data() + static_cast<size_t>(y) * image.view.pitch;
+			memcpy(write ? mapped : local, write ? local : mapped, rowSize);
+		}
+	};
+
+	for (auto mode : { 0, 1, 2 }) {
+		auto name = mode == 0 ? "map.mapUnmap" : (mode == 1 ? "map.write.1080p" : "map.read.1080p");
+		auto flags = static_cast<UINT>(mode == 1 ? DXGI_MAP_WRITE : DXGI_MAP_READ);
+		auto bytes = mode == 0 ? 0.0 : frameBytes;
+		registry.add(name, "software", bytes, [=](BenchBody* body) {
+			auto surface = std::make_shared<RefPtr<SoftwareSurface>>(makeRef<SoftwareSurface>(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM));
+			auto image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+			*body = [=](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					DXGI_MAPPED_RECT rect;
+					auto result = (*surface)->Map(&rect, flags);
+					if (FAILED(result)) {
+						return result;
+					}
+					if (mode != 0) {
+						copyRows(rect, *image, mode == 1);
+					}
+					(*surface)->Unmap();
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+#if defined(_WIN32)
+		registry.add(name, "dxgi", bytes, [=](BenchBody* body) {
+			auto surface = std::make_shared<ComPtr<IDXGISurface>>();
+			auto result = createStagingSurface(surface.get());
+			if (FAILED(result)) {
+				return result;
+			}
+			auto image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+			*body = [=](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					DXGI_MAPPED_RECT rect;
+					auto result = (*surface)->Map(&rect, flags);
+					if (FAILED(result)) {
+						return result;
+					}
+					if (mode != 0) {
+						copyRows(rect, *image, mode == 1);
+					}
+					(*surface)->Unmap();
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+#endif
+	}
+
+	// the StagingPool uploads with the backend fences, so the GPU copy overlaps the next upload.
+	registry.add("map.stagingUpload.1080p", "software", frameBytes, [](BenchBody* body) {
+		struct Fixture {
+			SteadyTimeSource					time;
+			MemoryStagingBackend				backend{ time, 0 };
+			StagingPool							pool{ backend, time };
+			RefPtr<SoftwareSurface>				target = makeRef<SoftwareSurface>(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+			std::shared_ptr<BenchImage>			image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+		};
+		auto fixture = std::make_shared<Fixture>();
+		*body = [fixture](BenchState& state) {
+			auto copy = [&](const StagingLease& lease) {
+				auto& source = fixture->backend.surface(lease.surface);
+				for (UINT y = 0; y < lease.height; y++) {
+					memcpy(fixture->target->data() + static_cast<size_t>(y) * fixture->target->pitch(),
+						source.data() + static_cast<size_t>(y) * source.pitch(), static_cast<size_t>(lease.width) * 4);
+				}
+			};
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = fixture->pool.upload(fixture->image->view, DXGI_FORMAT_R8G8B8A8_UNORM, copy);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			state.counter("surfaces", static_cast<double>(fixture->pool.stats().surfaces));
+			return S_OK;
+		};
+		return S_OK;
+	});
+#if defined(_WIN32)
+	registry.add("map.stagingUpload.1080p", "dxgi", frameBytes, [](BenchBody* body) {
+		auto& context = dxgiContext();
+		if (FAILED(context.result)) {
+			return context.result;
+		}
+		struct Fixture {
+			QpcTimeSource						time;
+			D3D10StagingBackend					backend{ dxgiContext().device.Get() };
+			StagingPool							pool{ backend, time };
+			ComPtr<ID3D10Texture2D>				target;
+			std::shared_ptr<BenchImage>			image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+		};
+		auto fixture = std::make_shared<Fixture>();
+		D3D10_TEXTURE2D_DESC desc = {};
+		desc.Width = 1920;
+		desc.Height = 1080;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D10_USAGE_DEFAULT;
+		desc.BindFlags = D3D10_BIND_SHADER_RESOURCE;
+		auto result = context.device->CreateTexture2D(&desc, nullptr, &fixture->target);
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [fixture](BenchState& state) {
+			auto copy = [&](const StagingLease& lease) {
+				D3D10_BOX box = { 0, 0, 0, lease.width, lease.height, 1 };
+				dxgiContext().device->CopySubresourceRegion(fixture->target.Get(), 0, 0, 0, 0, fixture->backend.texture(lease.surface), 0, &box);
+			};
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = fixture->pool.upload(fixture->image->view, DXGI_FORMAT_R8G8B8A8_UNORM, copy);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			// include the completion of the copies into the sample.
+			auto result = fixture->backend.waitFor(fixture->backend.signal());
+			state.counter("surfaces", static_cast<double>(fixture->pool.stats().surfaces));
+			state.counter("waits", static_cast<double>(fixture->pool.stats().waits));
+			return result;
+		};
+		return S_OK;
+	});
+#endif
+}
+
+// ============================================================================
+// Present
+//
+// The cost of the Present call itself and the round-trip from the Present
+// until the frame statistics report the frame as shown. The software swap
+// chain simulates a 240 Hz display, while the DXGI uses the real display of
+// the window, so the round-trips depend on its refresh rate.
+// ============================================================================
+inline void registerPresentBenchmarks(BenchRegistry& registry) {
+	registry.add("present.call", "software", 0.0, [](BenchBody* body) {
+		auto time = std::make_shared<SteadyTimeSource>();
+		std::shared_ptr<SoftwareSwapChain> swapChain;
+		auto result = createBenchSwapChain(*time, 240, &swapChain);
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [time, swapChain](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = swapChain->Present(0, 0);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("present.roundTrip", "software", 0.0, [](BenchBody* body) {
+		auto time = std::make_shared<SteadyTimeSource>();
+		std::shared_ptr<SoftwareSwapChain> swapChain;
+		auto result = createBenchSwapChain(*time, 240, &swapChain);
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [time, swapChain](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				UINT presentCount = 0;
+				auto result = swapChain->Present(1, 0);
+				if (SUCCEEDED(result)) {
+					swapChain->GetLastPresentCount(&presentCount);
+					result = waitPresented(presentCount, *time, [&](DXGI_FRAME_STATISTICS* stats) {
+						return swapChain->GetFrameStatistics(stats);
+					}, []() { std::this_thread::yield(); });
+				}
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+#if defined(_WIN32)
+	registry.add("present.call", "dxgi", 0.0, [](BenchBody* body) {
+		std::shared_ptr<DxgiPresentFixture> fixture;
+		auto result = createPresentFixture(&fixture);
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [fixture](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = fixture->swapChain->Present(0, 0);
+				if (FAILED(result)) {
+					return result;
+				}
+				pumpMessages();
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("present.roundTrip", "dxgi", 0.0, [](BenchBody* body) {
+		std::shared_ptr<DxgiPresentFixture> fixture;
+		auto result = createPresentFixture(&fixture);
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [fixture](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				UINT presentCount = 0;
+				auto result = fixture->swapChain->Present(1, 0);
+				if (SUCCEEDED(result)) {
+					fixture->swapChain->GetLastPresentCount(&presentCount);
+					result = waitPresented(presentCount, fixture->time, [&](DXGI_FRAME_STATISTICS* stats) {
+						return fixture->swapChain->GetFrameStatistics(stats);
+					}, []() { pumpMessages(); std::this_thread::yield(); });
+				}
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+#endif
+
+	// each sample runs the pipeline for a while and reports the median frame latency.
+	registry.addCustom("present.pipeline.latency", "software", "ns", [](BenchBody* body) {
+		auto time = std::make_shared<SteadyTimeSource>();
+		*body = [time](BenchState& state) {
+			std::shared_ptr<SoftwareSwapChain> swapChain;
+			auto result = createBenchSwapChain(*time, 240, &swapChain);
+			if (FAILED(result)) {
+				return result;
+			}
+			SoftwarePresentSink sink(*swapChain);
+			FramePipelineDesc desc = { WINDOW_WIDTH, WINDOW_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, 2, FramePipeline::DEFAULT_FRAME_LATENCY };
+			FramePipeline pipeline(desc, *time, [](const PipelineFrame& frame) {
+				memset(frame.surface->data(), static_cast<int>(frame.index & 0xff), frame.surface->size());
+				return S_OK;
+			}, sink);
+			auto start = time->now();
+			result = pipeline.start();
+			if (FAILED(result)) {
+				return result;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			pipeline.stop();
+			auto seconds = static_cast<double>(time->now() - start) / time->frequency();
+			auto report = pipeline.report();
+			state.setValue(static_cast<double>(report.latency.p50));
+			state.counter("presentsPerSecond", report.presented / seconds);
+			state.counter("latencyP99", static_cast<double>(report.latency.p99));
+			state.counter("dropped", static_cast<double>(report.dropped));
+			return pipeline.result();
+		};
+		return S_OK;
+	});
+}
+
+// ============================================================================
+// Format Conversion
+//
+// The conversions between the common back buffer formats for a 1080p frame
+// with the best SIMD level of the processor and with the scalar kernels. The
+// throughput is computed from the bytes of the source frame.
+// ============================================================================
+inline void registerFormatBenchmarks(BenchRegistry& registry) {
+	struct ConvertCase {
+		const char*	name;
+		DXGI_FORMAT	src;
+		DXGI_FORMAT	dst;
+	};
+	const ConvertCase cases[] = {
+		{ "rgba8-bgra8", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM },
+		{ "rgba8-rgb10a2", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R10G10B10A2_UNORM },
+		{ "rgb10a2-rgba8", DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM },
+		{ "rgba8-rgba16f", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT },
+		{ "rgba16f-rgba8", DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R8G8B8A8_UNORM }
+	};
+	for (auto& convert : cases) {
+		for (auto level : benchSimdLevels()) {
+			auto name = std::string("format.") + convert.name + ".1080p." + simdLevelString(level);
+			auto bytes = 1920.0 * 1080.0 * formatBytesPerPixel(convert.src);
+			registry.add(name, "cpu", bytes, [convert, level](BenchBody* body) {
+				auto src = makeBenchImage(1920, 1080, convert.src);
+				auto dst = makeBenchImage(1920, 1080, convert.dst);
+				*body = [src, dst, level](BenchState& state) {
+					for (uint64_t i = 0; i < state.iterations(); i++) {
+						auto result = convertSurface(src->view, dst->view, level);
+						if (FAILED(result)) {
+							return result;
+						}
+					}
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+}
+
+// ============================================================================
+// Image Processing
+//
+// The CPU utilities which process whole frames: the YUV, HDR and gamma
+// conversions, the resampling of the scaling modes, the image encoders of
+// the screenshots and the dirty region detection of the duplication. The
+// utilities which slice the work run on the shared thread pool. The gamma
+// ramps are measured as well, from the curve into the lookup tables.
+// ============================================================================
+inline void registerImageBenchmarks(BenchRegistry& registry) {
+	struct YuvCase {
+		const char*	name;
+		DXGI_FORMAT	src;
+		DXGI_FORMAT	dst;
+	};
+	const YuvCase yuvCases[] = {
+		{ "nv12-bgra8", DXGI_FORMAT_NV12, DXGI_FORMAT_B8G8R8A8_UNORM },
+		{ "bgra8-nv12", DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_NV12 },
+		{ "p010-rgb10a2", DXGI_FORMAT_P010, DXGI_FORMAT_R10G10B10A2_UNORM },
+		{ "yuy2-rgba8", DXGI_FORMAT_YUY2, DXGI_FORMAT_R8G8B8A8_UNORM }
+	};
+	for (auto& yuv : yuvCases) {
+		for (auto level : benchSimdLevels()) {
+			auto name = std::string("yuv.") + yuv.name + ".4K." + simdLevelString(level);
+			// the throughput is of the source frame, and the frames per second are reported as well.
+			auto bytes = static_cast<double>(benchImageSize(3840, 2160, yuv.src));
+			registry.add(name, "cpu", bytes, [yuv, level](BenchBody* body) {
+				auto src = makeBenchImage(3840, 2160, yuv.src);
+				auto dst = makeBenchImage(3840, 2160, yuv.dst);
+				auto converter = std::make_shared<YuvConverter>(YuvMatrix::Bt709, YuvRange::Limited);
+				*body = [src, dst, converter, level](BenchState& state) {
+					auto start = std::chrono::steady_clock::now();
+					for (uint64_t i = 0; i < state.iterations(); i++) {
+						auto result = converter->convert(src->view, dst->view, &benchPool(), level);
+						if (FAILED(result)) {
+							return result;
+						}
+					}
+					auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					state.counter("fps", state.iterations() / seconds);
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+
+	for (auto level : benchSimdLevels()) {
+		auto name = std::string("hdr.scrgb-hdr10.4K.") + simdLevelString(level);
+		registry.add(name, "cpu", 3840.0 * 2160.0 * 8.0, [level](BenchBody* body) {
+			auto src = makeBenchImage(3840, 2160, hdrEncodingFormat(HdrEncoding::ScRgb));
+			auto dst = makeBenchImage(3840, 2160, hdrEncodingFormat(HdrEncoding::Hdr10));
+			DXGI_HDR_METADATA_HDR10 metadata = {};
+			metadata.MaxMasteringLuminance = 1000;
+			metadata.MinMasteringLuminance = 50;
+			metadata.MaxContentLightLevel = 1000;
+			auto mapping = ToneMapping::fromMetadata(ToneMapper::Bt2390, metadata, 600.0f);
+			auto converter = std::make_shared<HdrConverter>(HdrEncoding::ScRgb, HdrEncoding::Hdr10, mapping);
+			*body = [src, dst, converter, level](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = converter->convert(src->view, dst->view, level);
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+
+	// a ramp is built from the curve and turned into the lookup tables whenever the curve changes.
+	std::string calibration = "BEGIN_DATA\n";
+	for (auto i = 0; i <= 256; i++) {
+		auto x = i / 256.0;
+		calibration += std::to_string(x) + " " + std::to_string(std::pow(x, 0.95)) + " " + std::to_string(x) + " " + std::to_string(std::pow(x, 1.05)) + "\n";
+	}
+	calibration += "END_DATA\n";
+	std::shared_ptr<CalibrationCurve> calibrationCurve;
+	CalibrationCurve::parse(calibration, &calibrationCurve);
+	struct RampCase {
+		const char*	name;
+		GammaCurve	curve;
+		bool		caps;
+	};
+	const RampCase ramps[] = {
+		{ "srgb.table", GammaCurve::srgb(), false },
+		{ "srgb.caps", GammaCurve::srgb(), true },
+		{ "bt1886.table", GammaCurve::bt1886(), false },
+		{ "power", GammaCurve::powerLaw(2.4), false },
+		{ "calibration", GammaCurve::calibrated(calibrationCurve), false }
+	};
+	for (auto& ramp : ramps) {
+		auto curve = ramp.curve;
+		auto useCaps = ramp.caps;
+		registry.add(std::string("gamma.ramp.") + ramp.name, "cpu", 0.0, [curve, useCaps](BenchBody* body) {
+			if (curve.type == GammaCurveType::Calibration && curve.calibration == nullptr) {
+				return E_FAIL;
+			}
+			// the capabilities of an output which has all the control points but not at the even spacing.
+			auto caps = std::make_shared<DXGI_GAMMA_CONTROL_CAPABILITIES>();
+			caps->ScaleAndOffsetSupported = true;
+			caps->MinConvertedValue = 0.0f;
+			caps->MaxConvertedValue = 1.0f;
+			caps->NumGammaControlPoints = GAMMA_CURVE_POINTS;
+			for (UINT i = 0; i < GAMMA_CURVE_POINTS; i++) {
+				caps->ControlPointPositions[i] = static_cast<float>(std::pow(static_cast<double>(i) / (GAMMA_CURVE_POINTS - 1), 1.1));
+			}
+			*body = [curve, useCaps, caps](BenchState& state) {
+				DXGI_GAMMA_CONTROL control;
+				uint32_t mix = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = buildGammaControl(curve, useCaps ? caps.get() : nullptr, &control);
+					if (FAILED(result)) {
+						return result;
+					}
+					GammaLut lut(control, useCaps ? caps.get() : nullptr);
+					mix ^= static_cast<uint32_t>(control.GammaCurve[i % GAMMA_CURVE_POINTS].Red * 255.0f);
+				}
+				state.counter("mix", mix & 1);
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+
+	for (auto format : { DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_R10G10B10A2_UNORM }) {
+		for (auto level : benchSimdLevels()) {
+			auto name = std::string("gamma.srgb.") + (format == DXGI_FORMAT_B8G8R8A8_UNORM ? "bgra8" : "rgb10a2") + ".1080p." + simdLevelString(level);
+			registry.add(name, "cpu", 1920.0 * 1080.0 * 4.0, [format, level](BenchBody* body) {
+				DXGI_GAMMA_CONTROL control;
+				auto result = buildGammaControl(GammaCurve::srgb(), nullptr, &control);
+				if (FAILED(result)) {
+					return result;
+				}
+				auto lut = std::make_shared<GammaLut>(control);
+				auto image = makeBenchImage(1920, 1080, format);
+				*body = [lut, image, level](BenchState& state) {
+					for (uint64_t i = 0; i < state.iterations(); i++) {
+						auto result = lut->apply(image->view, level);
+						if (FAILED(result)) {
+							return result;
+						}
+					}
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+
+	for (auto filter : { ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3 }) {
+		for (auto upscale : { true, false }) {
+			auto name = std::string("resample.") + resampleFilterString(filter) + (upscale ? ".1080p-4K" : ".4K-1080p");
+			registry.add(name, "cpu", upscale ? 3840.0 * 2160.0 * 4.0 : 1920.0 * 1080.0 * 4.0, [filter, upscale](BenchBody* body) {
+				auto src = upscale ? makeBenchImage(1920, 1080, DXGI_FORMAT_B8G8R8A8_UNORM) : makeBenchImage(3840, 2160, DXGI_FORMAT_B8G8R8A8_UNORM);
+				auto dst = upscale ? makeBenchImage(3840, 2160, DXGI_FORMAT_B8G8R8A8_UNORM) : makeBenchImage(1920, 1080, DXGI_FORMAT_B8G8R8A8_UNORM);
+				auto resampler = std::make_shared<Resampler>(ScalingMode::Stretched, filter);
+				*body = [src, dst, resampler](BenchState& state) {
+					for (uint64_t i = 0; i < state.iterations(); i++) {
+						auto result = resampler->resample(src->view, dst->view, &benchPool());
+						if (FAILED(result)) {
+							return result;
+						}
+					}
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+
+	// a 3:5 ratio puts some samples exactly on the source pixels, where the filters may have zero weights.
+	// The setup checks that the slices of a pool produce the same image as a single serial pass (with
+	// a pool of its own, as the bench pool has no workers on a single core machine).
+	for (auto filter : { ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3 }) {
+		auto name = std::string("resample.") + resampleFilterString(filter) + ".720p-1200p";
+		registry.add(name, "cpu", 1920.0 * 1200.0 * 4.0, [filter](BenchBody* body) {
+			auto src = makeBenchImage(1280, 720, DXGI_FORMAT_B8G8R8A8_UNORM);
+			auto dst = makeBenchImage(1920, 1200, DXGI_FORMAT_B8G8R8A8_UNORM);
+			auto serial = makeBenchImage(1920, 1200, DXGI_FORMAT_B8G8R8A8_UNORM);
+			auto resampler = std::make_shared<Resampler>(ScalingMode::Stretched, filter);
+			auto result = resampler->resample(src->view, serial->view);
+			if (SUCCEEDED(result)) {
+				ThreadPool pool(3);
+				result = resampler->resample(src->view, dst->view, &pool);
+			}
+			if (FAILED(result)) {
+				return result;
+			}
+			if (dst->data != serial->data) {
+				return E_FAIL;
+			}
+			*body = [src, dst, resampler](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = resampler->resample(src->view, dst->view, &benchPool());
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+
+	for (auto format : { ImageFormat::Png, ImageFormat::Qoi }) {
+		auto name = std::string("encode.") + (format == ImageFormat::Png ? "png" : "qoi") + ".1080p";
+		registry.add(name, "cpu", 1920.0 * 1080.0 * 4.0, [format](BenchBody* body) {
+			auto image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+			auto data = std::make_shared<std::vector<BYTE>>();
+			*body = [image, data, format](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = encodeImage(image->view, format, &benchPool(), data.get());
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				state.counter("ratio", static_cast<double>(data->size()) / image->data.size());
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+
+	// the value is the time which a capture takes from the present thread (without the copy), i.e. the capture call and
+	// the poll calls of the following frames until the file is written, which also map the surface for the encoding.
+	registry.addCustom("screenshot.capture.1080p", "software", "ns", [](BenchBody* body) {
+		struct Fixture {
+			SteadyTimeSource						time;
+			MemoryStagingBackend					backend{ time, 1000000 };
+			std::atomic<int64_t>					latency{ 0 };
+			std::unique_ptr<ScreenshotPipeline>		pipeline;
+			std::shared_ptr<BenchImage>				image = makeBenchImage(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+			std::string								path = (std::filesystem::temp_directory_path() / "dxgi-bench-screenshot.qoi").string();
+
+			~Fixture() {
+				pipeline.reset();
+				std::remove(path.c_str());
+			}
+		};
+		auto fixture = std::make_shared<Fixture>();
+		ScreenshotDesc desc = { ImageFormat::Qoi, 3, [raw = fixture.get()](const ScreenshotResult& result) {
+			raw->latency.store(result.latencyTicks);
+		} };
+		fixture->pipeline = std::make_unique<ScreenshotPipeline>(fixture->backend, benchPool(), fixture->time, desc);
+		*body = [fixture](BenchState& state) {
+			int64_t copyTicks = 0;
+			auto before = fixture->pipeline->stats();
+			auto result = fixture->pipeline->capture(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM, [&](const ScreenshotTarget& target) {
+				auto copyStart = fixture->time.now();
+				auto& surface = fixture->backend.surface(target.surface);
+				for (UINT y = 0; y < target.height; y++) {
+					memcpy(surface.data() + static_cast<size_t>(y) * surface.pitch(),
+						fixture->image->data.data() + static_cast<size_t>(y) * fixture->image->view.pitch, static_cast<size_t>(target.width) * 4);
+				}
+				copyTicks = fixture->time.now() - copyStart;
+			}, fixture->path);
+			auto after = fixture->pipeline->stats();
+			while (SUCCEEDED(result) && after.written + after.failed == before.written + before.failed) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				fixture->pipeline->poll();
+				after = fixture->pipeline->stats();
+			}
+			if (SUCCEEDED(result)) {
+				result = after.failed == before.failed ? fixture->pipeline->flush() : E_FAIL;
+			}
+			state.setValue(static_cast<double>(after.presentTicks - before.presentTicks - copyTicks));
+			state.counter("maxPresentCallNs", static_cast<double>(after.maxPresentTicks));
+			state.counter("captureToFileMs", ticksToMillis(fixture->latency.load(), fixture->time.frequency()));
+			return result;
+		};
+		return S_OK;
+	});
+
+	// two 4K frames which differ by a centered window of the given share of the area are given by turns.
+	for (auto percent : { 1u, 10u, 50u, 100u }) {
+		auto name = "duplication.update.4K.dirty" + std::to_string(percent) + "pct";
+		registry.add(name, "cpu", 3840.0 * 2160.0 * 4.0, [percent](BenchBody* body) {
+			const UINT width = 3840;
+			const UINT height = 2160;
+			auto first = makeBenchImage(width, height, DXGI_FORMAT_B8G8R8A8_UNORM);
+			auto second = makeBenchImage(width, height, DXGI_FORMAT_B8G8R8A8_UNORM);
+			auto scale = std::sqrt(percent / 100.0);
+			auto dirtyWidth = static_cast<UINT>(width * scale);
+			auto dirtyHeight = static_cast<UINT>(height * scale);
+			auto left = (width - dirtyWidth) / 2;
+			auto top = (height - dirtyHeight) / 2;
+			for (auto y = top; y < top + dirtyHeight; y++) {
+				memset(second->data.data() + static_cast<size_t>(y) * second->view.pitch + left * 4, 0x40, dirtyWidth * 4);
+			}
+			auto engine = std::make_shared<DuplicationEngine>(width, height, DXGI_FORMAT_B8G8R8A8_UNORM);
+			*body = [first, second, engine](BenchState& state) {
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = engine->update(i % 2 == 0 ? second->view : first->view);
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				state.counter("dirtyRects", static_cast<double>(engine->dirtyRects().size()));
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+}
+
+// ============================================================================
+// Timing
+//
+// The accuracy of the waits on the real clock, the cost of the vblank clock
+// and the input-to-present latency of the frame limiter. The limiter runs a
+// simulation with a ManualTimeSource like in the testFrameLimiter, so each
+// of its samples is the median latency of a simulated run of 600 frames.
+//
+// Both loops count a frame as missed when it is rendered after the present
+// deadline it aimed for: the naive vsync loop aims for the first vblank after
+// its start, and the naive tearing loop for its next paced present. The 1% of
+// 6 ms spikes are above the predicted 95th percentile, so the limiter misses
+// them. With vsync those frames are shown a refresh later, so the limiter cuts
+// the median latency from a refresh to ~6 ms while its 99th percentile grows
+// to ~23 ms. A safety margin which covers the spikes (the jitMargin7ms ones)
+// misses nothing and keeps both under a refresh, for a median of ~12.5 ms.
+// ============================================================================
+inline void registerTimingBenchmarks(BenchRegistry& registry) {
+	registry.addCustom("timing.preciseWait.lateness", "cpu", "ns", [](BenchBody* body) {
+		auto time = std::make_shared<SteadyTimeSource>();
+		auto waiter = std::make_shared<PreciseWaiter>(*time);
+		*body = [time, waiter](BenchState& state) {
+			state.setValue(static_cast<double>(waiter->waitUntil(time->now() + time->frequency() / 1000)));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.addCustom("timing.sleepUntil.lateness", "cpu", "ns", [](BenchBody* body) {
+		auto time = std::make_shared<SteadyTimeSource>();
+		*body = [time](BenchState& state) {
+			auto target = time->now() + time->frequency() / 1000;
+			time->waitUntil(target);
+			state.setValue(static_cast<double>(time->now() - target));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("timing.vblankClock.addSample", "cpu", 0.0, [](BenchBody* body) {
+		struct Fixture {
+			ManualTimeSource		time;
+			std::vector<int64_t>	vblanks;
+			int64_t					span;
+			uint64_t				next = 0;
+			VBlankClock				clock{ time.frequency(), { 60, 1 } };
+		};
+		auto fixture = std::make_shared<Fixture>();
+		SyntheticVBlankSource source(fixture->time, { 60, 1 }, 300.0, fixture->time.frequency() / 5000);
+		fixture->vblanks.resize(4096);
+		for (auto& vblank : fixture->vblanks) {
+			source.WaitForVBlank(&vblank);
+		}
+		fixture->span = fixture->vblanks.back() - fixture->vblanks.front() + static_cast<int64_t>(source.period());
+		*body = [fixture](BenchState& state) {
+			int64_t predicted = 0;
+			auto count = fixture->vblanks.size();
+			for (uint64_t i = 0; i < state.iterations(); i++, fixture->next++) {
+				auto ticks = fixture->vblanks[fixture->next % count] + static_cast<int64_t>(fixture->next / count) * fixture->span;
+				fixture->clock.addSample(ticks);
+				predicted += fixture->clock.nextVBlank(ticks) - ticks;
+			}
+			return predicted >= 0 ? S_OK : E_FAIL;
+		};
+		return S_OK;
+	});
+
+	const struct {
+		const char*	name;
+		bool		limited;
+		int64_t		safetyMargin;
+	} loops[] = {
+		{ "jit", true, 1000000 },
+		{ "jitMargin7ms", true, 7000000 },
+		{ "naive", false, 0 }
+	};
+	for (auto mode : { PresentMode::VSync, PresentMode::Tearing }) {
+		for (auto& loop : loops) {
+			auto name = std::string("limiter.") + presentModeString(mode) + "." + loop.name + ".latency";
+			auto limited = loop.limited;
+			auto safetyMargin = loop.safetyMargin;
+			registry.addCustom(name, "cpu", "ns", [mode, limited, safetyMargin](BenchBody* body) {
+				auto seed = std::make_shared<uint32_t>(1);
+				*body = [mode, limited, safetyMargin, seed](BenchState& state) {
+					const int64_t lead = 500000;
+					const int64_t interval = 8333333;
+					ManualTimeSource time;
+					SyntheticVBlankSource display(time, { 60, 1 }, 0.0, 0);
+					VBlankClock clock(time.frequency(), { 60, 1 });
+					for (auto i = 0; i < 16; i++) {
+						int64_t vblank;
+						display.WaitForVBlank(&vblank);
+						clock.addSample(vblank);
+					}
+					FrameLimiterDesc desc = { mode, lead, mode == PresentMode::Tearing ? interval : 0, safetyMargin, 0.95 };
+					FrameLimiter limiter(desc, time, &clock);
+					std::mt19937 random((*seed)++);
+					std::lognormal_distribution<double> cost(std::log(3e6), 0.3);
+					LatencyHistogram latency;
+					uint64_t missed = 0;
+					auto next = time.now() + interval;
+					for (auto frame = 0; frame < 600; frame++) {
+						auto start = limited ? 0 : time.now();
+						auto deadline = limited ? limiter.beginFrame() : (mode == PresentMode::VSync ? display.nextVBlank(start) - lead : next);
+						start = time.now();
+						time.advance(static_cast<int64_t>(cost(random)) + (random() % 100 == 0 ? 6000000 : 0));
+						if (limited) {
+							limiter.endFrame();
+						}
+						int64_t shown;
+						if (mode == PresentMode::VSync) {
+							// the frame is shown on the first vblank after the present lead.
+							shown = display.nextVBlank(time.now() + lead - 1);
+							missed += shown - lead > deadline ? 1 : 0;
+							if (!limited) {
+								time.waitUntil(shown);
+							}
+						} else if (limited) {
+							shown = time.now();
+							missed += shown > deadline ? 1 : 0;
+						} else {
+							// the naive loop paces its presents instead of the frame starts.
+							missed += time.now() > deadline ? 1 : 0;
+							time.waitUntil(next);
+							shown = time.now();
+							next = std::max(next, shown - interval) + interval;
+						}
+						latency.record(static_cast<uint64_t>(shown - start));
+					}
+					auto report = latency.report();
+					state.setValue(static_cast<double>(report.p50));
+					state.counter("latencyP99", static_cast<double>(report.p99));
+					state.counter("missed", static_cast<double>(missed));
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+}
+
+// a private data store built on a standard map of GUIDs (the baselines of the PrivateDataStore).
+template <typename Map>
+class MapPrivateData final {
+public:
+	HRESULT SetPrivateData(REFGUID name, UINT size, const void* data) {
+		auto bytes = static_cast<const uint8_t*>(data);
+		mEntries[name].assign(bytes, bytes + size);
+		return S_OK;
+	}
+
+	HRESULT GetPrivateData(REFGUID name, UINT* size, void* data) const {
+		auto entry = mEntries.find(name);
+		if (entry == mEntries.end()) {
+			*size = 0;
+			return DXGI_ERROR_NOT_FOUND;
+		}
+		auto entrySize = static_cast<UINT>(entry->second.size());
+		if (*size < entrySize) {
+			*size = entrySize;
+			return DXGI_ERROR_MORE_DATA;
+		}
+		*size = entrySize;
+		std::memcpy(data, entry->second.data(), entrySize);
+		return S_OK;
+	}
+private:
+	Map mEntries;
+};
+
+struct GuidHash {
+	size_t operator()(const GUID& guid) const {
+		uint64_t halves[2];
+		std::memcpy(halves, &guid, sizeof(halves));
+		return static_cast<size_t>(halves[0] ^ (halves[1] * 0x9e3779b97f4a7c15ull));
+	}
+};
+
+struct GuidLess {
+	bool operator()(const GUID& a, const GUID& b) const {
+		return std::memcmp(&a, &b, sizeof(GUID)) < 0;
+	}
+};
+
+typedef MapPrivateData<std::unordered_map<GUID, std::vector<uint8_t>, GuidHash>> UnorderedMapPrivateData;
+typedef MapPrivateData<std::map<GUID, std::vector<uint8_t>, GuidLess>> OrderedMapPrivateData;
+
+// the names of the private data benchmarks, shared so that all the stores see the same keys.
+struct PrivateDataKeys {
+	std::vector<GUID>	stored;		// the names which are set into the stores.
+	std::vector<GUID>	lookups;	// the names which are looked up, a quarter of them missing.
+};
+
+inline const PrivateDataKeys& privateDataKeys() {
+	static const auto keys = [] {
+		PrivateDataKeys keys;
+		for (auto i = 0; i < 64; i++) {
+			keys.stored.push_back(createRandomGUID());
+		}
+		for (uint64_t i = 0; i < 1024; i++) {
+			auto hash = (i * 0x9e3779b97f4a7c15ull) >> 32;
+			keys.lookups.push_back(hash % 4 == 0 ? createRandomGUID() : keys.stored[hash % keys.stored.size()]);
+		}
+		return keys;
+	}();
+	return keys;
+}
+
+// register the set and the get of a private data store with the common keys and payloads.
+template <typename Store>
+inline void registerPrivateDataBenchmarks(BenchRegistry& registry, const char* store) {
+	for (auto set : { true, false }) {
+		auto name = std::string("privateData.") + (set ? "set." : "get.") + store;
+		registry.add(name, "cpu", 0.0, [set](BenchBody* body) {
+			auto store = std::make_shared<Store>();
+			uint64_t payload[2] = { 1, 2 };
+			for (auto& name : privateDataKeys().stored) {
+				auto result = store->SetPrivateData(name, sizeof(payload), payload);
+				if (FAILED(result)) {
+					return result;
+				}
+			}
+			// the sets replace the stored payloads, while the gets look up the mix of hits and misses.
+			*body = [store, set](BenchState& state) {
+				auto& keys = privateDataKeys();
+				uint64_t payload[2] = { 3, 4 };
+				uint64_t hits = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					UINT size = sizeof(payload);
+					auto result = set
+						? store->SetPrivateData(keys.stored[i % keys.stored.size()], size, payload)
+						: store->GetPrivateData(keys.lookups[i % keys.lookups.size()], &size, payload);
+					if (FAILED(result) && result != DXGI_ERROR_NOT_FOUND) {
+						return result;
+					}
+					hits += result == S_OK ? 1 : 0;
+				}
+				state.counter("hitRate", static_cast<double>(hits) / state.iterations());
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+}
+
+// ============================================================================
+// Resources
+//
+// The hand-off of shared surfaces with the keyed mutexes, the buffers which
+// a resize storm allocates, the per frame cost of the resource trimmer and the
+// private data of the DXGI objects.
+//
+// The resize storm simulates dragging the edge of a window for two seconds,
+// which sends a new size every 4 ms, while the application renders at 60 Hz.
+// Resizing the buffers on each request is compared against the ResizeManager
+// (resize_manager.h), which coalesces the requests and keeps the buffers in a
+// larger envelope. The time is the CPU cost of a whole storm, and the counters
+// give the buffer allocations which the swap chain made and the ResizeBuffers
+// calls which were made during it (and the sizes which the manager applied).
+// ============================================================================
+inline void registerResourceBenchmarks(BenchRegistry& registry) {
+	for (auto managed : { false, true }) {
+		registry.add(managed ? "resize.storm.managed" : "resize.storm.direct", "software", 0.0, [managed](BenchBody* body) {
+			*body = [managed](BenchState& state) {
+				uint64_t totalAllocations = 0;
+				int64_t totalAllocatedBytes = 0;
+				uint64_t applied = 0;
+				uint64_t resizeCalls = 0;
+				for (uint64_t storm = 0; storm < state.iterations(); storm++) {
+					ManualTimeSource time;
+					DXGI_SWAP_CHAIN_DESC desc = {};
+					desc.BufferCount = 3;
+					desc.BufferDesc.Width = WINDOW_WIDTH;
+					desc.BufferDesc.Height = WINDOW_HEIGHT;
+					desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+					desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+					std::shared_ptr<SoftwareSwapChain> swapChain;
+					auto result = SoftwareSwapChain::create(desc, time, &swapChain);
+					if (FAILED(result)) {
+						return result;
+					}
+					ResizeManager<SoftwareSwapChain> resizer(swapChain.get(), time, defaultResizePolicy(time.frequency()));
+					auto allocations = swapChain->summary().allocations;
+					auto allocatedBytes = swapChain->summary().allocatedBytes;
+
+					auto nextFrame = time.now();
+					for (auto i = 0; i < 500; i++) {
+						time.advance(4 * time.frequency() / 1000);
+						auto width = static_cast<UINT>(WINDOW_WIDTH + 300 * std::sin(i * 0.02));
+						auto height = static_cast<UINT>(WINDOW_HEIGHT + 200 * std::sin(i * 0.013));
+						result = S_OK;
+						if (managed) {
+							resizer.requestResize(width, height);
+						} else {
+							result = swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+							resizeCalls++;
+						}
+						if (managed && time.now() >= nextFrame) {
+							nextFrame = time.now() + time.frequency() / 60;
+							result = resizer.update();
+						}
+						if (FAILED(result)) {
+							return result;
+						}
+					}
+					result = managed ? resizer.flush() : S_OK;
+					if (FAILED(result)) {
+						return result;
+					}
+					totalAllocations += swapChain->summary().allocations - allocations;
+					totalAllocatedBytes += swapChain->summary().allocatedBytes - allocatedBytes;
+					applied += resizer.stats().applied;
+					resizeCalls += resizer.stats().reallocations;
+				}
+				state.counter("allocations", static_cast<double>(totalAllocations) / state.iterations());
+				state.counter("allocatedBytes", static_cast<double>(totalAllocatedBytes) / state.iterations());
+				state.counter("resizeBuffersCalls", static_cast<double>(resizeCalls) / state.iterations());
+				if (managed) {
+					state.counter("appliedSizes", static_cast<double>(applied) / state.iterations());
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+
+#if defined(__linux__)
+	for (auto mapped : { false, true }) {
+		auto name = mapped ? "shared.handoff.1080p" : "shared.keyedMutex";
+		registry.add(name, "software", mapped ? 1920.0 * 1080.0 * 4.0 : 0.0, [mapped](BenchBody* body) {
+			struct Fixture {
+				std::shared_ptr<PosixSharedSurface>	producer;
+				std::shared_ptr<PosixSharedSurface>	consumer;
+			};
+			auto fixture = std::make_shared<Fixture>();
+			auto name = "/dxgi-bench-" + std::to_string(getpid());
+			auto result = PosixSharedSurface::create(name, 1920, 1080, DXGI_FORMAT_B8G8R8A8_UNORM, &fixture->producer);
+			if (SUCCEEDED(result)) {
+				result = PosixSharedSurface::open(name, &fixture->consumer);
+			}
+			if (FAILED(result)) {
+				return result;
+			}
+			*body = [fixture, mapped](BenchState& state) {
+				uint64_t sum = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					DXGI_MAPPED_RECT rect;
+					auto result = fixture->producer->AcquireSync(0, 1000);
+					if (result != S_OK) {
+						return FAILED(result) ? result : DXGI_ERROR_WAIT_TIMEOUT;
+					}
+					result = mapped ? fixture->producer->Map(&rect, DXGI_MAP_WRITE) : S_FALSE;
+					if (result == S_OK) {
+						memset(rect.pBits, static_cast<int>(i & 0xff), fixture->producer->size());
+						fixture->producer->Unmap();
+					}
+					fixture->producer->ReleaseSync(1);
+					if (FAILED(result)) {
+						return result;
+					}
+					result = fixture->consumer->AcquireSync(1, 1000);
+					if (result != S_OK) {
+						return FAILED(result) ? result : DXGI_ERROR_WAIT_TIMEOUT;
+					}
+					// read a word of each cache line like a consumer which uploads the frame would.
+					result = mapped ? fixture->consumer->Map(&rect, DXGI_MAP_READ) : S_FALSE;
+					if (result == S_OK) {
+						auto words = reinterpret_cast<const uint64_t*>(rect.pBits);
+						for (size_t j = 0; j < fixture->consumer->size() / 8; j += 8) {
+							sum += words[j];
+						}
+						fixture->consumer->Unmap();
+					}
+					fixture->consumer->ReleaseSync(0);
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				if (mapped) {
+					state.counter("checksum", static_cast<double>(sum & 0xff));
+				}
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+#elif defined(_WIN32)
+	registry.add("shared.keyedMutex", "dxgi", 0.0, [](BenchBody* body) {
+		auto& context = dxgiContext();
+		if (FAILED(context.result)) {
+			return context.result;
+		}
+		struct Fixture {
+			std::shared_ptr<D3D10SharedSurface>	producer;
+			std::shared_ptr<D3D10SharedSurface>	consumer;
+		};
+		auto fixture = std::make_shared<Fixture>();
+		auto result = D3D10SharedSurface::create(context.device.Get(), 1920, 1080, DXGI_FORMAT_B8G8R8A8_UNORM, &fixture->producer);
+		if (SUCCEEDED(result)) {
+			result = D3D10SharedSurface::open(context.device.Get(), fixture->producer->sharedHandle(), &fixture->consumer);
+		}
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [fixture](BenchState& state) {
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				auto result = fixture->producer->AcquireSync(0, 1000);
+				if (result != S_OK) {
+					return FAILED(result) ? result : DXGI_ERROR_WAIT_TIMEOUT;
+				}
+				fixture->producer->ReleaseSync(1);
+				result = fixture->consumer->AcquireSync(1, 1000);
+				if (result != S_OK) {
+					return FAILED(result) ? result : DXGI_ERROR_WAIT_TIMEOUT;
+				}
+				fixture->consumer->ReleaseSync(0);
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+#endif
+
+	// a window of resources moves over 48 textures, so the others are offered and reclaimed in turns.
+	registry.add("trimmer.frame", "software", 0.0, [](BenchBody* body) {
+		const UINT64 size = 1024 * 1024;
+		struct Fixture {
+			SteadyTimeSource								time;
+			DiscardableHeap									heap{ 64 * 1024 * 1024 };
+			std::unique_ptr<ResourceTrimmer>				trimmer;
+			std::vector<std::unique_ptr<HeapResource>>		resources;
+			std::vector<ResourceTrimmer::Handle>			handles;
+			uint64_t										frame = 0;
+
+			~Fixture() {
+				trimmer.reset();
+			}
+		};
+		auto fixture = std::make_shared<Fixture>();
+		auto desc = defaultTrimmerDesc();
+		desc.idleFrames = 8;
+		fixture->trimmer = std::make_unique<ResourceTrimmer>(fixture->time, desc);
+		for (auto i = 0; i < 48; i++) {
+			fixture->resources.push_back(std::make_unique<HeapResource>(fixture->heap, size, 0x9e3779b9u * (i + 1)));
+			fixture->handles.push_back(fixture->trimmer->add(fixture->resources.back().get(), size));
+		}
+		auto result = fixture->trimmer->start();
+		if (FAILED(result)) {
+			return result;
+		}
+		*body = [fixture](BenchState& state) {
+			auto before = fixture->trimmer->stats();
+			for (uint64_t i = 0; i < state.iterations(); i++, fixture->frame++) {
+				auto center = fixture->frame / 4;
+				for (auto j = 0; j < 6; j++) {
+					auto result = fixture->trimmer->use(fixture->handles[(center + j) % fixture->handles.size()]);
+					if (FAILED(result)) {
+						return result;
+					}
+				}
+				fixture->trimmer->endFrame();
+			}
+			auto after = fixture->trimmer->stats();
+			state.counter("reclaimsPerFrame", static_cast<double>(after.reclaims - before.reclaims) / state.iterations());
+			return fixture->trimmer->result();
+		};
+		return S_OK;
+	});
+
+	registerPrivateDataBenchmarks<PrivateDataStore>(registry, "store");
+	registerPrivateDataBenchmarks<UnorderedMapPrivateData>(registry, "unorderedMap");
+	registerPrivateDataBenchmarks<OrderedMapPrivateData>(registry, "map");
+}
+
+// ============================================================================
+// Utilities
+//
+// The small utilities which are called often: the GUID generation, the string
+// presentations of the enums and the flags, the call tracing of the TRACE_CALL
+// and the latency statistics of the frames. The string presentations are
+// compared against the std::string helpers (and the bare printf of the
+// formats and the flags) which the name tables of dxgi_util.h replaced.
+// ============================================================================
+
+// the string helpers which the name tables of dxgi_util.h replaced (the baselines of the string benchmarks).
+// The enum names are measured through calls which are not inlined, as otherwise the compiler folds the strlen
+// of each case of the switch into a constant, which does not happen where the names are actually written.
+BENCH_NOINLINE const char* legacyScalingString(DXGI_MODE_SCALING mode) {
+	switch (mode) {
+	case DXGI_MODE_SCALING_CENTERED:
+		return "centered";
+	case DXGI_MODE_SCALING_STRETCHED:
+		return "stretched";
+	case DXGI_MODE_SCALING_UNSPECIFIED:
+		return "unspecified";
+	default:
+		return "unknown";
+	}
+}
+
+BENCH_NOINLINE const char* benchScalingString(DXGI_MODE_SCALING mode) {
+	return scalingString(mode);
+}
+
+inline std::string legacyUsageString(DXGI_USAGE usage) {
+	std::string result;
+	if ((usage & DXGI_USAGE_BACK_BUFFER) != 0) {
+		result += "[back-buffer]";
+	}
+	if ((usage & DXGI_USAGE_DISCARD_ON_PRESENT) != 0) {
+		result += "[discard-on-present]";
+	}
+	if ((usage & DXGI_USAGE_READ_ONLY) != 0) {
+		result += "[read-only]";
+	}
+	if ((usage & DXGI_USAGE_RENDER_TARGET_OUTPUT) != 0) {
+		result += "[render-target-output]";
+	}
+	if ((usage & DXGI_USAGE_SHADER_INPUT) != 0) {
+		result += "[shader-input]";
+	}
+	if ((usage & DXGI_USAGE_SHARED) != 0) {
+		result += "[shared]";
+	}
+	if ((usage & DXGI_USAGE_UNORDERED_ACCESS) != 0) {
+		result += "[unordered-access]";
+	}
+	return result;
+}
+
+inline std::string legacyRectString(const RECT& rect) {
+	std::string str = "{";
+	str += "top: " + std::to_string(rect.top);
+	str += ", right: " + std::to_string(rect.right);
+	str += ", bottom: " + std::to_string(rect.bottom);
+	str += ", left: " + std::to_string(rect.left);
+	str += "}";
+	return str;
+}
+
+// a function which the call tracing benchmarks wrap (not inlined so the call is not removed).
+BENCH_NOINLINE HRESULT benchTracedCall(uint64_t value) {
+	return value == ~0ull ? E_FAIL : S_OK;
+}
+
+inline void registerUtilityBenchmarks(BenchRegistry& registry) {
+	registry.add("guid.createRandom", "cpu", 0.0, [](BenchBody* body) {
+		*body = [](BenchState& state) {
+			uint32_t mix = 0;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				mix ^= createRandomGUID().Data1;
+			}
+			state.counter("mix", static_cast<double>(mix & 1));
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	// each string helper is measured against the helper (or the bare printf) which it replaced.
+	typedef size_t (*StringFunc)(uint64_t i);
+	struct StringCase {
+		const char*	name;
+		StringFunc	legacy;
+		StringFunc	table;
+	};
+	const StringCase strings[] = {
+		{ "format", [](uint64_t i) {
+			char buffer[16];
+			return static_cast<size_t>(snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(i % 120)));
+		}, [](uint64_t i) {
+			return strlen(formatString(static_cast<DXGI_FORMAT>(i % 120)));
+		} },
+		{ "swapChainFlags", [](uint64_t i) {
+			char buffer[16];
+			return static_cast<size_t>(snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(i * 0x9e3779b9u & 0xfff)));
+		}, [](uint64_t i) {
+			return swapChainFlagsString(static_cast<UINT>(i * 0x9e3779b9u) & 0xfff).size();
+		} },
+		{ "scaling", [](uint64_t i) {
+			return strlen(legacyScalingString(static_cast<DXGI_MODE_SCALING>(i % 4)));
+		}, [](uint64_t i) {
+			return strlen(benchScalingString(static_cast<DXGI_MODE_SCALING>(i % 4)));
+		} },
+		{ "usage", [](uint64_t i) {
+			return legacyUsageString(static_cast<DXGI_USAGE>((i * 0x9e3779b9u) & 0x7f) << 4).size();
+		}, [](uint64_t i) {
+			return usageString(static_cast<DXGI_USAGE>((i * 0x9e3779b9u) & 0x7f) << 4).size();
+		} },
+		{ "rect", [](uint64_t i) {
+			RECT rect = { static_cast<LONG>(i & 0xff), 0, static_cast<LONG>(1920 + (i & 0xfff)), 1080 };
+			return legacyRectString(rect).size();
+		}, [](uint64_t i) {
+			RECT rect = { static_cast<LONG>(i & 0xff), 0, static_cast<LONG>(1920 + (i & 0xfff)), 1080 };
+			return rectString(rect).size();
+		} }
+	};
+	for (auto& string : strings) {
+		for (auto legacy : { true, false }) {
+			auto function = legacy ? string.legacy : string.table;
+			registry.add(std::string("string.") + string.name + (legacy ? ".legacy" : ".table"), "cpu", 0.0, [function](BenchBody* body) {
+				*body = [function](BenchState& state) {
+					size_t length = 0;
+					for (uint64_t i = 0; i < state.iterations(); i++) {
+						length += function(i);
+					}
+					state.counter("length", static_cast<double>(length) / state.iterations());
+					return S_OK;
+				};
+				return S_OK;
+			});
+		}
+	}
+
+	for (auto enabled : { false, true }) {
+		registry.add(enabled ? "trace.call.enabled" : "trace.call.disabled", "cpu", 0.0, [enabled](BenchBody* body) {
+			*body = [enabled](BenchState& state) {
+				// start from an empty ring, and drain it whenever it would be full (a part of the cost of the
+				// tracing), so the records are never dropped and the cost is the one of the record path.
+				callTracer().collect();
+				auto previous = callTracer().enabled();
+				callTracer().setEnabled(enabled);
+				HRESULT result = S_OK;
+				uint64_t dropped = 0;
+				for (uint64_t i = 0; i < state.iterations() && SUCCEEDED(result); i++) {
+					result = TRACE_CALL(benchTracedCall(i));
+					if (enabled && (i + 1) % TRACE_RING_CAPACITY == 0) {
+						dropped += callTracer().collect().dropped;
+					}
+				}
+				callTracer().setEnabled(previous);
+				if (enabled) {
+					dropped += callTracer().collect().dropped;
+				}
+				state.counter("dropped", static_cast<double>(dropped));
+				return result;
+			};
+			return S_OK;
+		});
+	}
+
+	registry.add("stats.histogramRecord", "cpu", 0.0, [](BenchBody* body) {
+		auto histogram = std::make_shared<LatencyHistogram>();
+		*body = [histogram](BenchState& state) {
+			uint64_t value = 0x9e3779b97f4a7c15ull;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				value ^= value << 13;
+				value ^= value >> 7;
+				value ^= value << 17;
+				histogram->record(value >> 40);
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+
+	registry.add("stats.frameStatisticsSample", "cpu", 0.0, [](BenchBody* body) {
+		struct Fixture {
+			ManualTimeSource			time;
+			FrameStatisticsRecorder		recorder{ time, { 60, 1 } };
+			DXGI_FRAME_STATISTICS		stats = {};
+		};
+		auto fixture = std::make_shared<Fixture>();
+		*body = [fixture](BenchState& state) {
+			auto period = fixture->time.frequency() / 60;
+			for (uint64_t i = 0; i < state.iterations(); i++) {
+				// each frame is shown two refreshes after its present.
+				fixture->time.advance(period);
+				auto& stats = fixture->stats;
+				stats.PresentCount++;
+				stats.PresentRefreshCount = stats.PresentCount + 2;
+				stats.SyncRefreshCount = stats.PresentRefreshCount;
+				stats.SyncQPCTime.QuadPart = fixture->time.now();
+				fixture->recorder.sample(stats.PresentCount + 2, S_OK, stats);
+			}
+			return S_OK;
+		};
+		return S_OK;
+	});
+}
+
+// ============================================================================
+// Reference Counting
+//
+// The atomic traffic of passing one shared object into a function on many
+// threads at once (like the adapters and outputs shared by the workers). The
+// Borrowed does not touch the reference count, a RefPtr copy (like a ComPtr
+// copy) makes an AddRef and a Release on the same cache line from all the
+// threads, and a moved RefPtr passes the ownership through without atomics.
+// The value is the time of a call on each thread, i.e. the wall time of the
+// sample divided by the calls made by a single thread.
+// ============================================================================
+
+// an object with an intrusive reference count which the threads share.
+class BenchShared final : public RefCounted<BenchShared> {};
+
+BENCH_NOINLINE uint32_t benchUseBorrowed(Borrowed<IUnknown> object) {
+	return object ? 1 : 0;
+}
+
+BENCH_NOINLINE uint32_t benchUseRefPtr(RefPtr<IUnknown> object) {
+	return object ? 1 : 0;
+}
+
+BENCH_NOINLINE RefPtr<IUnknown> benchPassRefPtr(RefPtr<IUnknown> object) {
+	return object;
+}
+
+#if defined(_WIN32)
+BENCH_NOINLINE uint32_t benchUseComPtr(ComPtr<IUnknown> object) {
+	return object ? 1 : 0;
+}
+#endif
+
+// a utility to run the function on the given amount of threads which all start at the same time.
+template <typename Function>
+inline void runOnThreads(UINT threads, Function function) {
+	std::atomic<UINT> ready(0);
+	std::vector<std::thread> workers;
+	for (auto i = 0u; i < threads; i++) {
+		workers.emplace_back([&ready, &function, threads] {
+			ready.fetch_add(1);
+			while (ready.load() < threads) {
+				std::this_thread::yield();
+			}
+			function();
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+inline void registerRefCountBenchmarks(BenchRegistry& registry) {
+	typedef uint32_t (*PassFunc)(const RefPtr<IUnknown>& object, uint64_t iterations);
+	struct Handle {
+		const char*	name;
+		PassFunc	pass;
+	};
+	std::vector<Handle> handles = {
+		{ "borrowed", [](const RefPtr<IUnknown>& object, uint64_t iterations) {
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < iterations; i++) {
+				sum += benchUseBorrowed(object);
+			}
+			return sum;
+		} },
+		{ "refPtr.copy", [](const RefPtr<IUnknown>& object, uint64_t iterations) {
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < iterations; i++) {
+				sum += benchUseRefPtr(object);
+			}
+			return sum;
+		} },
+		{ "refPtr.move", [](const RefPtr<IUnknown>& object, uint64_t iterations) {
+			// each thread takes a single reference of its own and moves it through the calls.
+			auto owned = object;
+			for (uint64_t i = 0; i < iterations; i++) {
+				owned = benchPassRefPtr(std::move(owned));
+			}
+			return owned ? static_cast<uint32_t>(iterations) : 0;
+		} },
+#if defined(_WIN32)
+		{ "comPtr.copy", [](const RefPtr<IUnknown>& object, uint64_t iterations) {
+			ComPtr<IUnknown> owner(object.get());
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < iterations; i++) {
+				sum += benchUseComPtr(owner);
+			}
+			return sum;
+		} },
+#endif
+	};
+	for (auto& handle : handles) {
+		for (auto threads : { 1u, 2u, 4u, 8u }) {
+			auto name = std::string("refcount.") + handle.name + "." + std::to_string(threads) + "threads";
+			auto pass = handle.pass;
+			registry.add(name, "cpu", 0.0, [pass, threads](BenchBody* body) {
+				RefPtr<IUnknown> object = makeRef<BenchShared>();
+				*body = [object, pass, threads](BenchState& state) {
+					std::atomic<uint64_t> calls(0);
+					runOnThreads(threads, [&] {
+						calls.fetch_add(pass(object, state.iterations()));
+					});
+					state.counter("threads", threads);
+					return calls.load() == threads * state.iterations() ? S_OK : E_FAIL;
+				};
+				return S_OK;
+			});
+		}
+	}
+}
+
+// ============================================================================
+// Error Handling
+//
+// The cost of handling failed calls with exceptions (like the check_hresult),
+// with the Result and with plain HRESULTs. A stubbed call fails with DEVICE_
+// RESET at the given rate, spread over the iterations with a hash so that the
+// branch predictor cannot learn the pattern. The success path should cost the
+// same for all three, while the exceptions get expensive as failures grow.
+// ============================================================================
+
+// an exception which the throwing variant of the stubbed call throws.
+struct BenchFailure {
+	HRESULT code;
+};
+
+// a utility to check whether the stubbed call fails on the given iteration.
+inline bool benchCallFails(uint64_t iteration, uint32_t percent) {
+	return ((iteration * 0x9e3779b97f4a7c15ull) >> 32) % 100 < percent;
+}
+
+BENCH_NOINLINE HRESULT benchFallibleCall(uint64_t iteration, uint32_t percent, uint32_t* value) {
+	if (benchCallFails(iteration, percent)) {
+		return DXGI_ERROR_DEVICE_RESET;
+	}
+	*value = static_cast<uint32_t>(iteration);
+	return S_OK;
+}
+
+BENCH_NOINLINE Result<uint32_t> benchFallibleResult(uint64_t iteration, uint32_t percent) {
+	if (benchCallFails(iteration, percent)) {
+		return Result<uint32_t>::failure(DXGI_ERROR_DEVICE_RESET, SOURCE_LOCATION);
+	}
+	return Result<uint32_t>(static_cast<uint32_t>(iteration), SOURCE_LOCATION);
+}
+
+BENCH_NOINLINE uint32_t benchFallibleThrow(uint64_t iteration, uint32_t percent) {
+	if (benchCallFails(iteration, percent)) {
+		throw BenchFailure{ DXGI_ERROR_DEVICE_RESET };
+	}
+	return static_cast<uint32_t>(iteration);
+}
+
+inline void registerErrorBenchmarks(BenchRegistry& registry) {
+	for (auto percent : { 0u, 1u, 10u, 50u }) {
+		auto suffix = "." + std::to_string(percent) + "pct";
+		registry.add("errors.exception" + suffix, "cpu", 0.0, [percent](BenchBody* body) {
+			*body = [percent](BenchState& state) {
+				uint64_t sum = 0;
+				uint64_t failures = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					try {
+						sum += benchFallibleThrow(i, percent);
+					} catch (const BenchFailure& failure) {
+						failures += failure.code == DXGI_ERROR_DEVICE_RESET ? 1 : 0;
+					}
+				}
+				state.counter("failureRate", static_cast<double>(failures) / state.iterations());
+				state.counter("mix", static_cast<double>(sum & 1));
+				return S_OK;
+			};
+			return S_OK;
+		});
+
+		registry.add("errors.result" + suffix, "cpu", 0.0, [percent](BenchBody* body) {
+			*body = [percent](BenchState& state) {
+				uint64_t sum = 0;
+				uint64_t failures = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					auto result = benchFallibleResult(i, percent);
+					if (result.ok()) {
+						sum += result.value();
+					} else {
+						failures += result.classification() == HresultClass::Retryable ? 1 : 0;
+					}
+				}
+				state.counter("failureRate", static_cast<double>(failures) / state.iterations());
+				state.counter("mix", static_cast<double>(sum & 1));
+				return S_OK;
+			};
+			return S_OK;
+		});
+
+		registry.add("errors.hresult" + suffix, "cpu", 0.0, [percent](BenchBody* body) {
+			*body = [percent](BenchState& state) {
+				uint64_t sum = 0;
+				uint64_t failures = 0;
+				for (uint64_t i = 0; i < state.iterations(); i++) {
+					uint32_t value;
+					if (SUCCEEDED(benchFallibleCall(i, percent, &value))) {
+						sum += value;
+					} else {
+						failures++;
+					}
+				}
+				state.counter("failureRate", static_cast<double>(failures) / state.iterations());
+				state.counter("mix", static_cast<double>(sum & 1));
+				return S_OK;
+			};
+			return S_OK;
+		});
+	}
+}
+
+// a utility to parse the value of a command line option.
+inline bool parseOption(int argc, char** argv, int* index, const char* name, std::string* value) {
+	if (strcmp(argv[*index], name) != 0) {
+		return false;
+	} else if (*index + 1 >= argc) {
+		printf("missing value for %s\n", name);
+		exit(1);
+	}
+	*value = argv[++*index];
+	return true;
+}
+
+int main(int argc, char** argv) {
+	auto config = defaultBenchConfig();
+	std::string output = "dxgi-bench.json";
+	auto list = false;
+	for (auto i = 1; i < argc; i++) {
+		std::string value;
+		if (strcmp(argv[i], "--list") == 0) {
+			list = true;
+		} else if (parseOption(argc, argv, &i, "--filter", &config.filter) || parseOption(argc, argv, &i, "--label", &config.label)
+			|| parseOption(argc, argv, &i, "--output", &output)) {
+			continue;
+		} else if (parseOption(argc, argv, &i, "--samples", &value)) {
+			config.samples = static_cast<UINT>(std::max(1, atoi(value.c_str())));
+		} else if (parseOption(argc, argv, &i, "--warmup-ms", &value)) {
+			config.warmupMillis = std::max(0.0, atof(value.c_str()));
+		} else if (parseOption(argc, argv, &i, "--sample-ms", &value)) {
+			config.sampleMillis = std::max(0.1, atof(value.c_str()));
+		} else {
+			printf("usage: dxgi-bench [--list] [--filter <text>] [--samples <count>] [--warmup-ms <millis>]\n");
+			printf("                  [--sample-ms <millis>] [--label <text>] [--output <results.json>]\n");
+			return 1;
+		}
+	}
+
+	BenchRegistry registry;
+	registerEnumerationBenchmarks(registry);
+	registerMapBenchmarks(registry);
+	registerPresentBenchmarks(registry);
+	registerFormatBenchmarks(registry);
+	registerImageBenchmarks(registry);
+	registerTimingBenchmarks(registry);
+	registerResourceBenchmarks(registry);
+	registerUtilityBenchmarks(registry);
+	registerRefCountBenchmarks(registry);
+	registerErrorBenchmarks(registry);
+	if (list) {
+		for (auto& benchmark : registry.benchmarks()) {
+			printf("%-44s %s\n", benchmark.name.c_str(), benchmark.backend.c_str());
+		}
+		return 0;
+	}
+
+	auto environment = benchEnvironment();
+#if defined(_WIN32)
+	environment.adapters = describeAdapters();
+#endif
+	printf("platform: %s, compiler: %s, simd: %s, threads: %u, pool workers: %u\n", environment.platform.c_str(),
+		environment.compiler.c_str(), environment.simd.c_str(), environment.threads, benchPool().workers());
+	for (auto& adapter : environment.adapters) {
+		printf("adapter: %s\n", adapter.c_str());
+	}
+	printf("%-44s %-8s %12s %12s %9s\n", "benchmark", "backend", "median", "min", "cv");
+	auto results = registry.run(config, printBenchResult);
+
+	auto failed = std::count_if(results.begin(), results.end(), [](const BenchResult& result) { return FAILED(result.result); });
+	if (!output.empty()) {
+		auto file = openTraceFile(output.c_str(), "w");
+		auto result = file != nullptr ? writeBenchJson(file, environment, config, results) : E_FAIL;
+		if (file != nullptr && fclose(file) != 0) {
+			result = E_FAIL;
+		}
+		if (FAILED(result)) {
+			printf("failed to write %s\n", output.c_str());
+			return 1;
+		}
+		printf("wrote %zu results into %s\n", results.size(), output.c_str());
+	}
+	return failed == 0 ? 0 : 2;
+}
\ No newline at end of file
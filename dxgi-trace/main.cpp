@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <vector>
+
+#include "../dxgi-1.0/call_trace.h"
+
+// ============================================================================
+// # dxgi-trace
+// An offline tool which converts the binary call traces (written by the other
+// projects with saveCallTrace) into Chrome trace / Perfetto JSON files. These
+// can be opened with chrome://tracing or with https://ui.perfetto.dev/.
+//
+//		dxgi-trace <input.trace> [output.json]
+//
+// A short summary of the calls per call site is always printed, so the tool
+// can be also used to quickly check which calls failed and what they cost.
+// ============================================================================
+
+// a summary of the calls at a single call site.
+struct SiteSummary {
+	uint64_t calls = 0;
+	uint64_t failures = 0;
+	uint64_t ticks = 0;
+	uint32_t maxTicks = 0;
+};
+
+int main(int argc, char** argv) {
+	if (argc < 2 || argc > 3) {
+		printf("usage: dxgi-trace <input.trace> [output.json]\n");
+		return 1;
+	}
+
+	auto input = openTraceFile(argv[1], "rb");
+	if (input == nullptr) {
+		printf("failed to open %s\n", argv[1]);
+		return 1;
+	}
+	TraceDump dump;
+	auto result = readTraceDump(input, &dump);
+	fclose(input);
+	if (FAILED(result)) {
+		printf("failed to read %s (0x%08x)\n", argv[1], static_cast<uint32_t>(result));
+		return 1;
+	}
+
+	std::vector<SiteSummary> summaries(dump.sites.size());
+	for (auto& record : dump.records) {
+		auto& summary = summaries[record.site];
+		summary.calls++;
+		summary.failures += FAILED(record.result) ? 1 : 0;
+		summary.ticks += record.duration;
+		summary.maxTicks = record.duration > summary.maxTicks ? record.duration : summary.maxTicks;
+	}
+	printf("records: %zu dropped: %llu\n", dump.records.size(), static_cast<unsigned long long>(dump.dropped));
+	for (size_t i = 0; i < dump.sites.size(); i++) {
+		auto& site = dump.sites[i];
+		auto& summary = summaries[i];
+		if (summary.calls == 0) {
+			continue;
+		}
+		printf("%8llu calls %4llu failed %10.3f ms total %8.3f ms max  %s:%u %s\n",
+			static_cast<unsigned long long>(summary.calls),
+			static_cast<unsigned long long>(summary.failures),
+			ticksToMillis(static_cast<int64_t>(summary.ticks), dump.frequency),
+			ticksToMillis(summary.maxTicks, dump.frequency),
+			site.file.c_str(), site.line, site.call.c_str());
+	}
+
+	if (argc == 3) {
+		auto output = openTraceFile(argv[2], "w");
+		if (output == nullptr) {
+			printf("failed to open %s\n", argv[2]);
+			return 1;
+		}
+		result = writeChromeTrace(output, dump);
+		if (fclose(output) != 0 || FAILED(result)) {
+			printf("failed to write %s\n", argv[2]);
+			return 1;
+		}
+	}
+	return 0;
+}
\ No newline at end of file